@@ -33,7 +33,7 @@
 
 #include <utUtil/Logging.h>
 #include <utUtil/Exception.h>
-#include <utMath/Graph/Munkres.h>
+#include <utMath/Graph/LinearAssignment.h>
 #include <utMath/Optimization/LevenbergMarquardt.h>
 #include <utAlgorithm/Function/SinglePointMultiProjection.h>
 
@@ -246,7 +246,7 @@ std::vector< Math::Vector< T, 3 > > reconstruct3DPointsImpl( const std::vector<
 		}
 	}
 
-	Math::Graph::Munkres< T > m( matrix );
+	Math::Graph::LinearAssignment< T > m( matrix );
 	m.solve();
 	std::vector< std::size_t > matchList = m.getRowMatchList();
 
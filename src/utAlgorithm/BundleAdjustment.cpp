@@ -60,6 +60,114 @@ namespace Ubitrack { namespace Algorithm {
 #ifdef HAVE_LAPACK
 
 
+/**
+ * @internal projects a single 3D point into a camera and computes the jacobian blocks
+ * of the projection wrt. the camera (quaternion + translation) and the point parameters.
+ *
+ * @param input parameter vector, 7 values per camera followed by 3 values per point
+ * @param camIndex index of the first camera parameter in \c input
+ * @param pointIndex index of the first point parameter in \c input
+ * @param pose the camera pose, equivalent to the camera parameters
+ * @param result the dehomogenized projection
+ * @param jCam 2x7 jacobian wrt. the camera parameters
+ * @param jPoint 2x3 jacobian wrt. the point parameters
+ */
+template< class VType, class VT >
+void projectionWithJacobian( const VT& input, const std::size_t camIndex, const std::size_t pointIndex, const Math::Pose& pose
+	, Math::Vector< VType, 2 >& result, Math::Matrix< VType, 2, 7 >& jCam, Math::Matrix< VType, 2, 3 >& jPoint )
+{
+	const VType qx = input( camIndex + 0 );
+	const VType qy = input( camIndex + 1 );
+	const VType qz = input( camIndex + 2 );
+	const VType qw = input( camIndex + 3 );
+	const VType tx = input( camIndex + 4 );
+	const VType ty = input( camIndex + 5 );
+	const VType tz = input( camIndex + 6 );
+
+	// fetch x, y and z coordinate of 3D point from vector
+	const VType x = input( pointIndex + 0 );
+	const VType y = input( pointIndex + 1 );
+	const VType z = input( pointIndex + 2 );
+	
+	Math::Vector< VType, 3 > pts ( x, y, z );
+	pts = pose * pts;
+	result( 0 ) = pts( 0 ) / pts( 2 );
+	result( 1 ) = pts( 1 ) / pts( 2 );
+	
+	const VType t2 = qw*qw;
+	const VType t3 = qx*qx;
+	const VType t4 = qy*qy;
+	const VType t5 = qz*qz;
+	const VType t6 = qw*qy*2;
+	const VType t7 = t2-t3-t4+t5;
+	const VType t8 = t7*z;
+	const VType t9 = qx*qz*2;
+	const VType t10 = qw*qx*2;
+	const VType t11 = qy*qz*2;
+	const VType t12 = t10+t11;
+	const VType t13 = t12*y;
+	const VType t14 = t6-t9;
+	const VType t23 = t14*x;
+	const VType t15 = t8+t13-t23+tz;
+	const VType t16 = t2+t3-t4-t5;
+	const VType t17 = t16*x;
+	const VType t18 = qw*qz*2;
+	const VType t33 = qx*qy*2;
+	const VType t19 = t18-t33;
+	const VType t20 = t6+t9;
+	const VType t21 = t20*z;
+	const VType t34 = t19*y;
+	const VType t22 = t17+t21-t34+tx;
+	const VType t24 = 1/(t15*t15);
+	const VType t25 = qz*x*2;
+	const VType t26 = qw*y*2;
+	const VType t43 = qx*z*2;
+	const VType t27 = t25+t26-t43;
+	const VType t28 = 1/t15;
+	const VType t29 = qx*x*2;
+	const VType t30 = qy*y*2;
+	const VType t31 = qz*z*2;
+	const VType t32 = t29+t30+t31;
+	const VType t35 = qw*x*2;
+	const VType t36 = qy*z*2;
+	const VType t44 = qz*y*2;
+	const VType t37 = t35+t36-t44;
+	const VType t38 = qx*y*2;
+	const VType t39 = qw*z*2;
+	const VType t41 = qy*x*2;
+	const VType t40 = t38+t39-t41;
+	const VType t42 = t28*t40;
+	const VType t45 = t2-t3+t4-t5;
+	const VType t46 = t45*y;
+	const VType t47 = t18+t33;
+	const VType t48 = t47*x;
+	const VType t49 = t10-t11;
+	const VType t52 = t49*z;
+	const VType t50 = t46+t48-t52+ty;
+	const VType t51 = t28*t37;
+	jCam( 0, 0 ) = t32/(t8+t13+tz-x*(t6-qx*qz*2))-t22*t24*t27;
+	jCam( 0, 1 ) = t42+t22*t24*t37;
+	jCam( 0, 2 ) = -t27*t28-t22*t24*t32;
+	jCam( 0, 3 ) = t51-t22*t24*t40;
+	jCam( 0, 4 ) = t28;
+	jCam( 0, 5 ) = 0;
+	jCam( 0, 6 ) = -t22*t24;
+	jPoint( 0, 0 ) = t16*t28+t14*t22*t24;
+	jPoint( 0, 1 ) = -t19*t28-t12*t22*t24;
+	jPoint( 0, 2 ) = t20*t28-t7*t22*t24;
+	jCam( 1, 0 ) = -t42-t24*t27*t50;
+	jCam( 1, 1 ) = t28*t32+t24*t37*t50;
+	jCam( 1, 2 ) = t51-t24*t32*t50;
+	jCam( 1, 3 ) = t27*t28-t24*t40*t50;
+	jCam( 1, 4 ) = 0;
+	jCam( 1, 5 ) = t28;
+	jCam( 1, 6 ) = -t24*t50;
+	jPoint( 1, 0 ) = t28*t47+t14*t24*t50;
+	jPoint( 1, 1 ) = t28*t45-t12*t24*t50;
+	jPoint( 1, 2 ) = -t28*t49-t7*t24*t50;
+}
+
+
 template< class VType >
 class MinimizeReprojectionErrorAllPoints
 {
@@ -104,107 +212,27 @@ public:
 		
 		J = Math::Matrix< VType >::zeros( J.size1(), J.size2() );
 				
+		Math::Vector< VType, 2 > projected;
+		Math::Matrix< VType, 2, 7 > jCam;
+		Math::Matrix< VType, 2, 3 > jPoint;
+		
 		std::size_t row_index = 0;
-		std::size_t index_cam = 0;
 		std::size_t start_index_3d_pts = n_cams*7;
 		for( std::size_t iter_c( 0 ); iter_c < n_cams; ++iter_c )// für alle cameras
 		{
 			const std::size_t camIndex = iter_c*7;
-			const VType qx = input( camIndex + 0 );
-			const VType qy = input( camIndex + 1 );
-			const VType qz = input( camIndex + 2 );
-			const VType qw = input( camIndex + 3 );
-			const VType tx = input( camIndex + 4 );
-			const VType ty = input( camIndex + 5 );
-			const VType tz = input( camIndex + 6 );
-			
-			const Math::Pose pose( Math::Quaternion( qx, qy, qz, qw ), Math::Vector< VType, 3 >( tx, ty, tz ) );
+			const Math::Pose pose( Math::Quaternion( input( camIndex + 0 ), input( camIndex + 1 ), input( camIndex + 2 ), input( camIndex + 3 ) )
+				, Math::Vector< VType, 3 >( input( camIndex + 4 ), input( camIndex + 5 ), input( camIndex + 6 ) ) );
 
 			for ( std::size_t iter_p( 0 ); iter_p < n_pts3D; ++iter_p, row_index += 2 )
 			{
-				// fetch x, y and z coordinate of 3D point from vector
 				const std::size_t pointIndex = start_index_3d_pts + (iter_p*3);
-				const VType x = input( pointIndex + 0 );
-				const VType y = input( pointIndex + 1 );
-				const VType z = input( pointIndex + 2 );
-				
-				Math::Vector< VType, 3 > pts ( x, y, z );
-				pts = pose * pts;
-				result( row_index + 0 ) = pts( 0 ) / pts( 2 );
-				result( row_index + 1 ) = pts( 1 ) / pts( 2 );
+				projectionWithJacobian( input, camIndex, pointIndex, pose, projected, jCam, jPoint );
 				
-				const std::size_t jrow0 = row_index;
-				const std::size_t jrow1 = jrow0 + 1;
-				
-				const VType t2 = qw*qw;
-				const VType t3 = qx*qx;
-				const VType t4 = qy*qy;
-				const VType t5 = qz*qz;
-				const VType t6 = qw*qy*2;
-				const VType t7 = t2-t3-t4+t5;
-				const VType t8 = t7*z;
-				const VType t9 = qx*qz*2;
-				const VType t10 = qw*qx*2;
-				const VType t11 = qy*qz*2;
-				const VType t12 = t10+t11;
-				const VType t13 = t12*y;
-				const VType t14 = t6-t9;
-				const VType t23 = t14*x;
-				const VType t15 = t8+t13-t23+tz;
-				const VType t16 = t2+t3-t4-t5;
-				const VType t17 = t16*x;
-				const VType t18 = qw*qz*2;
-				const VType t33 = qx*qy*2;
-				const VType t19 = t18-t33;
-				const VType t20 = t6+t9;
-				const VType t21 = t20*z;
-				const VType t34 = t19*y;
-				const VType t22 = t17+t21-t34+tx;
-				const VType t24 = 1/(t15*t15);
-				const VType t25 = qz*x*2;
-				const VType t26 = qw*y*2;
-				const VType t43 = qx*z*2;
-				const VType t27 = t25+t26-t43;
-				const VType t28 = 1/t15;
-				const VType t29 = qx*x*2;
-				const VType t30 = qy*y*2;
-				const VType t31 = qz*z*2;
-				const VType t32 = t29+t30+t31;
-				const VType t35 = qw*x*2;
-				const VType t36 = qy*z*2;
-				const VType t44 = qz*y*2;
-				const VType t37 = t35+t36-t44;
-				const VType t38 = qx*y*2;
-				const VType t39 = qw*z*2;
-				const VType t41 = qy*x*2;
-				const VType t40 = t38+t39-t41;
-				const VType t42 = t28*t40;
-				const VType t45 = t2-t3+t4-t5;
-				const VType t46 = t45*y;
-				const VType t47 = t18+t33;
-				const VType t48 = t47*x;
-				const VType t49 = t10-t11;
-				const VType t52 = t49*z;
-				const VType t50 = t46+t48-t52+ty;
-				const VType t51 = t28*t37;
-				J( jrow0, camIndex + 0 ) = t32/(t8+t13+tz-x*(t6-qx*qz*2))-t22*t24*t27;
-				J( jrow0, camIndex + 1 ) = t42+t22*t24*t37;
-				J( jrow0, camIndex + 2 ) = -t27*t28-t22*t24*t32;
-				J( jrow0, camIndex + 3 ) = t51-t22*t24*t40;
-				J( jrow0, camIndex + 4 ) = t28;
-				J( jrow0, camIndex + 6 ) = -t22*t24;
-				J( jrow0,  pointIndex + 0 ) = t16*t28+t14*t22*t24;
-				J( jrow0,  pointIndex + 1 ) = -t19*t28-t12*t22*t24;
-				J( jrow0,  pointIndex + 2 ) = t20*t28-t7*t22*t24;
-				J( jrow1, camIndex + 0 ) = -t42-t24*t27*t50;
-				J( jrow1, camIndex + 1 ) = t28*t32+t24*t37*t50;
-				J( jrow1, camIndex + 2 ) = t51-t24*t32*t50;
-				J( jrow1, camIndex + 3 ) = t27*t28-t24*t40*t50;
-				J( jrow1, camIndex + 5 ) = t28;
-				J( jrow1, camIndex + 6 ) = -t24*t50;
-				J( jrow1,  pointIndex + 0 ) = t28*t47+t14*t24*t50;
-				J( jrow1,  pointIndex + 1 ) = t28*t45-t12*t24*t50;
-				J( jrow1,  pointIndex + 2 ) = -t28*t49-t7*t24*t50;
+				result( row_index + 0 ) = projected( 0 );
+				result( row_index + 1 ) = projected( 1 );
+				ublas::subrange( J, row_index, row_index + 2, camIndex, camIndex + 7 ) = jCam;
+				ublas::subrange( J, row_index, row_index + 2, pointIndex, pointIndex + 3 ) = jPoint;
 			}
 		}
 		
@@ -213,6 +241,356 @@ public:
 	}
 };
 
+/**
+ * @internal inverts a symmetric positive definite 3x3 matrix
+ * @return false if the matrix is singular
+ */
+template< class VType >
+bool invertSymmetric3x3( const Math::Matrix< VType, 3, 3 >& m, Math::Matrix< VType, 3, 3 >& inv )
+{
+	const VType c00 = m( 1, 1 ) * m( 2, 2 ) - m( 1, 2 ) * m( 2, 1 );
+	const VType c01 = m( 1, 2 ) * m( 2, 0 ) - m( 1, 0 ) * m( 2, 2 );
+	const VType c02 = m( 1, 0 ) * m( 2, 1 ) - m( 1, 1 ) * m( 2, 0 );
+	const VType det = m( 0, 0 ) * c00 + m( 0, 1 ) * c01 + m( 0, 2 ) * c02;
+	if ( det == VType( 0 ) )
+		return false;
+
+	const VType f = VType( 1 ) / det;
+	inv( 0, 0 ) = f * c00;
+	inv( 0, 1 ) = inv( 1, 0 ) = f * c01;
+	inv( 0, 2 ) = inv( 2, 0 ) = f * c02;
+	inv( 1, 1 ) = f * ( m( 0, 0 ) * m( 2, 2 ) - m( 0, 2 ) * m( 2, 0 ) );
+	inv( 1, 2 ) = inv( 2, 1 ) = f * ( m( 0, 2 ) * m( 1, 0 ) - m( 0, 0 ) * m( 1, 2 ) );
+	inv( 2, 2 ) = f * ( m( 0, 0 ) * m( 1, 1 ) - m( 0, 1 ) * m( 1, 0 ) );
+	return true;
+}
+
+
+/**
+ * @internal Levenberg-Marquardt optimizer for the bundle adjustment problem that exploits
+ * the block structure of the jacobian.
+ *
+ * Only the 2x7 camera and 2x3 point blocks of every observation are stored. In each step the
+ * point parameters are eliminated from the normal equations (Schur complement), the reduced
+ * camera system is solved with a dense cholesky decomposition and the point updates are
+ * computed by back-substitution. Memory grows linearly with the number of observations and
+ * the cost is dominated by the reduced camera system instead of the number of points.
+ *
+ * The parameter and measurement vectors have the same layout as for
+ * \c MinimizeReprojectionErrorAllPoints, the damping strategy is the same as in
+ * \c Math::Optimization::levenbergMarquardt. If the cholesky decomposition of the reduced
+ * camera system fails, the remaining steps are solved with a SVD instead.
+ */
+template< class VType >
+class SparseBundleAdjustmentSolver
+{
+public:
+	typedef typename Math::Matrix< VType >::base_type MatType;
+	typedef typename Math::Vector< VType >::base_type VecType;
+
+	/**
+	 * @param cams number of cameras
+	 * @param points number of 3D points
+	 * @param pointCount number of observations per camera, observation \c j of a camera refers to point \c j.
+	 *   The measurement vector contains all observations, those of points beyond \c points are skipped.
+	 */
+	SparseBundleAdjustmentSolver( const std::size_t cams, const std::size_t points, const std::vector< std::size_t >& pointCount )
+		: n_cams( cams )
+		, n_pts3D( points )
+		, m_pointObservations( points )
+	{
+		std::size_t iMeasurement = 0;
+		for ( std::size_t iCam = 0; iCam < n_cams; ++iCam )
+			for ( std::size_t iPoint = 0; iPoint < pointCount[ iCam ]; ++iPoint, iMeasurement += 2 )
+			{
+				if ( iPoint >= n_pts3D )
+					continue;
+				m_pointObservations[ iPoint ].push_back( m_observations.size() );
+				m_observations.push_back( Observation( iCam, iPoint, iMeasurement ) );
+			}
+
+		const std::size_t n_obs = m_observations.size();
+		m_jCam.resize( n_obs );
+		m_jPoint.resize( n_obs );
+		m_residuals.resize( n_obs );
+		m_jCam2.resize( n_obs );
+		m_jPoint2.resize( n_obs );
+		m_residuals2.resize( n_obs );
+		m_W.resize( n_obs );
+		m_Y.resize( n_obs );
+		m_U.resize( n_cams );
+		m_V.resize( n_pts3D );
+		m_Vinv.resize( n_pts3D );
+	}
+
+	/** number of observations used in the optimization */
+	std::size_t observations() const
+	{ return m_observations.size(); }
+
+	/**
+	 * @param params initial parameters on entry, optimized parameters on exit
+	 * @param measurement the measurement vector
+	 * @param terminationCriteria functor that returns true if the optimization should terminate
+	 * @param fStepSize initial damping
+	 * @param fStepFactor factor by which the damping is changed after each step
+	 * @return the residual of the optimization process
+	 */
+	template< class TC >
+	VType optimize( VecType& params, const VecType& measurement, const TC& terminationCriteria
+		, const VType fStepSize = 1.0, const VType fStepFactor = 10.0 )
+	{
+		namespace lapack = boost::numeric::bindings::lapack;
+
+		const std::size_t n_camParams = 7 * n_cams;
+		MatType reducedSystem( n_camParams, n_camParams );
+		VecType reducedRhs( n_camParams );
+		VecType newParams( params.size() );
+		VecType singularValues( n_camParams );
+		VecType work( 5 * n_camParams );
+		bool bUseSvd = false;
+
+		VType fErrPrev = evaluate( params, measurement, m_residuals, m_jCam, m_jPoint );
+		OPT_LOG_DEBUG( "Sparse bundle adjustment residual 0: " << fErrPrev );
+
+		VType fLambda = fStepSize;
+		std::size_t iteration = 0;
+		bool bTerminate = false;
+		while ( !bTerminate )
+		{
+			++iteration;
+
+			// camera update in reducedRhs
+			buildReducedSystem( fLambda, reducedSystem, reducedRhs );
+			if ( !bUseSvd )
+			{
+				if ( lapack::posv( 'L', reducedSystem, reducedRhs ) != 0 )
+				{
+					OPT_LOG_DEBUG( "Error in cholesky decomposition, switching to SVD" );
+					bUseSvd = true;
+					continue;
+				}
+			}
+			else
+			{
+				int rank;
+				if ( lapack::gelss( reducedSystem, reducedRhs, singularValues, VType( -1 ), rank, work ) != 0 )
+					UBITRACK_THROW( "lapack::gelss returned an error" );
+				OPT_LOG_DEBUG( "Effective rank: " << rank );
+			}
+
+			// camera updates
+			for ( std::size_t i = 0; i < n_camParams; ++i )
+				newParams( i ) = params( i ) + reducedRhs( i );
+
+			// back-substitution of the point updates
+			for ( std::size_t iPoint = 0; iPoint < n_pts3D; ++iPoint )
+			{
+				VType rhs[ 3 ] = { m_eb[ iPoint ]( 0 ), m_eb[ iPoint ]( 1 ), m_eb[ iPoint ]( 2 ) };
+				const std::vector< std::size_t >& obs( m_pointObservations[ iPoint ] );
+				for ( std::vector< std::size_t >::const_iterator it = obs.begin(); it != obs.end(); ++it )
+				{
+					const Math::Matrix< VType, 7, 3 >& W( m_W[ *it ] );
+					const std::size_t camIndex = 7 * m_observations[ *it ].iCam;
+					for ( std::size_t b = 0; b < 3; ++b )
+						for ( std::size_t a = 0; a < 7; ++a )
+							rhs[ b ] -= W( a, b ) * reducedRhs( camIndex + a );
+				}
+
+				const std::size_t pointIndex = n_camParams + 3 * iPoint;
+				for ( std::size_t a = 0; a < 3; ++a )
+					newParams( pointIndex + a ) = params( pointIndex + a ) 
+						+ m_Vinv[ iPoint ]( a, 0 ) * rhs[ 0 ] + m_Vinv[ iPoint ]( a, 1 ) * rhs[ 1 ] + m_Vinv[ iPoint ]( a, 2 ) * rhs[ 2 ];
+			}
+
+			// compute new error
+			const VType fErr = evaluate( newParams, measurement, m_residuals2, m_jCam2, m_jPoint2 );
+			OPT_LOG_DEBUG( "Sparse bundle adjustment residual " << iteration << ": " << fErr );
+
+			// check if we should terminate
+			bTerminate = terminationCriteria( iteration, fErr, fErrPrev );
+
+			// update parameters
+			if ( fErr >= fErrPrev )
+				fLambda *= fStepFactor;
+			else
+			{
+				fLambda /= fStepFactor;
+				params.swap( newParams );
+				m_residuals.swap( m_residuals2 );
+				m_jCam.swap( m_jCam2 );
+				m_jPoint.swap( m_jPoint2 );
+				fErrPrev = fErr;
+			}
+		}
+
+		return fErrPrev;
+	}
+
+protected:
+
+	/// @internal camera and point index of a single 2D observation
+	struct Observation
+	{
+		Observation( const std::size_t cam, const std::size_t point, const std::size_t measurement )
+			: iCam( cam )
+			, iPoint( point )
+			, iMeasurement( measurement )
+		{}
+
+		std::size_t iCam;
+		std::size_t iPoint;
+		
+		/// index of the observed 2D point in the measurement vector
+		std::size_t iMeasurement;
+	};
+
+	/**
+	 * computes the residuals and jacobian blocks of all observations
+	 * @return squared residual
+	 */
+	VType evaluate( const VecType& params, const VecType& measurement, std::vector< Math::Vector< VType, 2 > >& residuals
+		, std::vector< Math::Matrix< VType, 2, 7 > >& jCam, std::vector< Math::Matrix< VType, 2, 3 > >& jPoint ) const
+	{
+		VType fErr = 0;
+		Math::Vector< VType, 2 > projected;
+		std::size_t iCamPrev = n_cams;
+		Math::Pose pose;
+		for ( std::size_t k = 0; k < m_observations.size(); ++k )
+		{
+			const std::size_t camIndex = 7 * m_observations[ k ].iCam;
+			if ( m_observations[ k ].iCam != iCamPrev )
+			{
+				iCamPrev = m_observations[ k ].iCam;
+				pose = Math::Pose( Math::Quaternion( params( camIndex + 0 ), params( camIndex + 1 ), params( camIndex + 2 ), params( camIndex + 3 ) )
+					, Math::Vector< VType, 3 >( params( camIndex + 4 ), params( camIndex + 5 ), params( camIndex + 6 ) ) );
+			}
+
+			const std::size_t pointIndex = 7 * n_cams + 3 * m_observations[ k ].iPoint;
+			projectionWithJacobian( params, camIndex, pointIndex, pose, projected, jCam[ k ], jPoint[ k ] );
+
+			const std::size_t iMeasurement = m_observations[ k ].iMeasurement;
+			residuals[ k ]( 0 ) = measurement( iMeasurement + 0 ) - projected( 0 );
+			residuals[ k ]( 1 ) = measurement( iMeasurement + 1 ) - projected( 1 );
+			fErr += residuals[ k ]( 0 ) * residuals[ k ]( 0 ) + residuals[ k ]( 1 ) * residuals[ k ]( 1 );
+		}
+		return fErr;
+	}
+
+	/** builds the damped normal equations and eliminates the point parameters */
+	void buildReducedSystem( const VType fLambda, MatType& S, VecType& rhs )
+	{
+		const std::size_t n_camParams = 7 * n_cams;
+
+		// block diagonals and gradients
+		m_ea.assign( n_cams, Math::Vector< VType, 7 >( Math::Vector< VType, 7 >::zeros() ) );
+		m_eb.assign( n_pts3D, Math::Vector< VType, 3 >( Math::Vector< VType, 3 >::zeros() ) );
+		std::fill( m_U.begin(), m_U.end(), Math::Matrix< VType, 7, 7 >::zeros() );
+		std::fill( m_V.begin(), m_V.end(), Math::Matrix< VType, 3, 3 >::zeros() );
+
+		for ( std::size_t k = 0; k < m_observations.size(); ++k )
+		{
+			const Math::Matrix< VType, 2, 7 >& A( m_jCam[ k ] );
+			const Math::Matrix< VType, 2, 3 >& B( m_jPoint[ k ] );
+			const Math::Vector< VType, 2 >& r( m_residuals[ k ] );
+			Math::Matrix< VType, 7, 7 >& U( m_U[ m_observations[ k ].iCam ] );
+			Math::Matrix< VType, 3, 3 >& V( m_V[ m_observations[ k ].iPoint ] );
+			Math::Vector< VType, 7 >& ea( m_ea[ m_observations[ k ].iCam ] );
+			Math::Vector< VType, 3 >& eb( m_eb[ m_observations[ k ].iPoint ] );
+			Math::Matrix< VType, 7, 3 >& W( m_W[ k ] );
+
+			for ( std::size_t a = 0; a < 7; ++a )
+			{
+				for ( std::size_t b = 0; b < 7; ++b )
+					U( a, b ) += A( 0, a ) * A( 0, b ) + A( 1, a ) * A( 1, b );
+				for ( std::size_t b = 0; b < 3; ++b )
+					W( a, b ) = A( 0, a ) * B( 0, b ) + A( 1, a ) * B( 1, b );
+				ea( a ) += A( 0, a ) * r( 0 ) + A( 1, a ) * r( 1 );
+			}
+			for ( std::size_t a = 0; a < 3; ++a )
+			{
+				for ( std::size_t b = 0; b < 3; ++b )
+					V( a, b ) += B( 0, a ) * B( 0, b ) + B( 1, a ) * B( 1, b );
+				eb( a ) += B( 0, a ) * r( 0 ) + B( 1, a ) * r( 1 );
+			}
+		}
+
+		// damped camera blocks on the diagonal
+		S.clear();
+		for ( std::size_t iCam = 0; iCam < n_cams; ++iCam )
+			for ( std::size_t a = 0; a < 7; ++a )
+			{
+				for ( std::size_t b = 0; b < 7; ++b )
+					S( 7 * iCam + a, 7 * iCam + b ) = m_U[ iCam ]( a, b );
+				S( 7 * iCam + a, 7 * iCam + a ) += fLambda;
+				rhs( 7 * iCam + a ) = m_ea[ iCam ]( a );
+			}
+
+		// Schur complement of the damped point blocks
+		for ( std::size_t iPoint = 0; iPoint < n_pts3D; ++iPoint )
+		{
+			Math::Matrix< VType, 3, 3 > V( m_V[ iPoint ] );
+			for ( std::size_t a = 0; a < 3; ++a )
+				V( a, a ) += fLambda;
+			if ( !invertSymmetric3x3( V, m_Vinv[ iPoint ] ) )
+				m_Vinv[ iPoint ] = Math::Matrix< VType, 3, 3 >::zeros();
+
+			const std::vector< std::size_t >& obs( m_pointObservations[ iPoint ] );
+			for ( std::vector< std::size_t >::const_iterator it = obs.begin(); it != obs.end(); ++it )
+			{
+				// Y = W * V^-1
+				const Math::Matrix< VType, 7, 3 >& W( m_W[ *it ] );
+				Math::Matrix< VType, 7, 3 >& Y( m_Y[ *it ] );
+				for ( std::size_t a = 0; a < 7; ++a )
+					for ( std::size_t b = 0; b < 3; ++b )
+						Y( a, b ) = W( a, 0 ) * m_Vinv[ iPoint ]( 0, b ) + W( a, 1 ) * m_Vinv[ iPoint ]( 1, b ) + W( a, 2 ) * m_Vinv[ iPoint ]( 2, b );
+
+				const std::size_t iRow = 7 * m_observations[ *it ].iCam;
+				for ( std::size_t a = 0; a < 7; ++a )
+					rhs( iRow + a ) -= Y( a, 0 ) * m_eb[ iPoint ]( 0 ) + Y( a, 1 ) * m_eb[ iPoint ]( 1 ) + Y( a, 2 ) * m_eb[ iPoint ]( 2 );
+			}
+
+			// S -= Y_i * W_j^T for all pairs of cameras observing the point
+			for ( std::vector< std::size_t >::const_iterator it1 = obs.begin(); it1 != obs.end(); ++it1 )
+			{
+				const Math::Matrix< VType, 7, 3 >& Y( m_Y[ *it1 ] );
+				const std::size_t iRow = 7 * m_observations[ *it1 ].iCam;
+				for ( std::vector< std::size_t >::const_iterator it2 = obs.begin(); it2 != obs.end(); ++it2 )
+				{
+					const Math::Matrix< VType, 7, 3 >& W( m_W[ *it2 ] );
+					const std::size_t iCol = 7 * m_observations[ *it2 ].iCam;
+					for ( std::size_t b = 0; b < 7; ++b )
+						for ( std::size_t a = 0; a < 7; ++a )
+							S( iRow + a, iCol + b ) -= Y( a, 0 ) * W( b, 0 ) + Y( a, 1 ) * W( b, 1 ) + Y( a, 2 ) * W( b, 2 );
+				}
+			}
+		}
+		assert( S.size1() == n_camParams );
+	}
+
+	const std::size_t n_cams;
+	const std::size_t n_pts3D;
+
+	std::vector< Observation > m_observations;
+	std::vector< std::vector< std::size_t > > m_pointObservations;
+
+	// linearization at the current and at the tested parameters
+	std::vector< Math::Matrix< VType, 2, 7 > > m_jCam;
+	std::vector< Math::Matrix< VType, 2, 3 > > m_jPoint;
+	std::vector< Math::Vector< VType, 2 > > m_residuals;
+	std::vector< Math::Matrix< VType, 2, 7 > > m_jCam2;
+	std::vector< Math::Matrix< VType, 2, 3 > > m_jPoint2;
+	std::vector< Math::Vector< VType, 2 > > m_residuals2;
+
+	// blocks of the normal equations
+	std::vector< Math::Matrix< VType, 7, 7 > > m_U;
+	std::vector< Math::Matrix< VType, 3, 3 > > m_V;
+	std::vector< Math::Matrix< VType, 3, 3 > > m_Vinv;
+	std::vector< Math::Matrix< VType, 7, 3 > > m_W;
+	std::vector< Math::Matrix< VType, 7, 3 > > m_Y;
+	std::vector< Math::Vector< VType, 7 > > m_ea;
+	std::vector< Math::Vector< VType, 3 > > m_eb;
+};
+
 /** 
  * @tparam ForwardIterator1 iterator to container including containers of 2D observations
  * @tparam ForwardIterator2 iterator to container including extrinsic camera pose
@@ -226,6 +604,8 @@ void simpleBundleAdjustmentImpl (
 	, ForwardIterator3 i3DPtsBegin //  e.g. std::vector < Math::Vector< T, 3 > >::iterator -> begin()
 	, ForwardIterator3 i3DPtsEnd //  e.g. std::vector < Math::Vector< T, 3 > >::iterator -> end()
 	//, visibility <- next to come :)
+	, const bool bSparse = false
+	, const double fDamping = 1.0
 	)
 {
 	typedef typename std::iterator_traits< ForwardIterator3 >::value_type vector3d_type;
@@ -301,8 +681,16 @@ void simpleBundleAdjustmentImpl (
 	
 	
 	OPT_LOG_DEBUG( "Optimizing pose over " << numberCameras << " cameras using " << observationCountTotal << " observations" );
-	MinimizeReprojectionErrorAllPoints< value_type > minimizeFunc( n_cams, n_pts3D );
-	value_type res = Math::Optimization::levenbergMarquardt( minimizeFunc, paramVector, observationVector, Math::Optimization::OptTerminate( 10, 1e-6 ), Math::Optimization::OptNoNormalize() );
+	if ( bSparse )
+	{
+		SparseBundleAdjustmentSolver< value_type > solver( n_cams, n_pts3D, point_count );
+		solver.optimize( paramVector, observationVector, Math::Optimization::OptTerminate( 10, 1e-6 ), value_type( fDamping ) );
+	}
+	else
+	{
+		MinimizeReprojectionErrorAllPoints< value_type > minimizeFunc( n_cams, n_pts3D );
+		Math::Optimization::levenbergMarquardt( minimizeFunc, paramVector, observationVector, Math::Optimization::OptTerminate( 10, 1e-6 ), Math::Optimization::OptNoNormalize() );
+	}
 	
 	// LOG4CPP_TRACE( logger, "optimized parameter vector:\n" << paramVector );
 	
@@ -336,6 +724,16 @@ void simpleBundleAdjustment( const std::vector< std::vector< Math::Vector2f > >&
 	simpleBundleAdjustmentImpl( pts2D.begin(), pts2D.end(), poses.begin(), pts3D.begin(), pts3D.end() );
 }
 
+void sparseBundleAdjustment( const std::vector< std::vector< Math::Vector2d > >& pts2D, std::vector< Math::Pose >& poses, std::vector< Math::Vector3d > & pts3D, const double fDamping )
+{
+	simpleBundleAdjustmentImpl( pts2D.begin(), pts2D.end(), poses.begin(), pts3D.begin(), pts3D.end(), true, fDamping );
+}
+
+void sparseBundleAdjustment( const std::vector< std::vector< Math::Vector2f > >& pts2D,  std::vector< Math::Pose >& poses, std::vector< Math::Vector3f > & pts3D, const double fDamping )
+{
+	simpleBundleAdjustmentImpl( pts2D.begin(), pts2D.end(), poses.begin(), pts3D.begin(), pts3D.end(), true, fDamping );
+}
+
 #endif // HAVE_LAPACK
 
 } } // namespace Ubitrack::Algorithm
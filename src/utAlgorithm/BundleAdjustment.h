@@ -53,6 +53,24 @@ namespace Ubitrack { namespace Algorithm {
 UBITRACK_EXPORT void simpleBundleAdjustment( const std::vector< std::vector< Math::Vector2d > >& pts2D, std::vector< Math::Pose >& camPoses, std::vector< Math::Vector3d >& pts3D );
 
 UBITRACK_EXPORT void simpleBundleAdjustment( const std::vector< std::vector< Math::Vector2f > >& pts2D, std::vector< Math::Pose >& camPoses, std::vector< Math::Vector3f >& pts3D);
+
+/**
+ * @ingroup tracking_algorithms
+ * @brief Performs the same bundle adjustment as \c simpleBundleAdjustment using a sparse solver
+ *
+ * Instead of building the dense jacobian of all observations only the 2x7 camera and 2x3 point
+ * blocks of each observation are stored. In each Levenberg-Marquardt step the points are
+ * eliminated from the normal equations via the Schur complement and only the reduced camera
+ * system is factorized, so that the cost grows linearly with the number of points.
+ *
+ * @param pts2D \c std::vector of observations, for each camera a new \c std::vector
+ * @return camPoses \c std::vector of poses, defining the initial extrinsic camera orientations
+ * @return pts3D \c std::vector of initial 3D points , basis of the 2D observations in 1st parameter
+ * @param fDamping initial damping of the Levenberg-Marquardt steps, 0 performs undamped Gauss-Newton steps
+ */
+UBITRACK_EXPORT void sparseBundleAdjustment( const std::vector< std::vector< Math::Vector2d > >& pts2D, std::vector< Math::Pose >& camPoses, std::vector< Math::Vector3d >& pts3D, const double fDamping = 1.0 );
+
+UBITRACK_EXPORT void sparseBundleAdjustment( const std::vector< std::vector< Math::Vector2f > >& pts2D, std::vector< Math::Pose >& camPoses, std::vector< Math::Vector3f >& pts3D, const double fDamping = 1.0 );
 	
 #endif // HAVE_LAPACK
 
@@ -36,6 +36,10 @@
 
 #ifdef HAVE_LAPACK
 #include "Undistortion.h"
+#include "UndistortionMap.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #endif
 
 namespace Ubitrack { namespace Algorithm { namespace CameraLens {
@@ -64,25 +68,141 @@ void distort( const Ubitrack::Math::CameraIntrinsics< double >& mat, const std::
 
 #ifdef HAVE_LAPACK
 
+namespace {
+
+	/** maximal number of undistortion maps kept */
+	const std::size_t g_maxUndistortionMaps = 8;
+
+	/** serializes changes of the published lists */
+	boost::mutex g_undistortionMapMutex;
+
+	template< typename T >
+	struct UndistortionMaps
+	{
+		typedef std::vector< boost::shared_ptr< const UndistortionMap< T > > > List;
+
+		/** 
+		 * the current list of maps. It is never modified after publishing but replaced as a whole,
+		 * so that \c undistort can read it with an atomic load instead of locking a mutex.
+		 */
+		static boost::shared_ptr< const List >& published()
+		{
+			static boost::shared_ptr< const List > pList;
+			return pList;
+		}
+	};
+
+	/// @internal returns the undistortion map for the intrinsics or an empty pointer
+	template< typename T >
+	boost::shared_ptr< const UndistortionMap< T > > findUndistortionMap( const Math::CameraIntrinsics< T >& intrinsics )
+	{
+		const boost::shared_ptr< const typename UndistortionMaps< T >::List > pList( boost::atomic_load( &UndistortionMaps< T >::published() ) );
+		if( pList )
+			for( std::size_t i = 0; i < pList->size(); ++i )
+				if( ( *pList )[ i ]->matches( intrinsics ) )
+					return ( *pList )[ i ];
+		return boost::shared_ptr< const UndistortionMap< T > >();
+	}
+
+	template< typename T >
+	bool enableUndistortionMapImpl( const Math::CameraIntrinsics< T >& intrinsics, const T tolerance )
+	{
+		if( intrinsics.dimension( 0 ) == 0 || intrinsics.dimension( 1 ) == 0 )
+			UBITRACK_THROW( "Undistortion map needs the image dimension of the camera intrinsics" );
+
+		// build outside of the lock, this takes a while
+		boost::shared_ptr< const UndistortionMap< T > > pMap( new UndistortionMap< T >( intrinsics, tolerance ) );
+		if( pMap->maxError() > tolerance )
+			return false;
+
+		typedef typename UndistortionMaps< T >::List List;
+		boost::mutex::scoped_lock lock( g_undistortionMapMutex );
+		const boost::shared_ptr< const List > pOld( boost::atomic_load( &UndistortionMaps< T >::published() ) );
+		boost::shared_ptr< List > pNew( pOld ? new List( *pOld ) : new List );
+
+		std::size_t i = 0;
+		while( i < pNew->size() && !( *pNew )[ i ]->matches( intrinsics ) )
+			++i;
+		if( i < pNew->size() )
+			( *pNew )[ i ] = pMap;
+		else
+		{
+			if( pNew->size() >= g_maxUndistortionMaps )
+				pNew->erase( pNew->begin() );
+			pNew->push_back( pMap );
+		}
+
+		boost::atomic_store( &UndistortionMaps< T >::published(), boost::shared_ptr< const List >( pNew ) );
+		return true;
+	}
+
+	template< typename T >
+	void undistortImpl( const Math::CameraIntrinsics< T >& mat, const Math::Vector< T, 2 >& distorted, Math::Vector< T, 2 >& undistorted )
+	{
+		boost::shared_ptr< const UndistortionMap< T > > pMap( findUndistortionMap( mat ) );
+		if( pMap )
+			pMap->undistort( distorted, undistorted );
+		else
+			undistort_impl( mat, distorted, undistorted );
+	}
+
+	template< typename T >
+	void undistortImpl( const Math::CameraIntrinsics< T >& mat, const std::vector< Math::Vector< T, 2 > >& distorted, std::vector< Math::Vector< T, 2 > >& undistorted )
+	{
+		boost::shared_ptr< const UndistortionMap< T > > pMap( findUndistortionMap( mat ) );
+		if( pMap )
+			pMap->undistort( distorted, undistorted );
+		else
+			undistort_impl( mat, distorted, undistorted );
+	}
+
+} // anonymous namespace
 
 void undistort( const Ubitrack::Math::CameraIntrinsics< float >& mat, const Math::Vector2f& distorted, Math::Vector2f& undistorted )
 {
-	undistort_impl( mat, distorted, undistorted );
+	undistortImpl( mat, distorted, undistorted );
 }
 
 void undistort( const Ubitrack::Math::CameraIntrinsics< double >& mat, const Math::Vector2d& distorted, Math::Vector2d& undistorted )
 {
-	undistort_impl( mat, distorted, undistorted );
+	undistortImpl( mat, distorted, undistorted );
 }
 
 void undistort( const Ubitrack::Math::CameraIntrinsics< float >& mat, const std::vector< Math::Vector2f >& distorted, std::vector< Math::Vector2f >& undistorted )
 {
-	undistort_impl( mat, distorted, undistorted );	
+	undistortImpl( mat, distorted, undistorted );	
 }
 
 void undistort( const Ubitrack::Math::CameraIntrinsics< double >& mat, const std::vector< Math::Vector2d >& distorted, std::vector< Math::Vector2d >& undistorted )
 {
-	undistort_impl( mat, distorted, undistorted );
+	undistortImpl( mat, distorted, undistorted );
+}
+
+bool enableUndistortionMap( const Math::CameraIntrinsics< float >& intrinsics, const float tolerance )
+{
+	return enableUndistortionMapImpl( intrinsics, tolerance );
+}
+
+bool enableUndistortionMap( const Math::CameraIntrinsics< double >& intrinsics, const double tolerance )
+{
+	return enableUndistortionMapImpl( intrinsics, tolerance );
+}
+
+boost::shared_ptr< const UndistortionMap< float > > getUndistortionMap( const Math::CameraIntrinsics< float >& intrinsics )
+{
+	return findUndistortionMap( intrinsics );
+}
+
+boost::shared_ptr< const UndistortionMap< double > > getUndistortionMap( const Math::CameraIntrinsics< double >& intrinsics )
+{
+	return findUndistortionMap( intrinsics );
+}
+
+void disableUndistortionMaps()
+{
+	boost::mutex::scoped_lock lock( g_undistortionMapMutex );
+	boost::atomic_store( &UndistortionMaps< float >::published(), boost::shared_ptr< const UndistortionMaps< float >::List >() );
+	boost::atomic_store( &UndistortionMaps< double >::published(), boost::shared_ptr< const UndistortionMaps< double >::List >() );
 }
 	
 #endif
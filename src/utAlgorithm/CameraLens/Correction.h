@@ -35,6 +35,8 @@
 
 #include <vector>	// std::vector
 
+#include <boost/shared_ptr.hpp>
+
 #include <utCore.h>
 #include <utMath/Vector.h>
 #include <utMath/Matrix.h>
@@ -42,6 +44,8 @@
 
 namespace Ubitrack { namespace Algorithm { namespace CameraLens {
 
+template< typename T > class UndistortionMap;
+
 /**
  * apply lens distortion to a point given in image coordinates
  *
@@ -142,6 +146,50 @@ UBITRACK_EXPORT void undistort( const Math::CameraIntrinsics< float >& intrinsic
  * For further information on this algorithm see void undistort( const Math::CameraIntrinsics< float >& intrinsics, const Math::Vector2f& distorted, Math::Vector2f& undistorted );
  */
 UBITRACK_EXPORT void undistort( const Math::CameraIntrinsics< double >& intrinsics, const std::vector< Math::Vector2d >& distorted, std::vector< Math::Vector2d >& undistorted );
+
+/**
+ * Precomputes an undistortion lookup map for a camera.
+ *
+ * Afterwards all calls of \c undistort with exactly the same intrinsics use the map
+ * ( see \c UndistortionMap ) instead of the non-linear optimization per point.
+ * The intrinsics need to contain the image dimension. A small number of maps is kept,
+ * enabling a map for another camera may discard the least recently enabled one.
+ *
+ * The map is only used if it reaches the tolerance, otherwise \c undistort keeps
+ * using the non-linear optimization for this camera.
+ *
+ * @param intrinsics camera intrinsics parameters including the image dimension
+ * @param tolerance maximal interpolation error of the map in pixels
+ * @return \c true if the map reached the tolerance and is used
+ */
+UBITRACK_EXPORT bool enableUndistortionMap( const Math::CameraIntrinsics< float >& intrinsics, const float tolerance = 0.01f );
+
+/** 
+ * @brief overloaded function \c enableUndistortionMap with \c double precision parameters.
+ */
+UBITRACK_EXPORT bool enableUndistortionMap( const Math::CameraIntrinsics< double >& intrinsics, const double tolerance = 0.01 );
+
+/**
+ * Returns the undistortion map enabled for a camera.
+ *
+ * Callers that undistort many points or batches of the same camera can keep the map and
+ * call \c UndistortionMap::undistort directly, which skips the search of the map by intrinsics.
+ * The map stays valid as long as it is referenced, also if it is disabled in the meantime.
+ *
+ * @param intrinsics camera intrinsics parameters
+ * @return the map or an empty pointer if none is enabled for these intrinsics
+ */
+UBITRACK_EXPORT boost::shared_ptr< const UndistortionMap< float > > getUndistortionMap( const Math::CameraIntrinsics< float >& intrinsics );
+
+/** 
+ * @brief overloaded function \c getUndistortionMap with \c double precision parameters.
+ */
+UBITRACK_EXPORT boost::shared_ptr< const UndistortionMap< double > > getUndistortionMap( const Math::CameraIntrinsics< double >& intrinsics );
+
+/**
+ * Removes all undistortion maps, \c undistort uses the non-linear optimization again.
+ */
+UBITRACK_EXPORT void disableUndistortionMaps();
 	
 #endif
 	
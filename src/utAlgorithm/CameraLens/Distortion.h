@@ -129,7 +129,7 @@ inline void distort_impl( const Math::CameraIntrinsics< T >& camIntrin,  const M
 
 
 template< typename T, std::size_t N >
-inline void distort_impl( const Math::CameraIntrinsics< T > camIntrin, const std::vector< Math::Vector< T, N > >& pointsIn, std::vector< Math::Vector< T, N > >& result )
+inline void distort_impl( const Math::CameraIntrinsics< T >& camIntrin, const std::vector< Math::Vector< T, N > >& pointsIn, std::vector< Math::Vector< T, N > >& result )
 {
 	typename std::vector< Math::Vector< T, N > >::const_iterator itBegin = pointsIn.begin();
 	const typename std::vector< Math::Vector< T, N > >::const_iterator itEnd = pointsIn.end();
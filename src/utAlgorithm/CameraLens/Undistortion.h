@@ -68,7 +68,7 @@ public:
 	 
 	PointUndistortion( const Math::CameraIntrinsics< T >& cam )
 		: m_k( cam.radial_params )
-		, m_p( cam.tangential.radial_params )
+		, m_p( cam.tangential_params )
 	{}
 	
 	PointUndistortion( const Math::Vector< T, 6 >& radVec, const Math::Vector< T, 2 >& tanVec )
@@ -224,7 +224,7 @@ void undistort_impl( const Math::CameraIntrinsics< T >& mat, const Math::Vector<
 }
 
 template< typename T, std::size_t N >
-inline void undistort_impl( const Math::CameraIntrinsics< T > camIntrin, const std::vector< Math::Vector< T, N > >& pointsIn, std::vector< Math::Vector< T, N > >& result )
+inline void undistort_impl( const Math::CameraIntrinsics< T >& camIntrin, const std::vector< Math::Vector< T, N > >& pointsIn, std::vector< Math::Vector< T, N > >& result )
 {
 	typename std::vector< Math::Vector< T, N > >::const_iterator itBegin = pointsIn.begin();
 	const typename std::vector< Math::Vector< T, N > >::const_iterator itEnd = pointsIn.end();
@@ -0,0 +1,338 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup calibration
+ * @file
+ * Precomputed lookup map for fast removal of lens distortion
+ */
+
+#ifndef __UBITRACK_CALIBRATION_FUNCTION_CAMERALENS_UNDISTORTIONMAP_H_INCLUDED__
+#define __UBITRACK_CALIBRATION_FUNCTION_CAMERALENS_UNDISTORTIONMAP_H_INCLUDED__
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/CameraIntrinsics.h>
+#include "Undistortion.h"
+
+#include <cmath>		// std::ceil, std::fabs
+#include <vector>		// std::vector
+#include <algorithm>	// std::max
+#include <limits>		// std::numeric_limits
+
+#ifdef HAVE_LAPACK
+
+namespace Ubitrack { namespace Algorithm { namespace CameraLens {
+
+/**
+ * @ingroup calibration
+ * Lookup map to remove the lens distortion of image points.
+ *
+ * The map samples the undistortion function of a camera on a regular grid
+ * covering the image ( plus a small margin ) and interpolates the displacement
+ * between the distorted and the undistorted point bicubically ( Catmull-Rom ).
+ * Undistorting a point with the map therefore costs a few multiplications instead
+ * of a non-linear optimization per point.
+ *
+ * During construction the grid spacing is halved until the interpolation error,
+ * measured on a grid of sample points inside every cell, is below the requested tolerance
+ * or the minimal spacing is reached. The reached error is available via \c maxError(),
+ * it may exceed the tolerance if the minimal spacing was not fine enough.
+ *
+ * Points outside of the covered area are undistorted with \c undistort_impl.
+ *
+ * @tparam T built-in type of the coordinates ( e.g. \c double or \c float )
+ */
+template< typename T >
+class UndistortionMap
+{
+public:
+	/** type of the 2D points */
+	typedef Math::Vector< T, 2 > vector_type;
+
+	/**
+	 * Builds the undistortion map for a camera.
+	 *
+	 * @param intrinsics camera intrinsics including the image dimension (must not be zero)
+	 * @param tolerance maximal interpolation error in pixels
+	 * @param maxSpacing initial grid spacing in pixels
+	 * @param minSpacing smallest grid spacing in pixels
+	 */
+	UndistortionMap( const Math::CameraIntrinsics< T >& intrinsics, const T tolerance = static_cast< T >( 0.01 )
+		, const T maxSpacing = 32, const T minSpacing = 2 )
+		: m_tolerance( tolerance )
+		, m_maxError( 0 )
+	{
+		// CameraIntrinsics only provides an assignment operator
+		m_intrinsics = intrinsics;
+
+		const std::size_t width = std::max< std::size_t >( intrinsics.dimension( 0 ), 1 );
+		const std::size_t height = std::max< std::size_t >( intrinsics.dimension( 1 ), 1 );
+
+		T spacing = maxSpacing;
+		while( true )
+		{
+			build( width, height, spacing );
+			m_maxError = validate();
+			if( m_maxError <= tolerance || spacing * 0.5 < minSpacing )
+				break;
+			spacing *= 0.5;
+		}
+	}
+
+	/** @return the camera intrinsics the map was built for */
+	const Math::CameraIntrinsics< T >& intrinsics() const
+	{ return m_intrinsics; }
+
+	/** @return the grid spacing in pixels */
+	T spacing() const
+	{ return m_spacing; }
+
+	/** @return the maximal interpolation error measured during construction in pixels */
+	T maxError() const
+	{ return m_maxError; }
+
+	/** @return the interpolation error the map was built for in pixels */
+	T tolerance() const
+	{ return m_tolerance; }
+
+	/** @return \c true if the map was built for exactly these camera intrinsics */
+	bool matches( const Math::CameraIntrinsics< T >& intrinsics ) const
+	{
+		if( intrinsics.dimension( 0 ) != m_intrinsics.dimension( 0 ) || intrinsics.dimension( 1 ) != m_intrinsics.dimension( 1 ) )
+			return false;
+		for( std::size_t r = 0; r < 3; ++r )
+			for( std::size_t c = 0; c < 3; ++c )
+				if( intrinsics.matrix( r, c ) != m_intrinsics.matrix( r, c ) )
+					return false;
+		for( std::size_t i = 0; i < 6; ++i )
+			if( intrinsics.radial_params( i ) != m_intrinsics.radial_params( i ) )
+				return false;
+		return intrinsics.tangential_params( 0 ) == m_intrinsics.tangential_params( 0 )
+			&& intrinsics.tangential_params( 1 ) == m_intrinsics.tangential_params( 1 );
+	}
+
+	/** @return \c true if the point lies within the area covered by the map */
+	bool contains( const T x, const T y ) const
+	{
+		// the outermost nodes only support the interpolation of the neighbouring cells
+		const T fx = ( x - m_origin ) / m_spacing;
+		const T fy = ( y - m_origin ) / m_spacing;
+		return fx >= 1 && fy >= 1 && fx <= static_cast< T >( m_cols - 2 ) && fy <= static_cast< T >( m_rows - 2 );
+	}
+
+	/**
+	 * Removes the lens distortion of a single point.
+	 * @param distorted distorted point in image coordinates
+	 * @param undistorted undistorted point in image coordinates
+	 */
+	void undistort( const vector_type& distorted, vector_type& undistorted ) const
+	{
+		const T x = distorted( 0 );
+		const T y = distorted( 1 );
+		if( !lookup( x, y, undistorted( 0 ), undistorted( 1 ) ) )
+			undistort_impl( m_intrinsics, distorted, undistorted );
+	}
+
+	/**
+	 * Removes the lens distortion of several points.
+	 * @param iBegin iterator pointing to the first distorted point
+	 * @param iEnd iterator pointing behind the last distorted point
+	 * @param iOut output iterator for the undistorted points ( may be \c iBegin )
+	 */
+	template< typename ForwardIterator1, typename ForwardIterator2 >
+	void undistort( ForwardIterator1 iBegin, const ForwardIterator1 iEnd, ForwardIterator2 iOut ) const
+	{
+		vector_type undistorted;
+		for( ; iBegin != iEnd; ++iBegin, ++iOut )
+		{
+			undistort( *iBegin, undistorted );
+			*iOut = undistorted;
+		}
+	}
+
+	/**
+	 * Removes the lens distortion of several points.
+	 * @param distorted distorted points in image coordinates
+	 * @param undistorted undistorted points in image coordinates, resized if necessary
+	 */
+	void undistort( const std::vector< vector_type >& distorted, std::vector< vector_type >& undistorted ) const
+	{
+		undistorted.resize( distorted.size() );
+		undistort( distorted.begin(), distorted.end(), undistorted.begin() );
+	}
+
+protected:
+
+	/** Catmull-Rom weights of the four nodes around a position \c t in [0,1] between the two middle nodes */
+	static void cubicWeights( const T t, T w[ 4 ] )
+	{
+		const T t2 = t * t;
+		const T t3 = t2 * t;
+		w[ 0 ] = static_cast< T >( 0.5 ) * ( -t3 + 2 * t2 - t );
+		w[ 1 ] = static_cast< T >( 0.5 ) * ( 3 * t3 - 5 * t2 + 2 );
+		w[ 2 ] = static_cast< T >( 0.5 ) * ( -3 * t3 + 4 * t2 + t );
+		w[ 3 ] = static_cast< T >( 0.5 ) * ( t3 - t2 );
+	}
+
+	/** bicubic interpolation of the displacement, returns \c false outside of the grid */
+	bool lookup( const T x, const T y, T& xOut, T& yOut ) const
+	{
+		if( !contains( x, y ) )
+			return false;
+
+		const T fx = ( x - m_origin ) / m_spacing;
+		const T fy = ( y - m_origin ) / m_spacing;
+		const std::size_t c = std::min( static_cast< std::size_t >( fx ), m_cols - 3 );
+		const std::size_t r = std::min( static_cast< std::size_t >( fy ), m_rows - 3 );
+
+		T wx[ 4 ], wy[ 4 ];
+		cubicWeights( fx - static_cast< T >( c ), wx );
+		cubicWeights( fy - static_cast< T >( r ), wy );
+
+		T dx = 0;
+		T dy = 0;
+		const T* pRow = &m_displacement[ 2 * ( ( r - 1 ) * m_cols + c - 1 ) ];
+		for( std::size_t i = 0; i < 4; ++i, pRow += 2 * m_cols )
+		{
+			const T rx = wx[ 0 ] * pRow[ 0 ] + wx[ 1 ] * pRow[ 2 ] + wx[ 2 ] * pRow[ 4 ] + wx[ 3 ] * pRow[ 6 ];
+			const T ry = wx[ 0 ] * pRow[ 1 ] + wx[ 1 ] * pRow[ 3 ] + wx[ 2 ] * pRow[ 5 ] + wx[ 3 ] * pRow[ 7 ];
+			dx += wy[ i ] * rx;
+			dy += wy[ i ] * ry;
+		}
+
+		xOut = x + dx;
+		yOut = y + dy;
+		return true;
+	}
+
+	/**
+	 * Inverts the distortion of a point with Newton iterations until convergence.
+	 * The grid is sampled with a much tighter termination criterion than \c undistort_impl uses,
+	 * otherwise the optimization noise would dominate the interpolation error.
+	 */
+	void undistortExact( const vector_type& distorted, vector_type& undistorted ) const
+	{
+		const internal::PointUndistortion< T > distortion( m_intrinsics.radial_params, m_intrinsics.tangential_params );
+		vector_type target, x, current;
+		Math::Matrix< T, 2, 2 > J;
+		internal::unproject_impl( m_intrinsics, distorted, target );
+		x = target;
+		for( std::size_t i = 0; i < 20; ++i )
+		{
+			distortion.evaluateWithJacobian( current, x, J );
+			const T ex = current( 0 ) - target( 0 );
+			const T ey = current( 1 ) - target( 1 );
+			const T det = J( 0, 0 ) * J( 1, 1 ) - J( 0, 1 ) * J( 1, 0 );
+			if( det == 0 )
+				break;
+			const T dx = (  J( 1, 1 ) * ex - J( 0, 1 ) * ey ) / det;
+			const T dy = ( -J( 1, 0 ) * ex + J( 0, 0 ) * ey ) / det;
+			x( 0 ) -= dx;
+			x( 1 ) -= dy;
+			if( std::fabs( dx ) + std::fabs( dy ) < 16 * std::numeric_limits< T >::epsilon() )
+				break;
+		}
+		internal::project_impl( m_intrinsics, x, undistorted );
+	}
+
+	/** samples the undistortion function on a grid with the given spacing */
+	void build( const std::size_t width, const std::size_t height, const T spacing )
+	{
+		// one cell of margin around the image, as detected features may lie on the border,
+		// plus one row/column of nodes supporting the bicubic interpolation
+		m_spacing = spacing;
+		m_origin = -2 * spacing;
+		m_cols = static_cast< std::size_t >( std::ceil( ( width - 1 ) / spacing ) ) + 5;
+		m_rows = static_cast< std::size_t >( std::ceil( ( height - 1 ) / spacing ) ) + 5;
+		m_displacement.resize( 2 * m_cols * m_rows );
+
+		vector_type distorted, undistorted;
+		for( std::size_t r = 0; r < m_rows; ++r )
+			for( std::size_t c = 0; c < m_cols; ++c )
+			{
+				distorted( 0 ) = m_origin + c * spacing;
+				distorted( 1 ) = m_origin + r * spacing;
+				undistortExact( distorted, undistorted );
+				m_displacement[ 2 * ( r * m_cols + c ) ] = undistorted( 0 ) - distorted( 0 );
+				m_displacement[ 2 * ( r * m_cols + c ) + 1 ] = undistorted( 1 ) - distorted( 1 );
+			}
+	}
+
+	/**
+	 * @return the maximal interpolation error over all covered cells, each sampled on a regular
+	 * grid of \c g_validationSamples x \c g_validationSamples points including the cell center
+	 */
+	T validate() const
+	{
+		static const std::size_t n = g_validationSamples;
+		T maxError = 0;
+		vector_type distorted, undistorted;
+		for( std::size_t r = 1; r + 2 < m_rows; ++r )
+			for( std::size_t c = 1; c + 2 < m_cols; ++c )
+				for( std::size_t i = 0; i < n; ++i )
+					for( std::size_t j = 0; j < n; ++j )
+					{
+						distorted( 0 ) = m_origin + ( c + ( j + static_cast< T >( 0.5 ) ) / n ) * m_spacing;
+						distorted( 1 ) = m_origin + ( r + ( i + static_cast< T >( 0.5 ) ) / n ) * m_spacing;
+						undistortExact( distorted, undistorted );
+						T x, y;
+						lookup( distorted( 0 ), distorted( 1 ), x, y );
+						maxError = std::max( maxError, std::max( std::fabs( x - undistorted( 0 ) ), std::fabs( y - undistorted( 1 ) ) ) );
+					}
+		return maxError;
+	}
+
+	/** number of validation samples per cell and axis, odd to include the cell center */
+	static const std::size_t g_validationSamples = 5;
+
+	/** the camera the map was built for */
+	Math::CameraIntrinsics< T > m_intrinsics;
+
+	/** requested interpolation error */
+	const T m_tolerance;
+
+	/** interpolation error reached */
+	T m_maxError;
+
+	/** grid spacing in pixels */
+	T m_spacing;
+
+	/** image coordinate of the first grid node (same in x and y) */
+	T m_origin;
+
+	/** number of grid nodes per row */
+	std::size_t m_cols;
+
+	/** number of grid rows */
+	std::size_t m_rows;
+
+	/** interleaved displacement ( undistorted - distorted ) of all grid nodes */
+	std::vector< T > m_displacement;
+};
+
+}}} // namespace Ubitrack::Algorithm::CameraLens
+
+#endif // HAVE_LAPACK
+
+#endif //__UBITRACK_CALIBRATION_FUNCTION_CAMERALENS_UNDISTORTIONMAP_H_INCLUDED__
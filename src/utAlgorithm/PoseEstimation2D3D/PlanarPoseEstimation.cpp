@@ -154,14 +154,17 @@ T optimizePoseImpl( Pose& p, const std::vector< Vector< T, 2 > >& p2D, const std
 	Vector< T, 7 > params;
 	p.toVector( params );
 
+	// the solver of the thread keeps its workspace, including the measurement vector, for the next call
+	Optimization::LevenbergMarquardtSolver< T, 0, 7 >& lm( Optimization::threadLevenbergMarquardtSolver< T, 0, 7 >() );
+
 	// copy 2D points to measurement vector
-	Math::Vector< T >  measurements( 2 * p2D.size() );
+	typename Optimization::LevenbergMarquardtSolver< T, 0, 7 >::MeasurementVectorType& measurements( lm.measurementBuffer( 2 * p2D.size() ) );
 	for ( std::size_t i( 0 ); i < p2D.size(); i++ )
 		ublas::subrange( measurements, 2*i, (i+1)*2 ) = p2D[ i ];
 
 	// perform optimization
 	Function::MultiplePointProjection< T > projection( p3D, cam );
-	T fRes = Optimization::levenbergMarquardt( projection, params, measurements, 
+	T fRes = lm.solve( projection, params, measurements, 
 		Optimization::OptTerminate( nIterations, 1e-6 ), Function::ProjectivePoseNormalize() );
 
 	// copy back rot & trans from vector
@@ -244,11 +244,20 @@ public:
 
 
 
-template< typename InputIterator >
+/**
+ * Refines a pose from 3D-3D point correspondences with a caller-provided levenberg-marquardt solver.
+ * Keeping the solver between calls avoids allocating its workspace as long as the number of points 
+ * does not change.
+ *
+ * @param lm a \c Math::Optimization::LevenbergMarquardtSolver with the value type of the points and 7 
+ *   parameters, e.g. \c LevenbergMarquardtSolver< double, 0, 7 >
+ */
+template< typename InputIterator, typename Solver >
 bool estimatePose6D_3D3D( const InputIterator iBeginA, const InputIterator iEndA
 	, Math::Pose& pose
 	, const InputIterator iBeginB, const InputIterator iEndB
-	, const Math::Optimization::OptTerminate& criteria )
+	, const Math::Optimization::OptTerminate& criteria
+	, Solver& lm )
 {
 #ifndef HAVE_LAPACK
 	return false;
@@ -265,8 +274,8 @@ bool estimatePose6D_3D3D( const InputIterator iBeginA, const InputIterator iEndA
 	// if( !estimatePose6D_3D3D( iBeginA, iEndA, pose, iBeginB, iEndB ) )
 		// return false;
 		
-	// 2) prepare the expectation values of the minimization function
-	Math::Vector< T > measurement = Math::Vector< T >::zeros( 3*n );
+	// 2) prepare the expectation values of the minimization function, in the workspace of the solver
+	typename Solver::MeasurementVectorType& measurement = lm.measurementBuffer( 3*n );
 	std::size_t i = 0;
 	for( InputIterator it( iBeginA ); it != iEndA; ++it, ++i )
 	{
@@ -279,13 +288,12 @@ bool estimatePose6D_3D3D( const InputIterator iBeginA, const InputIterator iEndA
 	PoseEstimation3D3D::PointCorrespodencesSinglePose< InputIterator > func( iBeginB, iEndB );
 	
 	// 4) set the parameter vector to optimize
-	// Math::Vector< T, 7 > paramVector;
-	Math::Vector< T > paramVector( 7 );
+	Math::Vector< T, 7 > paramVector;
 	pose.toVector( paramVector );
 	
 	
 	// 5) perform optimization
-	T residual = Ubitrack::Math::Optimization::levenbergMarquardt( func, paramVector, measurement, criteria, Math::Optimization::OptNoNormalize() );	
+	T residual = lm.solve( func, paramVector, measurement, criteria, Math::Optimization::OptNoNormalize() );	
 	
 	// pose = Math::Pose::fromVector( paramVector );
 	// skip the upper version to normalize the pose directly
@@ -300,6 +308,27 @@ bool estimatePose6D_3D3D( const InputIterator iBeginA, const InputIterator iEndA
 }
 	
 
+/**
+ * Refines a pose from 3D-3D point correspondences. Uses a levenberg-marquardt solver of the calling 
+ * thread, whose normal equations are small enough for bounded storage.
+ */
+template< typename InputIterator >
+bool estimatePose6D_3D3D( const InputIterator iBeginA, const InputIterator iEndA
+	, Math::Pose& pose
+	, const InputIterator iBeginB, const InputIterator iEndB
+	, const Math::Optimization::OptTerminate& criteria )
+{
+#ifndef HAVE_LAPACK
+	return false;
+#else
+	typedef typename std::iterator_traits< InputIterator >::value_type vector_type;
+	typedef typename vector_type::value_type T;
+	return estimatePose6D_3D3D( iBeginA, iEndA, pose, iBeginB, iEndB, criteria
+		, Math::Optimization::threadLevenbergMarquardtSolver< T, 0, 7 >() );
+#endif	// HAVE_LAPACK
+}
+	
+
 UBITRACK_EXPORT bool estimatePose6D_3D3D( const std::vector< Math::Vector3f >& pointsA
 	, Math::Pose& pose
 	, const std::vector< Math::Vector3f >& pointsB
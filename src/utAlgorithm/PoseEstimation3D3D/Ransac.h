@@ -37,6 +37,8 @@
 #include <utCore.h>
 #include <utMath/Blas1.h>
 #include <utMath/Optimization/Ransac.h>
+#include <utMath/Optimization/ParallelRansac.h>
+#include <utMath/Optimization/RansacStrategies.h>
 
 namespace Ubitrack { namespace Algorithm { namespace PoseEstimation3D3D {
 
@@ -92,6 +94,39 @@ bool estimatePose6D_3D3D ( const InputIterator itBegin1, const InputIterator itE
 	return ( inlier > 0 );
 }
 
+/// overloaded function that evaluates the ransac hypotheses in several threads
+template< typename T, typename InputIterator, typename ResultType >
+bool estimatePose6D_3D3D ( const InputIterator itBegin1, const InputIterator itEnd1
+		, ResultType& pose
+		, const InputIterator itBegin2, const InputIterator itEnd2
+		, const Math::Optimization::ParallelRansacParameter< T >& params )
+{
+	const std::size_t inlier = Math::Optimization::ransac( itBegin1, itEnd1, itBegin2, itEnd2, pose, PoseEstimation3D3D::Ransac< T >(), params  );
+	return ( inlier > 0 );
+}
+
+/// overloaded function that uses the adaptive ransac variant
+template< typename T, typename InputIterator, typename ResultType >
+bool estimatePose6D_3D3D ( const InputIterator itBegin1, const InputIterator itEnd1
+		, ResultType& pose
+		, const InputIterator itBegin2, const InputIterator itEnd2
+		, const Math::Optimization::AdaptiveRansacParameter< T >& params )
+{
+	const std::size_t inlier = Math::Optimization::ransac( itBegin1, itEnd1, itBegin2, itEnd2, pose, PoseEstimation3D3D::Ransac< T >(), params  );
+	return ( inlier > 0 );
+}
+
+/// overloaded function that uses the preemptive ransac variant
+template< typename T, typename InputIterator, typename ResultType >
+bool estimatePose6D_3D3D ( const InputIterator itBegin1, const InputIterator itEnd1
+		, ResultType& pose
+		, const InputIterator itBegin2, const InputIterator itEnd2
+		, const Math::Optimization::PreemptiveRansacParameter< T >& params )
+{
+	const std::size_t inlier = Math::Optimization::ransac( itBegin1, itEnd1, itBegin2, itEnd2, pose, PoseEstimation3D3D::Ransac< T >(), params  );
+	return ( inlier > 0 );
+}
+
 UBITRACK_EXPORT bool estimatePose6D_3D3D( const std::vector< Math::Vector3f >& pointsA
 	, Math::Pose& pose
 	, const std::vector< Math::Vector3f >& pointsB
@@ -37,6 +37,8 @@
 #include <utCore.h>
 #include <utMath/Blas1.h>
 #include <utMath/Optimization/Ransac.h>
+#include <utMath/Optimization/ParallelRansac.h>
+#include <utMath/Optimization/RansacStrategies.h>
 
 namespace Ubitrack { namespace Algorithm { namespace ToolTip {
 
@@ -111,6 +113,57 @@ bool estimatePosition3D_6D( Math::Vector< T, 3 >& pw
 	return ( inlier > 0 );
 }
 
+/// overloaded function that evaluates the ransac hypotheses in several threads
+template< typename T, typename InputIterator >
+bool estimatePosition3D_6D( Math::Vector< T, 3 >& pw
+	, const InputIterator iBegin
+	, const InputIterator iEnd
+	, Math::Vector< T, 3 >& pm
+	, const Math::Optimization::ParallelRansacParameter< T >& params )
+{
+	Math::Vector< T, 6 > resultVector;
+	const std::size_t inlier = Math::Optimization::ransac( iBegin, iEnd, resultVector, ToolTip::Ransac< T >(), params  );
+	
+	pw = Math::Vector< T, 3 > ( resultVector[ 0 ], resultVector[ 1 ], resultVector[ 2 ] );
+	pm = Math::Vector< T, 3 > ( resultVector[ 3 ], resultVector[ 4 ], resultVector[ 5 ] );
+	
+	return ( inlier > 0 );
+}
+
+/// overloaded function that uses the adaptive ransac variant
+template< typename T, typename InputIterator >
+bool estimatePosition3D_6D( Math::Vector< T, 3 >& pw
+	, const InputIterator iBegin
+	, const InputIterator iEnd
+	, Math::Vector< T, 3 >& pm
+	, const Math::Optimization::AdaptiveRansacParameter< T >& params )
+{
+	Math::Vector< T, 6 > resultVector;
+	const std::size_t inlier = Math::Optimization::ransac( iBegin, iEnd, resultVector, ToolTip::Ransac< T >(), params  );
+	
+	pw = Math::Vector< T, 3 > ( resultVector[ 0 ], resultVector[ 1 ], resultVector[ 2 ] );
+	pm = Math::Vector< T, 3 > ( resultVector[ 3 ], resultVector[ 4 ], resultVector[ 5 ] );
+	
+	return ( inlier > 0 );
+}
+
+/// overloaded function that uses the preemptive ransac variant
+template< typename T, typename InputIterator >
+bool estimatePosition3D_6D( Math::Vector< T, 3 >& pw
+	, const InputIterator iBegin
+	, const InputIterator iEnd
+	, Math::Vector< T, 3 >& pm
+	, const Math::Optimization::PreemptiveRansacParameter< T >& params )
+{
+	Math::Vector< T, 6 > resultVector;
+	const std::size_t inlier = Math::Optimization::ransac( iBegin, iEnd, resultVector, ToolTip::Ransac< T >(), params  );
+	
+	pw = Math::Vector< T, 3 > ( resultVector[ 0 ], resultVector[ 1 ], resultVector[ 2 ] );
+	pm = Math::Vector< T, 3 > ( resultVector[ 3 ], resultVector[ 4 ], resultVector[ 5 ] );
+	
+	return ( inlier > 0 );
+}
+
 UBITRACK_EXPORT bool estimatePosition3D_6D( Math::Vector3f& pw
 	, const std::vector< Math::Pose >& poses 
 	, Math::Vector3f& pm
@@ -45,6 +45,7 @@
 
 #include "Util/vector_traits.h"
 #include "Util/matrix_traits.h"
+#include "Util/small_matrix_kernels.h"
 #include "Geometry/container_traits.h"
 #include "Stochastic/identity_iterator.h"
 
@@ -206,8 +207,7 @@ public:
 		static const typename Math::Util::matrix_traits< MatrixType >::size_type size2 = Math::Util::matrix_traits< MatrixType >::size2;
 
 		// call for column-major representation (there is no row_major call yet)
-		// mat_vec_product_impl_forward< size1, size2, 0, 0 >() ( lhs, rhs, result );
-		mat_vec_product_impl_backward< size1, size2, size1, size2 >() ( lhs, rhs, result );
+		Math::Util::mat_vec_prod< size1, size2 >( Math::Util::matrix_traits< MatrixType >::ptr( lhs ), &rhs[ 0 ], &result[ 0 ] );
 	}
 	
 	template< typename MatrixType, typename VectorType >
@@ -217,126 +217,7 @@ public:
 		this->operator()( lhs, rhs, result );
 		return result;
 	}
-	
-protected:
-	/**
-	 * @internal
-	 * Internal functor that implements a matrix-vector product.
-	 *
-	 * The implementation uses recursive functional programming,
-	 * that optimizes calculations at compile time.
-	 *
-	 * @note it sums up elements starting from the first element.
-	 *
-	 * @tparam M_MAX value that signs the first dimension of the matrix (rows)
-	 * @tparam N_MAX value that signs the second dimension of the matrix (columns)
-	 * @tparam M value that defines the current matrix/result vector row
-	 * @tparam N value that defines the current matrix/vector column 
-	 */
-	template< std::size_t M_MAX, std::size_t N_MAX, std::size_t M, std::size_t N >
-	struct mat_vec_product_impl_forward
-	{
-		template< typename MatType, typename VecType, typename ReturnType  >
-		void operator() ( const MatType& mat, const VecType& vec1, ReturnType &vec2 ) const
-		{
-			vec2[ M ] += Math::Util::matrix_traits< MatType >::ptr( mat )[ (N*(M_MAX) ) + M ] * vec1[ N ];
-			mat_vec_product_impl_forward< M_MAX, N_MAX, M, N+1 >()( mat, vec1, vec2 );
-		}
-	};
-	
-	/// @internal Partial specialization of functor that signs the first element (first row)
-	template< std::size_t M_MAX, std::size_t N_MAX, std::size_t M >
-	struct mat_vec_product_impl_forward< M_MAX, N_MAX, M, 0 >
-	{
-		template< typename MatType, typename VecType, typename ReturnType  >
-		void operator() ( const MatType& mat, const VecType& vec1, ReturnType &vec2 ) const
-		{
-			vec2[ M ] = Math::Util::matrix_traits< MatType >::ptr( mat )[ M ] * vec1[ 0 ];
-			mat_vec_product_impl_forward< M_MAX, N_MAX, M, 1 >()( mat, vec1, vec2 );
-		}
-	};
-	
-	
-	/// @internal Partial specialization of functor that signs the next row
-	template< std::size_t M_MAX, std::size_t N_MAX, std::size_t M >
-	struct mat_vec_product_impl_forward< M_MAX, N_MAX, M, N_MAX >
-	{
-		template< typename MatType, typename VecType, typename ReturnType >
-		void operator() ( const MatType& mat, const VecType& vec1, ReturnType &vec2 ) const
-		{
-			mat_vec_product_impl_forward< M_MAX, N_MAX, M+1, 0 >()( mat, vec1, vec2 );
-		}
-	};
-	
-	/// @internal Partial specialization of functor that signs the final element
-	template< std::size_t M_MAX, std::size_t N_MAX >
-	struct mat_vec_product_impl_forward< M_MAX, N_MAX, M_MAX, 0 >
-	{
-		template< typename MatType, typename VecType, typename ReturnType >
-		void operator() ( const MatType& mat, const VecType&, const ReturnType& ) const
-		{
-			return;
-		}
-	};
 
-	/**
-	 * @internal
-	 * Internal functor that implements a matrix-vector product.
-	 *
-	 * The implementation uses recursive functional programming,
-	 * that optimizes calculations at compile time.
-	 *
-	 * @note it sums up elements starting from the final element.
-	 *
-	 * @tparam M_MAX value that signs the first dimension of the matrix (rows)
-	 * @tparam N_MAX value that signs the second dimension of the matrix (columns)
-	 * @tparam M value that defines the current matrix/result vector row
-	 * @tparam N value that defines the current matrix/vector column 
-	 */
-	template< std::size_t M_MAX, std::size_t N_MAX, std::size_t M, std::size_t N >
-	struct mat_vec_product_impl_backward
-	{
-		template< typename MatType, typename VecType, typename ReturnType  >
-		void operator() ( const MatType& mat, const VecType& vec1, ReturnType &vec2 ) const
-		{
-			vec2[ M-1 ] += Math::Util::matrix_traits< MatType >::ptr( mat )[ ((N-1)*(M_MAX) ) + (M-1) ] * vec1[ N-1 ];
-			mat_vec_product_impl_backward< M_MAX, N_MAX, M, N-1 >()( mat, vec1, vec2 );
-		}
-	};
-	
-	/// @internal Partial specialization of functor that signs the first element (final row)
-	template< std::size_t M_MAX, std::size_t N_MAX, std::size_t M >
-	struct mat_vec_product_impl_backward< M_MAX, N_MAX, M, N_MAX >
-	{
-		template< typename MatType, typename VecType, typename ReturnType  >
-		void operator() ( const MatType& mat, const VecType& vec1, ReturnType &vec2 ) const
-		{
-			vec2[ M-1 ] = Math::Util::matrix_traits< MatType >::ptr( mat )[ ((N_MAX-1)*(M_MAX) ) + (M-1) ] * vec1[ N_MAX-1 ];
-			mat_vec_product_impl_backward< M_MAX, N_MAX, M, N_MAX-1 >()( mat, vec1, vec2 );
-		}
-	};
-	
-	/// @internal Partial specialization of functor that signs the next row
-	template< std::size_t M_MAX, std::size_t N_MAX, std::size_t M >
-	struct mat_vec_product_impl_backward< M_MAX, N_MAX, M, 0 >
-	{
-		template< typename MatType, typename VecType, typename ReturnType >
-		void operator() ( const MatType& mat, const VecType& vec1, ReturnType &vec2 ) const
-		{
-			mat_vec_product_impl_backward< M_MAX, N_MAX, M-1, N_MAX >()( mat, vec1, vec2 );
-		}
-	};
-	
-	/// @internal Partial specialization of functor that signs the final element (end of first row reached)
-	template< std::size_t M_MAX, std::size_t N_MAX >
-	struct mat_vec_product_impl_backward< M_MAX, N_MAX, 0, N_MAX >
-	{
-		template< typename MatType, typename VecType, typename ReturnType >
-		void operator() ( const MatType& mat, const VecType&, const ReturnType& ) const
-		{
-			return;
-		}
-	};
 };
 
 /**
@@ -44,6 +44,7 @@
 #define __UBITRACK_MATH_BLAS_LEVEL_3_H__
 
 #include "Util/matrix_traits.h"
+#include "Util/small_matrix_kernels.h"
 #include "Geometry/container_traits.h"
 
 #include "Matrix.h"
@@ -83,8 +84,8 @@ public:
 		static const typename Math::Util::matrix_traits< MatrixTypeRight >::size_type size3 = Math::Util::matrix_traits< MatrixTypeRight >::size2;
 
 		// call for column-major representation (there is no row_major call yet)
-		mat_mat_product_impl_forward< size1, size2, size3, 0, 0, 0 >() ( lhs, rhs, result );
-		//mat_mat_product_impl_backward< size1, size2, size1, size2 >() ( lhs, rhs, result );
+		Math::Util::mat_mat_prod< size1, size2, size3 >( Math::Util::matrix_traits< MatrixTypeLeft >::ptr( lhs )
+			, Math::Util::matrix_traits< MatrixTypeRight >::ptr( rhs ), Math::Util::matrix_traits< RetMatrixType >::ptr( result ) );
 	}
 	
 	template< typename MatrixTypeLeft, typename MatrixTypeRight >
@@ -94,91 +95,7 @@ public:
 		this->operator()( lhs, rhs, result );
 		return result;
 	}
-	
-protected:
-	/**
-	 * @internal
-	 * Internal functor that implements a matrix-matrix product.
-	 *
-	 * The implementation uses recursive functional programming,
-	 * that optimizes calculations at compile time.
-	 *
-	 * @note it sums up elements starting from the first element.
-	 *
-	 * @tparam M1_MAX value that signs the first dimension of the 1st matrix (rows)
-	 * @tparam N1_MAX value that signs the second dimension of the 1st matrix (columns)
-	 * @tparam N2_MAX value that signs the second dimension of the 2nd matrix (columns, rows should be equal to the columns of the 1st matrix )
-	 * @tparam M an integer that defines the row within the the resulting matrix
-	 * @tparam N an integer that defines the column within the the resulting matrix
-	 * @tparam STEP integer that defines the index to the input matrix elements which are processed for the m-n element of the resulting matrix.
-	 */
-	template< std::size_t M1_MAX, std::size_t N1_MAX, std::size_t N2_MAX, std::size_t M, std::size_t N, std::size_t STEP >
-	struct mat_mat_product_impl_forward
-	{
-		template< typename MatTypeLeft, typename MatTypeRight, typename ReturnMatType  >
-		void operator() ( const MatTypeLeft& mat1, const MatTypeRight& mat2, ReturnMatType &resultMat ) const
-		{
-			// std::cout << " Matrix " << M << " x " << N << " step " << STEP << " :";
-			
-			const typename Math::Util::matrix_traits< MatTypeLeft >::value_type value1 = Math::Util::matrix_traits< MatTypeLeft >::ptr( mat1 )[ (STEP*M1_MAX) + M ];
-			const typename Math::Util::matrix_traits< MatTypeRight >::value_type value2 = Math::Util::matrix_traits< MatTypeRight >::ptr( mat2 )[ (N*N1_MAX) + STEP ];
-			Math::Util::matrix_traits< ReturnMatType >::ptr( resultMat )[ (N*M1_MAX) + M ] += value1 * value2;
-			// std::cout << value1 << " x  " << value2 << "\n";
-			mat_mat_product_impl_forward< M1_MAX, N1_MAX, N2_MAX, M, N, STEP+1 >()( mat1, mat2, resultMat );
-		}
-	};
-	
-	/// @internal Partial specialization of functor that signs the first element (first row)
-	template< std::size_t M1_MAX, std::size_t N1_MAX, std::size_t N2_MAX, std::size_t M, std::size_t N >//, std::size_t STEP >
-	struct mat_mat_product_impl_forward< M1_MAX, N1_MAX, N2_MAX, M, N, 0 >
-	{
-		template< typename MatTypeLeft, typename MatTypeRight, typename ReturnMatType  >
-		void operator() ( const MatTypeLeft& mat1, const MatTypeRight& mat2, ReturnMatType &resultMat ) const
-		{
-			
-			// std::cout << " Matrix new init " << M << " x " << N << " : ";
-			const typename Math::Util::matrix_traits< MatTypeLeft >::value_type value1 = Math::Util::matrix_traits< MatTypeLeft >::ptr( mat1 )[ M ];
-			const typename Math::Util::matrix_traits< MatTypeRight >::value_type value2 = Math::Util::matrix_traits< MatTypeRight >::ptr( mat2 )[ (N*N1_MAX) ];
-			Math::Util::matrix_traits< ReturnMatType >::ptr( resultMat )[ (N*M1_MAX) + M ] = value1 * value2;
-			// std::cout << value1 << " x  " << value2 << "\n";
-			mat_mat_product_impl_forward< M1_MAX, N1_MAX, N2_MAX, M, N, 1 >()( mat1, mat2, resultMat );
-		}
-	};
-	
-	
-	/// @internal Partial specialization of functor that signs the next column, resets the row as well
-	template< std::size_t M1_MAX, std::size_t N1_MAX, std::size_t N2_MAX, std::size_t N >
-	struct mat_mat_product_impl_forward< M1_MAX, N1_MAX, N2_MAX, M1_MAX, N, 0 >
-	{
-		template< typename MatTypeLeft, typename MatTypeRight, typename ReturnMatType >
-		void operator() ( const MatTypeLeft& mat1, const MatTypeRight& mat2, ReturnMatType &resultMat ) const
-		{
-			
-			mat_mat_product_impl_forward< M1_MAX, N1_MAX, N2_MAX, 0, N+1 , 0 >()( mat1, mat2, resultMat );
-		}
-	};
-	
-	/// @internal Partial specialization of functor that signs the next row
-	template< std::size_t M1_MAX, std::size_t N1_MAX, std::size_t N2_MAX, std::size_t M, std::size_t N >
-	struct mat_mat_product_impl_forward< M1_MAX, N1_MAX, N2_MAX, M, N, N1_MAX >
-	{
-		template< typename MatTypeLeft, typename MatTypeRight, typename ReturnMatType  >
-		void operator() ( const MatTypeLeft& mat1, const MatTypeRight& mat2, ReturnMatType &resultMat ) const
-		{
-			mat_mat_product_impl_forward< M1_MAX, N1_MAX, N2_MAX, M+1, N , 0 >()( mat1, mat2, resultMat );
-		}
-	};
-	
-	/// @internal Partial specialization of functor that signs the final element
-	template< std::size_t M1_MAX, std::size_t N1_MAX, std::size_t N2_MAX >
-	struct mat_mat_product_impl_forward< M1_MAX, N1_MAX, N2_MAX, 0, N2_MAX, 0 >
-	{
-		template< typename MatTypeLeft, typename MatTypeRight, typename ReturnMatType  >
-		void operator() ( const MatTypeLeft& mat1, const MatTypeRight& mat2, ReturnMatType &resultMat ) const
-		{
-			return;
-		}
-	};
+
 };
 
 // include guard needed since same function is within BLAS2 header
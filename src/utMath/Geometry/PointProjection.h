@@ -37,9 +37,11 @@
 
 #include <utMath/Vector.h> //includes static assert
 #include <utMath/Matrix.h>
+#include <utMath/CameraIntrinsics.h>
 
 #include "container_traits.h"
 #include "../Util/type_traits.h"
+#include "../Util/point_batch_kernels.h"
 #include "../Stochastic/identity_iterator.h"
 
 #include <algorithm> //std::transform
@@ -138,6 +140,92 @@ public:
 };
 
 
+/// @internal batch kernel for a pinhole projection with a 3-by-4 matrix
+template< typename T >
+struct ProjectPointsKernel
+{
+	const Math::Matrix< T, 3, 4 >& m_projection;
+
+	ProjectPointsKernel( const Math::Matrix< T, 3, 4 >& projection )
+		: m_projection( projection )
+	{}
+
+	void operator() ( const std::size_t n, const T* x, const T* y, const T* z, T* u, T* v ) const
+	{
+		Math::Util::project_points_soa( &m_projection( 0, 0 ), n, x, y, z, u, v );
+	}
+};
+
+/// @internal batch kernel for a projection into a camera with lens distortion
+template< typename T >
+struct ProjectPointsCameraKernel
+{
+	const Math::CameraIntrinsics< T >& m_intrinsics;
+	const Math::Matrix< T, 3, 4 >& m_extrinsic;
+
+	ProjectPointsCameraKernel( const Math::CameraIntrinsics< T >& intrinsics, const Math::Matrix< T, 3, 4 >& extrinsic )
+		: m_intrinsics( intrinsics )
+		, m_extrinsic( extrinsic )
+	{}
+
+	void operator() ( const std::size_t n, const T* x, const T* y, const T* z, T* u, T* v ) const
+	{
+		if ( m_intrinsics.calib_type == Math::CameraIntrinsics< T >::OPENCV_4_0_FISHEYE )
+			Math::Util::project_fisheye_points_soa( &m_extrinsic( 0, 0 ), &m_intrinsics.matrix( 0, 0 )
+				, &m_intrinsics.radial_params( 0 ), n, x, y, z, u, v );
+		else
+			Math::Util::project_distort_points_soa( &m_extrinsic( 0, 0 ), &m_intrinsics.matrix( 0, 0 )
+				, &m_intrinsics.radial_params( 0 ), &m_intrinsics.tangential_params( 0 ), n, x, y, z, u, v );
+	}
+};
+
+/// @internal projects 3D points in blocks, which are copied to structure-of-arrays layout for the batch kernel
+template< typename T, typename ForwardIterator1, typename ForwardIterator2, typename Kernel >
+inline void project_points_blocked( ForwardIterator1 iBegin, const ForwardIterator1 iEnd, ForwardIterator2 iOut, const Kernel& kernel )
+{
+	static const std::size_t blockSize = 64;
+	T in[ 3 ][ blockSize ];
+	T out[ 2 ][ blockSize ];
+
+	while ( iBegin != iEnd )
+	{
+		std::size_t n = 0;
+		for ( ; n < blockSize && iBegin != iEnd; ++n, ++iBegin )
+		{
+			in[ 0 ][ n ] = (*iBegin)( 0 );
+			in[ 1 ][ n ] = (*iBegin)( 1 );
+			in[ 2 ][ n ] = (*iBegin)( 2 );
+		}
+
+		kernel( n, in[ 0 ], in[ 1 ], in[ 2 ], out[ 0 ], out[ 1 ] );
+
+		for ( std::size_t i = 0; i < n; ++i, ++iOut )
+			*iOut = Math::Vector< T, 2 >( out[ 0 ][ i ], out[ 1 ][ i ] );
+	}
+}
+
+/// @internal projects points one by one using the \c ProjectPoint functor
+template< typename T, std::size_t M, std::size_t N, typename ForwardIterator1, typename ForwardIterator2 >
+inline void project_points_impl( const Math::Matrix< T, M, N > &projection, const ForwardIterator1 iBegin, const ForwardIterator1 iEnd, ForwardIterator2 iOut, const Ubitrack::Util::false_type& )
+{
+	Ubitrack::Util::identity< const Math::Matrix< T, M, N > > id_container( projection );
+	std::transform( iBegin, iEnd, id_container.begin(), iOut, ProjectPoint() );
+	
+	//const std::size_t n = std::distance( iBegin, iEnd );
+	//Ubitrack::Util::identity< const Math::Matrix< T, M, N > > id_container( projection, n );
+	//std::transform( id_container.begin(), id_container.end(), iBegin, iOut, ProjectPoint() );
+	
+	// std::transform( iBegin, iEnd, iOut, std::bind1st( ProjectPoint< T, M, N, vector_type_in >(), projection ) );
+}
+
+/// @internal projects 3D points with the batch kernel
+template< typename T, typename ForwardIterator1, typename ForwardIterator2 >
+inline void project_points_impl( const Math::Matrix< T, 3, 4 > &projection, const ForwardIterator1 iBegin, const ForwardIterator1 iEnd, ForwardIterator2 iOut, const Ubitrack::Util::true_type& )
+{
+	project_points_blocked< T >( iBegin, iEnd, iOut, ProjectPointsKernel< T >( projection ) );
+}
+
+
 /**
  * @ingroup math geometry
  * @brief Projects several points using iterators pointing to the storage class of the points.
@@ -195,14 +283,115 @@ inline void project_points( const Math::Matrix< T, M, N > &projection, const For
 	UBITRACK_STATIC_ASSERT( ( Ubitrack::Util::is_same< value_type_in, value_type_out >::value ), INPUT_AND_OUTPUT_VECTOR_NEED_SAME_BUILTIN_TYPE );
 	UBITRACK_STATIC_ASSERT( ( Ubitrack::Util::is_same< vector_type_out, Math::Vector< T, 2 > >::value ), OUTPUT_VECTOR_NEEDS_TO_BE_DEFINED_WITH_2_DIMENSIONS );
 
-	Ubitrack::Util::identity< const Math::Matrix< T, M, N > > id_container( projection );
-	std::transform( iBegin, iEnd, id_container.begin(), iOut, ProjectPoint() );
-	
-	//const std::size_t n = std::distance( iBegin, iEnd );
-	//Ubitrack::Util::identity< const Math::Matrix< T, M, N > > id_container( projection, n );
-	//std::transform( id_container.begin(), id_container.end(), iBegin, iOut, ProjectPoint() );
-	
-	// std::transform( iBegin, iEnd, iOut, std::bind1st( ProjectPoint< T, M, N, vector_type_in >(), projection ) );
+	// 3D points projected by a 3-by-4 matrix use the batch kernel
+	static const bool use_batch_kernel = ( M == 3 ) && ( N == 4 ) && Ubitrack::Util::is_same< vector_type_in, Math::Vector< T, 3 > >::value;
+	project_points_impl( projection, iBegin, iEnd, iOut, Ubitrack::Util::constant_value< bool, use_batch_kernel >() );
+}
+
+
+
+/**
+ * @ingroup math geometry
+ * @brief Projects several \b 3D points given in structure-of-arrays layout.
+ *
+ * Calculates @f$ \hat{p}_{3x1} = P_{3x4} \cdot [x_i y_i z_i 1]^T @f$ and
+ * @f$ [u_i v_i]^T = [\hat{p_{1}} \hat{p_{2}}]^T / \hat{p_{3}} @f$ for all points. Several points are
+ * projected at once using SIMD instructions if available.
+ *
+ * @tparam T built-in type of matrix and coordinates ( e.g. \c double or \c float )
+ * @param projection the \b 3-by-4 \b projection \b matrix
+ * @param n number of points
+ * @param x,y,z arrays of the 3D coordinates
+ * @param u,v arrays for the projected 2D coordinates
+ */
+template< typename T >
+inline void project_points( const Math::Matrix< T, 3, 4 > &projection, const std::size_t n, const T* x, const T* y, const T* z, T* u, T* v )
+{
+	Math::Util::project_points_soa( &projection( 0, 0 ), n, x, y, z, u, v );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Projects several \b 3D points stored in one contiguous buffer.
+ *
+ * The input buffer stores all x-coordinates first, followed by all y- and all z-coordinates
+ * ( @f$ [x_0 \ldots x_{n-1} y_0 \ldots y_{n-1} z_0 \ldots z_{n-1}] @f$ ), the output buffer
+ * stores all u-coordinates followed by all v-coordinates.
+ *
+ * @tparam T built-in type of matrix and coordinates ( e.g. \c double or \c float )
+ * @param projection the \b 3-by-4 \b projection \b matrix
+ * @param n number of points
+ * @param pointsIn buffer of \c 3*n coordinates
+ * @param pointsOut buffer for \c 2*n coordinates
+ */
+template< typename T >
+inline void project_points( const Math::Matrix< T, 3, 4 > &projection, const std::size_t n, const T* pointsIn, T* pointsOut )
+{
+	Math::Util::project_points_soa( &projection( 0, 0 ), n, pointsIn, pointsIn + n, pointsIn + 2 * n, pointsOut, pointsOut + n );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Projects several \b 3D points given in structure-of-arrays layout into a camera with lens distortion.
+ *
+ * The points are transformed into the camera frame by @f$ [R|t] @f$ , normalized, distorted
+ * with the lens parameters of the camera (same model as \c Algorithm::CameraLens::distort )
+ * and mapped to pixel coordinates by the intrinsic matrix.
+ *
+ * @tparam T built-in type of matrix and coordinates ( e.g. \c double or \c float )
+ * @param intrinsics the camera intrinsics including lens distortion
+ * @param extrinsic the \b 3-by-4 matrix @f$ [R|t] @f$ transforming points into the camera frame
+ * @param n number of points
+ * @param x,y,z arrays of the 3D coordinates
+ * @param u,v arrays for the pixel coordinates
+ */
+template< typename T >
+inline void project_points( const Math::CameraIntrinsics< T >& intrinsics, const Math::Matrix< T, 3, 4 > &extrinsic
+	, const std::size_t n, const T* x, const T* y, const T* z, T* u, T* v )
+{
+	ProjectPointsCameraKernel< T >( intrinsics, extrinsic )( n, x, y, z, u, v );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Projects several \b 3D points stored in one contiguous buffer into a camera with lens distortion.
+ *
+ * Buffer layout as for the pinhole version, parameters as for the structure-of-arrays version.
+ */
+template< typename T >
+inline void project_points( const Math::CameraIntrinsics< T >& intrinsics, const Math::Matrix< T, 3, 4 > &extrinsic
+	, const std::size_t n, const T* pointsIn, T* pointsOut )
+{
+	ProjectPointsCameraKernel< T >( intrinsics, extrinsic )( n, pointsIn, pointsIn + n, pointsIn + 2 * n, pointsOut, pointsOut + n );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Projects several \b 3D points into a camera with lens distortion using iterators.
+ *
+ * Same as the iterator version of the pinhole projection, but includes the lens distortion
+ * of the camera. The points are processed in blocks using the batch kernels.
+ *
+ * @tparam T built-in type of matrix and input/output vectors ( e.g. \c double or \c float )
+ * @tparam ForwardIterator1 type of forward iterator to container of input points ( \c Math::Vector< T, 3 > )
+ * @tparam ForwardIterator2 type of the output iterator for the projected points ( \c Math::Vector< T, 2 > )
+ * @param intrinsics the camera intrinsics including lens distortion
+ * @param extrinsic the \b 3-by-4 matrix @f$ [R|t] @f$ transforming points into the camera frame
+ * @param iBegin \c iterator pointing to first element in the input container/storage class of the \b points ( usually \c begin() )
+ * @param iEnd \c iterator pointing behind the last element in the input container/storage class of the \b points ( usually \c end() )
+ * @param iOut output \c iterator for storing the projected points ( usually \c begin() or \c std::back_inserter(container) )
+ */
+template< typename T, typename ForwardIterator1, typename ForwardIterator2 >
+inline void project_points( const Math::CameraIntrinsics< T >& intrinsics, const Math::Matrix< T, 3, 4 > &extrinsic
+	, const ForwardIterator1 iBegin, const ForwardIterator1 iEnd, ForwardIterator2 iOut )
+{
+	typedef typename Ubitrack::Util::container_traits< ForwardIterator1 >::value_type vector_type_in;
+	typedef typename Ubitrack::Util::container_traits< ForwardIterator2 >::value_type vector_type_out;
+
+	UBITRACK_STATIC_ASSERT( ( Ubitrack::Util::is_same< vector_type_in, Math::Vector< T, 3 > >::value ), INPUT_VECTOR_NEEDS_TO_BE_DEFINED_WITH_3_DIMENSIONS );
+	UBITRACK_STATIC_ASSERT( ( Ubitrack::Util::is_same< vector_type_out, Math::Vector< T, 2 > >::value ), OUTPUT_VECTOR_NEEDS_TO_BE_DEFINED_WITH_2_DIMENSIONS );
+
+	project_points_blocked< T >( iBegin, iEnd, iOut, ProjectPointsCameraKernel< T >( intrinsics, extrinsic ) );
 }
 
 
@@ -41,6 +41,7 @@
 
 #include "container_traits.h"
 #include "../Util/type_traits.h"
+#include "../Util/point_batch_kernels.h"
 #include "../Stochastic/identity_iterator.h"
 
 #include <algorithm> //std::transform
@@ -94,9 +95,9 @@ public:
 	template< typename T >
 	Math::Vector< T, 2 > operator() ( const Math::Matrix< T, 2, 3 > &transMat, const Math::Vector< T, 3 > &vec ) const
 	{
-		const T e1 = transMat( 0, 0 ) * vec( 0 ) + transMat( 0, 1 ) * vec( 1 ) + transMat( 0, 2 ) * vec( 2 );
-		const T e2 = transMat( 1, 0 ) * vec( 0 ) + transMat( 1, 1 ) * vec( 1 ) + transMat( 1, 2 ) * vec( 2 );
-		return Math::Vector< T, 2 > ( e1, e2 );
+		Math::Vector< T, 2 > result;
+		Math::Util::mat_vec_prod< 2, 3 >( &transMat( 0, 0 ), &vec( 0 ), &result( 0 ) );
+		return result;
 	}
 
 	/// @internal Specialization of bracket operator (\c operator() ) for \b 3-by-3 \b transformation of \b 2D \b points (as Vector2D)
@@ -113,10 +114,9 @@ public:
 	template< typename T >
 	Math::Vector< T, 3 > operator() ( const Math::Matrix< T, 3, 3 > &transMat, const Math::Vector< T, 3 > &vec ) const
 	{
-		const T e1 = transMat( 0, 0 ) * vec( 0 ) + transMat( 0, 1 ) * vec( 1 ) + transMat( 0, 2 ) * vec( 2 );
-		const T e2 = transMat( 1, 0 ) * vec( 0 ) + transMat( 1, 1 ) * vec( 1 ) + transMat( 1, 2 ) * vec( 2 );
-		const T e3 = transMat( 2, 0 ) * vec( 0 ) + transMat( 2, 1 ) * vec( 1 ) + transMat( 2, 2 ) * vec( 2 );
-		return Math::Vector< T, 3 > ( e1, e2, e3 );
+		Math::Vector< T, 3 > result;
+		Math::Util::mat_vec_prod< 3, 3 >( &transMat( 0, 0 ), &vec( 0 ), &result( 0 ) );
+		return result;
 	}
 
 	/// @internal Specialization of bracket operator (\c operator() ) for \b 3-by-4 \b transformation of \b 3D \b points (as Vector2D)
@@ -143,10 +143,9 @@ public:
 	template< typename T >
 	Math::Vector< T, 3 > operator() ( const Math::Matrix< T, 3, 4 > &transMat, const Math::Vector< T, 4 > &vec ) const
 	{
-		const T e1 = transMat( 0, 0 ) * vec( 0 ) + transMat( 0, 1 ) * vec( 1 ) + transMat( 0, 2 ) * vec( 2 ) + transMat( 0, 3 ) * vec( 3 );
-		const T e2 = transMat( 1, 0 ) * vec( 0 ) + transMat( 1, 1 ) * vec( 1 ) + transMat( 1, 2 ) * vec( 2 ) + transMat( 1, 3 ) * vec( 3 );
-		const T e3 = transMat( 2, 0 ) * vec( 0 ) + transMat( 2, 1 ) * vec( 1 ) + transMat( 2, 2 ) * vec( 2 ) + transMat( 2, 3 ) * vec( 3 );
-		return Math::Vector< T, 3 > ( e1, e2, e3 );
+		Math::Vector< T, 3 > result;
+		Math::Util::mat_vec_prod< 3, 4 >( &transMat( 0, 0 ), &vec( 0 ), &result( 0 ) );
+		return result;
 	}
 	
 	/// @internal Specialization of bracket operator (\c operator() ) for \b 4-by-4 \b transformation of \b 2D \b points
@@ -175,15 +174,57 @@ public:
 	template< typename T >
 	Math::Vector< T, 4 > operator() ( const Math::Matrix< T, 4, 4 > &transMat, const Math::Vector< T, 4 > &vec ) const
 	{
-		const T e1 = transMat( 0, 0 ) * vec( 0 ) + transMat( 0, 1 ) * vec( 1 ) + transMat( 0, 2 ) * vec( 2 ) + transMat( 0, 3 ) * vec( 3 );
-		const T e2 = transMat( 1, 0 ) * vec( 0 ) + transMat( 1, 1 ) * vec( 1 ) + transMat( 1, 2 ) * vec( 2 ) + transMat( 1, 3 ) * vec( 3 );
-		const T e3 = transMat( 2, 0 ) * vec( 0 ) + transMat( 2, 1 ) * vec( 1 ) + transMat( 2, 2 ) * vec( 2 ) + transMat( 2, 3 ) * vec( 3 );
-		const T e4 = transMat( 3, 0 ) * vec( 0 ) + transMat( 3, 1 ) * vec( 1 ) + transMat( 3, 3 ) * vec( 2 ) + transMat( 3, 3 ) * vec( 3 );
-		return Math::Vector< T, 4 > ( e1, e2, e3, e4 );
+		Math::Vector< T, 4 > result;
+		Math::Util::mat_vec_prod< 4, 4 >( &transMat( 0, 0 ), &vec( 0 ), &result( 0 ) );
+		return result;
 	}
 };
 
 
+/// @internal transforms points one by one using the \c TransformPoint functor
+template< typename T, std::size_t M, std::size_t N, typename ForwardIterator1, typename ForwardIterator2 >
+inline void transform_points_impl( const Math::Matrix< T, M, N > &transformation, const ForwardIterator1 iBegin, const ForwardIterator1 iEnd, ForwardIterator2 iOut, const Ubitrack::Util::false_type& )
+{
+	// std::transform( iBegin, iEnd, iOut, std::bind1st( TransformPoint< T, M, N, vector_type_in >(), transformation ) );
+	const std::size_t n = std::distance( iBegin, iEnd );
+	Ubitrack::Util::identity< const Math::Matrix< T, M, N > > id_container( transformation, n );
+	std::transform( id_container.begin(), id_container.end(), iBegin, iOut, TransformPoint() );
+}
+
+/// @internal transforms 3D points in blocks, which are copied to structure-of-arrays layout for the batch kernel
+template< typename T, std::size_t M, typename ForwardIterator1, typename ForwardIterator2 >
+inline void transform_points_impl( const Math::Matrix< T, M, 4 > &transformation, ForwardIterator1 iBegin, const ForwardIterator1 iEnd, ForwardIterator2 iOut, const Ubitrack::Util::true_type& )
+{
+	static const std::size_t blockSize = 64;
+	T in[ 3 ][ blockSize ];
+	T out[ M ][ blockSize ];
+	T* outPtr[ M ];
+	for ( std::size_t r = 0; r < M; ++r )
+		outPtr[ r ] = out[ r ];
+
+	while ( iBegin != iEnd )
+	{
+		std::size_t n = 0;
+		for ( ; n < blockSize && iBegin != iEnd; ++n, ++iBegin )
+		{
+			in[ 0 ][ n ] = (*iBegin)( 0 );
+			in[ 1 ][ n ] = (*iBegin)( 1 );
+			in[ 2 ][ n ] = (*iBegin)( 2 );
+		}
+
+		Math::Util::transform_points_soa< M >( &transformation( 0, 0 ), n, in[ 0 ], in[ 1 ], in[ 2 ], outPtr );
+
+		for ( std::size_t i = 0; i < n; ++i, ++iOut )
+		{
+			Math::Vector< T, M > result;
+			for ( std::size_t r = 0; r < M; ++r )
+				result( r ) = out[ r ][ i ];
+			*iOut = result;
+		}
+	}
+}
+
+
 /**
  * @ingroup math geometry
  * @brief transforms several points spatially using iterators pointing to the storage class of the points.
@@ -247,10 +288,82 @@ inline void transform_points( const Math::Matrix< T, M, N > &transformation, con
 	UBITRACK_STATIC_ASSERT( (Ubitrack::Util::is_same< value_type_in, value_type_out >::value ), INPUT_AND_OUTPUT_VECTOR_NEED_SAME_BUILTIN_TYPE );
 	UBITRACK_STATIC_ASSERT( (Ubitrack::Util::is_same< vector_type_out, Math::Vector< T, M > >::value ), OUTPUT_VECTOR_NEEDS_SAME_DIMENSION_AS_MATRIX_ROWS );
 
-	// std::transform( iBegin, iEnd, iOut, std::bind1st( TransformPoint< T, M, N, vector_type_in >(), transformation ) );
-	const std::size_t n = std::distance( iBegin, iEnd );
-	Ubitrack::Util::identity< const Math::Matrix< T, M, N > > id_container( transformation, n );
-	std::transform( id_container.begin(), id_container.end(), iBegin, iOut, TransformPoint() );
+	// 3D points transformed by 3-by-4 or 4-by-4 matrices use the batch kernels
+	static const bool use_batch_kernel = ( N == 4 ) && Ubitrack::Util::is_same< vector_type_in, Math::Vector< T, 3 > >::value;
+	transform_points_impl( transformation, iBegin, iEnd, iOut, Ubitrack::Util::constant_value< bool, use_batch_kernel >() );
+}
+
+
+
+/**
+ * @ingroup math geometry
+ * @brief transforms several \b 3D points given in structure-of-arrays layout.
+ *
+ * Calculates @f$ \hat{p}_{3x1} = M_{3x4} \cdot [x_i y_i z_i 1]^T @f$ for all points. Several points are
+ * transformed at once using SIMD instructions if available.
+ *
+ * Example use case:\n
+ @code
+ Matrix< float, 3, 4 > trans; // <- should be filled with values
+ std::vector< float > x( n ), y( n ), z( n ); // <- should be filled with values
+ transform_points( trans, n, &x[ 0 ], &y[ 0 ], &z[ 0 ], &x[ 0 ], &y[ 0 ], &z[ 0 ] ); // in-place
+ @endcode
+ *
+ * @tparam T built-in type of matrix and coordinates ( e.g. \c double or \c float )
+ * @param transformation the \b 3-by-4 \b transformation \b matrix
+ * @param n number of points
+ * @param x,y,z arrays of the input coordinates
+ * @param xOut,yOut,zOut arrays for the transformed coordinates (may be the same as the input arrays)
+ */
+template< typename T >
+inline void transform_points( const Math::Matrix< T, 3, 4 > &transformation, const std::size_t n, const T* x, const T* y, const T* z, T* xOut, T* yOut, T* zOut )
+{
+	T* const out[ 3 ] = { xOut, yOut, zOut };
+	Math::Util::transform_points_soa< 3 >( &transformation( 0, 0 ), n, x, y, z, out );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief transforms several \b 3D points given in structure-of-arrays layout into homogeneous \b 4D points.
+ *
+ * Calculates @f$ \hat{p}_{4x1} = M_{4x4} \cdot [x_i y_i z_i 1]^T @f$ for all points.
+ *
+ * @tparam T built-in type of matrix and coordinates ( e.g. \c double or \c float )
+ * @param transformation the \b 4-by-4 \b transformation \b matrix
+ * @param n number of points
+ * @param x,y,z arrays of the input coordinates
+ * @param xOut,yOut,zOut,wOut arrays for the transformed coordinates (may be the same as the input arrays)
+ */
+template< typename T >
+inline void transform_points( const Math::Matrix< T, 4, 4 > &transformation, const std::size_t n, const T* x, const T* y, const T* z, T* xOut, T* yOut, T* zOut, T* wOut )
+{
+	T* const out[ 4 ] = { xOut, yOut, zOut, wOut };
+	Math::Util::transform_points_soa< 4 >( &transformation( 0, 0 ), n, x, y, z, out );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief transforms several \b 3D points stored in one contiguous buffer.
+ *
+ * The buffer stores all x-coordinates first, followed by all y- and all z-coordinates
+ * ( @f$ [x_0 \ldots x_{n-1} y_0 \ldots y_{n-1} z_0 \ldots z_{n-1}] @f$ ). The output buffer has the
+ * same layout with \c M blocks of \c n coordinates each.
+ *
+ * @tparam T built-in type of matrix and coordinates ( e.g. \c double or \c float )
+ * @tparam M first dimension of matrix (rows), either 3 or 4
+ * @param transformation the \b 3-by-4 or \b 4-by-4 \b transformation \b matrix
+ * @param n number of points
+ * @param pointsIn buffer of \c 3*n input coordinates
+ * @param pointsOut buffer for \c M*n output coordinates (may be the same as the input buffer for \c M=3 )
+ */
+template< typename T, std::size_t M >
+inline void transform_points( const Math::Matrix< T, M, 4 > &transformation, const std::size_t n, const T* pointsIn, T* pointsOut )
+{
+	UBITRACK_STATIC_ASSERT( ( ( M == 3 ) || ( M == 4 ) ), USING_A_NON_STANDARD_TRANSFORMATION_MATRIX );
+	T* out[ M ];
+	for ( std::size_t r = 0; r < M; ++r )
+		out[ r ] = pointsOut + r * n;
+	Math::Util::transform_points_soa< M >( &transformation( 0, 0 ), n, pointsIn, pointsIn + n, pointsIn + 2 * n, out );
 }
 
 
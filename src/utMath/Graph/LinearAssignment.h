@@ -0,0 +1,435 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup math graph
+ * @file
+ * LinearAssignment class
+ *
+ * Solves the linear assignment problem with a shortest augmenting path algorithm
+ * in the style of Jonker and Volgenant. Other than \c Munkres, it runs in O(n^3),
+ * handles rectangular matrices directly, supports gating of implausible pairs
+ * and can be warm-started with the dual variables of a previous solution, e.g. of
+ * the previous frame when associating features between consecutive images.
+ */
+
+#ifndef __UBITRACK_MATH_GRAPH_LINEARASSIGNMENT_H_INCLUDED__
+#define __UBITRACK_MATH_GRAPH_LINEARASSIGNMENT_H_INCLUDED__
+
+#include <utCore.h>
+#include <utMath/Matrix.h>
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+namespace Ubitrack { namespace Math { namespace Graph {
+
+/**
+ * @ingroup math
+ * Solver for the (rectangular) linear assignment problem.
+ *
+ * Every row is matched to at most one column and vice versa, such that the number of
+ * matches is maximal and the sum of the matched costs is minimal. Entries that are
+ * infinite are never matched.
+ *
+ * If a gate is set, entries larger than the gate are never matched and rows or columns
+ * may remain unmatched even if a partner would be available. Matching row i and column j
+ * is then only preferred over leaving both unmatched if their cost is below the gate.
+ *
+ * Internally the problem is extended to a square one: rows are padded with zero rows,
+ * missing columns with zero columns and in gated mode every row gets a private dummy
+ * column with the gate as cost.
+ *
+ * @param T floating point type of the costs
+ */
+template< typename T >
+class LinearAssignment
+{
+public:
+
+	/** Default constructor */
+	LinearAssignment()
+		: m_rows( 0 )
+		, m_cols( 0 )
+		, m_size( 0 )
+		, m_gated( false )
+		, m_gate( 0 )
+	{}
+
+	/** Constructor directly using a matrix which should be solved */
+	LinearAssignment( const Math::Matrix< T, 0, 0 >& matrix )
+		: m_rows( 0 )
+		, m_cols( 0 )
+		, m_size( 0 )
+		, m_gated( false )
+		, m_gate( 0 )
+	{
+		setMatrix( matrix );
+	}
+
+	/**
+	 * Sets a gate. Must be called before \c setMatrix.
+	 * @param gate maximum cost of a match, also the cost of leaving a row unmatched
+	 */
+	void setGate( T gate )
+	{
+		m_gated = true;
+		m_gate = gate;
+	}
+
+	/** removes the gate. Must be called before \c setMatrix. */
+	void clearGate()
+	{ m_gated = false; }
+
+	/**
+	 * sets the input data
+	 * @param matrix the cost matrix to be solved, rows and columns may differ in size
+	 */
+	void setMatrix( const Math::Matrix< T, 0, 0 >& matrix )
+	{
+		m_rows = matrix.size1();
+		m_cols = matrix.size2();
+		m_size = m_gated ? m_rows + m_cols : std::max( m_rows, m_cols );
+
+		// columns: [ real | padding or dummy columns ], rows: [ real | zero rows ]
+		m_cost.assign( m_size * m_size, T( 0 ) );
+		for ( std::size_t i = 0; i < m_rows; i++ )
+		{
+			T* pRow = &m_cost[ i * m_size ];
+			for ( std::size_t j = 0; j < m_cols; j++ )
+			{
+				const T c = matrix( i, j );
+				pRow[ j ] = ( m_gated && !( c <= m_gate ) ) ? infinity() : c;
+			}
+
+			if ( m_gated )
+			{
+				std::fill( pRow + m_cols, pRow + m_size, infinity() );
+				pRow[ m_cols + i ] = m_gate;
+			}
+		}
+	}
+
+	/** solves the problem from scratch. Must be called AFTER the input data was set */
+	void solve()
+	{
+		initialize( std::vector< T >(), std::vector< T >() );
+		augment();
+	}
+
+	/**
+	 * solves the problem starting from the dual variables of a previous solution.
+	 *
+	 * If the costs changed only little, most matches are already found during the
+	 * initialization. Column duals take precedence, if only row duals are given they are
+	 * used instead. Missing entries are initialized with zero, superfluous ones are ignored.
+	 * Any values result in the optimal solution, only the run time depends on them.
+	 *
+	 * @param rowDuals row duals, e.g. from \c getRowDuals()
+	 * @param colDuals column duals, e.g. from \c getColDuals()
+	 */
+	void solve( const std::vector< T >& rowDuals, const std::vector< T >& colDuals )
+	{
+		initialize( rowDuals, colDuals );
+		augment();
+	}
+
+	/**
+	 * returns the result as a ordered list of matches
+	 * the order is corresponding to the rows, unmatched rows
+	 * have a value that is not smaller than the number of columns
+	 *
+	 * @return match list of rows to columns
+	 */
+	std::vector< std::size_t > getRowMatchList() const
+	{
+		std::vector< std::size_t > list( m_rows );
+		for ( std::size_t i = 0; i < m_rows; i++ )
+			list[ i ] = m_col4row[ i ] < 0 ? m_size : static_cast< std::size_t >( m_col4row[ i ] );
+		return list;
+	}
+
+	/**
+	 * returns the result as a ordered list of matches
+	 * the order is corresponding to the columns, unmatched columns
+	 * have a value that is not smaller than the number of rows
+	 *
+	 * @return match list of columns to rows
+	 */
+	std::vector< std::size_t > getColMatchList() const
+	{
+		std::vector< std::size_t > list( m_cols );
+		for ( std::size_t j = 0; j < m_cols; j++ )
+			list[ j ] = m_row4col[ j ] < 0 ? m_size : static_cast< std::size_t >( m_row4col[ j ] );
+		return list;
+	}
+
+	/**
+	 * returns the result as a masked Matrix
+	 * @return every 1 in the matrix represents a match
+	 */
+	Math::Matrix< T, 0, 0 > getMaskMatrix() const
+	{
+		Math::Matrix< T, 0, 0 > mask( m_rows, m_cols );
+		mask.clear();
+		for ( std::size_t i = 0; i < m_rows; i++ )
+			if ( m_col4row[ i ] >= 0 && static_cast< std::size_t >( m_col4row[ i ] ) < m_cols )
+				mask( i, m_col4row[ i ] ) = T( 1 );
+		return mask;
+	}
+
+	/** @return sum of the costs of all matches */
+	T getCost() const
+	{
+		T cost( 0 );
+		for ( std::size_t i = 0; i < m_rows; i++ )
+			if ( m_col4row[ i ] >= 0 && static_cast< std::size_t >( m_col4row[ i ] ) < m_cols )
+				cost += m_cost[ i * m_size + m_col4row[ i ] ];
+		return cost;
+	}
+
+	/** @return dual variables of the rows, can be used to warm-start the next problem */
+	std::vector< T > getRowDuals() const
+	{ return std::vector< T >( m_u.begin(), m_u.begin() + m_rows ); }
+
+	/** @return dual variables of the columns, can be used to warm-start the next problem */
+	std::vector< T > getColDuals() const
+	{ return std::vector< T >( m_v.begin(), m_v.begin() + m_cols ); }
+
+private:
+
+	static T infinity()
+	{ return std::numeric_limits< T >::infinity(); }
+
+	const T* row( std::size_t i ) const
+	{ return &m_cost[ i * m_size ]; }
+
+	/**
+	 * Computes a feasible dual solution from the given duals and matches all
+	 * pairs with zero reduced cost that do not conflict.
+	 */
+	void initialize( const std::vector< T >& rowDuals, const std::vector< T >& colDuals )
+	{
+		m_u.assign( m_size, T( 0 ) );
+		m_v.assign( m_size, T( 0 ) );
+		m_col4row.assign( m_size, -1 );
+		m_row4col.assign( m_size, -1 );
+
+		if ( colDuals.empty() && !rowDuals.empty() )
+		{
+			// column reduction: v_j = min_i( c_ij - u_i )
+			std::copy( rowDuals.begin(), rowDuals.begin() + std::min( rowDuals.size(), m_rows ), m_u.begin() );
+			std::vector< std::size_t > best( m_size, 0 );
+			std::fill( m_v.begin(), m_v.end(), infinity() );
+			for ( std::size_t i = 0; i < m_size; i++ )
+			{
+				const T* pRow = row( i );
+				for ( std::size_t j = 0; j < m_size; j++ )
+					if ( pRow[ j ] - m_u[ i ] < m_v[ j ] )
+					{
+						m_v[ j ] = pRow[ j ] - m_u[ i ];
+						best[ j ] = i;
+					}
+			}
+
+			for ( std::size_t j = 0; j < m_size; j++ )
+				if ( m_v[ j ] == infinity() )
+					m_v[ j ] = T( 0 );
+				else if ( m_col4row[ best[ j ] ] < 0 )
+					match( best[ j ], j );
+
+			// rows that got no match are made feasible again, they are augmented later
+			for ( std::size_t i = 0; i < m_size; i++ )
+				if ( m_col4row[ i ] < 0 )
+				{
+					const T lowest = rowMinimum( i ).first;
+					m_u[ i ] = lowest == infinity() ? T( 0 ) : lowest;
+				}
+			return;
+		}
+
+		// row reduction: u_i = min_j( c_ij - v_j )
+		std::copy( colDuals.begin(), colDuals.begin() + std::min( colDuals.size(), m_cols ), m_v.begin() );
+		for ( std::size_t i = 0; i < m_size; i++ )
+		{
+			const std::pair< T, std::size_t > minimum( rowMinimum( i ) );
+			if ( minimum.first == infinity() )
+				continue;
+			m_u[ i ] = minimum.first;
+			if ( m_row4col[ minimum.second ] < 0 )
+				match( i, minimum.second );
+		}
+	}
+
+	/** @return minimum reduced cost of a row without row dual and its column, prefers unmatched columns */
+	std::pair< T, std::size_t > rowMinimum( std::size_t i ) const
+	{
+		const T* pRow = row( i );
+		T lowest = infinity();
+		std::size_t index = 0;
+		for ( std::size_t j = 0; j < m_size; j++ )
+		{
+			const T r = pRow[ j ] - m_v[ j ];
+			if ( r < lowest || ( r == lowest && m_row4col[ j ] < 0 && m_row4col[ index ] >= 0 ) )
+			{
+				lowest = r;
+				index = j;
+			}
+		}
+		return std::make_pair( lowest, index );
+	}
+
+	void match( std::size_t i, std::size_t j )
+	{
+		m_col4row[ i ] = static_cast< long >( j );
+		m_row4col[ j ] = static_cast< long >( i );
+	}
+
+	/** matches all remaining rows with shortest augmenting paths */
+	void augment()
+	{
+		std::vector< std::size_t > remaining( m_size );
+		std::vector< T > pathCost( m_size );
+		std::vector< std::size_t > path( m_size );
+		std::vector< std::size_t > scannedRows;
+		std::vector< std::size_t > scannedCols;
+		scannedRows.reserve( m_size );
+		scannedCols.reserve( m_size );
+
+		for ( std::size_t curRow = 0; curRow < m_size; curRow++ )
+		{
+			if ( m_col4row[ curRow ] >= 0 )
+				continue;
+
+			// Dijkstra on the reduced costs from the current row to the closest unmatched column
+			for ( std::size_t j = 0; j < m_size; j++ )
+				remaining[ j ] = m_size - j - 1;
+			std::fill( pathCost.begin(), pathCost.end(), infinity() );
+			scannedRows.clear();
+			scannedCols.clear();
+
+			std::size_t nRemaining = m_size;
+			std::size_t i = curRow;
+			long sink = -1;
+			T minVal( 0 );
+			while ( sink < 0 )
+			{
+				scannedRows.push_back( i );
+				const T* pRow = row( i );
+				const T base = minVal - m_u[ i ];
+
+				T lowest = infinity();
+				std::size_t index = 0;
+				for ( std::size_t it = 0; it < nRemaining; it++ )
+				{
+					const std::size_t j = remaining[ it ];
+					const T r = base + pRow[ j ] - m_v[ j ];
+					if ( r < pathCost[ j ] )
+					{
+						path[ j ] = i;
+						pathCost[ j ] = r;
+					}
+					if ( pathCost[ j ] < lowest || ( pathCost[ j ] == lowest && m_row4col[ j ] < 0 ) )
+					{
+						lowest = pathCost[ j ];
+						index = it;
+					}
+				}
+
+				// no finite path, the row stays unmatched
+				if ( lowest == infinity() )
+					break;
+
+				minVal = lowest;
+				const std::size_t j = remaining[ index ];
+				scannedCols.push_back( j );
+				remaining[ index ] = remaining[ --nRemaining ];
+
+				if ( m_row4col[ j ] < 0 )
+					sink = static_cast< long >( j );
+				else
+					i = m_row4col[ j ];
+			}
+
+			if ( sink < 0 )
+			{
+				m_u[ curRow ] = T( 0 );
+				continue;
+			}
+
+			// update the duals
+			m_u[ curRow ] += minVal;
+			for ( std::size_t k = 1; k < scannedRows.size(); k++ )
+			{
+				const std::size_t r = scannedRows[ k ];
+				m_u[ r ] += minVal - pathCost[ m_col4row[ r ] ];
+			}
+			for ( std::size_t k = 0; k < scannedCols.size(); k++ )
+			{
+				const std::size_t c = scannedCols[ k ];
+				m_v[ c ] -= minVal - pathCost[ c ];
+			}
+
+			// augment along the path
+			long j = sink;
+			while ( true )
+			{
+				const std::size_t r = path[ j ];
+				m_row4col[ j ] = static_cast< long >( r );
+				std::swap( m_col4row[ r ], j );
+				if ( r == curRow )
+					break;
+			}
+		}
+	}
+
+	/** number of rows of the input */
+	std::size_t m_rows;
+
+	/** number of columns of the input */
+	std::size_t m_cols;
+
+	/** size of the extended square problem */
+	std::size_t m_size;
+
+	bool m_gated;
+	T m_gate;
+
+	/** extended cost matrix, row major */
+	std::vector< T > m_cost;
+
+	/** row duals */
+	std::vector< T > m_u;
+
+	/** column duals */
+	std::vector< T > m_v;
+
+	std::vector< long > m_col4row;
+	std::vector< long > m_row4col;
+};
+
+}}} // namespace Ubitrack::Math::Graph
+
+#endif
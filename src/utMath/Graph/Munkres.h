@@ -33,6 +33,8 @@
  *
  * the result can be a masked matrix or a ordered new list of vectors
  *
+ * For larger problems use \c LinearAssignment, which runs in O(n^3).
+ *
  * @author Daniel Muhra <muhra@in.tum.de>
  */
 #ifndef __MUNKRES_INCLUDED__
@@ -138,9 +140,9 @@ Munkres< T >::Munkres( Math::Matrix< T, 0, 0 > & matrix)
 
 template< typename T >
 bool Munkres< T >::find_uncovered_in_matrix(T item, std::size_t & row, std::size_t & col) {
-	for ( std::size_t row( 0 ) ; row < m_max ; ++row )
+	for ( row = 0 ; row < m_max ; ++row )
 		if ( !row_mask[row] )
-			for ( std::size_t col( 0 ) ; col < m_max ; ++col )
+			for ( col = 0 ; col < m_max ; ++col )
 				if ( !col_mask[col] )
 					if ( m_matrix( row, col ) == item )
 						return true;
@@ -452,4 +452,56 @@ struct matrix_detail_traits< Ubitrack::Math::Matrix< T, sM, sN >, M >
 
 } } } } // namespace boost::numeric::bindings::traits
 
+
+// route products of small bounded matrices and vectors to the fixed-size kernels
+#include "Util/small_matrix_kernels.h"
+#include <boost/utility/enable_if.hpp>
+
+namespace boost { namespace numeric { namespace ublas {
+
+/**
+ * @ingroup math
+ * Product of two bounded matrices with at most 8 rows and columns.
+ * Is preferred by overload resolution over the generic ublas expression and
+ * computes the result directly using the small matrix kernels.
+ */
+template< typename T, std::size_t M, std::size_t N, std::size_t K >
+inline typename boost::enable_if_c< Ubitrack::Math::Util::use_small_matrix_kernel< M, N, K >::value, Ubitrack::Math::Matrix< T, M, K > >::type
+prod( const Ubitrack::Math::Matrix< T, M, N >& a, const Ubitrack::Math::Matrix< T, N, K >& b )
+{
+	Ubitrack::Math::Matrix< T, M, K > c;
+	Ubitrack::Math::Util::mat_mat_prod< M, N, K >( &a( 0, 0 ), &b( 0, 0 ), &c( 0, 0 ) );
+	return c;
+}
+
+/**
+ * @ingroup math
+ * Product of a bounded matrix and a bounded vector with at most 8 rows and columns.
+ * Is computed directly using the small matrix kernels.
+ */
+template< typename T, std::size_t M, std::size_t N >
+inline typename boost::enable_if_c< Ubitrack::Math::Util::use_small_matrix_kernel< M, N, 1 >::value, Ubitrack::Math::Vector< T, M > >::type
+prod( const Ubitrack::Math::Matrix< T, M, N >& a, const Ubitrack::Math::Vector< T, N >& b )
+{
+	Ubitrack::Math::Vector< T, M > c;
+	Ubitrack::Math::Util::mat_vec_prod< M, N >( &a( 0, 0 ), &b( 0 ), &c( 0 ) );
+	return c;
+}
+
+/**
+ * @ingroup math
+ * Product of a bounded (row) vector and a bounded matrix with at most 8 rows and columns.
+ * Is computed directly using the small matrix kernels.
+ */
+template< typename T, std::size_t M, std::size_t N >
+inline typename boost::enable_if_c< Ubitrack::Math::Util::use_small_matrix_kernel< M, N, 1 >::value, Ubitrack::Math::Vector< T, N > >::type
+prod( const Ubitrack::Math::Vector< T, M >& a, const Ubitrack::Math::Matrix< T, M, N >& b )
+{
+	Ubitrack::Math::Vector< T, N > c;
+	Ubitrack::Math::Util::mat_trans_vec_prod< M, N >( &b( 0, 0 ), &a( 0 ), &c( 0 ) );
+	return c;
+}
+
+} } } // namespace boost::numeric::ublas
+
 #endif // __UBITRACK_MATH_MATRIX_H_INCLUDED__
@@ -0,0 +1,217 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math
+ * @file
+ * Index based access to one- and two-parameter ransac problems.
+ *
+ * The adapters wrap the \c Estimator and \c Evaluator functors of a ransac
+ * problem description, so that the different ransac strategies can work on
+ * indices of values instead of the iterators themselves.
+ */
+
+#ifndef __UBITRACK_MATH_OPTIMIZATION_DETAIL_RANSACPROBLEM_H_INCLUDED__
+#define __UBITRACK_MATH_OPTIMIZATION_DETAIL_RANSACPROBLEM_H_INCLUDED__
+
+#include <vector>
+#include <iterator> // std::iterator_traits
+#include <algorithm> // std::find
+
+#include <boost/random/uniform_int_distribution.hpp>
+
+namespace Ubitrack { namespace Math { namespace Optimization { namespace Detail {
+
+/// @internal problem description of single-parameter ransac problems
+template< class InputIterator, class ResultType, class RansacFunctor >
+class RansacProblem1
+{
+public:
+	typedef typename std::iterator_traits< InputIterator >::value_type value_type;
+	typedef std::vector< value_type > list_type;
+
+	/// per-thread scratch memory, reused for all hypotheses of one worker
+	struct Workspace
+	{
+		list_type list;
+	};
+
+	RansacProblem1( const InputIterator iBegin, const InputIterator iEnd )
+		: m_iBegin( iBegin )
+		, m_nValues( std::distance( iBegin, iEnd ) )
+	{}
+
+	std::size_t size() const
+	{ return m_nValues; }
+
+	bool estimate( ResultType& result, const std::vector< std::size_t >& indices, Workspace& ws ) const
+	{
+		ws.list.clear();
+		for( std::vector< std::size_t >::const_iterator itIndex = indices.begin(); itIndex != indices.end(); ++itIndex )
+		{
+			InputIterator it ( m_iBegin );
+			std::advance( it, (*itIndex) );
+			ws.list.push_back( *it );
+		}
+		return typename RansacFunctor::Estimator()( result, ws.list.begin(), ws.list.end() );
+	}
+
+	/** error of a single value, efficient for random access iterators only */
+	template< typename T >
+	T error( const ResultType& hypothesis, const std::size_t index ) const
+	{
+		InputIterator it ( m_iBegin );
+		std::advance( it, index );
+		return typename RansacFunctor::Evaluator()( hypothesis, *it );
+	}
+
+	/**
+	 * counts inlier of a hypothesis, stops as soon as \c nRequired inlier cannot be reached anymore
+	 * @return number of inlier or 0 if the evaluation was aborted
+	 */
+	template< typename T >
+	std::size_t score( const ResultType& hypothesis, const T threshold, const std::size_t nRequired, std::vector< std::size_t >& inliers ) const
+	{
+		inliers.clear();
+		InputIterator it ( m_iBegin );
+		for ( std::size_t i = 0; i < m_nValues; i++, ++it )
+		{
+			if( inliers.size() + ( m_nValues - i ) < nRequired )
+				return 0;
+
+			const T d = typename RansacFunctor::Evaluator()( hypothesis, *it );
+			if( d < threshold )
+				inliers.push_back( i );
+		}
+		return inliers.size();
+	}
+
+protected:
+	const InputIterator m_iBegin;
+	const std::size_t m_nValues;
+};
+
+/// @internal problem description of two-parameter ransac problems
+template< class InputIterator1, class InputIterator2, class ResultType, class RansacFunctor >
+class RansacProblem2
+{
+public:
+	typedef typename std::iterator_traits< InputIterator1 >::value_type value_type1;
+	typedef typename std::iterator_traits< InputIterator2 >::value_type value_type2;
+
+	/// per-thread scratch memory, reused for all hypotheses of one worker
+	struct Workspace
+	{
+		std::vector< value_type1 > list1;
+		std::vector< value_type2 > list2;
+	};
+
+	RansacProblem2( const InputIterator1 iBegin1, const InputIterator1 iEnd1, const InputIterator2 iBegin2 )
+		: m_iBegin1( iBegin1 )
+		, m_iBegin2( iBegin2 )
+		, m_nValues( std::distance( iBegin1, iEnd1 ) )
+	{}
+
+	std::size_t size() const
+	{ return m_nValues; }
+
+	bool estimate( ResultType& result, const std::vector< std::size_t >& indices, Workspace& ws ) const
+	{
+		ws.list1.clear();
+		ws.list2.clear();
+		for( std::vector< std::size_t >::const_iterator itIndex = indices.begin(); itIndex != indices.end(); ++itIndex )
+		{
+			InputIterator1 it1 ( m_iBegin1 );
+			InputIterator2 it2 ( m_iBegin2 );
+			std::advance( it1, (*itIndex) );
+			std::advance( it2, (*itIndex) );
+			ws.list1.push_back( *it1 );
+			ws.list2.push_back( *it2 );
+		}
+		return typename RansacFunctor::Estimator()( result, ws.list1.begin(), ws.list1.end(), ws.list2.begin(), ws.list2.end() );
+	}
+
+	/** error of a single value pair, efficient for random access iterators only */
+	template< typename T >
+	T error( const ResultType& hypothesis, const std::size_t index ) const
+	{
+		InputIterator1 it1 ( m_iBegin1 );
+		InputIterator2 it2 ( m_iBegin2 );
+		std::advance( it1, index );
+		std::advance( it2, index );
+		return typename RansacFunctor::Evaluator()( hypothesis, *it1, *it2 );
+	}
+
+	/**
+	 * counts inlier of a hypothesis, stops as soon as \c nRequired inlier cannot be reached anymore
+	 * @return number of inlier or 0 if the evaluation was aborted
+	 */
+	template< typename T >
+	std::size_t score( const ResultType& hypothesis, const T threshold, const std::size_t nRequired, std::vector< std::size_t >& inliers ) const
+	{
+		inliers.clear();
+		InputIterator1 it1 ( m_iBegin1 );
+		InputIterator2 it2 ( m_iBegin2 );
+		for ( std::size_t i = 0; i < m_nValues; i++, ++it1, ++it2 )
+		{
+			if( inliers.size() + ( m_nValues - i ) < nRequired )
+				return 0;
+
+			const T d = typename RansacFunctor::Evaluator()( hypothesis, *it1, *it2 );
+			if( d < threshold )
+				inliers.push_back( i );
+		}
+		return inliers.size();
+	}
+
+protected:
+	const InputIterator1 m_iBegin1;
+	const InputIterator2 m_iBegin2;
+	const std::size_t m_nValues;
+};
+
+
+/**
+ * @internal draws \c k distinct indices out of [0,n) (Floyd's algorithm)
+ *
+ * Unlike shuffling the complete index vector this only costs O(k^2) and
+ * does not depend on any state besides the random number generator.
+ */
+template< class Generator >
+void drawMinimalSet( Generator& rng, const std::size_t n, const std::size_t k, std::vector< std::size_t >& indices )
+{
+	indices.clear();
+	for( std::size_t j = n - k; j < n; ++j )
+	{
+		boost::random::uniform_int_distribution< std::size_t > dist( 0, j );
+		const std::size_t t = dist( rng );
+		if( std::find( indices.begin(), indices.end(), t ) == indices.end() )
+			indices.push_back( t );
+		else
+			indices.push_back( j );
+	}
+}
+
+}}}} // namespace Ubitrack::Math::Optimization::Detail
+
+#endif // __UBITRACK_MATH_OPTIMIZATION_DETAIL_RANSACPROBLEM_H_INCLUDED__
@@ -36,9 +36,14 @@
 
 #ifdef HAVE_LAPACK
 
-// Boost
-#include <boost/scoped_ptr.hpp>
+// std
+#include <algorithm>
 
+// Boost
+#include <boost/config.hpp>
+#ifdef BOOST_NO_CXX11_THREAD_LOCAL
+#include <boost/thread/tss.hpp>
+#endif
 #include <boost/numeric/ublas/matrix_proxy.hpp>
 #include <boost/numeric/ublas/vector_proxy.hpp>
 
@@ -60,172 +65,346 @@ namespace Ubitrack { namespace Math { namespace Optimization {
 /** possible solvers to use in levenberg-marquardt optimization */
 enum LmSolverType { lmUseCholesky, lmUseQR, lmUseSVD };
 
+namespace Detail {
+
+/**
+ * \internal
+ * Selects the storage type of a levenberg-marquardt workspace matrix. Uses the bounded storage
+ * of Math::Matrix if both dimensions are known at compile time and dynamic storage otherwise.
+ */
+template< typename T, std::size_t M, std::size_t N >
+struct LmMatrixStorage
+{ typedef typename Math::Matrix< T, M, N >::base_type type; };
+
+template< typename T, std::size_t M >
+struct LmMatrixStorage< T, M, 0 >
+{ typedef typename Math::Matrix< T >::base_type type; };
+
+template< typename T, std::size_t N >
+struct LmMatrixStorage< T, 0, N >
+{ typedef typename Math::Matrix< T >::base_type type; };
+
+template< typename T >
+struct LmMatrixStorage< T, 0, 0 >
+{ typedef typename Math::Matrix< T >::base_type type; };
+
+} // namespace Detail
+
 /**
  * @ingroup math
- * Optimize a given problem using the levenberg marquardt optimizer.
+ * Levenberg-Marquardt optimizer that owns its workspace.
  *
- * @par The problem class
- * The problem class P must be modeled after the UnaryFunctionPrototype and implement the function
- * \c evaluateWithJacobian which computes the predicted measurement and the jacobian wrt. the parameters to optimize.
+ * All jacobians, residual vectors, the normal equation matrix and the lapack work arrays are allocated once
+ * by the constructor (or by \c resize()) and are reused by every call to \c solve(). No memory is allocated
+ * while iterating, which makes the solver suitable for small problems that are optimized at frame rate.
+ * Callers that assemble the measurement vector on every call can use \c measurementBuffer() for it.
  *
- * @param problem the problem to optimize -- provides measurement estimates and jacobians
- * @param params initial parameters on entry, optimized parameters on exit
- * @param measurement the measurement vector
- * @param terminationCriteria functor that returns true if the optimization should terminate. Is called with
- *   bool operator()( unsigned iteration, double currentError, double previousError )
- * @param normalize a UnaryFunction called after each iteration to normalize the result. Only needs to implement \c evaluate()
- * @param solver least-squares solver to use
- * @return the residual of the optimization process
+ * If the number of measurements \c M and/or the number of parameters \c N are given as template arguments,
+ * the corresponding buffers use bounded (stack) storage. A value of 0 selects dynamic storage which is
+ * sized at runtime.
+ *
+ * Termination, normalization and weighting policies are the same as for \c weightedLevenbergMarquardt().
  */
-template< class P, class X, class Y, class TC, class NT, class WFT > 
-typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const Y& measurement, 
-	const TC& terminationCriteria, const NT& normalize = OptNoNormalize(), 
-	 const WFT& weightFunction = OptNoWeightFunction(), LmSolverType solver = lmUseCholesky,
-	 const typename X::value_type fStepSize = 1.0, const typename X::value_type fStepFactor = 10.0 )
+template< typename T, std::size_t M = 0, std::size_t N = 0 >
+class LevenbergMarquardtSolver
 {
-	namespace lapack = boost::numeric::bindings::lapack;
-	namespace blas = boost::numeric::bindings::blas;
-	namespace ublas = boost::numeric::ublas;
-	typedef typename X::value_type T;
-	typedef typename Math::Matrix< T >::base_type MatType;
-	typedef typename Math::Vector< T >::base_type VecType;
-	
-	const std::size_t n_meas = measurement.size();
-	const std::size_t n_params = params.size();
-	// create some matrices and vectors
-	boost::scoped_ptr< MatType > pJacobian( new MatType( n_meas, n_params ) );
-	boost::scoped_ptr< MatType > pJacobian2( new MatType( n_meas, n_params ) );
-	MatType matJacobiSquare( n_params, n_params );
-	boost::scoped_ptr< VecType > pMeasurementDiff( new VecType( n_meas ) );
-	boost::scoped_ptr< VecType > pMeasurementDiff2( new VecType( n_meas ) );
-	VecType paramDiff( n_params );
-	VecType estimatedMeasurement( n_meas );
-	VecType newParams( n_params );
-
-	// compute initial error
-	problem.evaluateWithJacobian( estimatedMeasurement, params, *pJacobian );
-	ublas::noalias( *pMeasurementDiff ) = measurement - estimatedMeasurement;
-	OPT_LOG_TRACE( "Measurement Diff = " << *pMeasurementDiff );
-
-	// multiply jacobian and difference with sqare root of weight matrix
-	if ( !weightFunction.noWeights() )
+public:
+	typedef typename Detail::LmMatrixStorage< T, M, N >::type JacobianType;
+	typedef typename Detail::LmMatrixStorage< T, N, N >::type NormalMatrixType;
+	typedef typename Math::Vector< T, M >::base_type MeasurementVectorType;
+	typedef typename Math::Vector< T, N >::base_type ParameterVectorType;
+	typedef typename Math::Vector< T, 5 * N >::base_type WorkVectorType;
+
+	/**
+	 * Creates a solver for problems of the given size.
+	 * @param nMeasurements number of measurements (must be equal to \c M if \c M is not 0)
+	 * @param nParameters number of parameters (must be equal to \c N if \c N is not 0)
+	 */
+	LevenbergMarquardtSolver( std::size_t nMeasurements = M, std::size_t nParameters = N )
+		: m_nMeasurements( 0 )
+		, m_nParameters( 0 )
 	{
-		VecType weightVector( n_meas );
-		weightFunction.computeWeights( *pMeasurementDiff, weightVector );
-		for ( std::size_t i = 0; i < n_meas; i++ )
+		resize( nMeasurements, nParameters );
+	}
+
+	/**
+	 * Changes the size of the workspace. Does nothing if the size did not change.
+	 * @param nMeasurements number of measurements (must be equal to \c M if \c M is not 0)
+	 * @param nParameters number of parameters (must be equal to \c N if \c N is not 0)
+	 */
+	void resize( std::size_t nMeasurements, std::size_t nParameters )
+	{
+		if ( ( M != 0 && nMeasurements != M ) || ( N != 0 && nParameters != N ) )
+			UBITRACK_THROW( "LevenbergMarquardtSolver: problem size does not match the static workspace size" );
+
+		if ( nMeasurements == m_nMeasurements && nParameters == m_nParameters )
+			return;
+
+		for ( int i = 0; i < 2; i++ )
 		{
-			const T w = sqrt( weightVector( i ) );
-			(*pMeasurementDiff)( i ) *= w;
-			ublas::row( *pJacobian, i ) *= w;
+			m_jacobian[ i ].resize( nMeasurements, nParameters, false );
+			m_measurementDiff[ i ].resize( nMeasurements, false );
 		}
-		OPT_LOG_TRACE( "weights = " << weightVector );
+		m_estimatedMeasurement.resize( nMeasurements, false );
+		m_weights.resize( nMeasurements, false );
+		m_matJacobiSquare.resize( nParameters, nParameters, false );
+		m_paramDiff.resize( nParameters, false );
+		m_newParams.resize( nParameters, false );
+		m_singularValues.resize( nParameters, false );
+		m_work.resize( 5 * nParameters, false );
+
+		m_nMeasurements = nMeasurements;
+		m_nParameters = nParameters;
 	}
 
-	T fErrPrev = ublas::inner_prod( *pMeasurementDiff, *pMeasurementDiff );
-	OPT_LOG_DEBUG( "Levenberg-Marquardt residual 0: " << fErrPrev );
+	/** number of measurements the workspace is sized for */
+	std::size_t measurementSize() const
+	{ return m_nMeasurements; }
 
-	// start optimization loop
-	T fLambda = T( fStepSize );
-	std::size_t iteration = 0;
-	bool bTerminate = false;
-	while ( !bTerminate )
+	/** number of parameters the workspace is sized for */
+	std::size_t parameterSize() const
+	{ return m_nParameters; }
+
+	/**
+	 * Returns a measurement vector owned by the solver, e.g. to pass it to \c solve(). Its memory is only
+	 * reallocated if the number of measurements changes. The contents are not modified by \c solve().
+	 * @param nMeasurements number of measurements (must be equal to \c M if \c M is not 0)
+	 */
+	MeasurementVectorType& measurementBuffer( std::size_t nMeasurements )
+	{
+		if ( M != 0 && nMeasurements != M )
+			UBITRACK_THROW( "LevenbergMarquardtSolver: problem size does not match the static workspace size" );
+
+		if ( m_measurement.size() != nMeasurements )
+			m_measurement.resize( nMeasurements, false );
+		return m_measurement;
+	}
+
+	/**
+	 * Optimize a given problem. The workspace is resized if the problem size differs from the previous call.
+	 *
+	 * @param problem the problem to optimize -- provides measurement estimates and jacobians
+	 * @param params initial parameters on entry, optimized parameters on exit
+	 * @param measurement the measurement vector
+	 * @param terminationCriteria functor that returns true if the optimization should terminate. Is called with
+	 *   bool operator()( unsigned iteration, double currentError, double previousError )
+	 * @param normalize a UnaryFunction called after each iteration to normalize the result. Only needs to implement \c evaluate()
+	 * @param weightFunction computes the weights of the measurements from the residuals
+	 * @param solver least-squares solver to use
+	 * @return the residual of the optimization process
+	 */
+	template< class P, class X, class Y, class TC, class NT, class WFT >
+	T solve( P& problem, X& params, const Y& measurement, const TC& terminationCriteria, const NT& normalize, 
+		const WFT& weightFunction, LmSolverType solver = lmUseCholesky, const T fStepSize = 1.0, const T fStepFactor = 10.0 )
 	{
-		++iteration;
-
-		// do one optimization step
-		if ( solver == lmUseCholesky )
-			blas::syrk( 'L', 'T', T( 1 ), *pJacobian, T( 0 ), matJacobiSquare );
-		else
-			blas::gemm( 'T', 'N', T( 1 ), *pJacobian, *pJacobian, T( 0 ), matJacobiSquare );
-
-		blas::gemm( 'T', 'N', T( 1 ), *pJacobian, *pMeasurementDiff, T( 0 ), paramDiff );
-		
-		// add lambda to diagonal
-		for ( std::size_t i = 0; i < n_params; i++ )
-			matJacobiSquare( i, i ) += fLambda;		
-		
-		// do least squares
-		switch ( solver )
+		namespace lapack = boost::numeric::bindings::lapack;
+		namespace blas = boost::numeric::bindings::blas;
+		namespace ublas = boost::numeric::ublas;
+
+		resize( measurement.size(), params.size() );
+
+		// the current and the candidate jacobians/residuals are swapped by pointer
+		JacobianType* pJacobian = &m_jacobian[ 0 ];
+		JacobianType* pJacobian2 = &m_jacobian[ 1 ];
+		MeasurementVectorType* pMeasurementDiff = &m_measurementDiff[ 0 ];
+		MeasurementVectorType* pMeasurementDiff2 = &m_measurementDiff[ 1 ];
+
+		// compute initial error
+		problem.evaluateWithJacobian( m_estimatedMeasurement, params, *pJacobian );
+		ublas::noalias( *pMeasurementDiff ) = measurement - m_estimatedMeasurement;
+		OPT_LOG_TRACE( "Measurement Diff = " << *pMeasurementDiff );
+
+		// multiply jacobian and difference with sqare root of weight matrix
+		applyWeights( weightFunction, *pMeasurementDiff, *pJacobian );
+
+		T fErrPrev = ublas::inner_prod( *pMeasurementDiff, *pMeasurementDiff );
+		OPT_LOG_DEBUG( "Levenberg-Marquardt residual 0: " << fErrPrev );
+
+		// start optimization loop
+		T fLambda = T( fStepSize );
+		std::size_t iteration = 0;
+		bool bTerminate = false;
+		while ( !bTerminate )
 		{
-		case lmUseCholesky:
-			if ( lapack::posv( 'L', matJacobiSquare, paramDiff ) != 0 ) // result in paramDiff
-			{
-				OPT_LOG_DEBUG( "Error in cholesky decomposition, switching to SVD" );
-				solver = lmUseSVD;
-				continue;
-			}
-			break;
+			++iteration;
+
+			// do one optimization step
+			if ( solver == lmUseCholesky )
+				blas::syrk( 'L', 'T', T( 1 ), *pJacobian, T( 0 ), m_matJacobiSquare );
+			else
+				blas::gemm( 'T', 'N', T( 1 ), *pJacobian, *pJacobian, T( 0 ), m_matJacobiSquare );
 
-		case lmUseQR:
-			if ( lapack::gels( 'N', matJacobiSquare, paramDiff ) != 0 ) // result in paramDiff
-				UBITRACK_THROW( "lapack::gels returned an error" );
-			break;
+			blas::gemm( 'T', 'N', T( 1 ), *pJacobian, *pMeasurementDiff, T( 0 ), m_paramDiff );
 
-		case lmUseSVD:
+			// add lambda to diagonal
+			for ( std::size_t i = 0; i < m_nParameters; i++ )
+				m_matJacobiSquare( i, i ) += fLambda;
+
+			// do least squares
+			switch ( solver )
 			{
-				Math::Vector< T > sv( n_params );
-				int rank;
-				if ( lapack::gelss( matJacobiSquare, paramDiff, sv, T( -1 ), rank ) != 0 ) // result in paramDiff
-					UBITRACK_THROW( "lapack::gelss returned an error" );
-				OPT_LOG_DEBUG( "Effective rank: " << rank );
-				OPT_LOG_TRACE( "Singular values: " << sv );
-				OPT_LOG_TRACE( "Highest singular vector: " << ublas::row( matJacobiSquare, 0 ) );
-				OPT_LOG_TRACE( "Lowest effective singular vector: " << ublas::row( matJacobiSquare, rank - 1 ) );
+			case lmUseCholesky:
+				if ( lapack::posv( 'L', m_matJacobiSquare, m_paramDiff ) != 0 ) // result in paramDiff
+				{
+					OPT_LOG_DEBUG( "Error in cholesky decomposition, switching to SVD" );
+					solver = lmUseSVD;
+					continue;
+				}
+				break;
+
+			case lmUseQR:
+				if ( lapack::gels( 'N', m_matJacobiSquare, m_paramDiff, m_work ) != 0 ) // result in paramDiff
+					UBITRACK_THROW( "lapack::gels returned an error" );
+				break;
+
+			case lmUseSVD:
+				{
+					int rank;
+					if ( lapack::gelss( m_matJacobiSquare, m_paramDiff, m_singularValues, T( -1 ), rank, m_work ) != 0 ) // result in paramDiff
+						UBITRACK_THROW( "lapack::gelss returned an error" );
+					OPT_LOG_DEBUG( "Effective rank: " << rank );
+					OPT_LOG_TRACE( "Singular values: " << m_singularValues );
+					OPT_LOG_TRACE( "Highest singular vector: " << ublas::row( m_matJacobiSquare, 0 ) );
+					OPT_LOG_TRACE( "Lowest effective singular vector: " << ublas::row( m_matJacobiSquare, rank - 1 ) );
+				}
+				break;
 			}
-			break;
-		}
 
-		OPT_LOG_TRACE( "paramDiff: " << paramDiff );
-		ublas::noalias( newParams ) = params + paramDiff;
+			OPT_LOG_TRACE( "paramDiff: " << m_paramDiff );
+			ublas::noalias( m_newParams ) = params + m_paramDiff;
 
-		// normalize
-		normalize.evaluate( newParams, newParams );
+			// normalize
+			normalize.evaluate( m_newParams, m_newParams );
 
-		// compute new error
-		problem.evaluateWithJacobian( estimatedMeasurement, newParams, *pJacobian2 );
-		ublas::noalias( *pMeasurementDiff2 ) = measurement - estimatedMeasurement;
+			// compute new error
+			problem.evaluateWithJacobian( m_estimatedMeasurement, m_newParams, *pJacobian2 );
+			ublas::noalias( *pMeasurementDiff2 ) = measurement - m_estimatedMeasurement;
 
-		// multiply jacobian and difference with square root of weight matrix
-		if ( !weightFunction.noWeights() )
-		{
-			VecType weightVector( n_meas );
-			weightFunction.computeWeights( *pMeasurementDiff2, weightVector );
-			for ( std::size_t  i = 0; i < n_meas; i++ )
+			// multiply jacobian and difference with square root of weight matrix
+			applyWeights( weightFunction, *pMeasurementDiff2, *pJacobian2 );
+
+			const T fErr = ublas::inner_prod( *pMeasurementDiff2, *pMeasurementDiff2 );
+
+			OPT_LOG_TRACE( "measurementDiff: " << *pMeasurementDiff2 );
+			OPT_LOG_DEBUG( "Levenberg-Marquardt residual " << iteration << ": " << fErr );
+
+			// check if we should terminate
+			bTerminate = terminationCriteria( iteration, fErr, fErrPrev );
+
+			// update parameters
+			if ( fErr >= fErrPrev )
+				fLambda *= T( fStepFactor );
+			else
 			{
-				const T w = sqrt( weightVector( i ) );
-				(*pMeasurementDiff2)( i ) *= w;
-				ublas::row( *pJacobian2, i ) *= w;
+				fLambda /= T( fStepFactor );
+				ublas::noalias( params ) = m_newParams;
+
+				// swap measurementDiff and jacobian
+				std::swap( pMeasurementDiff, pMeasurementDiff2 );
+				std::swap( pJacobian, pJacobian2 );
+
+				fErrPrev = fErr;
 			}
-			OPT_LOG_TRACE( "weights = " << weightVector );
 		}
 
-		const T fErr = ublas::inner_prod( *pMeasurementDiff2, *pMeasurementDiff2 );
+		return fErrPrev;
+	}
 
-		OPT_LOG_TRACE( "measurementDiff: " << *pMeasurementDiff2 );
-		OPT_LOG_DEBUG( "Levenberg-Marquardt residual " << iteration << ": " << fErr );
+	/** Optimize a given problem without weights. See above. */
+	template< class P, class X, class Y, class TC, class NT >
+	T solve( P& problem, X& params, const Y& measurement, const TC& terminationCriteria, const NT& normalize = OptNoNormalize(), 
+		LmSolverType solver = lmUseCholesky, const T fStepSize = 1.0, const T fStepFactor = 10.0 )
+	{ return solve( problem, params, measurement, terminationCriteria, normalize, OptNoWeightFunction(), solver, fStepSize, fStepFactor ); }
 
-		// check if we should terminate
-		bTerminate = terminationCriteria( iteration, fErr, fErrPrev );
+protected:
+	/** multiplies residual and jacobian rows with the square root of the weights */
+	template< class WFT >
+	void applyWeights( const WFT& weightFunction, MeasurementVectorType& measurementDiff, JacobianType& jacobian )
+	{
+		if ( weightFunction.noWeights() )
+			return;
 
-		// update parameters
-		if ( fErr >= fErrPrev )
-			fLambda *= T( fStepFactor );
-		else
+		weightFunction.computeWeights( measurementDiff, m_weights );
+		for ( std::size_t i = 0; i < m_nMeasurements; i++ )
 		{
-			fLambda /= T( fStepFactor );
-			params = newParams;
+			const T w = sqrt( m_weights( i ) );
+			measurementDiff( i ) *= w;
+			boost::numeric::ublas::row( jacobian, i ) *= w;
+		}
+		OPT_LOG_TRACE( "weights = " << m_weights );
+	}
 
-			// swap measurementDiff
-			pMeasurementDiff.swap( pMeasurementDiff2 );
+	std::size_t m_nMeasurements;
+	std::size_t m_nParameters;
+
+	JacobianType m_jacobian[ 2 ];
+	MeasurementVectorType m_measurementDiff[ 2 ];
+	MeasurementVectorType m_estimatedMeasurement;
+	MeasurementVectorType m_weights;
+	MeasurementVectorType m_measurement;
+	NormalMatrixType m_matJacobiSquare;
+	ParameterVectorType m_paramDiff;
+	ParameterVectorType m_newParams;
+	ParameterVectorType m_singularValues;
+	WorkVectorType m_work;
+};
 
-			// swap jacobian
-			pJacobian.swap( pJacobian2 );
-			
-			fErrPrev = fErr;
-		}
+/**
+ * @ingroup math
+ * Returns a levenberg-marquardt solver owned by the calling thread, for functions that optimize a problem 
+ * of the same kind on every call but cannot keep a solver themselves. The workspace keeps the size of the 
+ * last problem, so repeated calls with the same number of measurements do not allocate memory.
+ *
+ * The solver must not be used recursively, i.e. not from within the problem evaluation of another 
+ * optimization with the same solver type.
+ */
+template< typename T, std::size_t M, std::size_t N >
+LevenbergMarquardtSolver< T, M, N >& threadLevenbergMarquardtSolver()
+{
+#ifndef BOOST_NO_CXX11_THREAD_LOCAL
+	static thread_local LevenbergMarquardtSolver< T, M, N > solver;
+	return solver;
+#else
+	static boost::thread_specific_ptr< LevenbergMarquardtSolver< T, M, N > >* pSolver = 
+		new boost::thread_specific_ptr< LevenbergMarquardtSolver< T, M, N > >;
+	LevenbergMarquardtSolver< T, M, N >* p = pSolver->get();
+	if ( !p )
+	{
+		p = new LevenbergMarquardtSolver< T, M, N >;
+		pSolver->reset( p );
 	}
+	return *p;
+#endif
+}
 
-	return fErrPrev;
+/**
+ * @ingroup math
+ * Optimize a given problem using the levenberg marquardt optimizer.
+ *
+ * @par The problem class
+ * The problem class P must be modeled after the UnaryFunctionPrototype and implement the function
+ * \c evaluateWithJacobian which computes the predicted measurement and the jacobian wrt. the parameters to optimize.
+ *
+ * This function creates a temporary workspace on each call. Use a LevenbergMarquardtSolver object if the same
+ * kind of problem is optimized repeatedly.
+ *
+ * @param problem the problem to optimize -- provides measurement estimates and jacobians
+ * @param params initial parameters on entry, optimized parameters on exit
+ * @param measurement the measurement vector
+ * @param terminationCriteria functor that returns true if the optimization should terminate. Is called with
+ *   bool operator()( unsigned iteration, double currentError, double previousError )
+ * @param normalize a UnaryFunction called after each iteration to normalize the result. Only needs to implement \c evaluate()
+ * @param solver least-squares solver to use
+ * @return the residual of the optimization process
+ */
+template< class P, class X, class Y, class TC, class NT, class WFT > 
+typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const Y& measurement, 
+	const TC& terminationCriteria, const NT& normalize = OptNoNormalize(), 
+	 const WFT& weightFunction = OptNoWeightFunction(), LmSolverType solver = lmUseCholesky,
+	 const typename X::value_type fStepSize = 1.0, const typename X::value_type fStepFactor = 10.0 )
+{
+	LevenbergMarquardtSolver< typename X::value_type > lm( measurement.size(), params.size() );
+	return lm.solve( problem, params, measurement, terminationCriteria, normalize, weightFunction, solver, fStepSize, fStepFactor );
 }
 
 /**
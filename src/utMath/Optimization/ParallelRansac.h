@@ -0,0 +1,390 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup math
+ * @file
+ * Multi-threaded variant of the RANSAC algorithm framework
+ *
+ * Hypotheses are generated and evaluated in batches by a fixed set of
+ * worker threads. Every worker draws its minimal sets from its own random
+ * number generator and handles a fixed, interleaved subset of the hypotheses
+ * of each batch. The best inlier set is reduced after every batch by
+ * preferring the largest inlier count and, among equal counts, the smallest
+ * hypothesis number. For a given seed and number of threads the result is
+ * therefore reproducible.
+ *
+ * The \c Estimator and \c Evaluator functors of the problem description are
+ * the same as for the serial \c ransac() and are called concurrently from
+ * several threads, therefore they must not modify shared state.
+ *
+ * As in the serial \c ransac() a \c std::runtime_error thrown while
+ * estimating or scoring a hypothesis only discards that hypothesis. Any
+ * other exception stops all workers after the current batch and is
+ * rethrown in the calling thread.
+ */
+
+
+#ifndef __UBITRACK_MATH_OPTIMIZATION_PARALLELRANSAC_INCLUDED__
+#define __UBITRACK_MATH_OPTIMIZATION_PARALLELRANSAC_INCLUDED__
+
+#include <utCore.h>
+#include "Optimization.h"
+#include "Ransac.h"
+#include "Detail/RansacProblem.h"
+
+#include <vector>
+#include <iterator> // std::iterator_traits
+#include <algorithm> // std::max
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+
+namespace Ubitrack { namespace Math { namespace Optimization {
+
+/**
+ * Parameter structure for the multi-threaded RANSAC algorithm framework
+ *
+ * Extends the usual \c RansacParameter by the parallelization settings.
+ */
+template< typename T >
+struct ParallelRansacParameter
+	: public RansacParameter< T >
+{
+public:
+	typedef typename RansacParameter< T >::size_type size_type;
+
+	/** number of worker threads, including the calling thread */
+	const size_type nThreads;
+
+	/** number of hypotheses evaluated before the workers synchronize */
+	const size_type batchSize;
+
+	/** seed of the random number generators, worker \c i uses \c seed+i */
+	const boost::uint32_t seed;
+
+	/**
+	 * Constructor
+	 *
+	 * @param params the usual ransac parametrization
+	 * @param threads number of worker threads, 0 uses all available hardware threads
+	 * @param batch number of hypotheses per batch, 0 uses four hypotheses per thread
+	 * @param rngSeed seed of the per-thread random number generators
+	 */
+	ParallelRansacParameter( const RansacParameter< T >& params, const std::size_t threads = 0, const std::size_t batch = 0, const boost::uint32_t rngSeed = 5489u )
+		: RansacParameter< T >( params )
+		, nThreads ( threads ? threads : std::max< std::size_t >( 1, boost::thread::hardware_concurrency() ) )
+		, batchSize ( batch ? batch : 4 * nThreads )
+		, seed ( rngSeed )
+		{};
+};
+
+
+namespace Detail {
+
+/// @internal the state shared by all workers of one parallel ransac run
+template< class Problem, class ResultType, typename T >
+class ParallelRansacEngine
+{
+public:
+	ParallelRansacEngine( const Problem& problem, const ParallelRansacParameter< T >& params )
+		: m_problem( problem )
+		, m_params( params )
+		, m_barrier( static_cast< unsigned int >( params.nThreads ) )
+		, m_workers( params.nThreads )
+		, m_nBestInliers( 0 )
+		, m_iBestHypothesis( 0 )
+		, m_bStop( false )
+		, m_nBatches( 0 )
+	{
+		for( std::size_t i = 0; i < m_workers.size(); ++i )
+			m_workers[ i ].rng.seed( params.seed + static_cast< boost::uint32_t >( i ) );
+	}
+
+	/**
+	 * runs all hypotheses and returns the size of the best inlier set found
+	 *
+	 * Exceptions thrown by the problem in a worker thread are rethrown in the calling thread.
+	 */
+	std::size_t run()
+	{
+		if( m_params.setSize > m_problem.size() )
+			return 0;
+
+		if( m_workers.size() == 1 )
+			work( 0 );
+		else
+		{
+			// the calling thread acts as the first worker
+			boost::thread_group threads;
+			for( std::size_t i = 1; i < m_workers.size(); ++i )
+				threads.create_thread( boost::bind( &ParallelRansacEngine::work, this, i ) );
+			work( 0 );
+			threads.join_all();
+		}
+
+		if( m_error )
+			boost::rethrow_exception( m_error );
+		return m_nBestInliers;
+	}
+
+	const std::vector< std::size_t >& bestInliers() const
+	{ return m_bestInliers; }
+
+	std::size_t batches() const
+	{ return m_nBatches; }
+
+protected:
+
+	/// @internal per-thread state, results are only valid for the current batch
+	struct Worker
+	{
+		boost::mt19937 rng;
+		typename Problem::Workspace workspace;
+		std::vector< std::size_t > sample;
+		std::vector< std::size_t > inliers;
+		std::vector< std::size_t > bestInliers;
+		std::size_t nBestInliers;
+		std::size_t iBestHypothesis;
+	};
+
+	void work( const std::size_t iWorker )
+	{
+		Worker& worker = m_workers[ iWorker ];
+		const std::size_t nThreads = m_workers.size();
+
+		for( std::size_t iBatch = 0; iBatch * m_params.batchSize < m_params.nMaxIterations; ++iBatch )
+		{
+			const std::size_t iFirst = iBatch * m_params.batchSize;
+			const std::size_t iLast = std::min( iFirst + m_params.batchSize, m_params.nMaxIterations );
+
+			// hypotheses must beat the result of all previous batches, read only between barriers
+			const std::size_t nRequiredGlobal = std::max( m_params.nMinInlier, m_nBestInliers + 1 );
+			worker.nBestInliers = 0;
+
+			for( std::size_t iHypothesis = iFirst + iWorker; iHypothesis < iLast; iHypothesis += nThreads )
+			{
+				const std::size_t nRequired = std::max( nRequiredGlobal, worker.nBestInliers + 1 );
+
+				// exceptions must not leave the thread, the worker has to reach the barriers in any case
+				try
+				{
+					drawMinimalSet( worker.rng, m_problem.size(), m_params.setSize, worker.sample );
+
+					ResultType hypothesis;
+					if( !m_problem.estimate( hypothesis, worker.sample, worker.workspace ) )
+						continue;
+
+					const std::size_t nInlier = m_problem.score( hypothesis, m_params.threshold, nRequired, worker.inliers );
+					if( nInlier >= nRequired )
+					{
+						worker.nBestInliers = nInlier;
+						worker.iBestHypothesis = iHypothesis;
+						worker.bestInliers.swap( worker.inliers );
+					}
+				}
+#ifdef OPTIMIZATION_LOGGING
+				catch ( const std::runtime_error& e )
+				{ OPT_LOG_DEBUG( "parallel RANSAC: caught exception: " << e.what() ); }
+#else
+				catch ( const std::runtime_error& )
+				{}
+#endif
+				catch ( ... )
+				{
+					setError( boost::current_exception() );
+					break;
+				}
+			}
+
+			if( nThreads > 1 )
+				m_barrier.wait();
+
+			if( iWorker == 0 )
+				reduce( iBatch );
+
+			if( nThreads > 1 )
+				m_barrier.wait();
+
+			if( m_bStop )
+				break;
+		}
+	}
+
+	/// @internal keeps the first exception of all workers
+	void setError( const boost::exception_ptr& error )
+	{
+		boost::mutex::scoped_lock l( m_errorMutex );
+		if( !m_error )
+			m_error = error;
+	}
+
+	/// @internal merges the worker results in a deterministic order, called by one thread only
+	void reduce( const std::size_t iBatch )
+	{
+		std::size_t iBestWorker = m_workers.size();
+		for( std::size_t i = 0; i < m_workers.size(); ++i )
+		{
+			const Worker& worker = m_workers[ i ];
+			if( !worker.nBestInliers )
+				continue;
+			if( iBestWorker == m_workers.size()
+				|| worker.nBestInliers > m_workers[ iBestWorker ].nBestInliers
+				|| ( worker.nBestInliers == m_workers[ iBestWorker ].nBestInliers && worker.iBestHypothesis < m_workers[ iBestWorker ].iBestHypothesis ) )
+				iBestWorker = i;
+		}
+
+		if( iBestWorker != m_workers.size() )
+		{
+			Worker& worker = m_workers[ iBestWorker ];
+			m_nBestInliers = worker.nBestInliers;
+			m_iBestHypothesis = worker.iBestHypothesis;
+			m_bestInliers.swap( worker.bestInliers );
+			OPT_LOG_TRACE( "parallel RANSAC batch " << iBatch + 1 << ": " << m_nBestInliers << " inlier from hypothesis " << m_iBestHypothesis + 1 );
+		}
+
+		m_nBatches = iBatch + 1;
+
+		// stop after the batch in which the required number of inlier was found or a worker failed
+		m_bStop = m_nBestInliers >= m_params.nMinInlier || m_error;
+	}
+
+	const Problem& m_problem;
+	const ParallelRansacParameter< T >& m_params;
+	boost::barrier m_barrier;
+	std::vector< Worker > m_workers;
+
+	std::size_t m_nBestInliers;
+	std::size_t m_iBestHypothesis;
+	std::vector< std::size_t > m_bestInliers;
+	bool m_bStop;
+	std::size_t m_nBatches;
+
+	boost::mutex m_errorMutex;
+	boost::exception_ptr m_error;
+};
+
+} // namespace Detail
+
+
+/**
+ * multi-threaded RANSAC algorithm (for one-parameter problems)
+ *
+ * @tparam InputIterator describes the type of container iterator that points to the values
+ * @tparam ResultType the result type of the solution formulation
+ * @tparam T describes the numeric type used for error calculation (usually \c float or \c double )
+ * @tparam RansacFunctor the type of the struct/class that should include \c Estimator and \c Evaluator functor object to estimate the solution and validate it
+ * @param iBegin an \c iterator point to the first element of a container including the values
+ * @param iEnd an \c iterator point to the final element of a container including the values
+ * @param result returns the best estimated result for the given problem and parameter set
+ * @param model an instance of the struct/class that includes the Estimator and Evaluator FunctorObjects that describe the solution of a problem and it's validation
+ * @param params an instance of the object containing the algorithms parametrization
+ * @return 0 (failure) or number of inlier on success
+*/
+template< class InputIterator, class ResultType, typename T, class RansacFunctor >
+std::size_t ransac( const InputIterator iBegin, const InputIterator iEnd
+	, ResultType& result
+	, const RansacFunctor& model
+	, const ParallelRansacParameter< T >& params )
+{
+	typedef Detail::RansacProblem1< InputIterator, ResultType, RansacFunctor > problem_type;
+
+	const problem_type problem( iBegin, iEnd );
+	assert( params.nMinInlier <= problem.size() );
+
+	OPT_LOG_DEBUG( "parallel RANSAC with " << problem.size() << " values , " << params.nMinInlier << " inlier required, " << params.nThreads << " threads" );
+
+	Detail::ParallelRansacEngine< problem_type, ResultType, T > engine( problem, params );
+	const std::size_t nBestInliers = engine.run();
+
+	if ( nBestInliers && nBestInliers >= params.nMinInlier )
+	{
+		typename problem_type::Workspace ws;
+		problem.estimate( result, engine.bestInliers(), ws );
+		OPT_LOG_DEBUG( "Estimated " << nBestInliers << " inlier after " << engine.batches() << " batches."  );
+		return nBestInliers;
+	}
+
+	OPT_LOG_DEBUG( "parallel RANSAC: Not enough inlier found" );
+	return 0;
+}
+
+
+/**
+ * multi-threaded RANSAC algorithm (for two-parameter problems)
+ *
+ * @tparam InputIterator1 describes the type of container iterator that points to the first type of values
+ * @tparam InputIterator2 describes the type of container iterator that points to the second type of values
+ * @tparam ResultType the result type of the solution formulation
+ * @tparam T describes the numeric type used for error calculation (usually \c float or \c double )
+ * @tparam RansacFunctor the type of the struct/class that should include \c Estimator and \c Evaluator functor object to estimate the solution and validate it
+ * @param iBegin1 an \c iterator that points to the first element of a container including the first problem values
+ * @param iEnd1 an \c iterator that points to the final element of a container including the first problem values
+ * @param iBegin2 an \c iterator that points to the first element of a container including the second problem values
+ * @param iEnd2 an \c iterator that points to the final element of a container including the second problem values
+ * @param result returns the best estimated result for the given problem and parameter set
+ * @param model an instance of the struct/class that includes the Estimator and Evaluator FunctorObjects that describe the solution of a problem and it's validation
+ * @param params an instance of the object containing the algorithms parametrization
+ * @return 0 (failure) or number of inlier on success
+*/
+template< typename InputIterator1, typename InputIterator2, class ResultType, typename T, class RansacFunctor >
+std::size_t ransac( const InputIterator1 iBegin1, const InputIterator1 iEnd1
+		, const InputIterator2 iBegin2, const InputIterator2 iEnd2
+		, ResultType& result
+		, const RansacFunctor& model
+		, const ParallelRansacParameter< T >& params )
+{
+	typedef Detail::RansacProblem2< InputIterator1, InputIterator2, ResultType, RansacFunctor > problem_type;
+
+	const problem_type problem( iBegin1, iEnd1, iBegin2 );
+	assert( params.nMinInlier <= problem.size() );
+	assert( static_cast< std::size_t >( std::distance( iBegin2, iEnd2 ) ) == problem.size() );
+
+	OPT_LOG_DEBUG( "parallel RANSAC with " << problem.size() << " values , " << params.nMinInlier << " inlier required, " << params.nThreads << " threads" );
+
+	Detail::ParallelRansacEngine< problem_type, ResultType, T > engine( problem, params );
+	const std::size_t nBestInliers = engine.run();
+
+	if ( nBestInliers && nBestInliers >= params.nMinInlier )
+	{
+		typename problem_type::Workspace ws;
+		problem.estimate( result, engine.bestInliers(), ws );
+		OPT_LOG_DEBUG( "Estimated " << nBestInliers << " inlier after " << engine.batches() << " batches."  );
+		return nBestInliers;
+	}
+
+	OPT_LOG_DEBUG( "parallel RANSAC: Not enough inlier found" );
+	return 0;
+}
+
+}}} // namespace Ubitrack::Math::Optimization
+
+#endif // __UBITRACK_MATH_OPTIMIZATION_PARALLELRANSAC_INCLUDED__
@@ -0,0 +1,567 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup math
+ * @file
+ * Variants of the RANSAC algorithm framework
+ *
+ * - adaptive termination: the number of iterations is updated from the
+ *   inlier ratio of the best hypothesis found so far
+ * - PROSAC sampling (Chum and Matas, 2005): values are expected to be sorted
+ *   by decreasing quality, minimal sets are drawn from a growing prefix
+ * - local optimization (LO-RANSAC, Chum et al., 2003): every new best
+ *   hypothesis is iteratively re-estimated from its inlier set
+ * - preemptive scoring (Nister, 2003): a fixed number of hypotheses is
+ *   scored on blocks of values and only the better half survives each block
+ *
+ * All variants use the same \c Estimator and \c Evaluator functors as
+ * the classical \c ransac() and are selected by the parameter type.
+ * They also handle exceptions the same way: a \c std::runtime_error thrown
+ * while estimating or scoring a hypothesis only discards that hypothesis,
+ * any other exception is passed on to the caller.
+ */
+
+
+#ifndef __UBITRACK_MATH_OPTIMIZATION_RANSACSTRATEGIES_INCLUDED__
+#define __UBITRACK_MATH_OPTIMIZATION_RANSACSTRATEGIES_INCLUDED__
+
+#include <utCore.h>
+#include "Optimization.h"
+#include "Ransac.h"
+#include "Detail/RansacProblem.h"
+
+#include <cmath> // std::log, std::pow, std::ceil
+#include <vector>
+#include <limits>
+#include <algorithm> // std::sort, std::min
+#include <stdexcept>
+
+#include <boost/cstdint.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+
+namespace Ubitrack { namespace Math { namespace Optimization {
+
+/** sampling strategy of the adaptive ransac */
+enum RansacSampling { ransacUniformSampling, ransacProsacSampling };
+
+
+/**
+ * computes the number of iterations needed to draw at least one outlier free
+ * minimal set with the given probability.
+ *
+ * @param inlierRatio the ratio of inlier to all values
+ * @param setSize size of the minimal set
+ * @param successProbability probability to draw an outlier free set
+ * @param nMaxIterations upper bound of the result
+ * @return the number of iterations, at least 1 and at most \c nMaxIterations
+ */
+inline std::size_t ransacIterations( const double inlierRatio, const std::size_t setSize, const double successProbability, const std::size_t nMaxIterations )
+{
+	if( inlierRatio >= 1. )
+		return std::min< std::size_t >( 1, nMaxIterations );
+
+	const double pGood = std::pow( inlierRatio, static_cast< int >( setSize ) );
+	if( pGood <= std::numeric_limits< double >::epsilon() )
+		return nMaxIterations;
+
+	const double n = std::ceil( std::log( 1. - successProbability ) / std::log( 1. - pGood ) );
+	if( n >= static_cast< double >( nMaxIterations ) )
+		return nMaxIterations;
+	return std::max< std::size_t >( 1, static_cast< std::size_t >( n ) );
+}
+
+
+/**
+ * Parameter structure for the adaptive RANSAC variants
+ *
+ * \c nMaxIterations of the base class becomes an upper bound, the actual
+ * number of iterations is derived from the best inlier ratio found so far.
+ * \c nMinInlier is only required for the final result and does not stop
+ * the iterations anymore.
+ */
+template< typename T >
+struct AdaptiveRansacParameter
+	: public RansacParameter< T >
+{
+public:
+	typedef typename RansacParameter< T >::size_type size_type;
+
+	/** probability to draw at least one outlier free set */
+	const T successProbability;
+
+	/** how minimal sets are drawn */
+	const RansacSampling sampling;
+
+	/** maximum number of re-estimations from the inlier set of a new best hypothesis, 0 disables local optimization */
+	const size_type nLocalOptimizations;
+
+	/** seed of the random number generator */
+	const boost::uint32_t seed;
+
+	/**
+	 * Constructor
+	 *
+	 * @param params the usual ransac parametrization, \c nMaxIterations becomes the upper bound
+	 * @param percentSuccess probability to draw at least one outlier free set
+	 * @param sampler uniform sampling or PROSAC, the latter requires values sorted by decreasing quality
+	 * @param nLocalOpt maximum number of local optimization steps
+	 * @param rngSeed seed of the random number generator
+	 */
+	AdaptiveRansacParameter( const RansacParameter< T >& params, const T percentSuccess = 0.99, const RansacSampling sampler = ransacUniformSampling
+		, const std::size_t nLocalOpt = 0, const boost::uint32_t rngSeed = 5489u )
+		: RansacParameter< T >( params )
+		, successProbability ( percentSuccess )
+		, sampling ( sampler )
+		, nLocalOptimizations ( nLocalOpt )
+		, seed ( rngSeed )
+		{};
+};
+
+
+/**
+ * Parameter structure for the preemptive RANSAC variant
+ *
+ * \c nMaxIterations of the base class is the number of hypotheses generated
+ * up front, these are reduced to one by scoring them on blocks of values.
+ */
+template< typename T >
+struct PreemptiveRansacParameter
+	: public RansacParameter< T >
+{
+public:
+	typedef typename RansacParameter< T >::size_type size_type;
+
+	/** number of values scored before the hypotheses are halved */
+	const size_type blockSize;
+
+	/** seed of the random number generator */
+	const boost::uint32_t seed;
+
+	/**
+	 * Constructor
+	 *
+	 * @param params the usual ransac parametrization, \c nMaxIterations is the number of hypotheses
+	 * @param block number of values scored before the hypotheses are halved
+	 * @param rngSeed seed of the random number generator
+	 */
+	PreemptiveRansacParameter( const RansacParameter< T >& params, const std::size_t block = 100, const boost::uint32_t rngSeed = 5489u )
+		: RansacParameter< T >( params )
+		, blockSize ( block ? block : 1 )
+		, seed ( rngSeed )
+		{};
+};
+
+
+namespace Detail {
+
+/**
+ * @internal PROSAC sampling schedule
+ *
+ * The first \c n values are used for sampling, \c n grows with the number
+ * of drawn sets so that eventually the whole set is sampled uniformly.
+ */
+class ProsacSampler
+{
+public:
+	/**
+	 * @param nValues number of values
+	 * @param setSize size of the minimal sets
+	 * @param nGrowth number of samples after which PROSAC is equivalent to RANSAC, 200000 in the original paper
+	 */
+	ProsacSampler( const std::size_t nValues, const std::size_t setSize, const std::size_t nGrowth = 200000 )
+		: m_nValues( nValues )
+		, m_setSize( setSize )
+		, m_n( setSize )
+		, m_t( 0 )
+		, m_Tn( static_cast< double >( nGrowth ) )
+		, m_TnPrime( 1 )
+	{
+		for( std::size_t i = 0; i < setSize; ++i )
+			m_Tn *= static_cast< double >( setSize - i ) / static_cast< double >( nValues - i );
+	}
+
+	template< class Generator >
+	void draw( Generator& rng, std::vector< std::size_t >& indices )
+	{
+		++m_t;
+		while( m_t >= m_TnPrime && m_n < m_nValues )
+		{
+			const double TnNext = m_Tn * static_cast< double >( m_n + 1 ) / static_cast< double >( m_n + 1 - m_setSize );
+			m_TnPrime += static_cast< std::size_t >( std::ceil( TnNext - m_Tn ) );
+			m_Tn = TnNext;
+			++m_n;
+		}
+
+		if( m_TnPrime < m_t )
+			drawMinimalSet( rng, m_n, m_setSize, indices );
+		else
+		{
+			// the newest value is always part of the set
+			drawMinimalSet( rng, m_n - 1, m_setSize - 1, indices );
+			indices.push_back( m_n - 1 );
+		}
+	}
+
+protected:
+	const std::size_t m_nValues;
+	const std::size_t m_setSize;
+	std::size_t m_n;
+	std::size_t m_t;
+	double m_Tn;
+	std::size_t m_TnPrime;
+};
+
+
+/**
+ * @internal adaptive ransac loop with optional PROSAC sampling and local optimization
+ * @return size of the best inlier set, indices are written to \c bestInliers
+ */
+template< class ResultType, class Problem, typename T >
+std::size_t adaptiveRansac( const Problem& problem, const AdaptiveRansacParameter< T >& params, std::vector< std::size_t >& bestInliers )
+{
+	const std::size_t nValues = problem.size();
+	if( params.setSize > nValues )
+		return 0;
+
+	boost::mt19937 rng( params.seed );
+	ProsacSampler prosac( nValues, params.setSize );
+	typename Problem::Workspace ws;
+
+	std::vector< std::size_t > sample;
+	std::vector< std::size_t > inliers;
+	std::vector< std::size_t > refinedInliers;
+	inliers.reserve( nValues );
+	refinedInliers.reserve( nValues );
+
+	std::size_t nBestInliers = 0;
+	std::size_t nIterations = params.nMaxIterations;
+
+	std::size_t iRun;
+	for( iRun = 0; iRun < nIterations; iRun++ )
+	{
+		if( params.sampling == ransacProsacSampling )
+			prosac.draw( rng, sample );
+		else
+			drawMinimalSet( rng, nValues, params.setSize, sample );
+
+		try
+		{
+			ResultType hypothesis;
+			if( !problem.estimate( hypothesis, sample, ws ) )
+			{
+				OPT_LOG_TRACE( "fast forward, no estimation possible" );
+				continue;
+			}
+
+			std::size_t nInlier = problem.score( hypothesis, params.threshold, nBestInliers + 1, inliers );
+			if( nInlier <= nBestInliers )
+				continue;
+
+			// local optimization: re-estimate from the inlier as long as the support grows
+			for( std::size_t iLocal = 0; iLocal < params.nLocalOptimizations; ++iLocal )
+			{
+				ResultType refined;
+				if( !problem.estimate( refined, inliers, ws ) )
+					break;
+
+				const std::size_t nRefined = problem.score( refined, params.threshold, nInlier + 1, refinedInliers );
+				if( nRefined <= nInlier )
+					break;
+
+				nInlier = nRefined;
+				inliers.swap( refinedInliers );
+			}
+
+			nBestInliers = nInlier;
+			bestInliers.swap( inliers );
+
+			nIterations = std::min( nIterations, ransacIterations( static_cast< double >( nBestInliers ) / nValues
+				, params.setSize, params.successProbability, params.nMaxIterations ) );
+			OPT_LOG_TRACE( "RANSAC iteration " << iRun + 1 << ": " << nBestInliers << " inlier, " << nIterations << " iterations required" );
+		}
+#ifdef OPTIMIZATION_LOGGING
+		catch ( const std::runtime_error& e )
+		{ OPT_LOG_DEBUG( "RANSAC: caught exception: " << e.what() ); }
+#else
+		catch ( const std::runtime_error& )
+		{}
+#endif
+	}
+
+	OPT_LOG_DEBUG( "adaptive RANSAC stopped after " << iRun << " iterations." );
+	return nBestInliers;
+}
+
+
+/// @internal orders hypotheses by decreasing score, ties by increasing index
+struct PreemptiveScoreCompare
+{
+	const std::vector< std::size_t >& scores;
+
+	PreemptiveScoreCompare( const std::vector< std::size_t >& s )
+		: scores( s )
+	{}
+
+	bool operator()( const std::size_t a, const std::size_t b ) const
+	{
+		return scores[ a ] > scores[ b ] || ( scores[ a ] == scores[ b ] && a < b );
+	}
+};
+
+
+/**
+ * @internal preemptive ransac
+ * @return size of the inlier set of the surviving hypothesis, indices are written to \c bestInliers
+ */
+template< class ResultType, class Problem, typename T >
+std::size_t preemptiveRansac( const Problem& problem, const PreemptiveRansacParameter< T >& params, std::vector< std::size_t >& bestInliers )
+{
+	const std::size_t nValues = problem.size();
+	if( params.setSize > nValues )
+		return 0;
+
+	boost::mt19937 rng( params.seed );
+	typename Problem::Workspace ws;
+
+	// generate all hypotheses up front
+	std::vector< ResultType > hypotheses;
+	hypotheses.reserve( params.nMaxIterations );
+	std::vector< std::size_t > sample;
+	for( std::size_t iRun = 0; iRun < params.nMaxIterations; iRun++ )
+	{
+		drawMinimalSet( rng, nValues, params.setSize, sample );
+		try
+		{
+			ResultType hypothesis;
+			if( problem.estimate( hypothesis, sample, ws ) )
+				hypotheses.push_back( hypothesis );
+		}
+#ifdef OPTIMIZATION_LOGGING
+		catch ( const std::runtime_error& e )
+		{ OPT_LOG_DEBUG( "preemptive RANSAC: caught exception: " << e.what() ); }
+#else
+		catch ( const std::runtime_error& )
+		{}
+#endif
+	}
+
+	if( hypotheses.empty() )
+		return 0;
+
+	// values are scored in random order
+	std::vector< std::size_t > order( nValues );
+	for( std::size_t i = 0; i < nValues; ++i )
+	{
+		boost::random::uniform_int_distribution< std::size_t > dist( 0, i );
+		const std::size_t j = dist( rng );
+		order[ i ] = order[ j ];
+		order[ j ] = i;
+	}
+
+	std::vector< std::size_t > scores( hypotheses.size(), 0 );
+	std::vector< std::size_t > alive( hypotheses.size() );
+	for( std::size_t i = 0; i < alive.size(); ++i )
+		alive[ i ] = i;
+
+	std::size_t iValue = 0;
+	while( iValue < nValues && alive.size() > 1 )
+	{
+		const std::size_t iBlockEnd = std::min( iValue + params.blockSize, nValues );
+		std::vector< std::size_t >::iterator itValid = alive.begin();
+		for( std::vector< std::size_t >::const_iterator it = alive.begin(); it != alive.end(); ++it )
+		{
+			try
+			{
+				for( std::size_t j = iValue; j < iBlockEnd; ++j )
+					if( problem.template error< T >( hypotheses[ *it ], order[ j ] ) < params.threshold )
+						scores[ *it ]++;
+				*itValid++ = *it;
+			}
+#ifdef OPTIMIZATION_LOGGING
+			catch ( const std::runtime_error& e )
+			{ OPT_LOG_DEBUG( "preemptive RANSAC: caught exception: " << e.what() ); }
+#else
+			catch ( const std::runtime_error& )
+			{}
+#endif
+		}
+		alive.erase( itValid, alive.end() );
+		iValue = iBlockEnd;
+
+		if( alive.empty() )
+			return 0;
+
+		// keep the better half
+		std::sort( alive.begin(), alive.end(), PreemptiveScoreCompare( scores ) );
+		alive.resize( std::max< std::size_t >( 1, alive.size() / 2 ) );
+		OPT_LOG_TRACE( "preemptive RANSAC: " << alive.size() << " hypotheses left after " << iValue << " values" );
+	}
+
+	// the winner is the best hypothesis of the last round
+	if( alive.size() > 1 )
+		std::sort( alive.begin(), alive.end(), PreemptiveScoreCompare( scores ) );
+	try
+	{
+		return problem.score( hypotheses[ alive.front() ], params.threshold, 0, bestInliers );
+	}
+#ifdef OPTIMIZATION_LOGGING
+	catch ( const std::runtime_error& e )
+	{ OPT_LOG_DEBUG( "preemptive RANSAC: caught exception: " << e.what() ); }
+#else
+	catch ( const std::runtime_error& )
+	{}
+#endif
+	return 0;
+}
+
+} // namespace Detail
+
+
+/**
+ * adaptive RANSAC algorithm (for one-parameter problems)
+ *
+ * For a description of the parameters see the classical \c ransac() function.
+ * @return 0 (failure) or number of inlier on success
+ */
+template< class InputIterator, class ResultType, typename T, class RansacFunctor >
+std::size_t ransac( const InputIterator iBegin, const InputIterator iEnd
+	, ResultType& result
+	, const RansacFunctor& model
+	, const AdaptiveRansacParameter< T >& params )
+{
+	const Detail::RansacProblem1< InputIterator, ResultType, RansacFunctor > problem( iBegin, iEnd );
+	assert( params.nMinInlier <= problem.size() );
+
+	std::vector< std::size_t > bestInliers;
+	const std::size_t nBestInliers = Detail::adaptiveRansac< ResultType >( problem, params, bestInliers );
+	if ( nBestInliers && nBestInliers >= params.nMinInlier )
+	{
+		typename Detail::RansacProblem1< InputIterator, ResultType, RansacFunctor >::Workspace ws;
+		problem.estimate( result, bestInliers, ws );
+		return nBestInliers;
+	}
+
+	OPT_LOG_DEBUG( "RANSAC: Not enough inlier found" );
+	return 0;
+}
+
+
+/**
+ * adaptive RANSAC algorithm (for two-parameter problems)
+ *
+ * For a description of the parameters see the classical \c ransac() function.
+ * @return 0 (failure) or number of inlier on success
+ */
+template< typename InputIterator1, typename InputIterator2, class ResultType, typename T, class RansacFunctor >
+std::size_t ransac( const InputIterator1 iBegin1, const InputIterator1 iEnd1
+		, const InputIterator2 iBegin2, const InputIterator2 iEnd2
+		, ResultType& result
+		, const RansacFunctor& model
+		, const AdaptiveRansacParameter< T >& params )
+{
+	const Detail::RansacProblem2< InputIterator1, InputIterator2, ResultType, RansacFunctor > problem( iBegin1, iEnd1, iBegin2 );
+	assert( params.nMinInlier <= problem.size() );
+	assert( static_cast< std::size_t >( std::distance( iBegin2, iEnd2 ) ) == problem.size() );
+
+	std::vector< std::size_t > bestInliers;
+	const std::size_t nBestInliers = Detail::adaptiveRansac< ResultType >( problem, params, bestInliers );
+	if ( nBestInliers && nBestInliers >= params.nMinInlier )
+	{
+		typename Detail::RansacProblem2< InputIterator1, InputIterator2, ResultType, RansacFunctor >::Workspace ws;
+		problem.estimate( result, bestInliers, ws );
+		return nBestInliers;
+	}
+
+	OPT_LOG_DEBUG( "RANSAC: Not enough inlier found" );
+	return 0;
+}
+
+
+/**
+ * preemptive RANSAC algorithm (for one-parameter problems)
+ *
+ * Values are accessed by index, therefore \c InputIterator should be a random access iterator.
+ * For a description of the parameters see the classical \c ransac() function.
+ * @return 0 (failure) or number of inlier on success
+ */
+template< class InputIterator, class ResultType, typename T, class RansacFunctor >
+std::size_t ransac( const InputIterator iBegin, const InputIterator iEnd
+	, ResultType& result
+	, const RansacFunctor& model
+	, const PreemptiveRansacParameter< T >& params )
+{
+	const Detail::RansacProblem1< InputIterator, ResultType, RansacFunctor > problem( iBegin, iEnd );
+	assert( params.nMinInlier <= problem.size() );
+
+	std::vector< std::size_t > bestInliers;
+	const std::size_t nBestInliers = Detail::preemptiveRansac< ResultType >( problem, params, bestInliers );
+	if ( nBestInliers && nBestInliers >= params.nMinInlier )
+	{
+		typename Detail::RansacProblem1< InputIterator, ResultType, RansacFunctor >::Workspace ws;
+		problem.estimate( result, bestInliers, ws );
+		return nBestInliers;
+	}
+
+	OPT_LOG_DEBUG( "RANSAC: Not enough inlier found" );
+	return 0;
+}
+
+
+/**
+ * preemptive RANSAC algorithm (for two-parameter problems)
+ *
+ * Values are accessed by index, therefore the iterators should be random access iterators.
+ * For a description of the parameters see the classical \c ransac() function.
+ * @return 0 (failure) or number of inlier on success
+ */
+template< typename InputIterator1, typename InputIterator2, class ResultType, typename T, class RansacFunctor >
+std::size_t ransac( const InputIterator1 iBegin1, const InputIterator1 iEnd1
+		, const InputIterator2 iBegin2, const InputIterator2 iEnd2
+		, ResultType& result
+		, const RansacFunctor& model
+		, const PreemptiveRansacParameter< T >& params )
+{
+	const Detail::RansacProblem2< InputIterator1, InputIterator2, ResultType, RansacFunctor > problem( iBegin1, iEnd1, iBegin2 );
+	assert( params.nMinInlier <= problem.size() );
+	assert( static_cast< std::size_t >( std::distance( iBegin2, iEnd2 ) ) == problem.size() );
+
+	std::vector< std::size_t > bestInliers;
+	const std::size_t nBestInliers = Detail::preemptiveRansac< ResultType >( problem, params, bestInliers );
+	if ( nBestInliers && nBestInliers >= params.nMinInlier )
+	{
+		typename Detail::RansacProblem2< InputIterator1, InputIterator2, ResultType, RansacFunctor >::Workspace ws;
+		problem.estimate( result, bestInliers, ws );
+		return nBestInliers;
+	}
+
+	OPT_LOG_DEBUG( "RANSAC: Not enough inlier found" );
+	return 0;
+}
+
+}}} // namespace Ubitrack::Math::Optimization
+
+#endif // __UBITRACK_MATH_OPTIMIZATION_RANSACSTRATEGIES_INCLUDED__
@@ -0,0 +1,304 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup tracking
+ * @file
+ * Kalman filter with state and measurement sizes known at compile time
+ */
+
+#ifndef __UBITRACK_MATH_STOCHASTIC_KALMANFILTER_H_INCLUDED__
+#define __UBITRACK_MATH_STOCHASTIC_KALMANFILTER_H_INCLUDED__
+
+#include <cassert>
+
+#include "../Vector.h"
+#include "../Matrix.h"
+#include "../Util/small_matrix_kernels.h"
+
+namespace Ubitrack { namespace Math { namespace Stochastic {
+
+/**
+ * Kalman filter with a state of \c N elements.
+ *
+ * All sizes are template arguments and all temporaries live on the stack, an update does not
+ * allocate memory. The covariance is updated in Joseph form
+ * @verbatim
+ P = ( I - K H ) P ( I - K H )^T + K R K^T
+ @endverbatim
+ * and kept exactly symmetric, which keeps it positive definite also for badly conditioned
+ * measurements. The innovation covariance is inverted by a Cholesky decomposition that is
+ * unrolled for the measurement size, with a fallback to gaussian elimination.
+ *
+ * The filter either owns its state and covariance, or the static functions are applied to
+ * the state and covariance of another class. Any ublas containers with contiguous storage,
+ * like \c Math::Vector< T > and \c Math::Matrix< T, 0, 0 > of size \c N, can be used then.
+ *
+ * Functions of the measurement and time updates must be modeled after the
+ * \c Ubitrack::Algorithm::Function::Prototype and implement \c evaluateWithJacobian().
+ *
+ * @tparam T the scalar type
+ * @tparam N number of elements in the state
+ */
+template< typename T, std::size_t N >
+class KalmanFilter
+{
+public:
+	typedef Math::Vector< T, N > state_type;
+	typedef Math::Matrix< T, N, N > covariance_type;
+
+	/** initializes the state with zeros and the covariance with identity */
+	KalmanFilter()
+		: m_state( state_type::zeros() )
+		, m_covariance( covariance_type::identity() )
+	{}
+
+	KalmanFilter( const state_type& state, const covariance_type& covariance )
+		: m_state( state )
+		, m_covariance( covariance )
+	{}
+
+	state_type& state()
+	{ return m_state; }
+
+	const state_type& state() const
+	{ return m_state; }
+
+	covariance_type& covariance()
+	{ return m_covariance; }
+
+	const covariance_type& covariance() const
+	{ return m_covariance; }
+
+	/**
+	 * measurement update with a measurement function of the sub-vector [iBegin, iBegin + K) of the state.
+	 * @tparam K size of the input of the measurement function
+	 * @return \c false if the innovation covariance is singular, the state is not changed then
+	 */
+	template< std::size_t K, class MF, std::size_t M >
+	bool measurementUpdate( const MF& measurementFunction, const Math::Vector< T, M >& measurement,
+		const Math::Matrix< T, M, M >& measurementCov, const std::size_t iBegin = 0 )
+	{ return measurementUpdate< K >( m_state, m_covariance, measurementFunction, measurement, measurementCov, iBegin ); }
+
+	/**
+	 * measurement update where the measurement is the sub-vector [iBegin, iBegin + M) of the state.
+	 * @return \c false if the innovation covariance is singular, the state is not changed then
+	 */
+	template< std::size_t M >
+	bool measurementUpdateIdentity( const Math::Vector< T, M >& measurement, const Math::Matrix< T, M, M >& measurementCov,
+		const std::size_t iBegin )
+	{ return measurementUpdateIdentity( m_state, m_covariance, measurement, measurementCov, iBegin ); }
+
+	/**
+	 * Replaces the sub-vector [iOutBegin, iOutBegin + O) of the state by a function of the sub-vector
+	 * [iInBegin, iInBegin + I) and transforms the covariance. The sub-vectors may overlap.
+	 * Use it for time updates ( O = I = N ) or normalizations.
+	 */
+	template< std::size_t O, std::size_t I, class F >
+	void transformRange( const F& f, const std::size_t iOutBegin = 0, const std::size_t iInBegin = 0 )
+	{ transformRange< O, I >( m_state, m_covariance, f, iOutBegin, iInBegin ); }
+
+	/**
+	 * measurement update of external state and covariance of size \c N, see above.
+	 * @param state state vector, predicted value on entry, updated value on exit
+	 * @param stateCov covariance of the state, must be symmetric
+	 * @param measurementFunction function object of the measurement function
+	 * @param measurement measurement vector
+	 * @param measurementCov measurement covariance
+	 * @param iBegin index of the first element of the state used as input to the measurement function
+	 */
+	template< std::size_t K, class MF, std::size_t M, class VState, class MStateCov >
+	static bool measurementUpdate( VState& state, MStateCov& stateCov, const MF& measurementFunction,
+		const Math::Vector< T, M >& measurement, const Math::Matrix< T, M, M >& measurementCov, const std::size_t iBegin = 0 )
+	{
+		assert( state.size() == N && iBegin + K <= N );
+
+		Math::Vector< T, K > input;
+		for ( std::size_t i = 0; i < K; ++i )
+			input( i ) = state( iBegin + i );
+
+		Math::Vector< T, M > predicted;
+		Math::Matrix< T, M, K > jacobian;
+		measurementFunction.evaluateWithJacobian( predicted, input, jacobian );
+
+		T innovation[ M ];
+		for ( std::size_t i = 0; i < M; ++i )
+			innovation[ i ] = measurement( i ) - predicted( i );
+
+		return update< M, K >( &state( 0 ), &stateCov( 0, 0 ), &jacobian( 0, 0 ), innovation, &measurementCov( 0, 0 ), iBegin );
+	}
+
+	/** identity measurement update of external state and covariance of size \c N, see above */
+	template< std::size_t M, class VState, class MStateCov >
+	static bool measurementUpdateIdentity( VState& state, MStateCov& stateCov, const Math::Vector< T, M >& measurement,
+		const Math::Matrix< T, M, M >& measurementCov, const std::size_t iBegin )
+	{
+		assert( state.size() == N && iBegin + M <= N );
+
+		T jacobian[ M * M ];
+		T innovation[ M ];
+		for ( std::size_t j = 0; j < M; ++j )
+		{
+			for ( std::size_t i = 0; i < M; ++i )
+				jacobian[ j * M + i ] = ( i == j ) ? 1 : 0;
+			innovation[ j ] = measurement( j ) - state( iBegin + j );
+		}
+
+		return update< M, M >( &state( 0 ), &stateCov( 0, 0 ), jacobian, innovation, &measurementCov( 0, 0 ), iBegin );
+	}
+
+	/** transformation of a range of external state and covariance of size \c N, see above */
+	template< std::size_t O, std::size_t I, class F, class VState, class MStateCov >
+	static void transformRange( VState& state, MStateCov& stateCov, const F& f, const std::size_t iOutBegin = 0, const std::size_t iInBegin = 0 )
+	{
+		assert( state.size() == N && iOutBegin + O <= N && iInBegin + I <= N );
+
+		Math::Vector< T, I > input;
+		for ( std::size_t i = 0; i < I; ++i )
+			input( i ) = state( iInBegin + i );
+
+		Math::Vector< T, O > result;
+		Math::Matrix< T, O, I > jacobian;
+		f.evaluateWithJacobian( result, input, jacobian );
+		for ( std::size_t i = 0; i < O; ++i )
+			state( iOutBegin + i ) = result( i );
+
+		// jacobian of the whole state, identity outside of the output rows
+		T g[ N * N ];
+		for ( std::size_t j = 0; j < N; ++j )
+			for ( std::size_t i = 0; i < N; ++i )
+				g[ j * N + i ] = ( i == j ) ? 1 : 0;
+		for ( std::size_t i = 0; i < O; ++i )
+		{
+			for ( std::size_t j = 0; j < N; ++j )
+				g[ j * N + iOutBegin + i ] = 0;
+			for ( std::size_t j = 0; j < I; ++j )
+				g[ ( iInBegin + j ) * N + iOutBegin + i ] = jacobian( i, j );
+		}
+
+		// P = G P G^T
+		T* p = &stateCov( 0, 0 );
+		T gp[ N * N ];
+		Util::mat_mat_prod< N, N, N >( g, p, gp );
+		symmetricProduct( gp, g, p );
+	}
+
+protected:
+	/**
+	 * @internal
+	 * Measurement update on raw storage.
+	 * @param x the state
+	 * @param p the covariance
+	 * @param h column-major M-by-K jacobian of the measurement function
+	 * @param innovation measurement minus predicted measurement
+	 * @param r column-major M-by-M measurement covariance
+	 * @param iBegin first element of the state used by the measurement function
+	 */
+	template< std::size_t M, std::size_t K >
+	static bool update( T* x, T* p, const T* h, const T* innovation, const T* r, const std::size_t iBegin )
+	{
+		// P H^T, the covariance columns of the input sub-vector are contiguous
+		T ht[ K * M ];
+		for ( std::size_t i = 0; i < M; ++i )
+			for ( std::size_t j = 0; j < K; ++j )
+				ht[ i * K + j ] = h[ j * M + i ];
+		T pht[ N * M ];
+		Util::mat_mat_prod< N, K, M >( p + iBegin * N, ht, pht );
+
+		// innovation covariance S = H P H^T + R
+		T hpht[ K * M ];
+		for ( std::size_t i = 0; i < M; ++i )
+			for ( std::size_t j = 0; j < K; ++j )
+				hpht[ i * K + j ] = pht[ i * N + iBegin + j ];
+		T s[ M * M ];
+		Util::mat_mat_prod< M, K, M >( h, hpht, s );
+		for ( std::size_t j = 0; j < M; ++j )
+			for ( std::size_t i = 0; i <= j; ++i )
+				s[ j * M + i ] = s[ i * M + j ] = ( s[ j * M + i ] + s[ i * M + j ] + r[ j * M + i ] + r[ i * M + j ] ) / 2;
+
+		T sInv[ M * M ];
+		if ( !Util::spd_invert< M >( s, sInv ) && !Util::lu_invert< M >( s, sInv ) )
+			return false;
+
+		// kalman gain
+		T gain[ N * M ];
+		Util::mat_mat_prod< N, M, M >( pht, sInv, gain );
+
+		// update state
+		T dx[ N ];
+		Util::mat_vec_prod< N, M >( gain, innovation, dx );
+		for ( std::size_t i = 0; i < N; ++i )
+			x[ i ] += dx[ i ];
+
+		// A = I - K H, H is zero outside of the input columns
+		T kh[ N * K ];
+		Util::mat_mat_prod< N, M, K >( gain, h, kh );
+		T a[ N * N ];
+		for ( std::size_t j = 0; j < N; ++j )
+			for ( std::size_t i = 0; i < N; ++i )
+				a[ j * N + i ] = ( i == j ) ? 1 : 0;
+		for ( std::size_t j = 0; j < K; ++j )
+			for ( std::size_t i = 0; i < N; ++i )
+				a[ ( iBegin + j ) * N + i ] -= kh[ j * N + i ];
+
+		// P = A P A^T + K R K^T
+		T ap[ N * N ];
+		Util::mat_mat_prod< N, N, N >( a, p, ap );
+		symmetricProduct( ap, a, p );
+
+		T kr[ N * M ];
+		Util::mat_mat_prod< N, M, M >( gain, r, kr );
+		for ( std::size_t j = 0; j < N; ++j )
+			for ( std::size_t i = 0; i <= j; ++i )
+			{
+				T v = 0;
+				for ( std::size_t k = 0; k < M; ++k )
+					v += kr[ k * N + i ] * gain[ k * N + j ];
+				p[ j * N + i ] += v;
+				if ( i != j )
+					p[ i * N + j ] += v;
+			}
+		return true;
+	}
+
+	/** @internal c = a * b^T for a result that is known to be symmetric, only the upper triangle is computed */
+	static void symmetricProduct( const T* a, const T* b, T* c )
+	{
+		for ( std::size_t j = 0; j < N; ++j )
+			for ( std::size_t i = 0; i <= j; ++i )
+			{
+				T v = 0;
+				for ( std::size_t k = 0; k < N; ++k )
+					v += a[ k * N + i ] * b[ k * N + j ];
+				c[ j * N + i ] = c[ i * N + j ] = v;
+			}
+	}
+
+	state_type m_state;
+	covariance_type m_covariance;
+};
+
+} } } // namespace Ubitrack::Math::Stochastic
+
+#endif // __UBITRACK_MATH_STOCHASTIC_KALMANFILTER_H_INCLUDED__
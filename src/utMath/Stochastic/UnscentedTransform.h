@@ -33,149 +33,258 @@
 #include <utMath/Vector.h>
 #include <utMath/Matrix.h>
 #include <utMath/Optimization/LevenbergMarquardt.h>
+#include <utMath/Stochastic/BackwardPropagation.h>
+#include <utMath/Util/parallel_ranges.h>
 
-// #include <boost/numeric/ublas/matrix_proxy.hpp>
-// #include <boost/numeric/ublas/vector_proxy.hpp>
+#include <vector>
+#include <algorithm>
+
+#include <boost/numeric/ublas/matrix_proxy.hpp>
+#include <boost/numeric/ublas/vector_proxy.hpp>
 
 namespace Ubitrack { namespace Math { namespace Stochastic {
 
 /**
- * Performs an Unscented Transform based on a set of measurements in 2D, a given variance (the probability distribution
- * in 2D is assumed to be isotrophic)  a 2D->6D function, and returns the predicted 6D covariance.
+ * Parameters of the unscented pose covariance estimation
  */
+struct UnscentedTransformParameter
+{
+	/** number of threads solving the sigma-point problems, including the calling thread */
+	std::size_t nThreads;
 
-// Note: the UnscentedTransform might be generalizable to arbitrary measurements and matrix dimensions,
-//    the covariance computation is specialized here (reduction from seven to six DOF)...
+	/** maximum number of levenberg-marquardt iterations per sigma point */
+	std::size_t maxIterations;
 
-template< class PType, class VType >
-Math::Matrix< double, 6, 6 > unscentedTransform(
-		const std::vector< Math::Vector< VType, 2 > >& measurements,
-		VType variance, PType& problem)
-{
-	namespace ublas = boost::numeric::ublas;
+	/** relative change of the residual at which the levenberg-marquardt optimizations stop */
+	double precision;
 
-	// Get standard deviation
-	VType stddev = sqrt(variance);
-	
-	// Storage for optimized parameters
-	std::vector< Math::Vector< VType > > optimizedParameters;
+	/**
+	 * @param threads number of threads, 0 uses all available hardware threads
+	 * @param iterations maximum number of iterations per sigma point
+	 * @param prec relative change of the residual to stop at
+	 */
+	UnscentedTransformParameter( const std::size_t threads = 1, const std::size_t iterations = 200, const double prec = 1e-6 )
+		: nThreads( threads ? threads : std::max< std::size_t >( 1, boost::thread::hardware_concurrency() ) )
+		, maxIterations( iterations )
+		, precision( prec )
+	{}
+};
 
-	// First guess of parameters
-	// TODO: better values than zero?
-	Math::Vector< VType, 7 > params = Math::Vector< VType, 7 >::zeros();
-	// Avoid degenerate (absolute value of zero) quaternion
-	params( 4 ) = 1;
 
-	// Combine measurements into single vector
-	Math::Vector< VType > measurementsCombined ( 2 * measurements.size() );
-	for ( unsigned i = 0; i < measurements.size(); i++ )
-	{
-		measurementsCombined[ 2 * i ] = measurements[ i ][ 0 ];
-		measurementsCombined[ 2 * i + 1 ] = measurements[ i ][ 1 ];
-	}
-	
-	// Create undisturbed set
-	Math::Vector< VType > sigmaSet ( 2 * measurements.size() );
-	sigmaSet = measurementsCombined;
-	
-	// LevenbergMarquadt on undisturbed set
-	VType residual = Math::Optimization::levenbergMarquardt(problem, params, sigmaSet,
-		Math::Optimization::OptTerminate( 200, 1e-6 ), Math::Optimization::OptNoNormalize());
+/**
+ * Estimates the 6D covariance of a pose that is computed from 2D measurements.
+ *
+ * The pose is given as 7-vector (tx, ty, tz, qx, qy, qz, qw) and the problem class maps it to the
+ * measurement vector (x1, y1, x2, y2, ...), like \c Algorithm::Function::MultiplePointProjection.
+ * The covariance refers to the error (e_t, e_r) of \c Math::ErrorPose, i.e. to a translation
+ * error e_t and the imaginary part e_r of a rotation error quaternion that is multiplied from the
+ * right: q = r * e_r.
+ *
+ * \c unscented() propagates the isotropic measurement noise through the whole nonlinear
+ * optimization: the measurement vector is disturbed along each of its L axes by +/- sqrt( L * variance )
+ * and for each of the 2L sigma points the pose is optimized again. The sigma-point optimizations start
+ * from the undisturbed solution and are distributed over several threads, each with a
+ * levenberg-marquardt workspace of its own that is kept for the next call.
+ *
+ * \c firstOrder() computes the linearized covariance variance * ( J^T J )^-1 from the jacobian of the
+ * problem at the pose. It costs a single jacobian and an SVD and is sufficient for most poses.
+ *
+ * The problem is shared by all threads, its \c evaluateWithJacobian() must be const and thread-safe.
+ * Projective problems should be optimized with a normalization like
+ * \c Algorithm::Function::ProjectivePoseNormalize, which keeps the quaternion at unit length.
+ */
+template< typename VType >
+class UnscentedPoseCovariance
+{
+public:
+	typedef Optimization::LevenbergMarquardtSolver< VType, 0, 7 > solver_type;
 
-	// Store optimized parameters
-	optimizedParameters.push_back(params);
-	
-	// Iterate over all measurements
-	for ( unsigned i = 0; i < measurementsCombined.size(); i++ )
+	UnscentedPoseCovariance( const UnscentedTransformParameter& params = UnscentedTransformParameter() )
+		: m_params( params )
+		, m_solvers( params.nThreads )
+	{}
+
+	/**
+	 * Unscented transform of the measurement noise.
+	 *
+	 * @param problem the measurement function, see above
+	 * @param measurements 2D measurements
+	 * @param variance variance of each measurement coordinate
+	 * @param pose initial guess of the pose on entry, optimized pose on exit
+	 * @param normalize normalization of the pose after each optimization step, e.g. \c Algorithm::Function::ProjectivePoseNormalize
+	 * @return 6x6 covariance of the pose
+	 */
+	template< class PType, class NType >
+	Math::Matrix< double, 6, 6 > unscented( const PType& problem, const std::vector< Math::Vector< VType, 2 > >& measurements,
+		const VType variance, Math::Vector< VType, 7 >& pose, const NType& normalize )
 	{
-		// Copy undisturbed set and disturb it
-		sigmaSet = measurementsCombined;
-		sigmaSet[ i ] += stddev;
+		const std::size_t nMeasurements( 2 * measurements.size() );
+		m_measurements.resize( nMeasurements, false );
+		for ( std::size_t i = 0; i < measurements.size(); i++ )
+		{
+			m_measurements( 2 * i ) = measurements[ i ]( 0 );
+			m_measurements( 2 * i + 1 ) = measurements[ i ]( 1 );
+		}
 
-		// Reset parameters
-		params = Math::Vector< VType, 7 >::zeros();
-		params( 4 ) = 1;
+		// the undisturbed solution
+		m_solvers[ 0 ].solve( problem, pose, m_measurements, terminationCriteria(), normalize );
 
-		// LevenbergMarquadt on disturbed set
-		residual = Math::Optimization::levenbergMarquardt(problem, params, sigmaSet,
-			Math::Optimization::OptTerminate( 200, 1e-6 ), Math::Optimization::OptNoNormalize());
+		// the sigma points
+		m_sigmaPoses.resize( 2 * nMeasurements );
+		const std::size_t nThreads( std::min( m_params.nThreads, m_sigmaPoses.size() ) );
+		Math::Util::parallel_ranges( m_sigmaPoses.size(), nThreads,
+			SigmaPointSolver< PType, NType >( *this, problem, normalize, pose, std::sqrt( nMeasurements * variance ) ) );
 
-		// Debugging: output progress
-		// std::cout << "+";
+		return sampleCovariance( pose );
+	}
 
-		// Store optimized parameters
-		optimizedParameters.push_back(params);
+	/** Unscented transform without normalization of the pose, see above */
+	template< class PType >
+	Math::Matrix< double, 6, 6 > unscented( const PType& problem, const std::vector< Math::Vector< VType, 2 > >& measurements,
+		const VType variance, Math::Vector< VType, 7 >& pose )
+	{ return unscented( problem, measurements, variance, pose, Optimization::OptNoNormalize() ); }
 
-		// Copy undisturbed set and disturb it
-		sigmaSet = measurementsCombined;
-		sigmaSet[ i ] -= stddev;
+	/**
+	 * First-order propagation of the measurement noise.
+	 *
+	 * @param problem the measurement function, must implement \c jacobian()
+	 * @param variance variance of each measurement coordinate
+	 * @param pose the optimized pose
+	 * @return 6x6 covariance of the pose
+	 */
+	template< class PType >
+	static Math::Matrix< double, 6, 6 > firstOrder( const PType& problem, const VType variance, const Math::Vector< VType, 7 >& pose )
+	{
+		namespace ublas = boost::numeric::ublas;
 
-		// Reset parameters
-		params = Math::Vector< VType, 7 >::zeros();
-		params( 4 ) = 1;
+		Math::Matrix< VType, 0, 0 > jacobian7( problem.size(), 7 );
+		problem.jacobian( pose, jacobian7 );
 
-		// LevenbergMarquadt on disturbed set
-		residual = Math::Optimization::levenbergMarquardt(problem, params, sigmaSet,
-			Math::Optimization::OptTerminate( 200, 1e-6 ), Math::Optimization::OptNoNormalize());
+		// derivative of the pose w.r.t. the error: q = r * ( e_r, 1 ), t = t + e_t
+		const Math::Quaternion r( Math::Quaternion::fromVector( ublas::subrange( pose, 3, 7 ) ).normalize() );
+		Math::Matrix< VType, 4, 3 > dq;
+		dq( 0, 0 ) =  r.w(); dq( 0, 1 ) = -r.z(); dq( 0, 2 ) =  r.y();
+		dq( 1, 0 ) =  r.z(); dq( 1, 1 ) =  r.w(); dq( 1, 2 ) = -r.x();
+		dq( 2, 0 ) = -r.y(); dq( 2, 1 ) =  r.x(); dq( 2, 2 ) =  r.w();
+		dq( 3, 0 ) = -r.x(); dq( 3, 1 ) = -r.y(); dq( 3, 2 ) = -r.z();
 
-		// Debugging: output progress
-		// std::cout << "-";
+		Math::Matrix< VType, 0, 0 > jacobian6( problem.size(), 6 );
+		ublas::noalias( ublas::subrange( jacobian6, 0, problem.size(), 0, 3 ) ) = ublas::subrange( jacobian7, 0, problem.size(), 0, 3 );
+		ublas::noalias( ublas::subrange( jacobian6, 0, problem.size(), 3, 6 ) ) = ublas::prod( ublas::subrange( jacobian7, 0, problem.size(), 3, 7 ), dq );
 
-		// Store optimized parameters
-		optimizedParameters.push_back(params);
+		Math::Matrix< VType, 6, 6 > covariance;
+		backwardPropagationIdentity( covariance, variance, jacobian6 );
+		return Math::Matrix< double, 6, 6 >( covariance );
 	}
-	// Debugging: output progress
-	// std::cout << std::endl;
-	
-	// Compute average pose
-	Math::Vector< double, 7 > avgPose( Math::Vector< double, 7 >::zeros(); );
-	for ( typename std::vector< Math::Vector< VType > >::iterator it = optimizedParameters.begin();
-			it != optimizedParameters.end(); it++ )
+
+protected:
+	/** @internal solves the sigma-point problems of one thread */
+	template< class PType, class NType >
+	struct SigmaPointSolver
 	{
-		if ( it != optimizedParameters.begin() && 
-			ublas::inner_prod( ublas::subrange( *it, 3, 7 ), ublas::subrange( avgPose, 3, 7 ) ) < 0 )
-			ublas::subrange( *it, 3, 7 ) *= -1;
-		avgPose += *it;
-	}
-	avgPose /= optimizedParameters.size();
-	
-	// Debugging: output average pose
-	// std::cout << "Average pose:" << std::endl;
-	// std::cout << avgPose << std::endl;
+		typedef void result_type;
 
-	// Get average rotation
-	Math::Quaternion avgQuat( Math::Quaternion::fromVector( ublas::subrange( avgPose, 3, 7 ) ) );
-	avgQuat.normalize();
-	
-	// Compute covariance
-	Math::Matrix< double, 6, 6 > covariance( Math::Matrix< double, 6, 6 >::zeros() );
-	for ( typename std::vector< Math::Vector< VType > >::iterator it = optimizedParameters.begin();
-			it != optimizedParameters.end(); it++ )
+		UnscentedPoseCovariance& engine;
+		const PType& problem;
+		const NType& normalize;
+		const Math::Vector< VType, 7 >& pose;
+		const VType spread;
+
+		SigmaPointSolver( UnscentedPoseCovariance& e, const PType& p, const NType& n, const Math::Vector< VType, 7 >& x, const VType s )
+			: engine( e )
+			, problem( p )
+			, normalize( n )
+			, pose( x )
+			, spread( s )
+		{}
+
+		void operator()( const std::size_t t, const std::size_t first, const std::size_t last ) const
+		{
+			Math::Vector< VType > sigmaSet( engine.m_measurements );
+			for ( std::size_t i = first; i < last; i++ )
+			{
+				const std::size_t axis = i / 2;
+				sigmaSet( axis ) += ( i % 2 ) ? -spread : spread;
+
+				// warm start from the undisturbed solution
+				Math::Vector< VType, 7 >& result( engine.m_sigmaPoses[ i ] );
+				result = pose;
+				engine.m_solvers[ t ].solve( problem, result, sigmaSet, engine.terminationCriteria(), normalize );
+
+				sigmaSet( axis ) = engine.m_measurements( axis );
+			}
+		}
+	};
+
+	Optimization::OptTerminate terminationCriteria() const
+	{ return Optimization::OptTerminate( m_params.maxIterations, m_params.precision ); }
+
+	/** covariance of the sigma-point solutions, all with the same weight */
+	Math::Matrix< double, 6, 6 > sampleCovariance( const Math::Vector< VType, 7 >& center ) const
 	{
-		Math::Vector< double, 6 > localError;
-		ublas::subrange( localError, 0, 3 ) = ublas::subrange( *it, 0, 3 ) - ublas::subrange( avgPose, 0, 3 );;
-		
-		Math::Quaternion qLocal((*it)[ 3 ], (*it)[ 4 ], (*it)[ 5 ], (*it)[ 6 ]);
-		qLocal.normalize();
-
-		Math::Quaternion qDiff( avgQuat * ~qLocal );
-		localError( 3 ) = qDiff.x();
-		localError( 4 ) = qDiff.y();
-		localError( 5 ) = qDiff.z();
-		if ( qDiff.w() < 0 )
-			ublas::subrange( localError, 3, 6 ) *= -1;
-		covariance += ublas::outer_prod( localError, localError );
-
-		// Debugging: output error inner product
-		// VType innerProd = ublas::inner_prod( localError, localError );
-		// std::cout << "Inner product:" << std::endl;
-		// std::cout << innerProd << std::endl;
+		namespace ublas = boost::numeric::ublas;
+		// mean pose, quaternions on the hemisphere of the undisturbed solution
+		Math::Vector< double, 7 > avgPose( Math::Vector< double, 7 >::zeros() );
+		for ( std::size_t i = 0; i < m_sigmaPoses.size(); i++ )
+		{
+			Math::Vector< double, 7 > p( m_sigmaPoses[ i ] );
+			ublas::subrange( p, 3, 7 ) /= ublas::norm_2( ublas::subrange( p, 3, 7 ) );
+			if ( ublas::inner_prod( ublas::subrange( p, 3, 7 ), ublas::subrange( center, 3, 7 ) ) < 0 )
+				ublas::subrange( p, 3, 7 ) *= -1;
+			avgPose += p;
+		}
+		avgPose /= double( m_sigmaPoses.size() );
+		const Math::Quaternion avgQuat( Math::Quaternion::fromVector( ublas::subrange( avgPose, 3, 7 ) ).normalize() );
+		const Math::Quaternion invAvgQuat( ~avgQuat );
+
+		Math::Matrix< double, 6, 6 > covariance( Math::Matrix< double, 6, 6 >::zeros() );
+		for ( std::size_t i = 0; i < m_sigmaPoses.size(); i++ )
+		{
+			Math::Vector< double, 6 > localError;
+			for ( std::size_t j = 0; j < 3; j++ )
+				localError( j ) = m_sigmaPoses[ i ]( j ) - avgPose( j );
+
+			// rotation error in the frame of the mean: q = avg * e_r
+			const Math::Quaternion qDiff( invAvgQuat * Math::Quaternion::fromVector( ublas::subrange( m_sigmaPoses[ i ], 3, 7 ) ).normalize() );
+			const double sign = qDiff.w() < 0 ? -1.0 : 1.0;
+			localError( 3 ) = sign * qDiff.x();
+			localError( 4 ) = sign * qDiff.y();
+			localError( 5 ) = sign * qDiff.z();
+
+			covariance += ublas::outer_prod( localError, localError );
+		}
+		covariance /= double( m_sigmaPoses.size() );
+		return covariance;
 	}
-	covariance /= optimizedParameters.size();
-	
-	// Return 6D covariance
-	return covariance;
 
+	const UnscentedTransformParameter m_params;
+	std::vector< solver_type > m_solvers;
+	Math::Vector< VType > m_measurements;
+	std::vector< Math::Vector< VType, 7 > > m_sigmaPoses;
+};
+
+
+/**
+ * Performs an Unscented Transform based on a set of measurements in 2D, a given variance (the probability distribution
+ * in 2D is assumed to be isotrophic)  a 2D->6D function, and returns the predicted 6D covariance.
+ *
+ * The optimization of the undisturbed measurements starts from (0, 0, 0, 0, 1, 0, 0), all sigma points
+ * start from its result. Use an \c UnscentedPoseCovariance object to give a better initial pose, to use
+ * several threads or to keep the optimizer workspaces between calls.
+ */
+template< class PType, class VType >
+Math::Matrix< double, 6, 6 > unscentedTransform(
+		const std::vector< Math::Vector< VType, 2 > >& measurements,
+		VType variance, PType& problem)
+{
+	// First guess of parameters
+	// TODO: better values than zero?
+	Math::Vector< VType, 7 > params = Math::Vector< VType, 7 >::zeros();
+	// Avoid degenerate (absolute value of zero) quaternion
+	params( 4 ) = 1;
+
+	UnscentedPoseCovariance< VType > engine;
+	return engine.unscented( problem, measurements, variance, params );
 }
 	
 }}} // namespace Ubitrack::Math::Stochastic
@@ -149,6 +149,9 @@ T log_likelihood( const InputIterator1 ipBegin, const InputIterator1 ipEnd, cons
  * Expectation Maximization
  *
  * This is a template-framework to carry out the expectation maximization algorithm.
+ * For many values, high dimensions or badly separated components use
+ * \c expectation_maximization_blocked() from expectation_maximization_blocked.h,
+ * which evaluates the densities in log space and does not underflow.
  * 
  * @tparam InputIterator defines the type of input values
  * @tparam OutputIterator defines the type of output values (Probability Distribution)
@@ -0,0 +1,524 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+ /**
+ * @ingroup math stochastic
+ * @file
+ *
+ * Blocked expectation maximization for Gaussian mixture models.
+ *
+ * Same model type and result as \c expectation_maximization(), but the densities
+ * are evaluated in log space and normalized with the log-sum-exp trick, so they
+ * do not underflow for high dimensions or distant values. The values are copied
+ * into one contiguous array and processed in blocks, one mixture component after
+ * the other. Every component keeps the Cholesky factor of its covariance and the
+ * log-determinant for the whole E-step. The E-step accumulates the sufficient
+ * statistics of the M-step directly, no responsibilities are stored. Both are
+ * distributed over several threads.
+ */
+
+#ifndef __UBITRACK_MATH_STOCHASTIC_EXPECTATION_MAXIMIZATION_BLOCKED_H__
+#define __UBITRACK_MATH_STOCHASTIC_EXPECTATION_MAXIMIZATION_BLOCKED_H__
+
+// Ubitrack
+#include "Gaussian.h"
+#include "Weighted.h"
+#include "../Util/parallel_ranges.h"
+
+// std
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+
+namespace Ubitrack{ namespace Math { namespace Stochastic {
+
+/**
+ * @ingroup math stochastic
+ * Parameter structure for the blocked expectation maximization
+ */
+template< typename T >
+struct ExpectationMaximizationParameter
+{
+	/** maximum number of iterations */
+	std::size_t maxIter;
+
+	/** stop if the mean log likelihood changes less than this fraction */
+	T threshold;
+
+	/** number of worker threads, including the calling thread. Every thread gets at least 1000 values. */
+	std::size_t nThreads;
+
+	/** estimate diagonal covariances only */
+	bool diagonal;
+
+	/** added to the diagonal of the estimated covariances to keep them positive definite */
+	T regularization;
+
+	/** number of values processed per block */
+	std::size_t blockSize;
+
+	/**
+	 * @param max_iter maximum number of iterations
+	 * @param thresh relative change of the mean log likelihood to stop at
+	 * @param threads number of worker threads, 0 uses all available hardware threads
+	 * @param diag \c true to estimate diagonal covariances
+	 * @param reg value added to the diagonal of the covariances
+	 */
+	ExpectationMaximizationParameter( const std::size_t max_iter = 100, const T thresh = static_cast< T >( 1e-5 ), const std::size_t threads = 1, const bool diag = false, const T reg = static_cast< T >( 1e-6 ) )
+		: maxIter( max_iter )
+		, threshold( thresh )
+		, nThreads( threads ? threads : std::max< std::size_t >( 1, boost::thread::hardware_concurrency() ) )
+		, diagonal( diag )
+		, regularization( reg )
+		, blockSize( 256 )
+	{}
+};
+
+namespace Detail {
+
+/// @internal \c false for infinite values and NaN
+template< typename T >
+inline bool isFinite( const T x )
+{
+	return std::fabs( x ) <= std::numeric_limits< T >::max();
+}
+
+/// @internal a mixture component prepared for the evaluation of log densities
+template< typename T, std::size_t N >
+struct LogGaussian
+{
+	/** log of weight and normalization of the density, -inf for unusable components */
+	T logConstant;
+
+	T mean[ N ];
+
+	/** lower Cholesky factor of the covariance ( row major ), for diagonal covariances the inverse standard deviations */
+	T factor[ N * N ];
+
+	/** @return \c true if the covariance is positive definite */
+	bool prepare( const Weighted< Gaussian< T, N >, T >& gaussian, const bool diagonal )
+	{
+		const T log2pi = static_cast< T >( 1.8378770664093454836 );
+		logConstant = -std::numeric_limits< T >::infinity();
+		std::copy( gaussian.mean, gaussian.mean + N, mean );
+		if( !( gaussian.weight > 0 ) )
+			return true;
+
+		T logDet( 0 );
+		if( diagonal )
+		{
+			for( std::size_t i = 0; i < N; ++i )
+			{
+				const T var = gaussian.covariance[ i * N + i ];
+				if( !( var > 0 ) )
+					return false;
+				factor[ i ] = 1 / std::sqrt( var );
+				logDet += std::log( var );
+			}
+		}
+		else
+		{
+			// Cholesky decomposition, covariance = L * L^T
+			for( std::size_t i = 0; i < N; ++i )
+				for( std::size_t j = 0; j <= i; ++j )
+				{
+					T sum = gaussian.covariance[ i * N + j ];
+					for( std::size_t l = 0; l < j; ++l )
+						sum -= factor[ i * N + l ] * factor[ j * N + l ];
+					if( i == j )
+					{
+						if( !( sum > 0 ) )
+							return false;
+						factor[ i * N + i ] = std::sqrt( sum );
+						logDet += 2 * std::log( factor[ i * N + i ] );
+					}
+					else
+						factor[ i * N + j ] = sum / factor[ j * N + j ];
+				}
+		}
+
+		logConstant = std::log( gaussian.weight ) - static_cast< T >( 0.5 ) * ( N * log2pi + logDet );
+		return true;
+	}
+
+	/** @return squared Mahalanobis distance of a value, also stores its difference to the mean */
+	T mahalanobis( const T* value, T* diff, const bool diagonal ) const
+	{
+		for( std::size_t i = 0; i < N; ++i )
+			diff[ i ] = value[ i ] - mean[ i ];
+
+		T sum( 0 );
+		if( diagonal )
+			for( std::size_t i = 0; i < N; ++i )
+			{
+				const T y = diff[ i ] * factor[ i ];
+				sum += y * y;
+			}
+		else
+		{
+			// forward substitution L * y = diff
+			T y[ N ];
+			for( std::size_t i = 0; i < N; ++i )
+			{
+				T s = diff[ i ];
+				for( std::size_t l = 0; l < i; ++l )
+					s -= factor[ i * N + l ] * y[ l ];
+				y[ i ] = s / factor[ i * N + i ];
+				sum += y[ i ] * y[ i ];
+			}
+		}
+		return sum;
+	}
+};
+
+/// @internal sufficient statistics of the M-step, relative to the old means
+template< typename T, std::size_t N >
+struct MixtureStatistics
+{
+	std::vector< T > weights;
+	std::vector< T > sums;
+	std::vector< T > products;
+	T logLikelihood;
+	std::size_t nValid;
+
+	void reset( const std::size_t k )
+	{
+		weights.assign( k, 0 );
+		sums.assign( k * N, 0 );
+		products.assign( k * N * N, 0 );
+		logLikelihood = 0;
+		nValid = 0;
+	}
+};
+
+/**
+ * @internal
+ * E-step of the blocked expectation maximization for a range of values.
+ * Every worker thread writes to its own statistics.
+ */
+template< typename T, std::size_t N >
+struct MixtureExpectation
+{
+	typedef void result_type;
+
+	const std::vector< T >& values;
+	const std::vector< LogGaussian< T, N > >& components;
+	std::vector< MixtureStatistics< T, N > >& statistics;
+	const std::size_t blockSize;
+	const bool diagonal;
+	const bool accumulate;
+
+	MixtureExpectation( const std::vector< T >& v, const std::vector< LogGaussian< T, N > >& c, std::vector< MixtureStatistics< T, N > >& s, const std::size_t block, const bool diag, const bool acc )
+		: values( v )
+		, components( c )
+		, statistics( s )
+		, blockSize( block )
+		, diagonal( diag )
+		, accumulate( acc )
+	{}
+
+	void operator()( const std::size_t t, const std::size_t first, const std::size_t last ) const
+	{
+		const std::size_t k = components.size();
+		MixtureStatistics< T, N >& stats( statistics[ t ] );
+		stats.reset( k );
+
+		std::vector< T > logDensities( blockSize * k );
+		T diff[ N ];
+		for( std::size_t blockBegin = first; blockBegin < last; blockBegin += blockSize )
+		{
+			const std::size_t m = std::min( blockSize, last - blockBegin );
+			const T* pBlock = &values[ blockBegin * N ];
+
+			// log densities, one component after the other
+			for( std::size_t c = 0; c < k; ++c )
+			{
+				const LogGaussian< T, N >& component( components[ c ] );
+				if( component.logConstant == -std::numeric_limits< T >::infinity() )
+				{
+					for( std::size_t b = 0; b < m; ++b )
+						logDensities[ b * k + c ] = component.logConstant;
+					continue;
+				}
+				for( std::size_t b = 0; b < m; ++b )
+					logDensities[ b * k + c ] = component.logConstant - static_cast< T >( 0.5 ) * component.mahalanobis( pBlock + b * N, diff, diagonal );
+			}
+
+			// normalize with log-sum-exp, turn into responsibilities
+			for( std::size_t b = 0; b < m; ++b )
+			{
+				T* pLog = &logDensities[ b * k ];
+				const T maxLog = *std::max_element( pLog, pLog + k );
+				if( maxLog == -std::numeric_limits< T >::infinity() )
+					continue;
+
+				T sum( 0 );
+				for( std::size_t c = 0; c < k; ++c )
+					sum += std::exp( pLog[ c ] - maxLog );
+				const T logSum = maxLog + std::log( sum );
+				stats.logLikelihood += logSum;
+				stats.nValid++;
+
+				for( std::size_t c = 0; c < k; ++c )
+					pLog[ c ] = std::exp( pLog[ c ] - logSum );
+			}
+
+			if( !accumulate )
+				continue;
+
+			// sufficient statistics, again one component after the other
+			for( std::size_t c = 0; c < k; ++c )
+			{
+				const LogGaussian< T, N >& component( components[ c ] );
+				T* pSum = &stats.sums[ c * N ];
+				T* pProducts = &stats.products[ c * N * N ];
+				T weight( 0 );
+				for( std::size_t b = 0; b < m; ++b )
+				{
+					const T r = logDensities[ b * k + c ];
+					if( !( r > 0 ) )
+						continue;
+					weight += r;
+
+					const T* pValue = pBlock + b * N;
+					for( std::size_t i = 0; i < N; ++i )
+					{
+						diff[ i ] = pValue[ i ] - component.mean[ i ];
+						pSum[ i ] += r * diff[ i ];
+					}
+					if( diagonal )
+						for( std::size_t i = 0; i < N; ++i )
+							pProducts[ i * N + i ] += r * diff[ i ] * diff[ i ];
+					else
+						for( std::size_t i = 0; i < N; ++i )
+						{
+							const T ri = r * diff[ i ];
+							for( std::size_t j = i; j < N; ++j )
+								pProducts[ i * N + j ] += ri * diff[ j ];
+						}
+				}
+				stats.weights[ c ] += weight;
+			}
+		}
+	}
+};
+
+/// @internal state of the blocked expectation maximization
+template< typename T, std::size_t N >
+class BlockedExpectationMaximization
+{
+public:
+	typedef Weighted< Gaussian< T, N >, T > pdf_type;
+
+	template< typename InputIterator >
+	BlockedExpectationMaximization( const InputIterator itBegin, const InputIterator itEnd, const ExpectationMaximizationParameter< T >& params )
+		: m_params( params )
+	{
+		for( InputIterator it( itBegin ); it != itEnd; ++it )
+			for( std::size_t i = 0; i < N; ++i )
+				m_values.push_back( (*it)[ i ] );
+		m_n = m_values.size() / N;
+		m_nValid = 0;
+		m_nThreads = std::max< std::size_t >( 1, std::min( params.nThreads, m_n / 1000 ) );
+		m_statistics.resize( m_nThreads );
+	}
+
+	/// prepares the components, returns the mean log likelihood of the values
+	template< typename OutputIterator >
+	T expectation( const OutputIterator itBeginGauss, const OutputIterator itEndGauss, const bool accumulate )
+	{
+		m_components.resize( std::distance( itBeginGauss, itEndGauss ) );
+		std::size_t c = 0;
+		for( OutputIterator it( itBeginGauss ); it != itEndGauss; ++it, ++c )
+			if( !m_components[ c ].prepare( *it, m_params.diagonal ) )
+			{
+				// not positive definite, remove the component from the mixture
+				it->weight = 0;
+				m_components[ c ].logConstant = -std::numeric_limits< T >::infinity();
+			}
+
+		Math::Util::parallel_ranges( m_n, m_nThreads, MixtureExpectation< T, N >( m_values, m_components, m_statistics, m_params.blockSize, m_params.diagonal, accumulate ) );
+
+		T logLikelihood( 0 );
+		m_nValid = 0;
+		for( std::size_t t = 0; t < m_nThreads; ++t )
+		{
+			logLikelihood += m_statistics[ t ].logLikelihood;
+			m_nValid += m_statistics[ t ].nValid;
+		}
+		if( m_nValid < m_n )
+			return -std::numeric_limits< T >::infinity();
+		return logLikelihood / m_n;
+	}
+
+	/// re-estimates the components from the statistics of the last E-step
+	template< typename OutputIterator >
+	void maximization( const OutputIterator itBeginGauss, const OutputIterator itEndGauss )
+	{
+		// merge the statistics of all threads into the first one
+		MixtureStatistics< T, N >& total( m_statistics[ 0 ] );
+		for( std::size_t t = 1; t < m_nThreads; ++t )
+		{
+			std::transform( total.weights.begin(), total.weights.end(), m_statistics[ t ].weights.begin(), total.weights.begin(), std::plus< T >() );
+			std::transform( total.sums.begin(), total.sums.end(), m_statistics[ t ].sums.begin(), total.sums.begin(), std::plus< T >() );
+			std::transform( total.products.begin(), total.products.end(), m_statistics[ t ].products.begin(), total.products.begin(), std::plus< T >() );
+		}
+
+		std::size_t c = 0;
+		for( OutputIterator it( itBeginGauss ); it != itEndGauss; ++it, ++c )
+		{
+			const T weight = total.weights[ c ];
+			if( !( weight > 0 ) )
+			{
+				it->weight = 0;
+				continue;
+			}
+			// values with zero probability under all components carry no responsibility
+			it->weight = weight / m_nValid;
+
+			// the statistics are relative to the old mean
+			T shift[ N ];
+			for( std::size_t i = 0; i < N; ++i )
+			{
+				shift[ i ] = total.sums[ c * N + i ] / weight;
+				it->mean[ i ] += shift[ i ];
+			}
+
+			const T* pProducts = &total.products[ c * N * N ];
+			it->variance = 0;
+			for( std::size_t i = 0; i < N; ++i )
+				for( std::size_t j = i; j < N; ++j )
+				{
+					T cov( 0 );
+					if( i == j )
+						cov = pProducts[ i * N + i ] / weight - shift[ i ] * shift[ i ] + m_params.regularization;
+					else if( !m_params.diagonal )
+						cov = pProducts[ i * N + j ] / weight - shift[ i ] * shift[ j ];
+					it->covariance[ i * N + j ] = it->covariance[ j * N + i ] = cov;
+				}
+
+			for( std::size_t i = 0; i < N; ++i )
+				it->variance += it->covariance[ i * N + i ];
+			it->standardDeviation = std::sqrt( it->variance );
+		}
+	}
+
+protected:
+	const ExpectationMaximizationParameter< T > m_params;
+	std::vector< T > m_values;
+	std::size_t m_n;
+	std::size_t m_nValid;
+	std::size_t m_nThreads;
+	std::vector< LogGaussian< T, N > > m_components;
+	std::vector< MixtureStatistics< T, N > > m_statistics;
+};
+
+} // namespace Detail
+
+
+/**
+ * @ingroup math stochastic
+ * Numerically stable mean log likelihood of values under a Gaussian mixture model.
+ *
+ * @tparam InputIterator iterator to the values, must provide \c operator[]
+ * @tparam GaussIterator iterator to \c Weighted< Gaussian< T, N >, T >
+ * @param ipBegin iterator to the first component of the mixture
+ * @param ipEnd iterator behind the last component of the mixture
+ * @param ivBegin iterator to the first value
+ * @param ivEnd iterator behind the last value
+ * @param params parameters, e.g. the number of threads
+ * @return mean log likelihood, -inf if a value has zero probability
+ */
+template< typename GaussIterator, typename InputIterator >
+typename std::iterator_traits< GaussIterator >::value_type::value_type log_likelihood_blocked(
+	const GaussIterator ipBegin, const GaussIterator ipEnd
+	, const InputIterator ivBegin, const InputIterator ivEnd
+	, const ExpectationMaximizationParameter< typename std::iterator_traits< GaussIterator >::value_type::value_type >& params )
+{
+	typedef typename std::iterator_traits< GaussIterator >::value_type pdf_type;
+	typedef typename pdf_type::value_type value_type;
+
+	std::vector< pdf_type > mixture( ipBegin, ipEnd );
+	Detail::BlockedExpectationMaximization< value_type, pdf_type::size > engine( ivBegin, ivEnd, params );
+	return engine.expectation( mixture.begin(), mixture.end(), false );
+}
+
+/**
+ * @ingroup math stochastic
+ * Blocked expectation maximization for Gaussian mixture models
+ *
+ * Estimates the weights, means and covariances of a mixture of Gaussians starting from the
+ * given components, see the file description for the differences to \c expectation_maximization().
+ * Components whose covariance is not positive definite get a weight of zero and are no longer
+ * estimated.
+ *
+ * Example use case:\n
+ * std::vector< Vector3d > points3d; // <- the values \n
+ * std::vector< Weighted< Gaussian< double, 3 >, double > > mixture; // <- initial components, e.g. from k-means \n
+ * expectation_maximization_blocked( points3d.begin(), points3d.end(), mixture.begin(), mixture.end(), ExpectationMaximizationParameter< double >( 100, 1e-5, 4 ) );\n
+ *
+ * @tparam InputIterator iterator to the values, must provide \c operator[]
+ * @tparam OutputIterator iterator to \c Weighted< Gaussian< T, N >, T >
+ * @param itBegin iterator to the first value
+ * @param itEnd iterator behind the last value
+ * @param itBeginGauss iterator to the first component, updated in place
+ * @param itEndGauss iterator behind the last component
+ * @param params parameters of the algorithm
+ * @return mean log likelihood of the values under the final mixture. The iteration stops early
+ * and does not converge if the likelihood is not finite: -inf if a value has zero probability
+ * under all components, NaN if the computation failed.
+ */
+template< typename InputIterator, typename OutputIterator >
+typename std::iterator_traits< OutputIterator >::value_type::value_type expectation_maximization_blocked(
+	const InputIterator itBegin, const InputIterator itEnd
+	, OutputIterator itBeginGauss, OutputIterator itEndGauss
+	, const ExpectationMaximizationParameter< typename std::iterator_traits< OutputIterator >::value_type::value_type >& params )
+{
+	typedef typename std::iterator_traits< OutputIterator >::value_type pdf_type;
+	typedef typename pdf_type::value_type value_type;
+
+	Detail::BlockedExpectationMaximization< value_type, pdf_type::size > engine( itBegin, itEnd, params );
+
+	value_type likelihood = engine.expectation( itBeginGauss, itEndGauss, true );
+	if( !Detail::isFinite( likelihood ) )
+		return likelihood;
+	for( std::size_t i = 0; i < params.maxIter; ++i )
+	{
+		engine.maximization( itBeginGauss, itEndGauss );
+
+		const value_type newLikelihood = engine.expectation( itBeginGauss, itEndGauss, true );
+		if( !Detail::isFinite( newLikelihood ) )
+			return newLikelihood;
+		if( std::fabs( likelihood - newLikelihood ) < params.threshold * std::fabs( likelihood ) )
+			return newLikelihood;
+		likelihood = newLikelihood;
+	}
+	return likelihood;
+}
+
+} } } // namespace Ubitrack::Math::Stochastic
+
+#endif //__UBITRACK_MATH_STOCHASTIC_EXPECTATION_MAXIMIZATION_BLOCKED_H__
@@ -266,13 +266,15 @@ std::size_t copy_probability( const InputIterator iBegin, const InputIterator iE
  * @tparam OutputIterator type of the output iterator to container of the clusters
  * @tparam IndicesIterator type of the output iterator to container of the indices
  * @tparam BinaryOperator type of the evaluation function to estimate distance of elements
+ * @param max_iter maximum number of iterations
  */
  
 template< typename InputIterator, typename OutputIterator, typename IndicesIterator, typename BinaryOperator >
 typename std::iterator_traits< OutputIterator >::value_type::value_type k_means( 
 	const InputIterator iBegin, const InputIterator iEnd
 	, OutputIterator itMeanBegin, OutputIterator itMeanEnd
-	, IndicesIterator indicesOut, BinaryOperator distanceFunc )
+	, IndicesIterator indicesOut, BinaryOperator distanceFunc
+	, const std::size_t max_iter = 100 )
 {
 	// some typedefs regarding the input vector type
 	typedef typename std::iterator_traits< InputIterator >::value_type vector_in_type;
@@ -289,7 +291,6 @@ typename std::iterator_traits< OutputIterator >::value_type::value_type k_means(
 
 	// we use a quadratic type for epsilon, such that we do not need to calculate square roots later
 	const value_type epsilon = std::pow( static_cast< value_type > (1e-02), 2 );
-	const std::size_t max_iter = 100; // I hope the name says all
 	
 	// std::cout << "Vector Type " << typeid( vector_in_type ).name() << " of dimension=" << N << " and type=" << typeid( T ).name() << "\n";	
 	
@@ -316,9 +317,12 @@ typename std::iterator_traits< OutputIterator >::value_type::value_type k_means(
 		//accumulate the means from the clusters 
 		k_means_accumulate( iBegin, iEnd, indices.begin(), assign_to_mean< mean_type_iterator >( means_temp.begin() ) );
 		
-		// reset the amount of gathered values for the means, could be done nicer...
+		// reset the amount of gathered values for the means
+		std::vector< std::size_t > counts( n_cluster, 0 );
+		for( typename indices_container_type::const_iterator it = indices.begin(); it != indices.end(); ++it )
+			++counts[ *it ];
 		for( std::size_t k = 0; k<n_cluster; ++k )
-			means_temp[ k ] /= std::count ( indices.begin(), indices.end(), k );
+			means_temp[ k ] /= static_cast< value_type >( counts[ k ] );
 		
 		// calculate the summarized difference
 		std::vector< value_type > norms1;
@@ -356,6 +360,8 @@ typename std::iterator_traits< OutputIterator >::value_type::value_type k_means(
  * @ingroup math stochastic
  * @brief determines k centroids of clusters from a set of elements
  *
+ * For large sets of Euclidean vectors see \c k_means_accelerated() in k_means_accelerated.h.
+ *
  * This function can be applied to nearly any container structure
  * providing access to the single container elements via input iterators.
  * Although designed for stl-containers * (e.g. \c std::vector,
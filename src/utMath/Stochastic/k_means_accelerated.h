@@ -0,0 +1,576 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+ /**
+ * @ingroup math stochastic
+ * @file
+ *
+ * Accelerated k-means for Euclidean vectors.
+ *
+ * \c k_means_hamerly keeps an upper bound of the distance of every element to
+ * its centroid and a lower bound of the distance to the second closest one
+ * (G. Hamerly, "Making k-means even faster", SDM 2010). Both bounds are moved
+ * along with the centroids, distances are only recomputed for elements where
+ * the bounds do not prove that the assignment is unchanged. The means are
+ * updated incrementally from the elements that changed their cluster.
+ *
+ * \c k_means_mini_batch updates the centroids from small random samples
+ * (D. Sculley, "Web-scale k-means clustering", WWW 2010) and is meant for
+ * inputs that are too large to be visited in every iteration.
+ *
+ * Both distribute the assignment and accumulation over several threads.
+ * In contrast to \c k_means() they only work with the Euclidean distance,
+ * as the pruning relies on the triangle inequality.
+ */
+
+#ifndef __UBITRACK_MATH_STOCHASTIC_K_MEANS_ACCELERATED_H__
+#define __UBITRACK_MATH_STOCHASTIC_K_MEANS_ACCELERATED_H__
+
+#include "k_means.h" // copy_probability
+#include "../Util/parallel_ranges.h"
+#include <utUtil/Exception.h>
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+
+namespace Ubitrack{ namespace Math { namespace Stochastic {
+
+/**
+ * @ingroup math stochastic
+ * Parameter structure for the accelerated k-means algorithms
+ */
+template< typename T >
+struct KMeansParameter
+{
+	/** maximum number of iterations ( of mini-batches in mini-batch mode ) */
+	std::size_t maxIter;
+
+	/** stop if the mean squared movement of the centroids falls below this value */
+	T epsilon;
+
+	/** number of worker threads, including the calling thread. Every thread gets at least 1000 elements. */
+	std::size_t nThreads;
+
+	/** number of elements per mini-batch, 0 visits all elements in every iteration */
+	std::size_t batchSize;
+
+	/**
+	 * @param max_iter maximum number of iterations
+	 * @param eps threshold of the mean squared movement of the centroids, 0 iterates until no element changes its cluster
+	 * @param threads number of worker threads, 0 uses all available hardware threads
+	 * @param batch number of elements per mini-batch, 0 uses all elements ( Hamerly's algorithm )
+	 */
+	KMeansParameter( const std::size_t max_iter = 100, const T eps = 0, const std::size_t threads = 1, const std::size_t batch = 0 )
+		: maxIter( max_iter )
+		, epsilon( eps )
+		, nThreads( threads ? threads : std::max< std::size_t >( 1, boost::thread::hardware_concurrency() ) )
+		, batchSize( batch )
+	{}
+};
+
+namespace Detail {
+
+/// @internal squared Euclidean distance of two vectors, without temporary vectors
+template< typename VecType >
+inline typename VecType::value_type squared_euclidean( const VecType& a, const VecType& b )
+{
+	typename VecType::value_type d2( 0 );
+	for( std::size_t i = 0; i < a.size(); ++i )
+	{
+		const typename VecType::value_type d = a( i ) - b( i );
+		d2 += d * d;
+	}
+	return d2;
+}
+
+/// @internal Euclidean distance of two vectors
+template< typename VecType >
+inline typename VecType::value_type euclidean_distance( const VecType& a, const VecType& b )
+{
+	return std::sqrt( squared_euclidean( a, b ) );
+}
+
+/// @internal finds the closest and second closest centroid, returns the index of the closest one
+template< typename VecType >
+std::size_t nearest_two( const VecType& vec, const std::vector< VecType >& centroids, typename VecType::value_type& d1, typename VecType::value_type& d2 )
+{
+	typedef typename VecType::value_type value_type;
+	d1 = std::numeric_limits< value_type >::max();
+	d2 = std::numeric_limits< value_type >::max();
+	std::size_t index( 0 );
+	for( std::size_t k = 0; k < centroids.size(); ++k )
+	{
+		const value_type d = squared_euclidean( vec, centroids[ k ] );
+		if( d < d1 )
+		{
+			d2 = d1;
+			d1 = d;
+			index = k;
+		}
+		else if( d < d2 )
+			d2 = d;
+	}
+	d1 = std::sqrt( d1 );
+	d2 = std::sqrt( d2 );
+	return index;
+}
+
+/// @internal assigns every element of a range to the closest centroid
+template< typename InputIterator, typename VecType >
+struct assign_nearest
+{
+	typedef void result_type;
+
+	const InputIterator iBegin;
+	const std::vector< VecType >& centroids;
+	std::vector< std::size_t >& indices;
+
+	assign_nearest( const InputIterator first, const std::vector< VecType >& c, std::vector< std::size_t >& i )
+		: iBegin( first )
+		, centroids( c )
+		, indices( i )
+	{}
+
+	void operator()( const std::size_t, const std::size_t first, const std::size_t last ) const
+	{
+		typename VecType::value_type d1, d2;
+		for( std::size_t i = first; i < last; ++i )
+			indices[ i ] = nearest_two( *( iBegin + i ), centroids, d1, d2 );
+	}
+};
+
+
+/**
+ * @internal
+ * State of Hamerly's algorithm, shared by all worker threads.
+ *
+ * Every worker owns a fixed range of the elements and accumulates the changes of
+ * the cluster sums of its range separately. Between two assignment steps, one thread
+ * merges these changes and moves the centroids while the others wait at a barrier.
+ */
+template< typename InputIterator, typename VecType >
+class HamerlyEngine
+{
+public:
+	typedef typename VecType::value_type value_type;
+
+	HamerlyEngine( const InputIterator first, const std::size_t size, std::vector< VecType >& centroids, const KMeansParameter< value_type >& params )
+		: m_iBegin( first )
+		, m_n( size )
+		, m_k( centroids.size() )
+		, m_params( params )
+		, m_nThreads( std::max< std::size_t >( 1, std::min( params.nThreads, size / 1000 ) ) )
+		, m_centroids( centroids )
+		, m_indices( size )
+		, m_upper( size )
+		, m_lower( size )
+		, m_sums( m_k, VecType::zeros() )
+		, m_counts( m_k, 0 )
+		, m_halfDistance( m_k )
+		, m_movement( m_k, 0 )
+		, m_localSums( m_nThreads, std::vector< VecType >( m_k, VecType::zeros() ) )
+		, m_localCounts( m_nThreads, std::vector< long >( m_k, 0 ) )
+		, m_changed( m_nThreads, 0 )
+		, m_barrier( static_cast< unsigned >( m_nThreads ) )
+		, m_done( false )
+		, m_iterations( 0 )
+		, m_error( 0 )
+	{}
+
+	value_type run()
+	{
+		boost::thread_group threads;
+		for( std::size_t t = 1; t < m_nThreads; ++t )
+			threads.create_thread( boost::bind( &HamerlyEngine::work, this, t ) );
+		work( 0 );
+		threads.join_all();
+		return m_error;
+	}
+
+	const std::vector< std::size_t >& indices() const
+	{ return m_indices; }
+
+	std::size_t iterations() const
+	{ return m_iterations; }
+
+protected:
+
+	void work( const std::size_t t )
+	{
+		const std::size_t first = Math::Util::range_begin( m_n, m_nThreads, t );
+		const std::size_t last = Math::Util::range_begin( m_n, m_nThreads, t + 1 );
+
+		initialize( t, first, last );
+		while( true )
+		{
+			m_barrier.wait();
+			if( t == 0 )
+				moveCentroids();
+			m_barrier.wait();
+			if( m_done )
+				return;
+			assign( t, first, last );
+		}
+	}
+
+	/// assigns all elements of a range without any bounds
+	void initialize( const std::size_t t, const std::size_t first, const std::size_t last )
+	{
+		std::vector< VecType >& sums( m_localSums[ t ] );
+		std::vector< long >& counts( m_localCounts[ t ] );
+		for( std::size_t i = first; i < last; ++i )
+		{
+			const VecType& vec( *( m_iBegin + i ) );
+			const std::size_t index = nearest_two( vec, m_centroids, m_upper[ i ], m_lower[ i ] );
+			m_indices[ i ] = index;
+			sums[ index ] += vec;
+			counts[ index ]++;
+		}
+		m_changed[ t ] = last - first;
+	}
+
+	/// moves the bounds along with the centroids and reassigns elements where they are violated
+	void assign( const std::size_t t, const std::size_t first, const std::size_t last )
+	{
+		std::vector< VecType >& sums( m_localSums[ t ] );
+		std::vector< long >& counts( m_localCounts[ t ] );
+		std::size_t changed( 0 );
+		for( std::size_t i = first; i < last; ++i )
+		{
+			std::size_t index = m_indices[ i ];
+			m_upper[ i ] += m_movement[ index ];
+			m_lower[ i ] -= index == m_maxMoved ? m_secondMovement : m_movement[ m_maxMoved ];
+
+			const value_type bound = std::max( m_halfDistance[ index ], m_lower[ i ] );
+			if( m_upper[ i ] <= bound )
+				continue;
+
+			// tighten the upper bound and test again
+			const VecType& vec( *( m_iBegin + i ) );
+			m_upper[ i ] = euclidean_distance( vec, m_centroids[ index ] );
+			if( m_upper[ i ] <= bound )
+				continue;
+
+			const std::size_t newIndex = nearest_two( vec, m_centroids, m_upper[ i ], m_lower[ i ] );
+			if( newIndex != index )
+			{
+				sums[ index ] -= vec;
+				counts[ index ]--;
+				sums[ newIndex ] += vec;
+				counts[ newIndex ]++;
+				m_indices[ i ] = newIndex;
+				changed++;
+			}
+		}
+		m_changed[ t ] = changed;
+	}
+
+	/// merges the results of the workers and moves the centroids, called by one thread only
+	void moveCentroids()
+	{
+		std::size_t changed( 0 );
+		for( std::size_t t = 0; t < m_nThreads; ++t )
+		{
+			for( std::size_t k = 0; k < m_k; ++k )
+			{
+				m_sums[ k ] += m_localSums[ t ][ k ];
+				m_counts[ k ] += m_localCounts[ t ][ k ];
+				m_localSums[ t ][ k ] = VecType::zeros();
+				m_localCounts[ t ][ k ] = 0;
+			}
+			changed += m_changed[ t ];
+		}
+
+		if( !changed || m_iterations >= m_params.maxIter )
+		{
+			m_done = true;
+			return;
+		}
+		m_iterations++;
+
+		// new means, empty clusters keep their centroid
+		value_type error( 0 );
+		m_maxMoved = 0;
+		m_secondMovement = 0;
+		for( std::size_t k = 0; k < m_k; ++k )
+		{
+			m_movement[ k ] = 0;
+			if( m_counts[ k ] > 0 )
+			{
+				const VecType mean( m_sums[ k ] / static_cast< value_type >( m_counts[ k ] ) );
+				const value_type d2 = squared_euclidean( mean, m_centroids[ k ] );
+				m_movement[ k ] = std::sqrt( d2 );
+				m_centroids[ k ] = mean;
+				error += d2;
+			}
+
+			if( m_movement[ k ] > m_movement[ m_maxMoved ] )
+			{
+				m_secondMovement = m_movement[ m_maxMoved ];
+				m_maxMoved = k;
+			}
+			else if( k != m_maxMoved && m_movement[ k ] > m_secondMovement )
+				m_secondMovement = m_movement[ k ];
+		}
+		m_error = error / m_k;
+
+		// half of the distance to the closest other centroid
+		std::fill( m_halfDistance.begin(), m_halfDistance.end(), std::numeric_limits< value_type >::max() );
+		for( std::size_t k1 = 0; k1 < m_k; ++k1 )
+			for( std::size_t k2 = k1 + 1; k2 < m_k; ++k2 )
+			{
+				const value_type d = euclidean_distance( m_centroids[ k1 ], m_centroids[ k2 ] ) / 2;
+				m_halfDistance[ k1 ] = std::min( m_halfDistance[ k1 ], d );
+				m_halfDistance[ k2 ] = std::min( m_halfDistance[ k2 ], d );
+			}
+
+		if( m_error < m_params.epsilon )
+		{
+			// the assignment must still match the final centroids
+			m_done = true;
+			Math::Util::parallel_ranges( m_n, m_nThreads, assign_nearest< InputIterator, VecType >( m_iBegin, m_centroids, m_indices ) );
+		}
+	}
+
+	const InputIterator m_iBegin;
+	const std::size_t m_n;
+	const std::size_t m_k;
+	const KMeansParameter< value_type > m_params;
+	const std::size_t m_nThreads;
+
+	std::vector< VecType >& m_centroids;
+	std::vector< std::size_t > m_indices;
+
+	/** upper bound of the distance to the assigned centroid */
+	std::vector< value_type > m_upper;
+
+	/** lower bound of the distance to all other centroids */
+	std::vector< value_type > m_lower;
+
+	std::vector< VecType > m_sums;
+	std::vector< long > m_counts;
+
+	std::vector< value_type > m_halfDistance;
+	std::vector< value_type > m_movement;
+	std::size_t m_maxMoved;
+	value_type m_secondMovement;
+
+	std::vector< std::vector< VecType > > m_localSums;
+	std::vector< std::vector< long > > m_localCounts;
+	std::vector< std::size_t > m_changed;
+
+	boost::barrier m_barrier;
+	bool m_done;
+	std::size_t m_iterations;
+	value_type m_error;
+};
+
+} // namespace Detail
+
+
+/**
+ * @ingroup math stochastic
+ * @brief refines given centroids with Hamerly's accelerated k-means algorithm
+ *
+ * Gives the same result as Lloyd's algorithm with the Euclidean distance ( see \c k_means() )
+ * but usually computes only a small fraction of the element to centroid distances.
+ *
+ * @tparam InputIterator random access iterator to the input elements ( e.g. \c Math::Vector )
+ * @tparam OutputIterator random access iterator to the centroids
+ * @tparam IndicesIterator output iterator for the indices of the clusters of the input elements
+ * @param iBegin \c iterator pointing to first input element
+ * @param iEnd \c iterator pointing behind the last input element
+ * @param itMeanBegin \c iterator pointing to the first initial centroid, overwritten with the result
+ * @param itMeanEnd \c iterator pointing behind the last initial centroid
+ * @param indicesOut output \c iterator for the indices of the clusters
+ * @param params parameters, e.g. the number of threads
+ * @return mean squared movement of the centroids in the last iteration
+ * @throws Util::Exception if there are no input elements or no centroids
+ */
+template< typename InputIterator, typename OutputIterator, typename IndicesIterator >
+typename std::iterator_traits< OutputIterator >::value_type::value_type k_means_hamerly(
+	const InputIterator iBegin, const InputIterator iEnd
+	, OutputIterator itMeanBegin, OutputIterator itMeanEnd
+	, IndicesIterator indicesOut
+	, const KMeansParameter< typename std::iterator_traits< OutputIterator >::value_type::value_type >& params )
+{
+	typedef typename std::iterator_traits< OutputIterator >::value_type vector_type;
+	typedef typename vector_type::value_type value_type;
+
+	const std::size_t n = std::distance( iBegin, iEnd );
+	if( n == 0 || itMeanBegin == itMeanEnd )
+		UBITRACK_THROW( "k-means needs at least one element and one centroid" );
+	std::vector< vector_type > centroids( itMeanBegin, itMeanEnd );
+
+	Detail::HamerlyEngine< InputIterator, vector_type > engine( iBegin, n, centroids, params );
+	const value_type error = engine.run();
+
+	std::copy( centroids.begin(), centroids.end(), itMeanBegin );
+	std::copy( engine.indices().begin(), engine.indices().end(), indicesOut );
+	return error;
+}
+
+/**
+ * @ingroup math stochastic
+ * @brief refines given centroids with mini-batch k-means
+ *
+ * Every iteration draws \c params.batchSize random elements, assigns them to the closest
+ * centroid and moves the centroids towards them with a per-centroid learning rate that
+ * decreases with the number of elements it has seen so far. The result approximates the
+ * one of Lloyd's algorithm. Afterwards all elements are assigned to the closest centroid.
+ *
+ * @tparam InputIterator random access iterator to the input elements ( e.g. \c Math::Vector )
+ * @tparam OutputIterator random access iterator to the centroids
+ * @tparam IndicesIterator output iterator for the indices of the clusters of the input elements
+ * @param iBegin \c iterator pointing to first input element
+ * @param iEnd \c iterator pointing behind the last input element
+ * @param itMeanBegin \c iterator pointing to the first initial centroid, overwritten with the result
+ * @param itMeanEnd \c iterator pointing behind the last initial centroid
+ * @param indicesOut output \c iterator for the indices of the clusters
+ * @param params parameters, \c batchSize must not be 0
+ * @return mean squared movement of the centroids in the last iteration
+ * @throws Util::Exception if there are no input elements or no centroids
+ */
+template< typename InputIterator, typename OutputIterator, typename IndicesIterator >
+typename std::iterator_traits< OutputIterator >::value_type::value_type k_means_mini_batch(
+	const InputIterator iBegin, const InputIterator iEnd
+	, OutputIterator itMeanBegin, OutputIterator itMeanEnd
+	, IndicesIterator indicesOut
+	, const KMeansParameter< typename std::iterator_traits< OutputIterator >::value_type::value_type >& params )
+{
+	typedef typename std::iterator_traits< OutputIterator >::value_type vector_type;
+	typedef typename vector_type::value_type value_type;
+
+	const std::size_t n = std::distance( iBegin, iEnd );
+	if( n == 0 || itMeanBegin == itMeanEnd )
+		UBITRACK_THROW( "k-means needs at least one element and one centroid" );
+	const std::size_t batchSize = std::min( std::max< std::size_t >( params.batchSize, 1 ), n );
+	const std::size_t nThreads = std::max< std::size_t >( 1, std::min( params.nThreads, n / 1000 ) );
+
+	std::vector< vector_type > centroids( itMeanBegin, itMeanEnd );
+	const std::size_t n_cluster = centroids.size();
+	std::vector< std::size_t > seen( n_cluster, 0 );
+
+	std::vector< vector_type > batch( batchSize );
+	std::vector< std::size_t > batchIndices( batchSize );
+	value_type error( 0 );
+	for( std::size_t iter = 0; iter < params.maxIter; ++iter )
+	{
+		for( std::size_t i = 0; i < batchSize; ++i )
+			batch[ i ] = *( iBegin + Math::Random::distribute_uniform< std::size_t >( 0, n - 1 ) );
+
+		// the assignment uses the centroids from before the batch
+		Detail::assign_nearest< typename std::vector< vector_type >::const_iterator, vector_type > assign( batch.begin(), centroids, batchIndices );
+		if( batchSize >= 1000 && nThreads > 1 )
+			Math::Util::parallel_ranges( batchSize, nThreads, assign );
+		else
+			assign( 0, 0, batchSize );
+
+		const std::vector< vector_type > previous( centroids );
+		for( std::size_t i = 0; i < batchSize; ++i )
+		{
+			const std::size_t k = batchIndices[ i ];
+			const value_type eta = static_cast< value_type >( 1 ) / ++seen[ k ];
+			centroids[ k ] = centroids[ k ] * ( 1 - eta ) + batch[ i ] * eta;
+		}
+
+		error = 0;
+		for( std::size_t k = 0; k < n_cluster; ++k )
+			error += Detail::squared_euclidean( previous[ k ], centroids[ k ] );
+		error /= n_cluster;
+		if( error < params.epsilon )
+			break;
+	}
+
+	std::vector< std::size_t > indices( n );
+	Math::Util::parallel_ranges( n, nThreads, Detail::assign_nearest< InputIterator, vector_type >( iBegin, centroids, indices ) );
+
+	std::copy( centroids.begin(), centroids.end(), itMeanBegin );
+	std::copy( indices.begin(), indices.end(), indicesOut );
+	return error;
+}
+
+/**
+ * @ingroup math stochastic
+ * @brief determines k centroids of clusters from a set of Euclidean vectors
+ *
+ * Accelerated variant of \c k_means(). The centroids are seeded with k-means++
+ * ( \c copy_probability with squared distances ), then refined with \c k_means_mini_batch
+ * if \c params.batchSize is set and smaller than the number of elements, otherwise
+ * with \c k_means_hamerly.
+ *
+ * Example use case:\n
+ * std::vector< Vector3d > points3d; // <- input elements \n
+ * std::vector< Vector3d > centroids; // <- will be filled with the cluster centroids \n
+ * std::vector< std::size_t > indices; // <- will be filled with the cluster of every input element \n
+ * k_means_accelerated( points3d.begin(), points3d.end(), k, std::back_inserter( centroids ), std::back_inserter( indices ), KMeansParameter< double >( 100, 0, 4 ) );\n
+ *
+ * @tparam InputIterator random access iterator to the input elements
+ * @tparam OutputIterator1 type of the output iterator to container of the clusters
+ * @tparam OutputIterator2 type of the output iterator to container of the indices
+ * @param iBeginValues \c iterator pointing to first input element
+ * @param iEndValues \c iterator pointing behind the last input element
+ * @param n_cluster amount of clusters
+ * @param itCentroids output \c iterator for the centroids
+ * @param itIndices output \c iterator for the indices of the clusters of the input elements
+ * @param params parameters of the algorithm
+ * @return mean squared movement of the centroids in the last iteration
+ * @throws Util::Exception if there are no input elements or \c n_cluster is 0
+ */
+template< typename InputIterator, typename OutputIterator1, typename OutputIterator2 >
+typename std::iterator_traits< InputIterator >::value_type::value_type k_means_accelerated(
+	const InputIterator iBeginValues, const InputIterator iEndValues
+	, const std::size_t n_cluster
+	, OutputIterator1 itCentroids, OutputIterator2 itIndices
+	, const KMeansParameter< typename std::iterator_traits< InputIterator >::value_type::value_type >& params )
+{
+	typedef typename std::iterator_traits< InputIterator >::value_type vector_type;
+	typedef typename vector_type::value_type value_type;
+
+	const std::size_t n = std::distance( iBeginValues, iEndValues );
+	if( n == 0 || n_cluster == 0 )
+		UBITRACK_THROW( "k-means needs at least one element and one cluster" );
+
+	std::vector< vector_type > means;
+	means.reserve( n_cluster );
+	copy_probability( iBeginValues, iEndValues, n_cluster, std::back_inserter( means ), SquaredDistance< vector_type >() );
+
+	value_type error;
+	if( params.batchSize && params.batchSize < n )
+		error = k_means_mini_batch( iBeginValues, iEndValues, means.begin(), means.end(), itIndices, params );
+	else
+		error = k_means_hamerly( iBeginValues, iEndValues, means.begin(), means.end(), itIndices, params );
+
+	std::copy( means.begin(), means.end(), itCentroids );
+	return error;
+}
+
+} } } // namespace Ubitrack::Math::Stochastic
+
+#endif //__UBITRACK_MATH_STOCHASTIC_K_MEANS_ACCELERATED_H__
@@ -0,0 +1,219 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math
+ * @file
+ * Distributes the elements of a range over several threads.
+ */
+
+
+#ifndef __UBITRACK_MATH_UTIL_PARALLEL_RANGES_H_INCLUDED__
+#define __UBITRACK_MATH_UTIL_PARALLEL_RANGES_H_INCLUDED__
+
+#include <cstddef> // std::size_t
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Ubitrack { namespace Math { namespace Util {
+
+/**
+ * @internal
+ * @return first element of the \c i-th of \c n equally sized parts of [0, size)
+ */
+inline std::size_t range_begin( const std::size_t size, const std::size_t n, const std::size_t i )
+{
+	return ( size * i ) / n;
+}
+
+/**
+ * @internal
+ * Splits [0, size) into \c nThreads equally sized parts and calls \c func( t, first, last )
+ * for the \c t-th part in a thread of its own. The calling thread handles the first part.
+ * Returns after all parts are finished. There are never more parts than elements, and
+ * nothing is called for an empty range.
+ *
+ * @param size number of elements
+ * @param nThreads number of parts and threads, including the calling thread
+ * @param func functor, copied for every thread
+ */
+template< typename Function >
+void parallel_ranges( const std::size_t size, const std::size_t nThreads, Function func )
+{
+	if( size == 0 )
+		return;
+	const std::size_t nParts = std::max< std::size_t >( 1, std::min( nThreads, size ) );
+
+	boost::thread_group threads;
+	for( std::size_t t = 1; t < nParts; ++t )
+		threads.create_thread( boost::bind( func, t, range_begin( size, nParts, t ), range_begin( size, nParts, t + 1 ) ) );
+	func( 0, 0, range_begin( size, nParts, 1 ) );
+	threads.join_all();
+}
+
+/**
+ * @internal
+ * Persistent worker threads for repeated calls of \c parallel_ranges, which avoids creating
+ * threads on every call. The threads are started in the constructor and wait for work
+ * until the pool is destroyed. Only one thread may call \c run() at a time.
+ */
+class ParallelRangesPool
+	: private boost::noncopyable
+{
+public:
+	/** @param nThreads number of threads, including the calling thread */
+	explicit ParallelRangesPool( const std::size_t nThreads )
+		: m_nThreads( std::max< std::size_t >( nThreads, 1 ) )
+		, m_size( 0 )
+		, m_nParts( 0 )
+		, m_generation( 0 )
+		, m_nPending( 0 )
+		, m_bStop( false )
+	{
+		for( std::size_t t = 1; t < m_nThreads; ++t )
+			m_threads.create_thread( boost::bind( &ParallelRangesPool::work, this, t ) );
+	}
+
+	~ParallelRangesPool()
+	{
+		{
+			boost::mutex::scoped_lock l( m_mutex );
+			m_bStop = true;
+		}
+		m_start.notify_all();
+		m_threads.join_all();
+	}
+
+	/** number of threads, including the calling thread */
+	std::size_t threads() const
+	{ return m_nThreads; }
+
+	/**
+	 * Same as \c parallel_ranges( size, threads(), func ), but uses the threads of the pool.
+	 * Exceptions thrown by \c func in a worker thread are rethrown in the calling thread.
+	 */
+	template< typename Function >
+	void run( const std::size_t size, Function func )
+	{
+		if( size == 0 )
+			return;
+		const std::size_t nParts = std::min( m_nThreads, size );
+		if( nParts == 1 )
+		{
+			func( 0, 0, size );
+			return;
+		}
+
+		{
+			boost::mutex::scoped_lock l( m_mutex );
+			m_task = func;
+			m_size = size;
+			m_nParts = nParts;
+			m_nPending = nParts - 1;
+			m_error = boost::exception_ptr();
+			++m_generation;
+		}
+		m_start.notify_all();
+
+		// wait for the workers also if the own part fails, they use func
+		boost::exception_ptr error;
+		try
+		{
+			func( 0, 0, range_begin( size, nParts, 1 ) );
+		}
+		catch( ... )
+		{
+			error = boost::current_exception();
+		}
+
+		boost::mutex::scoped_lock l( m_mutex );
+		while( m_nPending )
+			m_done.wait( l );
+		m_task.clear();
+		if( !error )
+			error = m_error;
+		if( error )
+			boost::rethrow_exception( error );
+	}
+
+protected:
+	void work( const std::size_t t )
+	{
+		std::size_t generation = 0;
+		boost::mutex::scoped_lock l( m_mutex );
+		while( true )
+		{
+			while( !m_bStop && m_generation == generation )
+				m_start.wait( l );
+			if( m_bStop )
+				return;
+			generation = m_generation;
+			if( t >= m_nParts )
+				continue;
+
+			const std::size_t first = range_begin( m_size, m_nParts, t );
+			const std::size_t last = range_begin( m_size, m_nParts, t + 1 );
+			l.unlock();
+			boost::exception_ptr error;
+			try
+			{
+				m_task( t, first, last );
+			}
+			catch( ... )
+			{
+				error = boost::current_exception();
+			}
+			l.lock();
+
+			if( error && !m_error )
+				m_error = error;
+			if( --m_nPending == 0 )
+				m_done.notify_one();
+		}
+	}
+
+	const std::size_t m_nThreads;
+	boost::thread_group m_threads;
+	boost::mutex m_mutex;
+	boost::condition_variable m_start;
+	boost::condition_variable m_done;
+
+	boost::function< void ( std::size_t, std::size_t, std::size_t ) > m_task;
+	std::size_t m_size;
+	std::size_t m_nParts;
+	std::size_t m_generation;
+	std::size_t m_nPending;
+	boost::exception_ptr m_error;
+	bool m_bStop;
+};
+
+} } } // namespace Ubitrack::Math::Util
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup math
+ * @file
+ * Kernels to transform and project many points at once.
+ *
+ * The points are given in structure-of-arrays layout, i.e. one array per
+ * coordinate. Matrices are passed as raw column-major storage as used by
+ * \c Math::Matrix. Several points are processed at once with SSE2
+ * instructions where available (see small_matrix_kernels.h), the remaining
+ * points are processed one by one.
+ *
+ * Use the functions in \c Geometry/PointTransformation.h and
+ * \c Geometry/PointProjection.h instead of calling the kernels directly.
+ */
+
+
+#ifndef __UBITRACK_MATH_UTIL_POINT_BATCH_KERNELS_H_INCLUDED__
+#define __UBITRACK_MATH_UTIL_POINT_BATCH_KERNELS_H_INCLUDED__
+
+#include "small_matrix_kernels.h" // UBITRACK_MATH_SSE2_KERNELS
+
+#include <cmath> // std::sqrt, std::atan
+#include <cstddef> // std::size_t
+
+namespace Ubitrack { namespace Math { namespace Util {
+
+/**
+ * @internal
+ * Arithmetic on packets of values that are processed at once. The generic
+ * version processes a single value.
+ */
+template< typename T >
+struct simd_packet
+{
+	typedef T type;
+	static const std::size_t size = 1;
+
+	static type load( const T* p ) { return *p; }
+	static void store( T* p, const type a ) { *p = a; }
+	static type set1( const T a ) { return a; }
+	static type add( const type a, const type b ) { return a + b; }
+	static type sub( const type a, const type b ) { return a - b; }
+	static type mul( const type a, const type b ) { return a * b; }
+	static type div( const type a, const type b ) { return a / b; }
+};
+
+#ifdef UBITRACK_MATH_SSE2_KERNELS
+
+/// @internal four single precision values
+template<>
+struct simd_packet< float >
+{
+	typedef __m128 type;
+	static const std::size_t size = 4;
+
+	static type load( const float* p ) { return _mm_loadu_ps( p ); }
+	static void store( float* p, const type a ) { _mm_storeu_ps( p, a ); }
+	static type set1( const float a ) { return _mm_set1_ps( a ); }
+	static type add( const type a, const type b ) { return _mm_add_ps( a, b ); }
+	static type sub( const type a, const type b ) { return _mm_sub_ps( a, b ); }
+	static type mul( const type a, const type b ) { return _mm_mul_ps( a, b ); }
+	static type div( const type a, const type b ) { return _mm_div_ps( a, b ); }
+};
+
+/// @internal two double precision values
+template<>
+struct simd_packet< double >
+{
+	typedef __m128d type;
+	static const std::size_t size = 2;
+
+	static type load( const double* p ) { return _mm_loadu_pd( p ); }
+	static void store( double* p, const type a ) { _mm_storeu_pd( p, a ); }
+	static type set1( const double a ) { return _mm_set1_pd( a ); }
+	static type add( const type a, const type b ) { return _mm_add_pd( a, b ); }
+	static type sub( const type a, const type b ) { return _mm_sub_pd( a, b ); }
+	static type mul( const type a, const type b ) { return _mm_mul_pd( a, b ); }
+	static type div( const type a, const type b ) { return _mm_div_pd( a, b ); }
+};
+
+#endif // UBITRACK_MATH_SSE2_KERNELS
+
+/// @internal computes row \c r of \f$ M \cdot (x, y, z, 1)^T \f$ for a packet of points
+template< typename P >
+inline typename P::type affine_row( const typename P::type m[][ 4 ], const std::size_t r
+	, const typename P::type x, const typename P::type y, const typename P::type z )
+{
+	return P::add( P::add( P::mul( m[ r ][ 0 ], x ), P::mul( m[ r ][ 1 ], y ) ), P::add( P::mul( m[ r ][ 2 ], z ), m[ r ][ 3 ] ) );
+}
+
+/**
+ * @internal
+ * Transforms \c n 3D points with a column-major M-by-4 matrix
+ * \f$ p' = M \cdot (x, y, z, 1)^T \f$ . Row \c r of the result is written to \c out[ r ].
+ * The output arrays may be the same as the input arrays.
+ */
+template< std::size_t M, typename T >
+inline void transform_points_soa( const T* mat, const std::size_t n, const T* x, const T* y, const T* z, T* const out[ M ] )
+{
+	typedef simd_packet< T > P;
+	typedef typename P::type packet;
+
+	packet m[ M ][ 4 ];
+	for ( std::size_t r = 0; r < M; ++r )
+		for ( std::size_t c = 0; c < 4; ++c )
+			m[ r ][ c ] = P::set1( mat[ c * M + r ] );
+
+	std::size_t i = 0;
+	for ( ; i + P::size <= n; i += P::size )
+	{
+		const packet px = P::load( x + i );
+		const packet py = P::load( y + i );
+		const packet pz = P::load( z + i );
+		for ( std::size_t r = 0; r < M; ++r )
+			P::store( out[ r ] + i, affine_row< P >( m, r, px, py, pz ) );
+	}
+
+	for ( ; i < n; ++i )
+	{
+		const T px = x[ i ];
+		const T py = y[ i ];
+		const T pz = z[ i ];
+		for ( std::size_t r = 0; r < M; ++r )
+			out[ r ][ i ] = mat[ r ] * px + mat[ M + r ] * py + mat[ 2 * M + r ] * pz + mat[ 3 * M + r ];
+	}
+}
+
+/**
+ * @internal
+ * Projects \c n 3D points with a column-major 3-by-4 projection matrix and
+ * dehomogenizes the result to image coordinates \c u and \c v .
+ */
+template< typename T >
+inline void project_points_soa( const T* mat, const std::size_t n, const T* x, const T* y, const T* z, T* u, T* v )
+{
+	typedef simd_packet< T > P;
+	typedef typename P::type packet;
+
+	packet m[ 3 ][ 4 ];
+	for ( std::size_t r = 0; r < 3; ++r )
+		for ( std::size_t c = 0; c < 4; ++c )
+			m[ r ][ c ] = P::set1( mat[ c * 3 + r ] );
+
+	std::size_t i = 0;
+	for ( ; i + P::size <= n; i += P::size )
+	{
+		const packet px = P::load( x + i );
+		const packet py = P::load( y + i );
+		const packet pz = P::load( z + i );
+		const packet w = affine_row< P >( m, 2, px, py, pz );
+		P::store( u + i, P::div( affine_row< P >( m, 0, px, py, pz ), w ) );
+		P::store( v + i, P::div( affine_row< P >( m, 1, px, py, pz ), w ) );
+	}
+
+	for ( ; i < n; ++i )
+	{
+		const T e1 = mat[ 0 ] * x[ i ] + mat[ 3 ] * y[ i ] + mat[ 6 ] * z[ i ] + mat[ 9 ];
+		const T e2 = mat[ 1 ] * x[ i ] + mat[ 4 ] * y[ i ] + mat[ 7 ] * z[ i ] + mat[ 10 ];
+		const T e3 = mat[ 2 ] * x[ i ] + mat[ 5 ] * y[ i ] + mat[ 8 ] * z[ i ] + mat[ 11 ];
+		u[ i ] = e1 / e3;
+		v[ i ] = e2 / e3;
+	}
+}
+
+/**
+ * @internal
+ * Projects \c n 3D points into a camera with lens distortion.
+ *
+ * The points are transformed into the camera frame with the column-major
+ * 3-by-4 matrix \c extrinsic , normalized and distorted with the rational
+ * radial (6 parameters) and tangential (2 parameters) model of
+ * \c CameraLens/Distortion.h and finally mapped to pixel coordinates with the
+ * column-major 3-by-3 intrinsic matrix \c K .
+ */
+template< typename T >
+inline void project_distort_points_soa( const T* extrinsic, const T* K, const T* radial, const T* tangential
+	, const std::size_t n, const T* x, const T* y, const T* z, T* u, T* v )
+{
+	typedef simd_packet< T > P;
+	typedef typename P::type packet;
+
+	packet m[ 3 ][ 4 ];
+	for ( std::size_t r = 0; r < 3; ++r )
+		for ( std::size_t c = 0; c < 4; ++c )
+			m[ r ][ c ] = P::set1( extrinsic[ c * 3 + r ] );
+
+	// K is column-major, the sign of the last element determines the viewing direction
+	const T fx = K[ 0 ];
+	const T skew = K[ 3 ];
+	const T fy = K[ 4 ];
+	const T cx = K[ 6 ] * K[ 8 ];
+	const T cy = K[ 7 ] * K[ 8 ];
+	const T k22 = K[ 8 ];
+
+	const packet one = P::set1( T( 1 ) );
+	const packet two = P::set1( T( 2 ) );
+	const packet pk22 = P::set1( k22 );
+	const packet pfx = P::set1( fx );
+	const packet pskew = P::set1( skew );
+	const packet pfy = P::set1( fy );
+	const packet pcx = P::set1( cx );
+	const packet pcy = P::set1( cy );
+	packet rad[ 6 ];
+	for ( std::size_t k = 0; k < 6; ++k )
+		rad[ k ] = P::set1( radial[ k ] );
+	const packet tan0 = P::set1( tangential[ 0 ] );
+	const packet tan1 = P::set1( tangential[ 1 ] );
+
+	std::size_t i = 0;
+	for ( ; i + P::size <= n; i += P::size )
+	{
+		const packet px = P::load( x + i );
+		const packet py = P::load( y + i );
+		const packet pz = P::load( z + i );
+
+		const packet iz = P::div( one, P::mul( pk22, affine_row< P >( m, 2, px, py, pz ) ) );
+		const packet xn = P::mul( affine_row< P >( m, 0, px, py, pz ), iz );
+		const packet yn = P::mul( affine_row< P >( m, 1, px, py, pz ), iz );
+
+		const packet xx = P::mul( xn, xn );
+		const packet yy = P::mul( yn, yn );
+		const packet xy2 = P::mul( two, P::mul( xn, yn ) );
+		const packet r2 = P::add( xx, yy );
+		const packet r4 = P::mul( r2, r2 );
+		const packet r6 = P::mul( r4, r2 );
+		const packet upper = P::add( one, P::add( P::add( P::mul( rad[ 0 ], r2 ), P::mul( rad[ 1 ], r4 ) ), P::mul( rad[ 2 ], r6 ) ) );
+		const packet lower = P::add( one, P::add( P::add( P::mul( rad[ 3 ], r2 ), P::mul( rad[ 4 ], r4 ) ), P::mul( rad[ 5 ], r6 ) ) );
+		const packet ratio = P::div( upper, lower );
+
+		const packet xd = P::add( P::add( P::mul( xn, ratio ), P::mul( tan0, xy2 ) ), P::mul( tan1, P::add( r2, P::mul( two, xx ) ) ) );
+		const packet yd = P::add( P::add( P::mul( yn, ratio ), P::mul( tan1, xy2 ) ), P::mul( tan0, P::add( r2, P::mul( two, yy ) ) ) );
+
+		P::store( u + i, P::add( P::add( P::mul( xd, pfx ), P::mul( yd, pskew ) ), pcx ) );
+		P::store( v + i, P::add( P::mul( yd, pfy ), pcy ) );
+	}
+
+	for ( ; i < n; ++i )
+	{
+		const T xc = extrinsic[ 0 ] * x[ i ] + extrinsic[ 3 ] * y[ i ] + extrinsic[ 6 ] * z[ i ] + extrinsic[ 9 ];
+		const T yc = extrinsic[ 1 ] * x[ i ] + extrinsic[ 4 ] * y[ i ] + extrinsic[ 7 ] * z[ i ] + extrinsic[ 10 ];
+		const T zc = extrinsic[ 2 ] * x[ i ] + extrinsic[ 5 ] * y[ i ] + extrinsic[ 8 ] * z[ i ] + extrinsic[ 11 ];
+		const T xn = xc / ( k22 * zc );
+		const T yn = yc / ( k22 * zc );
+
+		const T xx = xn * xn;
+		const T yy = yn * yn;
+		const T xy2 = 2 * xn * yn;
+		const T r2 = xx + yy;
+		const T r4 = r2 * r2;
+		const T r6 = r4 * r2;
+		const T ratio = ( 1 + radial[ 0 ] * r2 + radial[ 1 ] * r4 + radial[ 2 ] * r6 )
+			/ ( 1 + radial[ 3 ] * r2 + radial[ 4 ] * r4 + radial[ 5 ] * r6 );
+
+		const T xd = xn * ratio + tangential[ 0 ] * xy2 + tangential[ 1 ] * ( r2 + 2 * xx );
+		const T yd = yn * ratio + tangential[ 1 ] * xy2 + tangential[ 0 ] * ( r2 + 2 * yy );
+
+		u[ i ] = xd * fx + yd * skew + cx;
+		v[ i ] = yd * fy + cy;
+	}
+}
+
+/**
+ * @internal
+ * Projects \c n 3D points into a camera with fish-eye lens distortion
+ * (4 radial parameters, equidistant model as used by OpenCV).
+ * Parameters as for \c project_distort_points_soa() . Not vectorized
+ * because of the arc tangent.
+ */
+template< typename T >
+inline void project_fisheye_points_soa( const T* extrinsic, const T* K, const T* radial
+	, const std::size_t n, const T* x, const T* y, const T* z, T* u, T* v )
+{
+	const T k22 = K[ 8 ];
+	for ( std::size_t i = 0; i < n; ++i )
+	{
+		const T xc = extrinsic[ 0 ] * x[ i ] + extrinsic[ 3 ] * y[ i ] + extrinsic[ 6 ] * z[ i ] + extrinsic[ 9 ];
+		const T yc = extrinsic[ 1 ] * x[ i ] + extrinsic[ 4 ] * y[ i ] + extrinsic[ 7 ] * z[ i ] + extrinsic[ 10 ];
+		const T zc = extrinsic[ 2 ] * x[ i ] + extrinsic[ 5 ] * y[ i ] + extrinsic[ 8 ] * z[ i ] + extrinsic[ 11 ];
+		const T xn = xc / ( k22 * zc );
+		const T yn = yc / ( k22 * zc );
+
+		const T r = std::sqrt( xn * xn + yn * yn );
+		T scale( 1 );
+		if ( r > T( 1e-8 ) )
+		{
+			const T theta = std::atan( r );
+			const T theta2 = theta * theta;
+			const T theta4 = theta2 * theta2;
+			const T thetaD = theta * ( 1 + radial[ 0 ] * theta2 + radial[ 1 ] * theta4 + radial[ 2 ] * theta4 * theta2 + radial[ 3 ] * theta4 * theta4 );
+			scale = thetaD / r;
+		}
+		const T xd = xn * scale;
+		const T yd = yn * scale;
+
+		u[ i ] = xd * K[ 0 ] + yd * K[ 3 ] + K[ 6 ] * k22;
+		v[ i ] = yd * K[ 4 ] + K[ 7 ] * k22;
+	}
+}
+
+} } } // namespace Ubitrack::Math::Util
+
+#endif //__UBITRACK_MATH_UTIL_POINT_BATCH_KERNELS_H_INCLUDED__
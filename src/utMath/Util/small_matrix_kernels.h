@@ -0,0 +1,310 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup math
+ * @file
+ * Kernels for products and inverses of small matrices and vectors with
+ * dimensions known at compile time.
+ *
+ * The kernels work on raw column-major storage as used by the bounded
+ * \c Math::Matrix and \c Math::Vector. All loop bounds are compile time
+ * constants, such that the compiler can unroll them completely. Columns are
+ * processed with SSE2 instructions where available, define
+ * \c UBITRACK_MATH_NO_SIMD to disable this.
+ *
+ * The kernels are used by \c ublas::prod() for bounded matrices and vectors
+ * (see end of Matrix.h) and by the \c Product functors of \c Blas2.h and
+ * \c Blas3.h .
+ */
+
+
+#ifndef __UBITRACK_MATH_UTIL_SMALL_MATRIX_KERNELS_H_INCLUDED__
+#define __UBITRACK_MATH_UTIL_SMALL_MATRIX_KERNELS_H_INCLUDED__
+
+#include <cstddef> // std::size_t
+#include <cmath>
+#include <algorithm> // std::swap
+
+#if !defined( UBITRACK_MATH_NO_SIMD ) && ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+	#define UBITRACK_MATH_SSE2_KERNELS
+	#include <emmintrin.h>
+#endif
+
+namespace Ubitrack { namespace Math { namespace Util {
+
+/// largest dimension for which the small matrix kernels are used
+static const std::size_t small_matrix_kernel_max_size = 8;
+
+/**
+ * @internal
+ * Determines at compile time if the kernels should be used for a product
+ * of a M-by-N matrix with a N-by-K matrix (use K=1 for vectors).
+ */
+template< std::size_t M, std::size_t N, std::size_t K >
+struct use_small_matrix_kernel
+{
+	static const bool value = ( M != 0 ) && ( N != 0 ) && ( K != 0 )
+		&& ( M <= small_matrix_kernel_max_size )
+		&& ( N <= small_matrix_kernel_max_size )
+		&& ( K <= small_matrix_kernel_max_size );
+};
+
+/**
+ * @internal
+ * Operations on a single matrix column of length M.
+ */
+template< typename T, std::size_t M >
+struct column_kernel
+{
+	/// c = a * s
+	static void scale( const T* a, const T s, T* c )
+	{
+		for ( std::size_t i = 0; i < M; ++i )
+			c[ i ] = a[ i ] * s;
+	}
+
+	/// c += a * s
+	static void scale_add( const T* a, const T s, T* c )
+	{
+		for ( std::size_t i = 0; i < M; ++i )
+			c[ i ] += a[ i ] * s;
+	}
+};
+
+#ifdef UBITRACK_MATH_SSE2_KERNELS
+
+/// @internal column operations on single precision values, four rows at once
+template< std::size_t M >
+struct column_kernel< float, M >
+{
+	static void scale( const float* a, const float s, float* c )
+	{
+		const __m128 s4 = _mm_set1_ps( s );
+		std::size_t i = 0;
+		for ( ; i + 4 <= M; i += 4 )
+			_mm_storeu_ps( c + i, _mm_mul_ps( _mm_loadu_ps( a + i ), s4 ) );
+		for ( ; i < M; ++i )
+			c[ i ] = a[ i ] * s;
+	}
+
+	static void scale_add( const float* a, const float s, float* c )
+	{
+		const __m128 s4 = _mm_set1_ps( s );
+		std::size_t i = 0;
+		for ( ; i + 4 <= M; i += 4 )
+			_mm_storeu_ps( c + i, _mm_add_ps( _mm_loadu_ps( c + i ), _mm_mul_ps( _mm_loadu_ps( a + i ), s4 ) ) );
+		for ( ; i < M; ++i )
+			c[ i ] += a[ i ] * s;
+	}
+};
+
+/// @internal column operations on double precision values, two rows at once
+template< std::size_t M >
+struct column_kernel< double, M >
+{
+	static void scale( const double* a, const double s, double* c )
+	{
+		const __m128d s2 = _mm_set1_pd( s );
+		std::size_t i = 0;
+		for ( ; i + 2 <= M; i += 2 )
+			_mm_storeu_pd( c + i, _mm_mul_pd( _mm_loadu_pd( a + i ), s2 ) );
+		for ( ; i < M; ++i )
+			c[ i ] = a[ i ] * s;
+	}
+
+	static void scale_add( const double* a, const double s, double* c )
+	{
+		const __m128d s2 = _mm_set1_pd( s );
+		std::size_t i = 0;
+		for ( ; i + 2 <= M; i += 2 )
+			_mm_storeu_pd( c + i, _mm_add_pd( _mm_loadu_pd( c + i ), _mm_mul_pd( _mm_loadu_pd( a + i ), s2 ) ) );
+		for ( ; i < M; ++i )
+			c[ i ] += a[ i ] * s;
+	}
+};
+
+#endif // UBITRACK_MATH_SSE2_KERNELS
+
+/**
+ * @internal
+ * Matrix-vector product \f$ c = A \cdot b \f$ of a column-major M-by-N
+ * matrix \c a with a vector \c b of length N. \c c must not alias the inputs.
+ */
+template< std::size_t M, std::size_t N, typename T >
+inline void mat_vec_prod( const T* a, const T* b, T* c )
+{
+	column_kernel< T, M >::scale( a, b[ 0 ], c );
+	for ( std::size_t j = 1; j < N; ++j )
+		column_kernel< T, M >::scale_add( a + j * M, b[ j ], c );
+}
+
+/**
+ * @internal
+ * Transposed matrix-vector product \f$ c = A^T \cdot b \f$ of a
+ * column-major M-by-N matrix \c a with a vector \c b of length M.
+ * \c c must not alias the inputs.
+ */
+template< std::size_t M, std::size_t N, typename T >
+inline void mat_trans_vec_prod( const T* a, const T* b, T* c )
+{
+	for ( std::size_t j = 0; j < N; ++j )
+	{
+		const T* col = a + j * M;
+		T sum = col[ 0 ] * b[ 0 ];
+		for ( std::size_t i = 1; i < M; ++i )
+			sum += col[ i ] * b[ i ];
+		c[ j ] = sum;
+	}
+}
+
+/**
+ * @internal
+ * Matrix-matrix product \f$ C = A \cdot B \f$ of a column-major M-by-N
+ * matrix \c a with a column-major N-by-K matrix \c b. \c c must not alias
+ * the inputs.
+ */
+template< std::size_t M, std::size_t N, std::size_t K, typename T >
+inline void mat_mat_prod( const T* a, const T* b, T* c )
+{
+	for ( std::size_t k = 0; k < K; ++k )
+		mat_vec_prod< M, N >( a, b + k * N, c + k * M );
+}
+
+/**
+ * @internal
+ * Inverse of a symmetric positive definite M-by-M matrix \c a by Cholesky
+ * decomposition. \c a and \c c may be stored row- or column-major and
+ * must not alias.
+ * @return \c false if the matrix is not positive definite, \c c is undefined then
+ */
+template< std::size_t M, typename T >
+inline bool spd_invert( const T* a, T* c )
+{
+	// lower triangular factor, a = L * L^T
+	T l[ M * M ];
+	T invDiag[ M ];
+	for ( std::size_t j = 0; j < M; ++j )
+	{
+		T d = a[ j * M + j ];
+		for ( std::size_t k = 0; k < j; ++k )
+			d -= l[ k * M + j ] * l[ k * M + j ];
+		if ( !( d > 0 ) )
+			return false;
+		const T ljj = std::sqrt( d );
+		invDiag[ j ] = 1 / ljj;
+		l[ j * M + j ] = ljj;
+
+		for ( std::size_t i = j + 1; i < M; ++i )
+		{
+			T v = a[ j * M + i ];
+			for ( std::size_t k = 0; k < j; ++k )
+				v -= l[ k * M + i ] * l[ k * M + j ];
+			l[ j * M + i ] = v * invDiag[ j ];
+		}
+	}
+
+	// inverse of L ( lower triangular, column-major ), stored in l
+	for ( std::size_t j = 0; j < M; ++j )
+	{
+		l[ j * M + j ] = invDiag[ j ];
+		for ( std::size_t i = j + 1; i < M; ++i )
+		{
+			T v = 0;
+			for ( std::size_t k = j; k < i; ++k )
+				v -= l[ k * M + i ] * l[ j * M + k ];
+			l[ j * M + i ] = v * invDiag[ i ];
+		}
+	}
+
+	// a^-1 = L^-T * L^-1
+	for ( std::size_t j = 0; j < M; ++j )
+		for ( std::size_t i = j; i < M; ++i )
+		{
+			T v = 0;
+			for ( std::size_t k = i; k < M; ++k )
+				v += l[ i * M + k ] * l[ j * M + k ];
+			c[ j * M + i ] = c[ i * M + j ] = v;
+		}
+	return true;
+}
+
+/**
+ * @internal
+ * Inverse of a general M-by-M column-major matrix \c a by Gauss-Jordan
+ * elimination with partial pivoting. \c a and \c c must not alias.
+ * @return \c false if the matrix is singular, \c c is undefined then
+ */
+template< std::size_t M, typename T >
+inline bool lu_invert( const T* a, T* c )
+{
+	T w[ M * M ];
+	for ( std::size_t i = 0; i < M * M; ++i )
+	{
+		w[ i ] = a[ i ];
+		c[ i ] = 0;
+	}
+	for ( std::size_t i = 0; i < M; ++i )
+		c[ i * M + i ] = 1;
+
+	for ( std::size_t j = 0; j < M; ++j )
+	{
+		// pivot row
+		std::size_t p = j;
+		for ( std::size_t i = j + 1; i < M; ++i )
+			if ( std::fabs( w[ j * M + i ] ) > std::fabs( w[ j * M + p ] ) )
+				p = i;
+		if ( w[ j * M + p ] == 0 )
+			return false;
+		if ( p != j )
+			for ( std::size_t k = 0; k < M; ++k )
+			{
+				std::swap( w[ k * M + p ], w[ k * M + j ] );
+				std::swap( c[ k * M + p ], c[ k * M + j ] );
+			}
+
+		const T f = 1 / w[ j * M + j ];
+		for ( std::size_t k = 0; k < M; ++k )
+		{
+			w[ k * M + j ] *= f;
+			c[ k * M + j ] *= f;
+		}
+
+		for ( std::size_t i = 0; i < M; ++i )
+			if ( i != j )
+			{
+				const T g = w[ j * M + i ];
+				for ( std::size_t k = 0; k < M; ++k )
+				{
+					w[ k * M + i ] -= g * w[ k * M + j ];
+					c[ k * M + i ] -= g * c[ k * M + j ];
+				}
+			}
+	}
+	return true;
+}
+
+} } } // namespace Ubitrack::Math::Util
+
+#endif //__UBITRACK_MATH_UTIL_SMALL_MATRIX_KERNELS_H_INCLUDED__
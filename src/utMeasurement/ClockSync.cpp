@@ -0,0 +1,490 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @ingroup datastructures
+ * @file
+ * Synchronization of many native sensor clocks to the local clock.
+ */
+
+#include "ClockSync.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Ubitrack { namespace Measurement {
+
+namespace {
+
+	/** limits the degree to the supported ones */
+	ClockSyncConfig supportedConfig( const ClockSyncConfig& config )
+	{
+		ClockSyncConfig c( config );
+		c.degree = std::min( std::max( c.degree, 1u ), 2u );
+		return c;
+	}
+
+	/** median of the values, reorders them */
+	double median( std::vector< double >& values )
+	{
+		const std::size_t mid = values.size() / 2;
+		std::nth_element( values.begin(), values.begin() + mid, values.end() );
+		double m = values[ mid ];
+		if ( values.size() % 2 == 0 )
+			m = 0.5 * ( m + *std::max_element( values.begin(), values.begin() + mid ) );
+		return m;
+	}
+
+	/**
+	 * solves the symmetric positive semi-definite 3x3 system a x = b by gaussian elimination,
+	 * @return \c false if it is singular
+	 */
+	bool solve3( double a[ 3 ][ 3 ], double b[ 3 ], double x[ 3 ] )
+	{
+		// equilibrate, the sums of powers of x differ by many orders of magnitude
+		double d[ 3 ];
+		for ( int i = 0; i < 3; i++ )
+		{
+			if ( a[ i ][ i ] <= 0.0 )
+				return false;
+			d[ i ] = 1.0 / std::sqrt( a[ i ][ i ] );
+		}
+		for ( int i = 0; i < 3; i++ )
+		{
+			for ( int j = 0; j < 3; j++ )
+				a[ i ][ j ] *= d[ i ] * d[ j ];
+			b[ i ] *= d[ i ];
+		}
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			int pivot = k;
+			for ( int i = k + 1; i < 3; i++ )
+				if ( std::fabs( a[ i ][ k ] ) > std::fabs( a[ pivot ][ k ] ) )
+					pivot = i;
+			if ( std::fabs( a[ pivot ][ k ] ) <= 1e-12 )
+				return false;
+			std::swap( a[ k ], a[ pivot ] );
+			std::swap( b[ k ], b[ pivot ] );
+			for ( int i = k + 1; i < 3; i++ )
+			{
+				const double f = a[ i ][ k ] / a[ k ][ k ];
+				for ( int j = k; j < 3; j++ )
+					a[ i ][ j ] -= f * a[ k ][ j ];
+				b[ i ] -= f * b[ k ];
+			}
+		}
+		for ( int k = 2; k >= 0; k-- )
+		{
+			double s = b[ k ];
+			for ( int j = k + 1; j < 3; j++ )
+				s -= a[ k ][ j ] * x[ j ];
+			x[ k ] = s / a[ k ][ k ];
+		}
+		for ( int i = 0; i < 3; i++ )
+			x[ i ] *= d[ i ];
+		return true;
+	}
+
+} // anonymous namespace
+
+
+ClockTracker::ClockTracker( const ClockSyncConfig& config )
+	: m_config( supportedConfig( config ) )
+	, m_sequence( 0 )
+	, m_publishedN0( 0.0 )
+	, m_publishedL0( 0 )
+	, m_bSynchronized( false )
+{
+	// publishes the initial model
+	reset();
+}
+
+
+void ClockTracker::reset()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_window.clear();
+	m_jumpCandidates.clear();
+	m_inliers = 0;
+	m_sinceRefit = 0;
+	clearSums();
+	m_model.n0 = 0.0;
+	m_model.l0 = 0;
+	m_model.c[ 0 ] = 0.0;
+	m_model.c[ 1 ] = 1.0;
+	m_model.c[ 2 ] = 0.0;
+	m_deviation = m_config.jumpThreshold / m_config.outlierThreshold;
+	m_samples = 0;
+	m_outliers = 0;
+	m_jumps = 0;
+	m_bSynchronized.store( false, boost::memory_order_release );
+	publish();
+}
+
+
+double ClockTracker::toX( double native ) const
+{
+	return ( native - m_model.n0 ) / m_config.nativeFrequency;
+}
+
+
+double ClockTracker::toY( Timestamp local ) const
+{
+	return static_cast< long long >( local - m_model.l0 ) * 1e-9;
+}
+
+
+void ClockTracker::clearSums()
+{
+	std::fill( m_sumX, m_sumX + 5, 0.0 );
+	std::fill( m_sumXY, m_sumXY + 3, 0.0 );
+}
+
+
+void ClockTracker::addToSums( const Sample& s, double sign )
+{
+	const double x = toX( s.native );
+	const double y = toY( s.local );
+	double xk = sign;
+	for ( int k = 0; k < 5; k++ )
+	{
+		m_sumX[ k ] += xk;
+		if ( k < 3 )
+			m_sumXY[ k ] += xk * y;
+		xk *= x;
+	}
+}
+
+
+void ClockTracker::solve()
+{
+	const std::size_t minQuadratic = 6;
+	if ( m_config.degree >= 2 && m_inliers >= minQuadratic )
+	{
+		double a[ 3 ][ 3 ] = {
+			{ m_sumX[ 0 ], m_sumX[ 1 ], m_sumX[ 2 ] },
+			{ m_sumX[ 1 ], m_sumX[ 2 ], m_sumX[ 3 ] },
+			{ m_sumX[ 2 ], m_sumX[ 3 ], m_sumX[ 4 ] } };
+		double b[ 3 ] = { m_sumXY[ 0 ], m_sumXY[ 1 ], m_sumXY[ 2 ] };
+		double c[ 3 ];
+		if ( solve3( a, b, c ) )
+		{
+			std::copy( c, c + 3, m_model.c );
+			return;
+		}
+	}
+
+	m_model.c[ 2 ] = 0.0;
+	if ( m_inliers == 0 )
+		return;
+
+	const double n = m_sumX[ 0 ];
+	const double det = n * m_sumX[ 2 ] - m_sumX[ 1 ] * m_sumX[ 1 ];
+	// drift is only estimated from samples that span some time, otherwise the offset is fitted
+	if ( m_inliers >= 2 && det > 1e-12 * n * m_sumX[ 2 ] )
+		m_model.c[ 1 ] = ( n * m_sumXY[ 1 ] - m_sumX[ 1 ] * m_sumXY[ 0 ] ) / det;
+	m_model.c[ 0 ] = ( m_sumXY[ 0 ] - m_model.c[ 1 ] * m_sumX[ 1 ] ) / n;
+}
+
+
+void ClockTracker::restart()
+{
+	// the fit starts again from the jump candidates, if there are any
+	std::vector< Sample > samples( m_jumpCandidates.begin(), m_jumpCandidates.end() );
+	m_window.clear();
+	m_jumpCandidates.clear();
+	m_inliers = 0;
+	m_sinceRefit = 0;
+	clearSums();
+	m_model.c[ 2 ] = 0.0;
+	m_deviation = m_config.jumpThreshold / m_config.outlierThreshold;
+	if ( samples.empty() )
+		return;
+
+	m_model.n0 = samples.front().native;
+	m_model.l0 = samples.front().local;
+	for ( std::size_t i = 0; i < samples.size(); i++ )
+	{
+		samples[ i ].inlier = true;
+		m_window.push_back( samples[ i ] );
+		addToSums( samples[ i ], 1.0 );
+		m_inliers++;
+	}
+	solve();
+}
+
+
+Timestamp ClockTracker::addSample( double native, Timestamp local )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_samples++;
+
+	const std::size_t minSamples = 2 * ( m_config.degree + 1 );
+	Sample s = { native, local, true };
+
+	// a native clock going backwards was reset
+	if ( !m_window.empty() && native < m_window.back().native )
+	{
+		m_jumps++;
+		m_jumpCandidates.clear();
+		restart();
+	}
+
+	if ( m_window.empty() )
+	{
+		m_model.n0 = native;
+		m_model.l0 = local;
+		m_model.c[ 0 ] = 0.0;
+		m_model.c[ 1 ] = 1.0;
+		m_model.c[ 2 ] = 0.0;
+	}
+
+	const double x = toX( native );
+	const double residual = toY( local ) - m_model.evaluate( x );
+	if ( m_inliers < minSamples || std::fabs( residual ) <= m_config.outlierThreshold * m_deviation )
+	{
+		m_jumpCandidates.clear();
+		m_window.push_back( s );
+		addToSums( s, 1.0 );
+		m_inliers++;
+	}
+	else
+	{
+		m_outliers++;
+		s.inlier = false;
+		m_window.push_back( s );
+
+		// consecutive outliers that agree with each other indicate a jump of one of the clocks
+		if ( std::fabs( residual ) > m_config.jumpThreshold )
+		{
+			if ( !m_jumpCandidates.empty() )
+			{
+				const Sample& first( m_jumpCandidates.front() );
+				const double firstResidual = toY( first.local ) - m_model.evaluate( toX( first.native ) );
+				if ( std::fabs( residual - firstResidual ) > 0.5 * m_config.jumpThreshold )
+					m_jumpCandidates.clear();
+			}
+			m_jumpCandidates.push_back( s );
+			if ( m_jumpCandidates.size() >= std::max< std::size_t >( m_config.jumpConfirmations, 1 ) )
+			{
+				m_jumps++;
+				restart();
+			}
+		}
+		else
+			m_jumpCandidates.clear();
+	}
+
+	while ( m_window.size() > std::max( m_config.windowSize, minSamples ) )
+	{
+		if ( m_window.front().inlier )
+		{
+			addToSums( m_window.front(), -1.0 );
+			m_inliers--;
+		}
+		m_window.pop_front();
+	}
+
+	m_sinceRefit++;
+	if ( m_sinceRefit >= m_config.refitInterval || m_window.size() == 2 * minSamples )
+		refitLocked();
+	else
+		solve();
+
+	m_bSynchronized.store( m_inliers >= minSamples, boost::memory_order_release );
+	publish();
+	return m_model.l0 + static_cast< long long >( std::floor( m_model.evaluate( toX( native ) ) * 1e9 + 0.5 ) );
+}
+
+
+void ClockTracker::refit()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	refitLocked();
+	publish();
+}
+
+
+void ClockTracker::refitLocked()
+{
+	m_sinceRefit = 0;
+	if ( m_window.empty() )
+		return;
+
+	// start from a least-squares fit to all samples, relative to the oldest one
+	m_model.n0 = m_window.front().native;
+	m_model.l0 = m_window.front().local;
+	clearSums();
+	for ( std::size_t i = 0; i < m_window.size(); i++ )
+	{
+		m_window[ i ].inlier = true;
+		addToSums( m_window[ i ], 1.0 );
+	}
+	m_inliers = m_window.size();
+	solve();
+
+	// iteratively reject samples that deviate from the median residual by more than a multiple of the
+	// median absolute deviation, the first fit may be biased by outliers
+	std::vector< double > residuals( m_window.size() );
+	std::vector< double > deviations( m_window.size() );
+	for ( int iteration = 0; iteration < 4; iteration++ )
+	{
+		for ( std::size_t i = 0; i < m_window.size(); i++ )
+			residuals[ i ] = toY( m_window[ i ].local ) - m_model.evaluate( toX( m_window[ i ].native ) );
+		std::copy( residuals.begin(), residuals.end(), deviations.begin() );
+		const double center = median( deviations );
+		for ( std::size_t i = 0; i < deviations.size(); i++ )
+			deviations[ i ] = std::fabs( residuals[ i ] - center );
+		m_deviation = std::max( m_config.minDeviation, 1.4826 * median( deviations ) );
+
+		const double threshold = m_config.outlierThreshold * m_deviation;
+		bool bChanged = false;
+		std::size_t inliers = 0;
+		for ( std::size_t i = 0; i < m_window.size(); i++ )
+		{
+			const bool bInlier = std::fabs( residuals[ i ] - center ) <= threshold;
+			bChanged = bChanged || bInlier != m_window[ i ].inlier;
+			inliers += bInlier ? 1 : 0;
+		}
+		if ( !bChanged || inliers < 2 )
+			break;
+
+		clearSums();
+		m_inliers = 0;
+		for ( std::size_t i = 0; i < m_window.size(); i++ )
+		{
+			m_window[ i ].inlier = std::fabs( residuals[ i ] - center ) <= threshold;
+			if ( m_window[ i ].inlier )
+			{
+				addToSums( m_window[ i ], 1.0 );
+				m_inliers++;
+			}
+		}
+		solve();
+	}
+}
+
+
+void ClockTracker::publish()
+{
+	// sequence lock: readers retry while the sequence number is odd or changes
+	const unsigned sequence = m_sequence.load( boost::memory_order_relaxed );
+	m_sequence.store( sequence + 1, boost::memory_order_relaxed );
+	boost::atomic_thread_fence( boost::memory_order_release );
+	m_publishedN0.store( m_model.n0, boost::memory_order_relaxed );
+	m_publishedL0.store( m_model.l0, boost::memory_order_relaxed );
+	for ( int i = 0; i < 3; i++ )
+		m_publishedC[ i ].store( m_model.c[ i ], boost::memory_order_relaxed );
+	m_sequence.store( sequence + 2, boost::memory_order_release );
+}
+
+
+ClockTracker::Model ClockTracker::loadModel() const
+{
+	Model model;
+	unsigned before, after;
+	do
+	{
+		before = m_sequence.load( boost::memory_order_acquire );
+		model.n0 = m_publishedN0.load( boost::memory_order_relaxed );
+		model.l0 = m_publishedL0.load( boost::memory_order_relaxed );
+		for ( int i = 0; i < 3; i++ )
+			model.c[ i ] = m_publishedC[ i ].load( boost::memory_order_relaxed );
+		boost::atomic_thread_fence( boost::memory_order_acquire );
+		after = m_sequence.load( boost::memory_order_relaxed );
+	}
+	while ( before != after || ( before & 1 ) );
+	return model;
+}
+
+
+Timestamp ClockTracker::convertNativeToLocal( double native ) const
+{
+	const Model model( loadModel() );
+	const double x = ( native - model.n0 ) / m_config.nativeFrequency;
+	return model.l0 + static_cast< long long >( std::floor( model.evaluate( x ) * 1e9 + 0.5 ) );
+}
+
+
+ClockSyncStatus ClockTracker::status() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	ClockSyncStatus s;
+	s.samples = m_samples;
+	s.outliers = m_outliers;
+	s.jumps = m_jumps;
+	s.windowSamples = m_window.size();
+	s.windowInliers = m_inliers;
+	s.deviation = m_deviation;
+	// slope at the most recent sample
+	const double x = m_window.empty() ? 0.0 : toX( m_window.back().native );
+	s.drift = ( m_model.c[ 1 ] + 2.0 * m_model.c[ 2 ] * x - 1.0 ) * 1e6;
+	return s;
+}
+
+
+ClockSyncService& ClockSyncService::instance()
+{
+	// never destroyed, so trackers can be used during static destruction
+	static ClockSyncService* pService = new ClockSyncService;
+	return *pService;
+}
+
+
+boost::shared_ptr< ClockTracker > ClockSyncService::clock( const std::string& sName, const ClockSyncConfig& config )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	boost::shared_ptr< ClockTracker >& pClock( m_clocks[ sName ] );
+	if ( !pClock )
+		pClock.reset( new ClockTracker( config ) );
+	return pClock;
+}
+
+
+bool ClockSyncService::hasClock( const std::string& sName ) const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	return m_clocks.find( sName ) != m_clocks.end();
+}
+
+
+void ClockSyncService::removeClock( const std::string& sName )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_clocks.erase( sName );
+}
+
+
+std::vector< std::string > ClockSyncService::clocks() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	std::vector< std::string > names;
+	for ( std::map< std::string, boost::shared_ptr< ClockTracker > >::const_iterator it = m_clocks.begin(); it != m_clocks.end(); ++it )
+		names.push_back( it->first );
+	return names;
+}
+
+} } // namespace Ubitrack::Measurement
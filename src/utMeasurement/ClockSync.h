@@ -0,0 +1,264 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @ingroup datastructures
+ * @file
+ * Synchronization of many native sensor clocks to the local clock with windowed robust fits.
+ */
+
+
+#ifndef _Ubitrack_Measurement_ClockSync_INCLUDED_
+#define _Ubitrack_Measurement_ClockSync_INCLUDED_
+
+#include <utCore.h>
+#include <utMeasurement/Timestamp.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Ubitrack { namespace Measurement {
+
+/** parameters of a \c ClockTracker */
+struct ClockSyncConfig
+{
+	ClockSyncConfig()
+		: nativeFrequency( 1e9 )
+		, degree( 1 )
+		, windowSize( 500 )
+		, refitInterval( 50 )
+		, outlierThreshold( 4.0 )
+		, minDeviation( 20e-6 )
+		, jumpThreshold( 0.05 )
+		, jumpConfirmations( 5 )
+	{}
+
+	/** approximate frequency of the native clock in Hz, it need not be precise */
+	double nativeFrequency;
+
+	/**
+	 * degree of the fitted polynomial, 1 for offset and drift, 2 to also follow drift changes.
+	 * An offset-only fit is not supported, the tracker uses 1 for 0 and 2 for larger values.
+	 */
+	unsigned degree;
+
+	/** number of most recent samples the fit is computed over */
+	std::size_t windowSize;
+
+	/** number of samples between robust batch fits, between them the fit is updated incrementally */
+	std::size_t refitInterval;
+
+	/** samples deviating from the fit by more than this multiple of the robust deviation are outliers */
+	double outlierThreshold;
+
+	/** lower bound of the robust deviation in seconds, the resolution of the local timestamps */
+	double minDeviation;
+
+	/** deviation in seconds above which consecutive consistent outliers indicate a clock jump */
+	double jumpThreshold;
+
+	/** number of consecutive consistent outliers that confirm a clock jump */
+	std::size_t jumpConfirmations;
+};
+
+
+/** state of a \c ClockTracker */
+struct ClockSyncStatus
+{
+	/** number of samples added */
+	unsigned long long samples;
+
+	/** number of samples rejected as outliers */
+	unsigned long long outliers;
+
+	/** number of detected clock jumps, including native clocks going backwards */
+	unsigned long long jumps;
+
+	/** number of samples in the window, and how many of them are used by the fit */
+	std::size_t windowSamples;
+	std::size_t windowInliers;
+
+	/** robust standard deviation of the local timestamps from the fit, in seconds */
+	double deviation;
+
+	/** local seconds per nominal native second at the most recent sample, minus one, in ppm */
+	double drift;
+};
+
+
+/**
+ * Relates one native clock to the local clock.
+ *
+ * Samples ( native, local ) are fitted with a polynomial of the configured degree over a window of
+ * recent samples. A robust batch fit runs every \c refitInterval samples: it iteratively rejects
+ * samples that deviate by more than \c outlierThreshold robust standard deviations, estimated from the
+ * median absolute deviation. Between batch fits, new samples are checked against the fit and added to
+ * the running sums of the normal equations, so the update is O(1). Consecutive outliers that agree
+ * with each other and deviate by more than \c jumpThreshold restart the fit from them, as does a native
+ * clock that goes backwards.
+ *
+ * Several sensors sharing one clock can add samples to the same tracker. \c convertNativeToLocal()
+ * evaluates the last published fit in constant time without locking and can be called from any number
+ * of threads while samples are added.
+ */
+class UBITRACK_EXPORT ClockTracker
+	: private boost::noncopyable
+{
+public:
+	explicit ClockTracker( const ClockSyncConfig& config = ClockSyncConfig() );
+
+	/**
+	 * Adds a native timestamp taken at the current local time, i.e. \c now().
+	 * @return the native time converted to local time
+	 */
+	Timestamp addSample( double native )
+	{ return addSample( native, now() ); }
+
+	/**
+	 * Adds a native timestamp and the local time it was received at.
+	 * @return the native time converted to local time with the updated fit
+	 */
+	Timestamp addSample( double native, Timestamp local );
+
+	/** converts a native time to local time with the current fit, lock-free and thread-safe */
+	Timestamp convertNativeToLocal( double native ) const;
+
+	/** @return \c true if the fit is based on enough samples to estimate the drift */
+	bool isSynchronized() const
+	{ return m_bSynchronized.load( boost::memory_order_acquire ); }
+
+	/** runs a robust batch fit over the window now */
+	void refit();
+
+	/** forgets all samples and publishes the initial model, local time = native time / \c nativeFrequency seconds */
+	void reset();
+
+	ClockSyncStatus status() const;
+
+	const ClockSyncConfig& config() const
+	{ return m_config; }
+
+protected:
+	struct Sample
+	{
+		double native;
+		Timestamp local;
+		bool inlier;
+	};
+
+	/** local = l0 + ( c0 + c1 * x + c2 * x^2 ) seconds with x = ( native - n0 ) / nativeFrequency */
+	struct Model
+	{
+		double n0;
+		Timestamp l0;
+		double c[ 3 ];
+
+		double evaluate( double x ) const
+		{ return c[ 0 ] + x * ( c[ 1 ] + x * c[ 2 ] ); }
+	};
+
+	double toX( double native ) const;
+	double toY( Timestamp local ) const;
+	void restart();
+	void refitLocked();
+	void addToSums( const Sample& s, double sign );
+	void clearSums();
+	void solve();
+	void publish();
+	Model loadModel() const;
+
+	const ClockSyncConfig m_config;
+
+	/** protects everything but the published model */
+	mutable boost::mutex m_mutex;
+
+	std::deque< Sample > m_window;
+	std::size_t m_inliers;
+	std::vector< Sample > m_jumpCandidates;
+	std::size_t m_sinceRefit;
+
+	/** sums of x^k ( k = 0..4 ) and y * x^k ( k = 0..2 ) over the inliers */
+	double m_sumX[ 5 ];
+	double m_sumXY[ 3 ];
+
+	Model m_model;
+	double m_deviation;
+
+	unsigned long long m_samples;
+	unsigned long long m_outliers;
+	unsigned long long m_jumps;
+
+	/** the published model, written with a sequence lock */
+	boost::atomic< unsigned > m_sequence;
+	boost::atomic< double > m_publishedN0;
+	boost::atomic< boost::uint64_t > m_publishedL0;
+	boost::atomic< double > m_publishedC[ 3 ];
+	boost::atomic< bool > m_bSynchronized;
+};
+
+
+/**
+ * Process-wide set of named clock trackers.
+ *
+ * Sensors that share a native clock, e.g. several devices on one bus, use the tracker of the same name.
+ */
+class UBITRACK_EXPORT ClockSyncService
+	: private boost::noncopyable
+{
+public:
+	/** returns the service */
+	static ClockSyncService& instance();
+
+	/**
+	 * returns the tracker of a clock, creating it with the given configuration on first use.
+	 * The tracker stays valid as long as a reference to it exists.
+	 */
+	boost::shared_ptr< ClockTracker > clock( const std::string& sName, const ClockSyncConfig& config = ClockSyncConfig() );
+
+	/** @return \c true if a tracker of the name exists */
+	bool hasClock( const std::string& sName ) const;
+
+	/** removes a tracker from the service */
+	void removeClock( const std::string& sName );
+
+	/** @return the names of all trackers */
+	std::vector< std::string > clocks() const;
+
+protected:
+	mutable boost::mutex m_mutex;
+	std::map< std::string, boost::shared_ptr< ClockTracker > > m_clocks;
+};
+
+} } // namespace Ubitrack::Measurement
+
+#endif // _Ubitrack_Measurement_ClockSync_INCLUDED_
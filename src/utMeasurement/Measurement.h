@@ -43,6 +43,7 @@
 #include <utMath/Scalar.h>
 #include <utMath/RotationVelocity.h>
 #include <utMath/CameraIntrinsics.h>
+#include <utUtil/PoolAllocator.h>
 
 // std
 #include <vector>
@@ -50,6 +51,7 @@
 
 // Boost
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/vector.hpp>
 
@@ -129,6 +131,9 @@ Measurement< X > b = a;
  * results in \c b being changed to \c dataE, too! Use \c Measurement::clone 
  * to copy data instead.
  *
+ * Payloads copied into a measurement are allocated together with the reference count
+ * in one block from the small object pool ( see \c Util::poolAllocate ).
+ *
  * @param Type data type of payload.
  */
 template< typename Type > 
@@ -174,7 +179,7 @@ class Measurement
 		
 		/** Construct from payload reference (content will be copied), with timestamp of 0. */
 		explicit Measurement( const Type& m )
-			: boost::shared_ptr< Type>( new Type( m ) )
+			: boost::shared_ptr< Type>( allocatePayload( m ) )
 			, m_timestamp( 0 )
 		{ }
 
@@ -186,10 +191,17 @@ class Measurement
 
 		/** Construct from timestamp and payload reference (content will be copied). */
 		Measurement( const timestamp_type t, const Type& m )
-			: boost::shared_ptr< Type>( new Type( m ) )
+			: boost::shared_ptr< Type>( allocatePayload( m ) )
 			, m_timestamp( t )
 		{ }
 
+		/**
+		 * Allocates a copy of a payload together with its reference count from the small object pool.
+		 * Use this instead of \c new \c Type when creating payload \c shared_ptrs.
+		 */
+		static boost::shared_ptr< Type > allocatePayload( const Type& m )
+		{ return boost::allocate_shared< Type >( Util::PoolAllocator< Type >(), m ); }
+
 		/**
 		 * set the internal timestamp
 		 */
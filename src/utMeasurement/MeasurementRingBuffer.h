@@ -0,0 +1,403 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup datastructures
+ * @file
+ * Bounded lock-free ring buffer to pass timestamped measurements between threads.
+ */
+
+
+#ifndef _Ubitrack_Measurement_MeasurementRingBuffer_INCLUDED_
+#define _Ubitrack_Measurement_MeasurementRingBuffer_INCLUDED_
+
+#include <utMeasurement/Measurement.h>
+#include <utUtil/Exception.h>
+#include <utMath/Util/type_traits.h>
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+
+namespace Ubitrack { namespace Measurement {
+
+/** producer policy of \c MeasurementRingBuffer: only one thread pushes measurements */
+struct SingleProducer
+{
+	static const bool multiProducer = false;
+};
+
+/** producer policy of \c MeasurementRingBuffer: several threads push measurements concurrently */
+struct MultiProducer
+{
+	static const bool multiProducer = true;
+};
+
+namespace Detail {
+
+/** initializes a payload slot from the prototype */
+template< class Type >
+inline void initializeSlot( Type& value, const Type& prototype )
+{ value = prototype; }
+
+/** copies do not keep the reserved capacity, so reserve it explicitly for later assignments */
+template< class Type, class Alloc >
+inline void initializeSlot( std::vector< Type, Alloc >& value, const std::vector< Type, Alloc >& prototype )
+{
+	value = prototype;
+	value.reserve( prototype.capacity() );
+}
+
+} // namespace Detail
+
+/**
+ * Bounded lock-free ring buffer for timestamped measurements.
+ *
+ * The buffer passes measurements from one or several producer threads to a single
+ * consumer thread. Payloads are stored by value in slots that are allocated once
+ * in the constructor, so pushing does neither allocate memory nor touch a reference
+ * count (payloads holding memory themselves, like \c std::vector, reuse the capacity
+ * of the slot after the first round).
+ *
+ * The consumer reads the buffered measurements without copying through a \c View,
+ * which also answers timestamp queries (latest, nearest, range). Slots stay valid until
+ * the consumer releases them with \c consume() or \c consumeUntil().
+ *
+ * When the buffer is full, \c push() fails and the measurement is counted as dropped.
+ *
+ * Each slot carries a sequence number (bounded MPMC queue by D. Vyukov, reduced to
+ * a single consumer). With the \c SingleProducer policy the write position is advanced
+ * without compare-and-swap.
+ *
+ * @tparam Type payload type, needs to be default constructible and assignable
+ * @tparam ProducerPolicy \c SingleProducer or \c MultiProducer
+ */
+template< typename Type, typename ProducerPolicy = MultiProducer >
+class MeasurementRingBuffer
+	: private boost::noncopyable
+{
+protected:
+	/// @internal one preallocated element of the buffer
+	struct Slot
+	{
+		boost::atomic< boost::uint64_t > sequence;
+		Timestamp time;
+		Type value;
+	};
+
+public:
+	typedef Type value_type;
+
+	/**
+	 * Read-only view onto the measurements currently available to the consumer.
+	 *
+	 * A view is a snapshot: measurements pushed after its creation are not visible.
+	 * It must only be used by the consumer thread and becomes invalid when the consumer
+	 * releases measurements. Index 0 is the oldest measurement.
+	 */
+	class View
+	{
+	public:
+		/** @return number of measurements in the view */
+		std::size_t size() const
+		{ return m_size; }
+
+		/** @return \c true if there are no measurements in the view */
+		bool empty() const
+		{ return m_size == 0; }
+
+		/** @return timestamp of the i-th measurement */
+		Timestamp time( const std::size_t i ) const
+		{ return slot( i ).time; }
+
+		/** @return reference to the payload of the i-th measurement, no copy is made */
+		const Type& operator[]( const std::size_t i ) const
+		{ return slot( i ).value; }
+
+		/** @return a copy of the i-th measurement as a \c Measurement */
+		Measurement< Type > measurement( const std::size_t i ) const
+		{ return Measurement< Type >( slot( i ).time, slot( i ).value ); }
+
+		/** @return index of the measurement with the latest timestamp, \c size() if empty */
+		std::size_t latest() const
+		{
+			std::size_t best = m_size;
+			for ( std::size_t i = 0; i < m_size; i++ )
+				if ( best == m_size || slot( i ).time >= slot( best ).time )
+					best = i;
+			return best;
+		}
+
+		/** @return index of the measurement with the timestamp closest to \c t, \c size() if empty */
+		std::size_t nearest( const Timestamp t ) const
+		{
+			std::size_t best = m_size;
+			Timestamp bestDiff = 0;
+			for ( std::size_t i = 0; i < m_size; i++ )
+			{
+				const Timestamp ti = slot( i ).time;
+				const Timestamp diff = ti > t ? ti - t : t - ti;
+				if ( best == m_size || diff < bestDiff )
+				{
+					best = i;
+					bestDiff = diff;
+				}
+			}
+			return best;
+		}
+
+		/**
+		 * Collects the indices of all measurements with timestamps in [ \c from, \c to ] in
+		 * the order of the buffer.
+		 * @return number of measurements found
+		 */
+		std::size_t range( const Timestamp from, const Timestamp to, std::vector< std::size_t >& indices ) const
+		{
+			indices.clear();
+			for ( std::size_t i = 0; i < m_size; i++ )
+			{
+				const Timestamp ti = slot( i ).time;
+				if ( ti >= from && ti <= to )
+					indices.push_back( i );
+			}
+			return indices.size();
+		}
+
+	protected:
+		friend class MeasurementRingBuffer;
+
+		View( const Slot* pSlots, const std::size_t mask, const boost::uint64_t first, const std::size_t size )
+			: m_pSlots( pSlots )
+			, m_mask( mask )
+			, m_first( first )
+			, m_size( size )
+		{}
+
+		const Slot& slot( const std::size_t i ) const
+		{ return m_pSlots[ ( m_first + i ) & m_mask ]; }
+
+		const Slot* m_pSlots;
+		std::size_t m_mask;
+		boost::uint64_t m_first;
+		std::size_t m_size;
+	};
+
+	/**
+	 * Constructor.
+	 * @param capacity number of slots, rounded up to the next power of two
+	 * @param prototype value the payloads of all slots are initialized with
+	 *   (e.g. a \c std::vector with reserved capacity)
+	 */
+	explicit MeasurementRingBuffer( const std::size_t capacity, const Type& prototype = Type() )
+		: m_capacity( roundUpPowerOfTwo( capacity ) )
+		, m_mask( m_capacity - 1 )
+		, m_slots( new Slot[ m_capacity ] )
+		, m_writePos( 0 )
+		, m_readPos( 0 )
+		, m_dropped( 0 )
+	{
+		if ( capacity == 0 )
+			UBITRACK_THROW( "MeasurementRingBuffer needs a capacity of at least one" );
+
+		for ( std::size_t i = 0; i < m_capacity; i++ )
+		{
+			m_slots[ i ].sequence.store( i, boost::memory_order_relaxed );
+			m_slots[ i ].time = 0;
+			Detail::initializeSlot( m_slots[ i ].value, prototype );
+		}
+	}
+
+	/** @return number of slots */
+	std::size_t capacity() const
+	{ return m_capacity; }
+
+	/** @return number of measurements that could not be pushed because the buffer was full */
+	boost::uint64_t dropped() const
+	{ return m_dropped.load( boost::memory_order_relaxed ); }
+
+	/** @return approximate number of buffered measurements */
+	std::size_t size() const
+	{
+		const boost::uint64_t w = m_writePos.load( boost::memory_order_acquire );
+		const boost::uint64_t r = m_readPos.load( boost::memory_order_acquire );
+		return w > r ? static_cast< std::size_t >( w - r ) : 0;
+	}
+
+	/**
+	 * Copies a payload into the buffer. Producer side.
+	 * @return \c false if the buffer is full
+	 */
+	bool push( const Timestamp t, const Type& value )
+	{
+		boost::uint64_t pos;
+		Slot* pSlot = acquireSlot( pos, Ubitrack::Util::constant_value< bool, ProducerPolicy::multiProducer >() );
+		if ( !pSlot )
+		{
+			m_dropped.fetch_add( 1, boost::memory_order_relaxed );
+			return false;
+		}
+
+		pSlot->time = t;
+		pSlot->value = value;
+		pSlot->sequence.store( pos + 1, boost::memory_order_release );
+		return true;
+	}
+
+	/**
+	 * Copies a measurement into the buffer. Producer side.
+	 * @return \c false if the buffer is full or the measurement has no payload
+	 */
+	bool push( const Measurement< Type >& m )
+	{
+		if ( !m.get() )
+			return false;
+		return push( m.time(), *m );
+	}
+
+	/**
+	 * Returns a zero-copy view onto all measurements that are completely written. Consumer side.
+	 */
+	View view() const
+	{
+		const boost::uint64_t first = m_readPos.load( boost::memory_order_relaxed );
+		std::size_t n = 0;
+		while ( n < m_capacity )
+		{
+			const Slot& s = m_slots[ ( first + n ) & m_mask ];
+			if ( s.sequence.load( boost::memory_order_acquire ) != first + n + 1 )
+				break;
+			n++;
+		}
+		return View( m_slots.get(), m_mask, first, n );
+	}
+
+	/**
+	 * Removes the oldest measurement and returns a copy of it. Consumer side.
+	 * @return \c false if the buffer is empty
+	 */
+	bool pop( Measurement< Type >& m )
+	{
+		const View v( view() );
+		if ( v.empty() )
+			return false;
+		m = v.measurement( 0 );
+		consume( 1 );
+		return true;
+	}
+
+	/**
+	 * Releases the \c n oldest measurements. Consumer side.
+	 * Stops at the first slot that is not completely written, so \c n is clamped to the size
+	 * of a view taken at the same time.
+	 * @param n number of measurements
+	 * @return number of released measurements
+	 */
+	std::size_t consume( const std::size_t n )
+	{
+		const boost::uint64_t first = m_readPos.load( boost::memory_order_relaxed );
+		boost::uint64_t pos = first;
+		for ( std::size_t i = 0; i < n; i++, pos++ )
+		{
+			Slot& s = m_slots[ pos & m_mask ];
+			if ( s.sequence.load( boost::memory_order_acquire ) != pos + 1 )
+				break;
+			s.sequence.store( pos + m_capacity, boost::memory_order_release );
+		}
+		m_readPos.store( pos, boost::memory_order_release );
+		return static_cast< std::size_t >( pos - first );
+	}
+
+	/**
+	 * Releases all measurements from the front of the buffer that are older than \c t. Consumer side.
+	 * @return number of released measurements
+	 */
+	std::size_t consumeUntil( const Timestamp t )
+	{
+		const View v( view() );
+		std::size_t n = 0;
+		while ( n < v.size() && v.time( n ) < t )
+			n++;
+		return consume( n );
+	}
+
+protected:
+
+	static std::size_t roundUpPowerOfTwo( const std::size_t n )
+	{
+		std::size_t p = 1;
+		while ( p < n )
+			p <<= 1;
+		return p;
+	}
+
+	/// @internal reserves the next slot for a single producer
+	Slot* acquireSlot( boost::uint64_t& pos, const Ubitrack::Util::false_type& )
+	{
+		pos = m_writePos.load( boost::memory_order_relaxed );
+		Slot* pSlot = &m_slots[ pos & m_mask ];
+		if ( pSlot->sequence.load( boost::memory_order_acquire ) != pos )
+			return 0;
+		m_writePos.store( pos + 1, boost::memory_order_relaxed );
+		return pSlot;
+	}
+
+	/// @internal reserves the next slot for one of several producers
+	Slot* acquireSlot( boost::uint64_t& pos, const Ubitrack::Util::true_type& )
+	{
+		pos = m_writePos.load( boost::memory_order_relaxed );
+		while ( true )
+		{
+			Slot* pSlot = &m_slots[ pos & m_mask ];
+			const boost::uint64_t seq = pSlot->sequence.load( boost::memory_order_acquire );
+			if ( seq == pos )
+			{
+				if ( m_writePos.compare_exchange_weak( pos, pos + 1, boost::memory_order_relaxed ) )
+					return pSlot;
+			}
+			else if ( seq < pos )
+				return 0; // full
+			else
+				pos = m_writePos.load( boost::memory_order_relaxed );
+		}
+	}
+
+	const std::size_t m_capacity;
+	const std::size_t m_mask;
+	boost::scoped_array< Slot > m_slots;
+
+	// producer and consumer positions on separate cache lines
+	char m_pad0[ 64 ];
+	boost::atomic< boost::uint64_t > m_writePos;
+	char m_pad1[ 64 ];
+	boost::atomic< boost::uint64_t > m_readPos;
+	char m_pad2[ 64 ];
+	boost::atomic< boost::uint64_t > m_dropped;
+};
+
+} } // namespace Ubitrack::Measurement
+
+#endif
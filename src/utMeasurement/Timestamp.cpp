@@ -45,6 +45,26 @@ namespace Ubitrack { namespace Measurement {
 
 
 Timestamp now()
+{
+	return now( Util::getClockPolicy() );
+}
+
+
+Timestamp now( Util::ClockPolicy policy )
+{
+	switch ( policy )
+	{
+		case Util::MonotonicClock:
+			return Util::calibratedNanoseconds();
+		case Util::StrictlyIncreasingClock:
+			return Util::strictlyIncreasingNanoseconds();
+		default:
+			return systemNow();
+	}
+}
+
+
+Timestamp systemNow()
 {
 #ifdef _MSC_VER
 
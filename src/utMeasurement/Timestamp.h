@@ -35,15 +35,26 @@
 
 #include <string>
 #include <utCore.h>
+#include <utUtil/Clock.h>
 
 namespace Ubitrack { namespace Measurement {
 
 /// Timestamp: nanoseconds since epoch (UNIX birth)
 typedef unsigned long long int Timestamp;
 
-/// retrieve the current system time as Timestamp
+/**
+ * retrieve the current time as Timestamp
+ *
+ * The clock is selected with \c Util::setClockPolicy(). By default this is the system time.
+ */
 UBITRACK_EXPORT Timestamp now();
 
+/// retrieve the current time as Timestamp from the given clock
+UBITRACK_EXPORT Timestamp now( Util::ClockPolicy policy );
+
+/// retrieve the current operating system wall clock time as Timestamp, regardless of the clock policy
+UBITRACK_EXPORT Timestamp systemNow();
+
 /// convert a Timestamp to a string (returns something like "Fri Mar 02 11:41:41 2007 UTC")
 UBITRACK_EXPORT std::string timestampToString( Timestamp );
 
@@ -44,6 +44,9 @@ namespace Ubitrack { namespace Measurement {
  * The sensors native clock is assumed to be precise whereas the local timestamp can have considerable
  * jitter when not using a real-time operating system. The shift and scaling between the clocks is
  * computed online using a kalman filter.
+ *
+ * \c ClockTracker ( see ClockSync.h ) additionally handles outliers in the native clock, changing drift
+ * and clock jumps, and can be shared between threads.
  */
 class UBITRACK_EXPORT TimestampSync
 {
@@ -55,11 +58,14 @@ public:
 	 * clock and the native clock resolution. The values need not be correct, but the order of
 	 * magnitude should be.
 	 *
+	 * The local clock is the one selected by \c Util::setClockPolicy() at construction time.
+	 *
 	 * @param approxNativeFreq frequency resolution of the sensor's native clock.
 	 * @param approxLocalFrequency resolution of the local clock.
 	 */
 	TimestampSync( double approxNativeFreq, double approxLocalFreq = 1e9 )
 		: m_events( 0 )
+		, m_clockPolicy( Util::getClockPolicy() )
 		, m_outlierBudget( -100 ) // no outlier detection the first 100 measurements
 	{
 		setFrequency( approxNativeFreq, approxLocalFreq );
@@ -69,14 +75,25 @@ public:
 	void setFrequency( double approxNativeFreq, double approxLocalFreq = 1e9 );
 
 	/**
-	 * Add a sensor timestamp and relate it to the current system clock.
+	 * Selects the local clock read by \c convertNativeToLocal( native ). Should be called before the
+	 * first timestamp is converted, as the estimate is not adapted to a different clock.
+	 */
+	void setClockPolicy( Util::ClockPolicy policy )
+	{ m_clockPolicy = policy; }
+
+	/** returns the local clock read by \c convertNativeToLocal( native ) */
+	Util::ClockPolicy getClockPolicy() const
+	{ return m_clockPolicy; }
+
+	/**
+	 * Add a sensor timestamp and relate it to the current time of the local clock.
 	 *
 	 * @param native native sensor clock value
 	 * @return the sensor time converted to a local time
 	 */
 	Timestamp convertNativeToLocal( double native )
 	{
-		return convertNativeToLocal( native, now() );
+		return convertNativeToLocal( native, now( m_clockPolicy ) );
 	}
 
 	/**
@@ -99,6 +116,9 @@ protected:
 	// number of treated events
 	unsigned m_events;
 
+	// local clock
+	Util::ClockPolicy m_clockPolicy;
+
 	// time of last received native time
 	double m_lastNative;
 	
@@ -32,12 +32,10 @@
 #ifndef _Ubitrack_Measurement_TimestampSyncLS_INCLUDED_
 #define _Ubitrack_Measurement_TimestampSyncLS_INCLUDED_
 
-#define DEBUG_TIMESTAMP_SYNC
-
 #ifdef DEBUG_TIMESTAMP_SYNC
 #include <iostream>
 #include <iomanip>
-// #include <cmath>
+#include <cmath>
 #endif
 
 #include <algorithm>
@@ -59,7 +57,7 @@ static const double g_fDeviationWeight = 0.01;
  * see class TimestampSync.
  * This does the same thing, but using an exponentially weighted recursive least-squares algorithm.
  */
-UBITRACK_EXPORT class TimestampSyncLS
+class TimestampSyncLS
 {
 public:
 	TimestampSyncLS()
@@ -0,0 +1,178 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @ingroup serialization
+ * @file
+ * Serialization into and from contiguous memory buffers
+ */
+
+
+#include "BufferSerialization.h"
+
+#include <cstring>
+#include <algorithm>
+
+
+namespace Ubitrack {
+namespace Serialization {
+
+BufferStreamBuf::BufferStreamBuf()
+    : m_mode(InternalMode)
+    , m_bOverrun(false)
+    , m_counted(0)
+{
+    setp(0, 0);
+    setg(0, 0, 0);
+}
+
+void BufferStreamBuf::writeTo(char* buffer, std::size_t size)
+{
+    m_mode = FixedMode;
+    m_bOverrun = false;
+    m_counted = 0;
+    setp(buffer, buffer+size);
+}
+
+void BufferStreamBuf::writeToInternal()
+{
+    m_mode = InternalMode;
+    m_bOverrun = false;
+    m_counted = 0;
+    if (m_storage.empty())
+        setp(0, 0);
+    else
+        setp(&m_storage[0], &m_storage[0]+m_storage.size());
+}
+
+void BufferStreamBuf::count()
+{
+    m_mode = CountingMode;
+    m_bOverrun = false;
+    m_counted = 0;
+    setp(m_scratch, m_scratch+sizeof(m_scratch));
+}
+
+void BufferStreamBuf::readFrom(const char* data, std::size_t size)
+{
+    // the get area is never written to
+    char* p = const_cast<char*>(data);
+    setg(p, p, p+size);
+}
+
+bool BufferStreamBuf::reserve(std::size_t n)
+{
+    const std::size_t used = static_cast<std::size_t>(pptr()-pbase());
+    if (static_cast<std::size_t>(epptr()-pptr())>=n)
+        return true;
+
+    switch (m_mode) {
+    case InternalMode:
+    {
+        m_storage.resize(std::max(2*m_storage.size(), std::max<std::size_t>(used+n, 256)));
+        setp(&m_storage[0], &m_storage[0]+m_storage.size());
+        pbump(static_cast<int>(used));
+        return true;
+    }
+    case CountingMode:
+        // the scratch area is only needed for single characters
+        m_counted += used;
+        setp(m_scratch, m_scratch+sizeof(m_scratch));
+        return n<=sizeof(m_scratch);
+    default:
+        m_bOverrun = true;
+        return false;
+    }
+}
+
+BufferStreamBuf::int_type BufferStreamBuf::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+        return traits_type::not_eof(c);
+    if (!reserve(1))
+        return traits_type::eof();
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
+std::streamsize BufferStreamBuf::xsputn(const char* s, std::streamsize n)
+{
+    const std::size_t len = static_cast<std::size_t>(n);
+    if (m_mode==CountingMode && len>static_cast<std::size_t>(epptr()-pptr())) {
+        m_counted += len;
+        return n;
+    }
+    if (!reserve(len)) {
+        // fill the rest of a fixed buffer like the default implementation
+        const std::size_t fits = static_cast<std::size_t>(epptr()-pptr());
+        std::memcpy(pptr(), s, fits);
+        pbump(static_cast<int>(fits));
+        return static_cast<std::streamsize>(fits);
+    }
+    std::memcpy(pptr(), s, len);
+    pbump(static_cast<int>(len));
+    return n;
+}
+
+void BufferStreamBuf::write(const char* p, std::size_t n)
+{
+    if (static_cast<std::size_t>(xsputn(p, static_cast<std::streamsize>(n)))!=n)
+        throw StreamOverrunException("Serialization buffer too small");
+}
+
+
+MessageWriter::MessageWriter(const SerializationProtocol p)
+    : m_protocol(p)
+    , m_stream(&m_buf)
+{
+    // the archives write nothing without header
+    if (p==PROTOCOL_BOOST_BINARY)
+        m_pBinaryArchive.reset(new boost::archive::binary_oarchive(m_buf, boost::archive::no_header));
+    else if (p==PROTOCOL_BOOST_TEXT)
+        m_pTextArchive.reset(new boost::archive::text_oarchive(m_stream, boost::archive::no_header));
+}
+
+MessageWriter::~MessageWriter()
+{
+}
+
+
+MessageReader::MessageReader(const SerializationProtocol p)
+    : m_protocol(p)
+    , m_stream(&m_buf)
+{
+    if (p==PROTOCOL_BOOST_BINARY)
+        m_pBinaryArchive.reset(new boost::archive::binary_iarchive(m_buf, boost::archive::no_header));
+    else if (p==PROTOCOL_BOOST_TEXT)
+        m_pTextArchive.reset(new boost::archive::text_iarchive(m_stream, boost::archive::no_header));
+}
+
+MessageReader::~MessageReader()
+{
+}
+
+} // Serialization
+} // Ubitrack
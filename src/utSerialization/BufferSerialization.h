@@ -0,0 +1,419 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup serialization
+ * @file
+ * Serialization into and from contiguous memory buffers, without intermediate streams
+ */
+
+
+#ifndef UBITRACK_BUFFERSERIALIZATION_H
+#define UBITRACK_BUFFERSERIALIZATION_H
+
+#include "utSerialization/Serialization.h"
+#include "utSerialization/Exception.h"
+
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/archive/archive_exception.hpp>
+
+
+namespace Ubitrack {
+namespace Serialization {
+
+/**
+ * \brief std::streambuf on contiguous memory.
+ *
+ * Reads directly from a caller-provided buffer. Writes either into a caller-provided buffer,
+ * into an internal buffer that grows as needed and keeps its capacity, or only counts the bytes.
+ * Also provides the write interface of msgpack streams.
+ */
+class UBITRACK_EXPORT BufferStreamBuf
+    : public std::streambuf
+    , private boost::noncopyable {
+public:
+    BufferStreamBuf();
+
+    /** writes into a caller-provided buffer, overruns are reported by \c overrun() */
+    void writeTo(char* buffer, std::size_t size);
+
+    /** writes into the internal buffer, starting from its beginning */
+    void writeToInternal();
+
+    /** only counts the written bytes */
+    void count();
+
+    /** reads from a caller-provided buffer */
+    void readFrom(const char* data, std::size_t size);
+
+    /** number of bytes written since the last call to \c writeTo, \c writeToInternal or \c count */
+    std::size_t written() const
+    { return m_counted+static_cast<std::size_t>(pptr()-pbase()); }
+
+    /** number of bytes read since the last call to \c readFrom */
+    std::size_t consumed() const
+    { return static_cast<std::size_t>(gptr()-eback()); }
+
+    /** the written data, invalidated by further writes into the internal buffer */
+    const char* data() const
+    { return pbase(); }
+
+    /** true if a write did not fit into the caller-provided buffer */
+    bool overrun() const
+    { return m_bOverrun; }
+
+    /** appends data, throws \c StreamOverrunException if it does not fit */
+    void write(const char* p, std::size_t n);
+
+protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char* s, std::streamsize n);
+
+    /** makes room for n more bytes, returns false if there is not enough space */
+    bool reserve(std::size_t n);
+
+    enum Mode { FixedMode, InternalMode, CountingMode };
+    Mode m_mode;
+    bool m_bOverrun;
+    std::size_t m_counted;
+    std::vector<char> m_storage;
+    char m_scratch[256];
+};
+
+
+namespace Detail {
+
+#ifdef HAVE_MSGPACK
+/** lets msgpack reference strings and ext payloads in the input buffer instead of copying them */
+inline bool referenceBuffer(msgpack::type::object_type, std::size_t, void*)
+{
+    return true;
+}
+#endif // HAVE_MSGPACK
+
+/** translates stream errors of boost archives on memory buffers */
+inline void rethrowArchiveException(const boost::archive::archive_exception& e, const BufferStreamBuf& buf)
+{
+    if (buf.overrun())
+        throw StreamOverrunException("Serialization buffer too small");
+    if (e.code==boost::archive::archive_exception::input_stream_error)
+        throw StreamOverrunException("Serialized data truncated");
+    throw e;
+}
+
+/** writes an object with a new boost archive without header */
+template<typename T>
+inline void saveArchive(const SerializationProtocol p, BufferStreamBuf& buf, const T& t)
+{
+    try {
+        if (p==PROTOCOL_BOOST_BINARY) {
+            boost::archive::binary_oarchive out_archive_b(buf, boost::archive::no_header);
+            BoostArchive::serialize(out_archive_b, t);
+        }
+        else {
+            std::ostream stream(&buf);
+            boost::archive::text_oarchive out_archive_t(stream, boost::archive::no_header);
+            BoostArchive::serialize(out_archive_t, t);
+        }
+    }
+    catch (const boost::archive::archive_exception& e) {
+        rethrowArchiveException(e, buf);
+    }
+    // text archives end with a newline when they are destroyed
+    if (buf.overrun())
+        throw StreamOverrunException("Serialization buffer too small");
+}
+
+} // Detail
+
+
+/**
+ * \brief Determine the serialized length of an object for a buffer.
+ *
+ * Exact for the boost archives, which are written without header into buffers, an upper bound
+ * for msgpack. The length of msgpack messages is computed from the shapes of the contained
+ * values and is cheap, the boost archives have to count a serialization.
+ */
+template<typename T>
+inline std::size_t maxSerializationLength(const SerializationProtocol p, const T& t)
+{
+    switch(p) {
+    case PROTOCOL_BOOST_TEXT:
+    case PROTOCOL_BOOST_BINARY:
+    {
+        BufferStreamBuf buf;
+        buf.count();
+        Detail::saveArchive(p, buf, t);
+        return buf.written();
+    }
+#ifdef HAVE_MSGPACK
+    case PROTOCOL_MSGPACK:
+        return MsgpackArchive::maxSerializationLength(t);
+#endif // HAVE_MSGPACK
+    default:
+        UBITRACK_THROW("Unknown Serialization Protocol");
+    }
+}
+
+/**
+ * \brief Serialize an object into a caller-provided buffer.
+ *
+ * Boost archives are written without header. Throws \c StreamOverrunException if the buffer
+ * is too small, use \c maxSerializationLength to size it.
+ * @return the number of bytes written
+ */
+template<typename T>
+inline std::size_t serialize(const SerializationProtocol p, char* buffer, const std::size_t size, const T& t)
+{
+    BufferStreamBuf buf;
+    buf.writeTo(buffer, size);
+    switch(p) {
+    case PROTOCOL_BOOST_TEXT:
+    case PROTOCOL_BOOST_BINARY:
+        Detail::saveArchive(p, buf, t);
+        break;
+#ifdef HAVE_MSGPACK
+    case PROTOCOL_MSGPACK:
+    {
+        msgpack::packer<BufferStreamBuf> pk(&buf);
+        MsgpackArchive::serialize(pk, t);
+    }
+        break;
+#endif // HAVE_MSGPACK
+    default:
+        UBITRACK_THROW("Unknown Serialization Protocol");
+    }
+    return buf.written();
+}
+
+/**
+ * \brief Deserialize an object directly from a buffer that was written by \c serialize.
+ *
+ * Throws \c StreamOverrunException if a boost archive is truncated.
+ * @return the number of bytes read
+ */
+template<typename T>
+inline std::size_t deserialize(const SerializationProtocol p, const char* data, const std::size_t size, T& t)
+{
+    switch(p) {
+    case PROTOCOL_BOOST_TEXT:
+    case PROTOCOL_BOOST_BINARY:
+    {
+        BufferStreamBuf buf;
+        buf.readFrom(data, size);
+        try {
+            if (p==PROTOCOL_BOOST_BINARY) {
+                boost::archive::binary_iarchive in_archive_b(buf, boost::archive::no_header);
+                BoostArchive::deserialize(in_archive_b, t);
+            }
+            else {
+                std::istream stream(&buf);
+                {
+                    boost::archive::text_iarchive in_archive_t(stream, boost::archive::no_header);
+                    BoostArchive::deserialize(in_archive_t, t);
+                }
+                // also consume the final newline
+                stream >> std::ws;
+            }
+        }
+        catch (const boost::archive::archive_exception& e) {
+            Detail::rethrowArchiveException(e, buf);
+        }
+        return buf.consumed();
+    }
+#ifdef HAVE_MSGPACK
+    case PROTOCOL_MSGPACK:
+    {
+        std::size_t offset = 0;
+        msgpack::object_handle oh = msgpack::unpack(data, size, offset, &Detail::referenceBuffer);
+        oh.get().convert(t);
+        return offset;
+    }
+#endif // HAVE_MSGPACK
+    default:
+        UBITRACK_THROW("Unknown Serialization Protocol");
+    }
+}
+
+
+/**
+ * \brief Serializes a sequence of messages into memory with one persistent archive.
+ *
+ * The boost archives are created once, without header, and write class information only with
+ * the first message of each type. Such messages can only be read by one \c MessageReader, in the
+ * order they were written. Msgpack messages are self-contained.
+ *
+ * Messages are written into an internal buffer that keeps its capacity, so writing does not
+ * allocate in the steady state, or into caller-provided buffers. After an exception, the writer
+ * and its reader have to be recreated.
+ */
+class UBITRACK_EXPORT MessageWriter
+    : private boost::noncopyable {
+public:
+    explicit MessageWriter(const SerializationProtocol p);
+    ~MessageWriter();
+
+    /**
+     * Serializes a message into the internal buffer.
+     * @return the size of the message at \c data()
+     */
+    template<typename T>
+    std::size_t write(const T& t)
+    {
+        m_buf.writeToInternal();
+        writeMessage(t);
+        return m_buf.written();
+    }
+
+    /**
+     * Serializes a message into a caller-provided buffer.
+     * Throws \c StreamOverrunException if the buffer is too small.
+     * @return the number of bytes written
+     */
+    template<typename T>
+    std::size_t write(char* buffer, const std::size_t size, const T& t)
+    {
+        m_buf.writeTo(buffer, size);
+        writeMessage(t);
+        return m_buf.written();
+    }
+
+    /** the last message written into the internal buffer */
+    const char* data() const
+    { return m_buf.data(); }
+
+    SerializationProtocol getProtocol() const
+    { return m_protocol; }
+
+protected:
+    template<typename T>
+    void writeMessage(const T& t)
+    {
+        try {
+            switch(m_protocol) {
+            case PROTOCOL_BOOST_TEXT:
+                m_stream.clear();
+                BoostArchive::serialize(*m_pTextArchive, t);
+                break;
+            case PROTOCOL_BOOST_BINARY:
+                BoostArchive::serialize(*m_pBinaryArchive, t);
+                break;
+#ifdef HAVE_MSGPACK
+            case PROTOCOL_MSGPACK:
+            {
+                msgpack::packer<BufferStreamBuf> pk(&m_buf);
+                MsgpackArchive::serialize(pk, t);
+            }
+                break;
+#endif // HAVE_MSGPACK
+            default:
+                UBITRACK_THROW("Unknown Serialization Protocol");
+            }
+        }
+        catch (const boost::archive::archive_exception& e) {
+            Detail::rethrowArchiveException(e, m_buf);
+        }
+    }
+
+    const SerializationProtocol m_protocol;
+    BufferStreamBuf m_buf;
+    std::ostream m_stream;
+    boost::scoped_ptr<boost::archive::binary_oarchive> m_pBinaryArchive;
+    boost::scoped_ptr<boost::archive::text_oarchive> m_pTextArchive;
+};
+
+
+/**
+ * \brief Deserializes the messages of a \c MessageWriter directly from memory.
+ *
+ * Keeps the archive open between messages and reuses the msgpack memory zone.
+ */
+class UBITRACK_EXPORT MessageReader
+    : private boost::noncopyable {
+public:
+    explicit MessageReader(const SerializationProtocol p);
+    ~MessageReader();
+
+    /**
+     * Deserializes the next message.
+     * @return the number of bytes read
+     */
+    template<typename T>
+    std::size_t read(const char* data, const std::size_t size, T& t)
+    {
+        m_buf.readFrom(data, size);
+        try {
+            switch(m_protocol) {
+            case PROTOCOL_BOOST_TEXT:
+                m_stream.clear();
+                BoostArchive::deserialize(*m_pTextArchive, t);
+                break;
+            case PROTOCOL_BOOST_BINARY:
+                BoostArchive::deserialize(*m_pBinaryArchive, t);
+                break;
+#ifdef HAVE_MSGPACK
+            case PROTOCOL_MSGPACK:
+            {
+                m_zone.clear();
+                std::size_t offset = 0;
+                bool referenced;
+                msgpack::object o = msgpack::unpack(m_zone, data, size, offset, referenced, &Detail::referenceBuffer);
+                o.convert(t);
+                return offset;
+            }
+#endif // HAVE_MSGPACK
+            default:
+                UBITRACK_THROW("Unknown Serialization Protocol");
+            }
+        }
+        catch (const boost::archive::archive_exception& e) {
+            Detail::rethrowArchiveException(e, m_buf);
+        }
+        return m_buf.consumed();
+    }
+
+    SerializationProtocol getProtocol() const
+    { return m_protocol; }
+
+protected:
+    const SerializationProtocol m_protocol;
+    BufferStreamBuf m_buf;
+    std::istream m_stream;
+    boost::scoped_ptr<boost::archive::binary_iarchive> m_pBinaryArchive;
+    boost::scoped_ptr<boost::archive::text_iarchive> m_pTextArchive;
+#ifdef HAVE_MSGPACK
+    msgpack::zone m_zone;
+#endif // HAVE_MSGPACK
+};
+
+} // Serialization
+} // Ubitrack
+
+#endif //UBITRACK_BUFFERSERIALIZATION_H
@@ -0,0 +1,303 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup serialization
+ * @file
+ * Chunked, memory-mapped recording files for measurement streams
+ */
+
+
+#include "MeasurementRecording.h"
+
+#include <cstring>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+
+namespace Ubitrack {
+namespace Serialization {
+
+namespace {
+
+const char fileMagic[8] = { 'U', 'T', 'R', 'E', 'C', 'O', 'R', 'D' };
+const boost::uint32_t fileVersion = 1;
+const boost::uint32_t byteOrderMark = 0x01020304;
+const boost::uint32_t chunkMagic = 0x4b435455; // "UTCK"
+
+/** followed by the type name, padded to 8 bytes */
+struct FileHeader {
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t byteOrder;
+    boost::uint32_t recordSize;
+    boost::uint32_t nameLength;
+};
+
+/**
+ * followed by the timestamps, the count+1 record offsets relative to the first record
+ * (only for variable-size records) and the records
+ */
+struct ChunkHeader {
+    boost::uint32_t magic;
+    boost::uint32_t count;
+    boost::uint64_t size;
+    boost::uint64_t firstTime;
+    boost::uint64_t lastTime;
+};
+
+inline std::size_t padded(const std::size_t n)
+{
+    return (n+7) & ~std::size_t(7);
+}
+
+/** checks that the record offsets of a chunk start at 0, never decrease and stay within the data */
+bool validOffsets(const boost::uint64_t* offsets, const std::size_t count, const std::size_t dataSize)
+{
+    if (offsets[0]!=0)
+        return false;
+    for (std::size_t i = 0; i<count; i++)
+        if (offsets[i+1]<offsets[i] || offsets[i+1]>dataSize)
+            return false;
+    return true;
+}
+
+} // anonymous namespace
+
+
+RecordingFileWriter::RecordingFileWriter(const std::string& sFilename, const std::string& sTypeName,
+    const boost::uint32_t recordSize, const std::size_t chunkRecords)
+    : m_pFile(0)
+    , m_sFilename(sFilename)
+    , m_recordSize(recordSize)
+    , m_stride(padded(recordSize))
+    , m_chunkRecords(std::max<std::size_t>(chunkRecords, 1))
+    , m_lastTime(0)
+{
+    m_pFile = std::fopen(sFilename.c_str(), "wb");
+    if (!m_pFile)
+        UBITRACK_THROW("Cannot create recording file "+sFilename);
+
+    FileHeader header;
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.byteOrder = byteOrderMark;
+    header.recordSize = recordSize;
+    header.nameLength = static_cast<boost::uint32_t>(sTypeName.size());
+
+    std::vector<char> name(padded(sTypeName.size()), 0);
+    std::copy(sTypeName.begin(), sTypeName.end(), name.begin());
+    if (std::fwrite(&header, sizeof(header), 1, m_pFile)!=1
+        || (!name.empty() && std::fwrite(&name[0], name.size(), 1, m_pFile)!=1)) {
+        std::fclose(m_pFile);
+        m_pFile = 0;
+        UBITRACK_THROW("Cannot write recording file "+sFilename);
+    }
+
+    m_times.reserve(m_chunkRecords);
+    if (m_recordSize)
+        m_data.reserve(m_chunkRecords*m_stride);
+    else
+        m_offsets.reserve(m_chunkRecords+1);
+}
+
+RecordingFileWriter::~RecordingFileWriter()
+{
+    try {
+        close();
+    }
+    catch (...) {
+    }
+}
+
+void RecordingFileWriter::beginRecord(const Measurement::Timestamp t)
+{
+    if (!m_pFile)
+        UBITRACK_THROW("Recording file "+m_sFilename+" is closed");
+    if (t<m_lastTime)
+        UBITRACK_THROW("Recorded measurements must not go back in time");
+    if (m_times.size()>=m_chunkRecords)
+        flush();
+    m_times.push_back(t);
+    m_lastTime = t;
+}
+
+char* RecordingFileWriter::appendFixed(const Measurement::Timestamp t)
+{
+    if (!m_recordSize)
+        UBITRACK_THROW("Recording file "+m_sFilename+" has variable-size records");
+    beginRecord(t);
+    const std::size_t offset = m_data.size();
+    m_data.resize(offset+m_stride);
+    return &m_data[offset];
+}
+
+void RecordingFileWriter::appendVariable(const Measurement::Timestamp t, const char* data, const std::size_t size)
+{
+    if (m_recordSize)
+        UBITRACK_THROW("Recording file "+m_sFilename+" has fixed-size records");
+    beginRecord(t);
+    if (m_offsets.empty())
+        m_offsets.push_back(0);
+    m_data.insert(m_data.end(), data, data+size);
+    m_data.resize(padded(m_data.size()));
+    m_offsets.push_back(m_data.size());
+}
+
+void RecordingFileWriter::flush()
+{
+    if (m_times.empty() || !m_pFile)
+        return;
+
+    ChunkHeader header;
+    header.magic = chunkMagic;
+    header.count = static_cast<boost::uint32_t>(m_times.size());
+    header.size = sizeof(header)+m_times.size()*sizeof(Measurement::Timestamp)
+        +m_offsets.size()*sizeof(boost::uint64_t)+m_data.size();
+    header.firstTime = m_times.front();
+    header.lastTime = m_times.back();
+
+    bool bOk = std::fwrite(&header, sizeof(header), 1, m_pFile)==1
+        && std::fwrite(&m_times[0], sizeof(Measurement::Timestamp), m_times.size(), m_pFile)==m_times.size();
+    if (bOk && !m_offsets.empty())
+        bOk = std::fwrite(&m_offsets[0], sizeof(boost::uint64_t), m_offsets.size(), m_pFile)==m_offsets.size();
+    if (bOk && !m_data.empty())
+        bOk = std::fwrite(&m_data[0], 1, m_data.size(), m_pFile)==m_data.size();
+    // make the chunk visible to readers of the file
+    if (!bOk || std::fflush(m_pFile)!=0)
+        UBITRACK_THROW("Cannot write recording file "+m_sFilename);
+
+    m_times.clear();
+    m_offsets.clear();
+    m_data.clear();
+}
+
+void RecordingFileWriter::close()
+{
+    if (!m_pFile)
+        return;
+    try {
+        flush();
+    }
+    catch (...) {
+        std::fclose(m_pFile);
+        m_pFile = 0;
+        throw;
+    }
+    const int result = std::fclose(m_pFile);
+    m_pFile = 0;
+    if (result!=0)
+        UBITRACK_THROW("Cannot write recording file "+m_sFilename);
+}
+
+
+RecordingFileReader::RecordingFileReader(const std::string& sFilename, const std::string& sTypeName,
+    const boost::uint32_t recordSize)
+    : m_recordSize(recordSize)
+    , m_stride(padded(recordSize))
+    , m_size(0)
+{
+    try {
+        m_pMapping.reset(new boost::interprocess::file_mapping(sFilename.c_str(), boost::interprocess::read_only));
+        m_pRegion.reset(new boost::interprocess::mapped_region(*m_pMapping, boost::interprocess::read_only));
+    }
+    catch (const boost::interprocess::interprocess_exception& e) {
+        UBITRACK_THROW("Cannot map recording file "+sFilename+": "+e.what());
+    }
+
+    const char* pBase = static_cast<const char*>(m_pRegion->get_address());
+    const std::size_t fileSize = m_pRegion->get_size();
+
+    FileHeader header;
+    if (fileSize<sizeof(header))
+        UBITRACK_THROW(sFilename+" is no recording file");
+    std::memcpy(&header, pBase, sizeof(header));
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic))!=0)
+        UBITRACK_THROW(sFilename+" is no recording file");
+    if (header.byteOrder!=byteOrderMark)
+        UBITRACK_THROW("Recording file "+sFilename+" was written with a different byte order");
+    if (header.version!=fileVersion)
+        UBITRACK_THROW("Unsupported version of recording file "+sFilename);
+
+    std::size_t pos = sizeof(header)+padded(header.nameLength);
+    if (pos>fileSize)
+        UBITRACK_THROW("Recording file "+sFilename+" is truncated");
+    if (header.recordSize!=recordSize || std::string(pBase+sizeof(header), header.nameLength)!=sTypeName)
+        UBITRACK_THROW("Recording file "+sFilename+" contains "+std::string(pBase+sizeof(header), header.nameLength)
+            +" instead of "+sTypeName);
+
+    // collect the chunks, stop at a chunk that was not written completely
+    while (pos+sizeof(ChunkHeader)<=fileSize) {
+        ChunkHeader chunkHeader;
+        std::memcpy(&chunkHeader, pBase+pos, sizeof(chunkHeader));
+        const std::size_t indexSize = chunkHeader.count*sizeof(Measurement::Timestamp)
+            +(recordSize ? 0 : (chunkHeader.count+1)*sizeof(boost::uint64_t));
+        if (chunkHeader.magic!=chunkMagic || chunkHeader.count==0 || chunkHeader.size>fileSize-pos
+            || chunkHeader.size<sizeof(chunkHeader)+indexSize || (chunkHeader.size & 7)!=0)
+            break;
+
+        Chunk chunk;
+        chunk.count = chunkHeader.count;
+        chunk.lastTime = chunkHeader.lastTime;
+        chunk.times = reinterpret_cast<const Measurement::Timestamp*>(pBase+pos+sizeof(chunkHeader));
+        chunk.offsets = recordSize ? 0 : reinterpret_cast<const boost::uint64_t*>(chunk.times+chunk.count);
+        chunk.data = pBase+pos+sizeof(chunkHeader)+indexSize;
+
+        const std::size_t dataSize = static_cast<std::size_t>(chunkHeader.size-sizeof(chunkHeader)-indexSize);
+        if (recordSize ? dataSize<chunk.count*m_stride : !validOffsets(chunk.offsets, chunk.count, dataSize))
+            break;
+
+        m_chunks.push_back(chunk);
+        m_size += chunk.count;
+        pos += static_cast<std::size_t>(chunkHeader.size);
+    }
+}
+
+RecordingFileReader::~RecordingFileReader()
+{
+}
+
+namespace {
+
+struct ChunkEndsBefore {
+    template<typename Chunk>
+    bool operator()(const Chunk& chunk, const Measurement::Timestamp t) const
+    { return chunk.lastTime<t; }
+};
+
+} // anonymous namespace
+
+void RecordingFileReader::find(const Measurement::Timestamp t, std::size_t& c, std::size_t& i) const
+{
+    c = std::lower_bound(m_chunks.begin(), m_chunks.end(), t, ChunkEndsBefore())-m_chunks.begin();
+    i = 0;
+    if (c<m_chunks.size()) {
+        const Chunk& chunk(m_chunks[c]);
+        i = std::lower_bound(chunk.times, chunk.times+chunk.count, t)-chunk.times;
+    }
+}
+
+} // Serialization
+} // Ubitrack
@@ -0,0 +1,643 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup serialization
+ * @file
+ * Chunked, memory-mapped recording files for measurement streams
+ */
+
+
+#ifndef UBITRACK_MEASUREMENTRECORDING_H
+#define UBITRACK_MEASUREMENTRECORDING_H
+
+#include "utSerialization/BufferSerialization.h"
+
+#include <utMeasurement/Measurement.h>
+#include <utMeasurement/MeasurementRingBuffer.h>
+#include <utMath/Scalar.h>
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Quaternion.h>
+#include <utMath/Pose.h>
+#include <utMath/ErrorVector.h>
+#include <utMath/ErrorPose.h>
+#include <utMath/RotationVelocity.h>
+#include <utUtil/OS.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <typeinfo>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/type_traits/integral_constant.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/utility.hpp>
+#include <boost/utility/enable_if.hpp>
+
+
+namespace boost { namespace interprocess {
+class file_mapping;
+class mapped_region;
+} }
+
+
+namespace Ubitrack {
+namespace Serialization {
+
+/**
+ * \brief Layout of the payload type \c T in recording files.
+ *
+ * Fixed-size types derive from \c Detail::FlatRecord and are stored as flat arrays of their
+ * scalar type, which can be read in place from the mapped file. All other types are stored
+ * as boost binary archives of variable size; their type name comes from \c typeid and is
+ * only portable between builds of the same compiler.
+ */
+template<typename T, typename Enable = void>
+struct RecordTraits {
+    static const bool fixedSize = false;
+    static const boost::uint32_t size = 0;
+
+    static std::string name()
+    { return std::string("archive:")+typeid(T).name(); }
+};
+
+
+namespace Detail {
+
+/** a record of \c Count values of the arithmetic type \c S */
+template<typename S, std::size_t Count>
+struct FlatRecord {
+    typedef S scalar_type;
+    static const bool fixedSize = true;
+    static const std::size_t count = Count;
+    static const boost::uint32_t size = static_cast<boost::uint32_t>(Count*sizeof(S));
+
+    /** e.g. "Pose:7x8", the layout is identified by kind, count and scalar size */
+    static std::string layoutName(const char* kind)
+    {
+        std::ostringstream s;
+        s << kind << ":" << Count << "x" << sizeof(S);
+        return s.str();
+    }
+};
+
+} // Detail
+
+
+template<typename T>
+struct RecordTraits<Math::Scalar<T>, typename boost::enable_if<boost::is_arithmetic<T> >::type>
+    : public Detail::FlatRecord<T, 1> {
+    static std::string name()
+    { return Detail::FlatRecord<T, 1>::layoutName("Scalar"); }
+
+    static void write(const Math::Scalar<T>& v, T* p)
+    { p[0] = v.m_value; }
+
+    static void read(const T* p, Math::Scalar<T>& v)
+    { v.m_value = p[0]; }
+};
+
+template<typename T, std::size_t N>
+struct RecordTraits<Math::Vector<T, N>, typename boost::enable_if_c<(N>0) && boost::is_arithmetic<T>::value>::type>
+    : public Detail::FlatRecord<T, N> {
+    static std::string name()
+    { return Detail::FlatRecord<T, N>::layoutName("Vector"); }
+
+    static void write(const Math::Vector<T, N>& v, T* p)
+    { std::copy(v.begin(), v.end(), p); }
+
+    static void read(const T* p, Math::Vector<T, N>& v)
+    { std::copy(p, p+N, v.begin()); }
+};
+
+/** matrices are stored in column-major order, like in memory */
+template<typename T, std::size_t M, std::size_t N>
+struct RecordTraits<Math::Matrix<T, M, N>, typename boost::enable_if_c<(M>0) && (N>0) && boost::is_arithmetic<T>::value>::type>
+    : public Detail::FlatRecord<T, M*N> {
+    static std::string name()
+    {
+        std::ostringstream s;
+        s << "Matrix" << M << "x" << N;
+        return Detail::FlatRecord<T, M*N>::layoutName(s.str().c_str());
+    }
+
+    static void write(const Math::Matrix<T, M, N>& m, T* p)
+    {
+        for (std::size_t j = 0; j<N; j++)
+            for (std::size_t i = 0; i<M; i++)
+                *p++ = m(i, j);
+    }
+
+    static void read(const T* p, Math::Matrix<T, M, N>& m)
+    {
+        for (std::size_t j = 0; j<N; j++)
+            for (std::size_t i = 0; i<M; i++)
+                m(i, j) = *p++;
+    }
+};
+
+/** x, y, z, w */
+template<>
+struct RecordTraits<Math::Quaternion>
+    : public Detail::FlatRecord<double, 4> {
+    static std::string name()
+    { return layoutName("Quaternion"); }
+
+    static void write(const Math::Quaternion& q, double* p)
+    {
+        p[0] = q.x(); p[1] = q.y(); p[2] = q.z(); p[3] = q.w();
+    }
+
+    static void read(const double* p, Math::Quaternion& q)
+    { q = Math::Quaternion(p[0], p[1], p[2], p[3]); }
+};
+
+template<>
+struct RecordTraits<Math::RotationVelocity>
+    : public Detail::FlatRecord<double, 3> {
+    static std::string name()
+    { return layoutName("RotationVelocity"); }
+
+    static void write(const Math::RotationVelocity& v, double* p)
+    { std::copy(v.begin(), v.end(), p); }
+
+    static void read(const double* p, Math::RotationVelocity& v)
+    { v = Math::RotationVelocity(p[0], p[1], p[2]); }
+};
+
+/** tx, ty, tz, qx, qy, qz, qw as in \c Pose::toVector */
+template<>
+struct RecordTraits<Math::Pose>
+    : public Detail::FlatRecord<double, 7> {
+    static std::string name()
+    { return layoutName("Pose"); }
+
+    static void write(const Math::Pose& pose, double* p)
+    {
+        std::copy(pose.translation().begin(), pose.translation().end(), p);
+        RecordTraits<Math::Quaternion>::write(pose.rotation(), p+3);
+    }
+
+    static void read(const double* p, Math::Pose& pose)
+    {
+        Math::Quaternion q;
+        RecordTraits<Math::Quaternion>::read(p+3, q);
+        pose = Math::Pose(q, Math::Vector<double, 3>(p[0], p[1], p[2]));
+    }
+};
+
+/** the value followed by the column-major covariance */
+template<typename T, std::size_t N>
+struct RecordTraits<Math::ErrorVector<T, N>, typename boost::enable_if_c<(N>0) && boost::is_arithmetic<T>::value>::type>
+    : public Detail::FlatRecord<T, N+N*N> {
+    static std::string name()
+    { return Detail::FlatRecord<T, N+N*N>::layoutName("ErrorVector"); }
+
+    static void write(const Math::ErrorVector<T, N>& v, T* p)
+    {
+        RecordTraits<Math::Vector<T, N> >::write(v.value, p);
+        RecordTraits<Math::Matrix<T, N, N> >::write(v.covariance, p+N);
+    }
+
+    static void read(const T* p, Math::ErrorVector<T, N>& v)
+    {
+        RecordTraits<Math::Vector<T, N> >::read(p, v.value);
+        RecordTraits<Math::Matrix<T, N, N> >::read(p+N, v.covariance);
+    }
+};
+
+/** the pose followed by the column-major 6x6 covariance */
+template<>
+struct RecordTraits<Math::ErrorPose>
+    : public Detail::FlatRecord<double, 7+36> {
+    static std::string name()
+    { return layoutName("ErrorPose"); }
+
+    static void write(const Math::ErrorPose& pose, double* p)
+    {
+        RecordTraits<Math::Pose>::write(pose, p);
+        RecordTraits<Math::Matrix<double, 6, 6> >::write(pose.covariance(), p+7);
+    }
+
+    static void read(const double* p, Math::ErrorPose& pose)
+    {
+        Math::Pose base;
+        Math::Matrix<double, 6, 6> covariance;
+        RecordTraits<Math::Pose>::read(p, base);
+        RecordTraits<Math::Matrix<double, 6, 6> >::read(p+7, covariance);
+        pose = Math::ErrorPose(base, covariance);
+    }
+};
+
+
+/**
+ * \brief Appends chunks of records to a recording file.
+ *
+ * A recording file starts with a header that identifies the record layout and is followed
+ * by chunks. Each chunk has a header with the number of records and their time range, the
+ * sorted timestamps of its records, for variable-size records their offsets, and the records
+ * themselves, each aligned to 8 bytes. Chunks are collected in memory and appended with one
+ * write, so a file cut off by a crash loses at most the incomplete chunk.
+ *
+ * Records must be appended in non-decreasing timestamp order. Files are written in the byte
+ * order of the machine.
+ */
+class UBITRACK_EXPORT RecordingFileWriter
+    : private boost::noncopyable {
+public:
+    /**
+     * Creates or truncates the file and writes the header.
+     * @param recordSize size of fixed-size records, 0 for variable-size records
+     * @param chunkRecords maximum number of records per chunk
+     */
+    RecordingFileWriter(const std::string& sFilename, const std::string& sTypeName,
+        const boost::uint32_t recordSize, const std::size_t chunkRecords = 1024);
+
+    /** writes the pending records and closes the file */
+    ~RecordingFileWriter();
+
+    /** @return space for a fixed-size record in the current chunk, valid until the next call */
+    char* appendFixed(const Measurement::Timestamp t);
+
+    /** copies a variable-size record into the current chunk */
+    void appendVariable(const Measurement::Timestamp t, const char* data, const std::size_t size);
+
+    /** appends the current chunk to the file, if it is not empty */
+    void flush();
+
+    /** flushes and closes the file */
+    void close();
+
+    /** @return number of records in the current chunk */
+    std::size_t pending() const
+    { return m_times.size(); }
+
+    /** @return timestamp of the last appended record, 0 if there is none */
+    Measurement::Timestamp lastTime() const
+    { return m_lastTime; }
+
+protected:
+    void beginRecord(const Measurement::Timestamp t);
+
+    std::FILE* m_pFile;
+    const std::string m_sFilename;
+    const boost::uint32_t m_recordSize;
+    const std::size_t m_stride;
+    const std::size_t m_chunkRecords;
+    Measurement::Timestamp m_lastTime;
+
+    std::vector<Measurement::Timestamp> m_times;
+    std::vector<boost::uint64_t> m_offsets;
+    std::vector<char> m_data;
+};
+
+
+/**
+ * \brief Read access to a memory-mapped recording file.
+ *
+ * Only the chunk headers are read when the file is opened. Records are addressed by chunk
+ * and index and point directly into the mapping. A truncated last chunk is ignored.
+ */
+class UBITRACK_EXPORT RecordingFileReader
+    : private boost::noncopyable {
+public:
+    /** maps the file, throws if it is no recording of the given record layout */
+    RecordingFileReader(const std::string& sFilename, const std::string& sTypeName, const boost::uint32_t recordSize);
+    ~RecordingFileReader();
+
+    /** @return total number of records */
+    std::size_t size() const
+    { return m_size; }
+
+    /** @return number of chunks */
+    std::size_t chunks() const
+    { return m_chunks.size(); }
+
+    /** @return number of records in a chunk */
+    std::size_t chunkSize(const std::size_t c) const
+    { return m_chunks[c].count; }
+
+    Measurement::Timestamp time(const std::size_t c, const std::size_t i) const
+    { return m_chunks[c].times[i]; }
+
+    const char* data(const std::size_t c, const std::size_t i) const
+    {
+        const Chunk& chunk(m_chunks[c]);
+        return chunk.data+(chunk.offsets ? chunk.offsets[i] : i*m_stride);
+    }
+
+    std::size_t dataSize(const std::size_t c, const std::size_t i) const
+    {
+        const Chunk& chunk(m_chunks[c]);
+        return chunk.offsets ? static_cast<std::size_t>(chunk.offsets[i+1]-chunk.offsets[i]) : m_recordSize;
+    }
+
+    /**
+     * Finds the first record with a timestamp not before \c t with two binary searches.
+     * Sets \c c to \c chunks() if there is none.
+     */
+    void find(const Measurement::Timestamp t, std::size_t& c, std::size_t& i) const;
+
+protected:
+    struct Chunk {
+        const Measurement::Timestamp* times;
+        const boost::uint64_t* offsets;
+        const char* data;
+        std::size_t count;
+        Measurement::Timestamp lastTime;
+    };
+
+    boost::scoped_ptr<boost::interprocess::file_mapping> m_pMapping;
+    boost::scoped_ptr<boost::interprocess::mapped_region> m_pRegion;
+    boost::uint32_t m_recordSize;
+    std::size_t m_stride;
+    std::size_t m_size;
+    std::vector<Chunk> m_chunks;
+};
+
+
+/**
+ * \brief Records a measurement stream from a producer thread.
+ *
+ * \c push() only copies the measurement into a preallocated lock-free ring buffer, so it
+ * never blocks on the file system. A background thread encodes the measurements into chunks
+ * and appends them to the file. If the ring buffer is full, measurements are dropped and
+ * counted. Partially filled chunks are written after \c maxChunkAge seconds, which bounds
+ * the delay until a measurement reaches the file.
+ *
+ * Measurements must be pushed by one thread in non-decreasing timestamp order, measurements
+ * that are older than their predecessor are dropped.
+ */
+template<typename T>
+class RecordingWriter
+    : private boost::noncopyable {
+public:
+    typedef RecordTraits<T> Traits;
+
+    /**
+     * Creates the file and starts the writer thread.
+     * @param chunkRecords maximum number of records per chunk
+     * @param queueCapacity number of measurements that can be buffered between the threads
+     * @param maxChunkAge maximum time in seconds a measurement is held in a partial chunk
+     * @param prototype value the buffered payloads are initialized with. Each slot keeps the
+     *   storage of its payload, so for \c std::vector payloads a prototype with reserved
+     *   capacity for the largest expected record avoids allocations in \c push().
+     */
+    explicit RecordingWriter(const std::string& sFilename, const std::size_t chunkRecords = 1024,
+        const std::size_t queueCapacity = 4096, const double maxChunkAge = 1.0, const T& prototype = T())
+        : m_file(sFilename, Traits::name(), Traits::size, chunkRecords)
+        , m_queue(queueCapacity, prototype)
+        , m_maxChunkAge(static_cast<Measurement::Timestamp>(maxChunkAge*1e9))
+        , m_bStop(false)
+        , m_written(0)
+        , m_outOfOrder(0)
+    {
+        m_thread.reset(new boost::thread(boost::bind(&RecordingWriter::run, this)));
+    }
+
+    /** writes all pushed measurements, errors are only reported by \c close() */
+    ~RecordingWriter()
+    {
+        try {
+            close();
+        }
+        catch (...) {
+        }
+    }
+
+    /**
+     * Copies a measurement into the queue, reusing the storage of the slot.
+     * @return \c false if it was dropped
+     */
+    bool push(const Measurement::Timestamp t, const T& value)
+    { return m_queue.push(t, value); }
+
+    bool push(const Measurement::Measurement<T>& m)
+    { return m_queue.push(m); }
+
+    /**
+     * Writes all pushed measurements and closes the file.
+     * Throws if the writer thread failed.
+     */
+    void close()
+    {
+        if (m_thread) {
+            m_bStop.store(true, boost::memory_order_release);
+            m_thread->join();
+            m_thread.reset();
+        }
+        if (!m_sError.empty())
+            UBITRACK_THROW("Recording failed: "+m_sError);
+    }
+
+    /** @return number of measurements written to the file or to the current chunk */
+    boost::uint64_t written() const
+    { return m_written.load(boost::memory_order_relaxed); }
+
+    /** @return number of measurements dropped because the queue was full or they were out of order */
+    boost::uint64_t dropped() const
+    { return m_queue.dropped()+m_outOfOrder.load(boost::memory_order_relaxed); }
+
+protected:
+    typedef Measurement::MeasurementRingBuffer<T, Measurement::SingleProducer> Queue;
+
+    void run()
+    {
+        try {
+            Measurement::Timestamp chunkStart = 0;
+            while (true) {
+                // measurements pushed before the stop request are in the view
+                const bool bStop = m_bStop.load(boost::memory_order_acquire);
+                const typename Queue::View v(m_queue.view());
+                for (std::size_t i = 0; i<v.size(); i++) {
+                    if (v.time(i)<m_file.lastTime()) {
+                        m_outOfOrder.fetch_add(1, boost::memory_order_relaxed);
+                        continue;
+                    }
+                    if (!m_file.pending())
+                        chunkStart = Measurement::now();
+                    appendRecord(v.time(i), v[i], boost::integral_constant<bool, Traits::fixedSize>());
+                    m_written.fetch_add(1, boost::memory_order_relaxed);
+                }
+                m_queue.consume(v.size());
+
+                if (v.empty()) {
+                    if (bStop)
+                        break;
+                    if (m_file.pending() && Measurement::now()-chunkStart>=m_maxChunkAge)
+                        m_file.flush();
+                    Util::sleep(1);
+                }
+            }
+            m_file.close();
+        }
+        catch (const std::exception& e) {
+            m_sError = e.what();
+        }
+    }
+
+    void appendRecord(const Measurement::Timestamp t, const T& value, boost::true_type)
+    {
+        Traits::write(value, reinterpret_cast<typename Traits::scalar_type*>(m_file.appendFixed(t)));
+    }
+
+    void appendRecord(const Measurement::Timestamp t, const T& value, boost::false_type)
+    {
+        m_buf.writeToInternal();
+        Detail::saveArchive(PROTOCOL_BOOST_BINARY, m_buf, value);
+        m_file.appendVariable(t, m_buf.data(), m_buf.written());
+    }
+
+    RecordingFileWriter m_file;
+    Queue m_queue;
+    BufferStreamBuf m_buf;
+    const Measurement::Timestamp m_maxChunkAge;
+    boost::atomic<bool> m_bStop;
+    boost::atomic<boost::uint64_t> m_written;
+    boost::atomic<boost::uint64_t> m_outOfOrder;
+    std::string m_sError;
+    boost::scoped_ptr<boost::thread> m_thread;
+};
+
+
+/**
+ * \brief Random access to a recorded measurement stream.
+ *
+ * The file is memory-mapped. \c seek() finds a timestamp with a binary search over the chunks
+ * and one within the chunk. Iterators give access to the timestamps and the raw records
+ * without copying; fixed-size records can be read in place as arrays of
+ * \c RecordTraits<T>::scalar_type, values are decoded on demand.
+ */
+template<typename T>
+class RecordingReader
+    : private boost::noncopyable {
+public:
+    typedef RecordTraits<T> Traits;
+
+    /** forward iterator over the records of a recording */
+    class const_iterator {
+    public:
+        const_iterator()
+            : m_pFile(0)
+            , m_chunk(0)
+            , m_index(0)
+        {}
+
+        Measurement::Timestamp time() const
+        { return m_pFile->time(m_chunk, m_index); }
+
+        /** @return the record in the mapped file */
+        const char* data() const
+        { return m_pFile->data(m_chunk, m_index); }
+
+        std::size_t dataSize() const
+        { return m_pFile->dataSize(m_chunk, m_index); }
+
+        /** decodes the record */
+        void value(T& t) const
+        { readRecord(t, boost::integral_constant<bool, Traits::fixedSize>()); }
+
+        Measurement::Measurement<T> measurement() const
+        {
+            Measurement::Measurement<T> m(time(), T());
+            value(*m);
+            return m;
+        }
+
+        const_iterator& operator++()
+        {
+            if (++m_index==m_pFile->chunkSize(m_chunk)) {
+                m_chunk++;
+                m_index = 0;
+            }
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const
+        { return m_chunk==other.m_chunk && m_index==other.m_index; }
+
+        bool operator!=(const const_iterator& other) const
+        { return !(*this==other); }
+
+    protected:
+        friend class RecordingReader;
+
+        const_iterator(const RecordingFileReader* pFile, const std::size_t chunk, const std::size_t index)
+            : m_pFile(pFile)
+            , m_chunk(chunk)
+            , m_index(index)
+        {}
+
+        void readRecord(T& t, boost::true_type) const
+        { Traits::read(reinterpret_cast<const typename Traits::scalar_type*>(data()), t); }
+
+        void readRecord(T& t, boost::false_type) const
+        { deserialize(PROTOCOL_BOOST_BINARY, data(), dataSize(), t); }
+
+        const RecordingFileReader* m_pFile;
+        std::size_t m_chunk;
+        std::size_t m_index;
+    };
+
+    /** maps the file, throws if it is no recording of \c T */
+    explicit RecordingReader(const std::string& sFilename)
+        : m_file(sFilename, Traits::name(), Traits::size)
+    {}
+
+    /** @return number of recorded measurements */
+    std::size_t size() const
+    { return m_file.size(); }
+
+    bool empty() const
+    { return m_file.size()==0; }
+
+    const_iterator begin() const
+    { return const_iterator(&m_file, 0, 0); }
+
+    const_iterator end() const
+    { return const_iterator(&m_file, m_file.chunks(), 0); }
+
+    /** @return the first measurement with a timestamp not before \c t, in O(log n) */
+    const_iterator seek(const Measurement::Timestamp t) const
+    {
+        std::size_t c, i;
+        m_file.find(t, c, i);
+        return const_iterator(&m_file, c, i);
+    }
+
+protected:
+    RecordingFileReader m_file;
+};
+
+} // Serialization
+} // Ubitrack
+
+#endif //UBITRACK_MEASUREMENTRECORDING_H
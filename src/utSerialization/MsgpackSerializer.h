@@ -41,9 +41,18 @@
 
 #include "utMeasurement/Measurement.h"
 
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
 #include <boost/array.hpp>
 #include <boost/call_traits.hpp>
 #include <boost/utility/enable_if.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_signed.hpp>
+#include <boost/predef/other/endian.h>
 
 #ifdef HAVE_MSGPACK
 
@@ -53,6 +62,488 @@ namespace Ubitrack {
 namespace Serialization {
 namespace MsgpackArchive {
 
+/**
+ * Msgpack ext type of the bulk encoding of numeric arrays.
+ *
+ * Vectors, matrices and lists of fixed-size vectors and poses are written as one ext object, whose
+ * payload is a small header followed by the elements as contiguous little-endian data:
+ * - byte 0: element type, kind in the high nibble (1 float, 2 signed, 3 unsigned), size in bytes in the low nibble
+ *   (1, 2, 4 or 8, floats 4 or 8), other codes are rejected
+ * - byte 1: rank (1 for vectors, 2 for matrices and lists)
+ * - byte 2: flags, bit 0 is set if a matrix is stored column-major
+ * - byte 3: reserved, 0
+ * - rank x uint32: dimensions
+ * Lists of poses are stored as n x 7 arrays in the order of \c Math::Pose::toVector.
+ *
+ * Readers also accept the per-element array encoding of older versions. Define 
+ * UBITRACK_MSGPACK_ARRAY_ENCODING to also write it, for peers that cannot read the bulk encoding.
+ */
+const int8_t bulkExtType = 42;
+
+namespace Detail {
+
+/** element type code of the bulk encoding */
+template< typename T >
+struct BulkTypeCode
+{
+	BOOST_STATIC_ASSERT( boost::is_arithmetic< T >::value );
+	static const uint8_t value = ( boost::is_floating_point< T >::value ? 0x10 : ( boost::is_signed< T >::value ? 0x20 : 0x30 ) ) | sizeof( T );
+};
+
+enum { bulkColumnMajor = 1 };
+
+/** payload size of a bulk encoded array */
+inline uint32_t bulkSize( std::size_t rank, std::size_t nElements, std::size_t elementSize )
+{
+	const std::size_t size = 4 + 4 * rank + nElements * elementSize;
+	if ( size > 0xffffffffu )
+		throw msgpack::type_error();
+	return static_cast< uint32_t >( size );
+}
+
+/** appends to the ext object that is currently packed */
+template< typename Stream >
+struct PackerSink
+{
+	explicit PackerSink( msgpack::packer< Stream >& o )
+		: packer( o )
+	{}
+
+	void append( const char* p, std::size_t n )
+	{ packer.pack_ext_body( p, static_cast< uint32_t >( n ) ); }
+
+	msgpack::packer< Stream >& packer;
+};
+
+/** appends to an ext object allocated in a zone */
+struct MemorySink
+{
+	explicit MemorySink( char* p )
+		: pos( p )
+	{}
+
+	void append( const char* p, std::size_t n )
+	{ std::memcpy( pos, p, n ); pos += n; }
+
+	char* pos;
+};
+
+/** appends elements in little-endian byte order */
+template< typename Sink, typename T >
+void appendElements( Sink& sink, const T* p, std::size_t n )
+{
+#if BOOST_ENDIAN_BIG_BYTE
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		char swapped[ sizeof( T ) ];
+		const char* bytes = reinterpret_cast< const char* >( p + i );
+		std::reverse_copy( bytes, bytes + sizeof( T ), swapped );
+		sink.append( swapped, sizeof( T ) );
+	}
+#else
+	sink.append( reinterpret_cast< const char* >( p ), n * sizeof( T ) );
+#endif
+}
+
+/** copies little-endian elements into native storage */
+template< typename T >
+void loadElements( const char* p, T* dest, std::size_t n )
+{
+#if BOOST_ENDIAN_BIG_BYTE
+	for ( std::size_t i = 0; i < n; i++ )
+		std::reverse_copy( p + i * sizeof( T ), p + ( i + 1 ) * sizeof( T ), reinterpret_cast< char* >( dest + i ) );
+#else
+	std::memcpy( dest, p, n * sizeof( T ) );
+#endif
+}
+
+/** loads elements of a different type */
+template< typename S, typename T >
+void loadConverted( const char* p, T* dest, std::size_t n )
+{
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		S s;
+		loadElements( p + i * sizeof( S ), &s, 1 );
+		dest[ i ] = static_cast< T >( s );
+	}
+}
+
+/** size in bytes of the elements of a type code, 0 if the code is unknown */
+inline std::size_t bulkElementSize( uint8_t code )
+{
+	switch ( code )
+	{
+		case 0x14: case 0x24: case 0x34: return 4;
+		case 0x18: case 0x28: case 0x38: return 8;
+		case 0x21: case 0x31: return 1;
+		case 0x22: case 0x32: return 2;
+		default: return 0;
+	}
+}
+
+/** loads n elements of the given type code, a single copy if the types match */
+template< typename T >
+void loadBulk( uint8_t code, const char* p, T* dest, std::size_t n )
+{
+	if ( code == BulkTypeCode< T >::value )
+	{
+		loadElements( p, dest, n );
+		return;
+	}
+
+	switch ( code )
+	{
+		case 0x14: loadConverted< float >( p, dest, n ); break;
+		case 0x18: loadConverted< double >( p, dest, n ); break;
+		case 0x21: loadConverted< int8_t >( p, dest, n ); break;
+		case 0x22: loadConverted< int16_t >( p, dest, n ); break;
+		case 0x24: loadConverted< int32_t >( p, dest, n ); break;
+		case 0x28: loadConverted< int64_t >( p, dest, n ); break;
+		case 0x31: loadConverted< uint8_t >( p, dest, n ); break;
+		case 0x32: loadConverted< uint16_t >( p, dest, n ); break;
+		case 0x34: loadConverted< uint32_t >( p, dest, n ); break;
+		case 0x38: loadConverted< uint64_t >( p, dest, n ); break;
+		default: throw msgpack::type_error();
+	}
+}
+
+/** writes the header of a bulk encoded array */
+template< typename T, typename Sink >
+void appendHeader( Sink& sink, uint8_t rank, uint8_t flags, uint32_t dim0, uint32_t dim1 = 0 )
+{
+	const char header[ 12 ] = { 
+		char( BulkTypeCode< T >::value ), char( rank ), char( flags ), 0, 
+		char( dim0 ), char( dim0 >> 8 ), char( dim0 >> 16 ), char( dim0 >> 24 ),
+		char( dim1 ), char( dim1 >> 8 ), char( dim1 >> 16 ), char( dim1 >> 24 ) };
+	sink.append( header, 4 + 4 * rank );
+}
+
+/** header of a received bulk encoded array */
+struct BulkHeader
+{
+	/**
+	 * parses the header and checks the type code and the payload size, throws msgpack::type_error.
+	 * The dimensions are bounded by the payload, so they can be used to size containers.
+	 */
+	BulkHeader( const msgpack::object& o, uint8_t expectedRank )
+	{
+		if ( o.type != msgpack::type::EXT || o.via.ext.type() != bulkExtType || o.via.ext.size < 4 )
+			throw msgpack::type_error();
+		const unsigned char* p = reinterpret_cast< const unsigned char* >( o.via.ext.data() );
+		code = p[ 0 ];
+		flags = p[ 2 ];
+		elementSize = bulkElementSize( code );
+		if ( elementSize == 0 || p[ 1 ] != expectedRank || o.via.ext.size < 4u + 4u * expectedRank )
+			throw msgpack::type_error();
+
+		const std::size_t payload = o.via.ext.size - 4u - 4u * expectedRank;
+		if ( payload % elementSize != 0 )
+			throw msgpack::type_error();
+		const std::size_t capacity = payload / elementSize;
+
+		// multiply without overflow, no dimension may exceed the payload
+		std::size_t nElements = 1;
+		for ( std::size_t i = 0; i < expectedRank; i++ )
+		{
+			const unsigned char* d = p + 4 + 4 * i;
+			dims[ i ] = uint32_t( d[ 0 ] ) | ( uint32_t( d[ 1 ] ) << 8 ) | ( uint32_t( d[ 2 ] ) << 16 ) | ( uint32_t( d[ 3 ] ) << 24 );
+			if ( dims[ i ] != 0 && nElements > capacity / dims[ i ] )
+				throw msgpack::type_error();
+			nElements *= dims[ i ];
+		}
+		if ( nElements != capacity )
+			throw msgpack::type_error();
+		data = o.via.ext.data() + 4 + 4 * expectedRank;
+	}
+
+	uint8_t code;
+	uint8_t flags;
+	uint32_t dims[ 2 ];
+	std::size_t elementSize;
+	const char* data;
+};
+
+/** allocates an ext object in a zone and returns a sink for its payload */
+inline MemorySink zoneSink( msgpack::object::with_zone& o, uint32_t size )
+{
+	char* p = static_cast< char* >( o.zone.allocate_align( size + 1 ) );
+	p[ 0 ] = static_cast< char >( bulkExtType );
+	o.type = msgpack::type::EXT;
+	o.via.ext.ptr = p;
+	o.via.ext.size = size;
+	return MemorySink( p + 1 );
+}
+
+
+// vectors
+
+template< typename T, std::size_t N >
+uint32_t bulkSize( const Math::Vector< T, N >& v )
+{ return bulkSize( 1, v.size(), sizeof( T ) ); }
+
+template< typename Sink, typename T, std::size_t N >
+void appendBulk( Sink& sink, const Math::Vector< T, N >& v )
+{
+	appendHeader< T >( sink, 1, 0, static_cast< uint32_t >( v.size() ) );
+	appendElements( sink, v.data().begin(), v.size() );
+}
+
+template< typename T, std::size_t N >
+void loadBulk( const msgpack::object& o, Math::Vector< T, N >& v )
+{
+	const BulkHeader h( o, 1 );
+	if ( N == 0 )
+		v.resize( h.dims[ 0 ], false );
+	else if ( h.dims[ 0 ] != N )
+		throw msgpack::type_error();
+	loadBulk( h.code, h.data, v.data().begin(), v.size() );
+}
+
+
+// matrices, stored column-major like Math::Matrix
+
+template< typename T, std::size_t M, std::size_t N >
+uint32_t bulkSize( const Math::Matrix< T, M, N >& m )
+{ return bulkSize( 2, m.size1() * m.size2(), sizeof( T ) ); }
+
+template< typename Sink, typename T, std::size_t M, std::size_t N >
+void appendBulk( Sink& sink, const Math::Matrix< T, M, N >& m )
+{
+	appendHeader< T >( sink, 2, bulkColumnMajor, static_cast< uint32_t >( m.size1() ), static_cast< uint32_t >( m.size2() ) );
+	appendElements( sink, m.data().begin(), m.size1() * m.size2() );
+}
+
+template< typename T, std::size_t M, std::size_t N >
+void loadBulk( const msgpack::object& o, Math::Matrix< T, M, N >& m )
+{
+	const BulkHeader h( o, 2 );
+	if ( M == 0 || N == 0 )
+		m.resize( h.dims[ 0 ], h.dims[ 1 ], false );
+	else if ( h.dims[ 0 ] != M || h.dims[ 1 ] != N )
+		throw msgpack::type_error();
+
+	if ( h.flags & bulkColumnMajor )
+		loadBulk( h.code, h.data, m.data().begin(), m.size1() * m.size2() );
+	else
+		for ( std::size_t i = 0; i < m.size1(); i++ )
+			for ( std::size_t j = 0; j < m.size2(); j++ )
+				loadBulk( h.code, h.data + ( i * m.size2() + j ) * h.elementSize, &m( i, j ), 1 );
+}
+
+
+// lists of vectors, stored as n x N arrays
+
+template< typename T, std::size_t N, typename Alloc >
+bool isBulkList( const std::vector< Math::Vector< T, N >, Alloc >& l )
+{
+	// dynamic vectors need a common, non-zero size
+	if ( !l.empty() && l[ 0 ].size() == 0 )
+		return false;
+	for ( std::size_t i = 1; i < l.size(); i++ )
+		if ( l[ i ].size() != l[ 0 ].size() )
+			return false;
+	return true;
+}
+
+template< typename T, std::size_t N, typename Alloc >
+uint32_t bulkSize( const std::vector< Math::Vector< T, N >, Alloc >& l )
+{ return bulkSize( 2, l.size() * ( l.empty() ? N : l[ 0 ].size() ), sizeof( T ) ); }
+
+template< typename Sink, typename T, std::size_t N, typename Alloc >
+void appendBulk( Sink& sink, const std::vector< Math::Vector< T, N >, Alloc >& l )
+{
+	appendHeader< T >( sink, 2, 0, static_cast< uint32_t >( l.size() ), static_cast< uint32_t >( l.empty() ? N : l[ 0 ].size() ) );
+	for ( std::size_t i = 0; i < l.size(); i++ )
+		appendElements( sink, l[ i ].data().begin(), l[ i ].size() );
+}
+
+template< typename T, std::size_t N, typename Alloc >
+void loadBulk( const msgpack::object& o, std::vector< Math::Vector< T, N >, Alloc >& l )
+{
+	const BulkHeader h( o, 2 );
+	// empty rows would leave the number of rows unbounded by the payload
+	if ( ( N != 0 && h.dims[ 1 ] != N ) || ( h.dims[ 1 ] == 0 && h.dims[ 0 ] != 0 ) )
+		throw msgpack::type_error();
+	l.resize( h.dims[ 0 ] );
+	for ( std::size_t i = 0; i < l.size(); i++ )
+	{
+		if ( N == 0 )
+			l[ i ].resize( h.dims[ 1 ], false );
+		loadBulk( h.code, h.data + i * h.dims[ 1 ] * h.elementSize, l[ i ].data().begin(), h.dims[ 1 ] );
+	}
+}
+
+
+// lists of poses, stored as n x 7 arrays
+
+template< typename Alloc >
+uint32_t bulkSize( const std::vector< Math::Pose, Alloc >& l )
+{ return bulkSize( 2, l.size() * 7, sizeof( double ) ); }
+
+template< typename Sink, typename Alloc >
+void appendBulk( Sink& sink, const std::vector< Math::Pose, Alloc >& l )
+{
+	appendHeader< double >( sink, 2, 0, static_cast< uint32_t >( l.size() ), 7 );
+	Math::Vector< double, 7 > v;
+	for ( std::size_t i = 0; i < l.size(); i++ )
+	{
+		l[ i ].toVector( v );
+		appendElements( sink, v.data().begin(), 7 );
+	}
+}
+
+template< typename Alloc >
+void loadBulk( const msgpack::object& o, std::vector< Math::Pose, Alloc >& l )
+{
+	const BulkHeader h( o, 2 );
+	if ( h.dims[ 1 ] != 7 )
+		throw msgpack::type_error();
+	l.resize( h.dims[ 0 ] );
+	Math::Vector< double, 7 > v;
+	for ( std::size_t i = 0; i < l.size(); i++ )
+	{
+		loadBulk( h.code, h.data + i * 7 * h.elementSize, v.data().begin(), 7 );
+		l[ i ] = Math::Pose::fromVector( v );
+	}
+}
+
+
+/** packs an object with the bulk encoding */
+template< typename Stream, typename T >
+void packBulk( msgpack::packer< Stream >& o, const T& v )
+{
+	o.pack_ext( bulkSize( v ), bulkExtType );
+	PackerSink< Stream > sink( o );
+	appendBulk( sink, v );
+}
+
+/** creates a zone allocated object with the bulk encoding */
+template< typename T >
+void objectBulk( msgpack::object::with_zone& o, const T& v )
+{
+	MemorySink sink( zoneSink( o, bulkSize( v ) ) );
+	appendBulk( sink, v );
+}
+
+
+// upper bounds of the packed size: at most 9 bytes per number, 5 per array and 6 per ext header
+
+template< typename T >
+uint32_t maxPackedSize( const T&, typename boost::enable_if< boost::is_arithmetic< T > >::type* = 0 );
+template< typename T >
+uint32_t maxPackedSize( const Math::Scalar< T >& s );
+template< typename T, std::size_t N >
+uint32_t maxPackedSize( const Math::Vector< T, N >& v );
+template< typename T, std::size_t M, std::size_t N >
+uint32_t maxPackedSize( const Math::Matrix< T, M, N >& m );
+inline uint32_t maxPackedSize( const Math::Quaternion& q );
+inline uint32_t maxPackedSize( const Math::RotationVelocity& v );
+inline uint32_t maxPackedSize( const Math::Pose& p );
+template< typename T, std::size_t N >
+uint32_t maxPackedSize( const Math::ErrorVector< T, N >& v );
+inline uint32_t maxPackedSize( const Math::ErrorPose& p );
+template< typename T >
+uint32_t maxPackedSize( const Math::CameraIntrinsics< T >& c );
+template< typename T, typename Alloc >
+uint32_t maxPackedSize( const std::vector< T, Alloc >& l );
+template< typename T, std::size_t N, typename Alloc >
+uint32_t maxPackedSize( const std::vector< Math::Vector< T, N >, Alloc >& l );
+template< typename Alloc >
+uint32_t maxPackedSize( const std::vector< Math::Pose, Alloc >& l );
+template< typename T >
+uint32_t maxPackedSize( const Measurement::Measurement< T >& m );
+
+template< typename T >
+uint32_t maxPackedSize( const T&, typename boost::enable_if< boost::is_arithmetic< T > >::type* )
+{ return 9; }
+
+template< typename T >
+uint32_t maxPackedSize( const Math::Scalar< T >& s )
+{ return maxPackedSize( s.m_value ); }
+
+template< typename T, std::size_t N >
+uint32_t maxPackedSize( const Math::Vector< T, N >& v )
+{
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+	return 6 + bulkSize( v );
+#else
+	return 5 + 9 * static_cast< uint32_t >( v.size() );
+#endif
+}
+
+template< typename T, std::size_t M, std::size_t N >
+uint32_t maxPackedSize( const Math::Matrix< T, M, N >& m )
+{
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+	return 6 + bulkSize( m );
+#else
+	return 5 + 9 * static_cast< uint32_t >( m.size1() * m.size2() );
+#endif
+}
+
+inline uint32_t maxPackedSize( const Math::Quaternion& )
+{ return maxPackedSize( Math::Vector< double, 4 >() ); }
+
+inline uint32_t maxPackedSize( const Math::RotationVelocity& )
+{ return maxPackedSize( Math::Vector< double, 3 >() ); }
+
+inline uint32_t maxPackedSize( const Math::Pose& p )
+{ return 5 + maxPackedSize( p.rotation() ) + maxPackedSize( p.translation() ); }
+
+template< typename T, std::size_t N >
+uint32_t maxPackedSize( const Math::ErrorVector< T, N >& v )
+{ return 5 + maxPackedSize( v.value ) + maxPackedSize( v.covariance ); }
+
+inline uint32_t maxPackedSize( const Math::ErrorPose& p )
+{ return 5 + maxPackedSize( p.rotation() ) + maxPackedSize( p.translation() ) + maxPackedSize( p.covariance() ); }
+
+template< typename T >
+uint32_t maxPackedSize( const Math::CameraIntrinsics< T >& c )
+{
+	return 5 + 9 + maxPackedSize( c.dimension ) + maxPackedSize( c.matrix ) + 9 
+		+ maxPackedSize( c.radial_params ) + maxPackedSize( c.tangential_params );
+}
+
+template< typename T, typename Alloc >
+uint32_t maxPackedSize( const std::vector< T, Alloc >& l )
+{
+	uint32_t size = 5;
+	for ( std::size_t i = 0; i < l.size(); i++ )
+		size += maxPackedSize( l[ i ] );
+	return size;
+}
+
+template< typename T, std::size_t N, typename Alloc >
+uint32_t maxPackedSize( const std::vector< Math::Vector< T, N >, Alloc >& l )
+{
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+	if ( isBulkList( l ) )
+		return 6 + bulkSize( l );
+#endif
+	uint32_t size = 5;
+	for ( std::size_t i = 0; i < l.size(); i++ )
+		size += maxPackedSize( l[ i ] );
+	return size;
+}
+
+template< typename Alloc >
+uint32_t maxPackedSize( const std::vector< Math::Pose, Alloc >& l )
+{
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+	return 6 + bulkSize( l );
+#else
+	return 5 + static_cast< uint32_t >( l.size() ) * maxPackedSize( Math::Pose() );
+#endif
+}
+
+template< typename T >
+uint32_t maxPackedSize( const Measurement::Measurement< T >& m )
+{ return m ? 5 + 9 + maxPackedSize( *m ) : 1; }
+
+} // namespace Detail
+
+
 template<typename T>
 struct MsgpackSerializationFormat {
   template<typename Stream>
@@ -80,9 +571,10 @@ struct MsgpackSerializationFormat {
   }
 
 
+  /** upper bound of the packed size */
   inline static uint32_t maxSerializedLength(typename boost::call_traits<T>::param_type t)
   {
-      return 0;
+      return Detail::maxPackedSize(t);
   }
 };
 
@@ -266,10 +758,16 @@ template<typename T, std::size_t N>
 struct convert<Ubitrack::Math::Vector<T, N> > {
   msgpack::object const& operator()(msgpack::object const& o, Ubitrack::Math::Vector<T, N>& v) const
   {
+      if (o.type==msgpack::type::EXT) {
+          Ubitrack::Serialization::MsgpackArchive::Detail::loadBulk(o, v);
+          return o;
+      }
       if (o.type!=msgpack::type::ARRAY) throw msgpack::type_error();
       std::size_t num_elements = o.via.array.size;
       if (N>0) {
           if (num_elements!=N) throw msgpack::type_error();
+      } else {
+          v.resize(num_elements, false);
       }
       for (std::size_t i = 0; i<num_elements; ++i) {
 		  msgpack::adaptor::convert<T>()(o.via.array.ptr[i], v(i));
@@ -284,6 +782,9 @@ struct pack<Ubitrack::Math::Vector<T, N> > {
   template<typename Stream>
   msgpack::packer<Stream>& operator()(msgpack::packer<Stream>& o, const Ubitrack::Math::Vector<T, N>& v) const
   {
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+      Ubitrack::Serialization::MsgpackArchive::Detail::packBulk(o, v);
+#else
       std::size_t num_elements = N;
       if (num_elements == 0) {
           num_elements = v.size();
@@ -292,6 +793,7 @@ struct pack<Ubitrack::Math::Vector<T, N> > {
       for (std::size_t i = 0; i<num_elements; ++i) {
           o.pack(v(i));
       }
+#endif
       return o;
   }
 };
@@ -300,6 +802,9 @@ template<typename T, std::size_t N>
 struct object_with_zone<Ubitrack::Math::Vector<T, N> > {
   void operator()(msgpack::object::with_zone& o, const Ubitrack::Math::Vector<T, N>& v) const
   {
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+      Ubitrack::Serialization::MsgpackArchive::Detail::objectBulk(o, v);
+#else
       std::size_t num_elements = N;
       if (num_elements == 0) {
           num_elements = v.size();
@@ -309,8 +814,9 @@ struct object_with_zone<Ubitrack::Math::Vector<T, N> > {
       o.via.array.ptr = static_cast<msgpack::object*>(
               o.zone.allocate_align(sizeof(msgpack::object)*o.via.array.size));
       for (std::size_t i = 0; i<num_elements; ++i) {
-          o.via.array.ptr[0] = msgpack::object(v(i), o.zone);
+          o.via.array.ptr[i] = msgpack::object(v(i), o.zone);
       }
+#endif
   }
 };
 
@@ -334,7 +840,7 @@ struct as<Ubitrack::Math::Matrix<T, M, N>, typename std::enable_if<msgpack::has_
       Ubitrack::Math::Matrix<T, M, N> result(M, N);
       for (std::size_t i = 0; i<M; ++i) {
           for (std::size_t j = 0; j<N; ++j) {
-              std::size_t idx = i*M + j;
+              std::size_t idx = i*N + j;
               result(i,j) = o.via.array.ptr[idx].as<T>();
           }
       }
@@ -347,6 +853,10 @@ template<typename T, std::size_t M, std::size_t N>
 struct convert<Ubitrack::Math::Matrix<T, M, N> > {
   msgpack::object const& operator()(msgpack::object const& o, Ubitrack::Math::Matrix<T, M, N>& v) const
   {
+      if (o.type==msgpack::type::EXT) {
+          Ubitrack::Serialization::MsgpackArchive::Detail::loadBulk(o, v);
+          return o;
+      }
       if (o.type!=msgpack::type::ARRAY) throw msgpack::type_error();
       std::size_t num_elements = o.via.array.size;
       if ((M>0) && (N>0)) {
@@ -357,7 +867,7 @@ struct convert<Ubitrack::Math::Matrix<T, M, N> > {
       }
       for (std::size_t i = 0; i<M; ++i) {
           for (std::size_t j = 0; j<N; ++j) {
-              std::size_t idx = i*M + j;
+              std::size_t idx = i*N + j;
 			  msgpack::adaptor::convert<T>()(o.via.array.ptr[idx], v(i, j));
               //v(i,j) = o.via.array.ptr[idx].as<T>();
           }
@@ -371,6 +881,9 @@ struct pack<Ubitrack::Math::Matrix<T, M, N> > {
   template<typename Stream>
   msgpack::packer<Stream>& operator()(msgpack::packer<Stream>& o, const Ubitrack::Math::Matrix<T, M, N>& v) const
   {
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+      Ubitrack::Serialization::MsgpackArchive::Detail::packBulk(o, v);
+#else
       std::size_t num_elements = M*N;
       if (num_elements == 0) {
           // cannot pack dynamically sized matrix without also serializing dimensions ...
@@ -379,10 +892,10 @@ struct pack<Ubitrack::Math::Matrix<T, M, N> > {
       o.pack_array((uint32_t)num_elements);
       for (std::size_t i = 0; i<M; ++i) {
           for (std::size_t j = 0; j<N; ++j) {
-              std::size_t idx = i*M + j;
               o.pack(v(i,j));
           }
       }
+#endif
       return o;
   }
 };
@@ -391,6 +904,9 @@ template<typename T, std::size_t M, std::size_t N>
 struct object_with_zone<Ubitrack::Math::Matrix<T, M, N> > {
   void operator()(msgpack::object::with_zone& o, const Ubitrack::Math::Matrix<T, M, N>& v) const
   {
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+      Ubitrack::Serialization::MsgpackArchive::Detail::objectBulk(o, v);
+#else
       std::size_t num_elements = M*N;
       if (num_elements == 0) {
           // cannot pack dynamically sized matrix without also serializing dimensions ...
@@ -402,10 +918,72 @@ struct object_with_zone<Ubitrack::Math::Matrix<T, M, N> > {
               o.zone.allocate_align(sizeof(msgpack::object)*o.via.array.size));
       for (std::size_t i = 0; i<M; ++i) {
           for (std::size_t j = 0; j<N; ++j) {
-              std::size_t idx = i*M + j;
+              std::size_t idx = i*N + j;
               o.via.array.ptr[idx] = msgpack::object(v(i,j), o.zone);
           }
       }
+#endif
+  }
+};
+
+
+
+/*
+ * std::vector<Ubitrack::Math::Vector<T, N> >, e.g. PositionList
+ */
+template<typename T, std::size_t N, typename Alloc>
+struct convert<std::vector<Ubitrack::Math::Vector<T, N>, Alloc> > {
+  msgpack::object const& operator()(msgpack::object const& o, std::vector<Ubitrack::Math::Vector<T, N>, Alloc>& v) const
+  {
+      if (o.type==msgpack::type::EXT) {
+          Ubitrack::Serialization::MsgpackArchive::Detail::loadBulk(o, v);
+          return o;
+      }
+      if (o.type!=msgpack::type::ARRAY) throw msgpack::type_error();
+      v.resize(o.via.array.size);
+      for (std::size_t i = 0; i<v.size(); ++i) {
+          msgpack::adaptor::convert<Ubitrack::Math::Vector<T, N> >()(o.via.array.ptr[i], v[i]);
+      }
+      return o;
+  }
+};
+
+template<typename T, std::size_t N, typename Alloc>
+struct pack<std::vector<Ubitrack::Math::Vector<T, N>, Alloc> > {
+  template<typename Stream>
+  msgpack::packer<Stream>& operator()(msgpack::packer<Stream>& o, const std::vector<Ubitrack::Math::Vector<T, N>, Alloc>& v) const
+  {
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+      if (Ubitrack::Serialization::MsgpackArchive::Detail::isBulkList(v)) {
+          Ubitrack::Serialization::MsgpackArchive::Detail::packBulk(o, v);
+          return o;
+      }
+#endif
+      o.pack_array((uint32_t)v.size());
+      for (std::size_t i = 0; i<v.size(); ++i) {
+          o.pack(v[i]);
+      }
+      return o;
+  }
+};
+
+template<typename T, std::size_t N, typename Alloc>
+struct object_with_zone<std::vector<Ubitrack::Math::Vector<T, N>, Alloc> > {
+  void operator()(msgpack::object::with_zone& o, const std::vector<Ubitrack::Math::Vector<T, N>, Alloc>& v) const
+  {
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+      if (Ubitrack::Serialization::MsgpackArchive::Detail::isBulkList(v)) {
+          Ubitrack::Serialization::MsgpackArchive::Detail::objectBulk(o, v);
+          return;
+      }
+#endif
+      o.type = type::ARRAY;
+      o.via.array.size = (uint32_t)v.size();
+      o.via.array.ptr = static_cast<msgpack::object*>(
+              o.zone.allocate_align(sizeof(msgpack::object)*o.via.array.size));
+      for (std::size_t i = 0; i<v.size(); ++i) {
+          o.via.array.ptr[i] = msgpack::object(v[i], o.zone);
+      }
   }
 };
 
@@ -577,6 +1155,76 @@ struct object_with_zone<Ubitrack::Math::Pose > {
 
 
 
+/*
+ * std::vector<Ubitrack::Math::Pose>, e.g. PoseList
+ */
+#if !defined(MSGPACK_USE_CPP03)
+// Math::Pose has an as<> adaptor, so msgpack would otherwise use its array-only one for lists
+template<typename Alloc>
+struct as<std::vector<Ubitrack::Math::Pose, Alloc> > {
+  std::vector<Ubitrack::Math::Pose, Alloc> operator()(msgpack::object const& o) const
+  {
+      std::vector<Ubitrack::Math::Pose, Alloc> v;
+      msgpack::adaptor::convert<std::vector<Ubitrack::Math::Pose, Alloc> >()(o, v);
+      return v;
+  }
+};
+#endif
+
+template<typename Alloc>
+struct convert<std::vector<Ubitrack::Math::Pose, Alloc> > {
+  msgpack::object const& operator()(msgpack::object const& o, std::vector<Ubitrack::Math::Pose, Alloc>& v) const
+  {
+      if (o.type==msgpack::type::EXT) {
+          Ubitrack::Serialization::MsgpackArchive::Detail::loadBulk(o, v);
+          return o;
+      }
+      if (o.type!=msgpack::type::ARRAY) throw msgpack::type_error();
+      v.resize(o.via.array.size);
+      for (std::size_t i = 0; i<v.size(); ++i) {
+          msgpack::adaptor::convert<Ubitrack::Math::Pose>()(o.via.array.ptr[i], v[i]);
+      }
+      return o;
+  }
+};
+
+template<typename Alloc>
+struct pack<std::vector<Ubitrack::Math::Pose, Alloc> > {
+  template<typename Stream>
+  msgpack::packer<Stream>& operator()(msgpack::packer<Stream>& o, const std::vector<Ubitrack::Math::Pose, Alloc>& v) const
+  {
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+      Ubitrack::Serialization::MsgpackArchive::Detail::packBulk(o, v);
+#else
+      o.pack_array((uint32_t)v.size());
+      for (std::size_t i = 0; i<v.size(); ++i) {
+          o.pack(v[i]);
+      }
+#endif
+      return o;
+  }
+};
+
+template<typename Alloc>
+struct object_with_zone<std::vector<Ubitrack::Math::Pose, Alloc> > {
+  void operator()(msgpack::object::with_zone& o, const std::vector<Ubitrack::Math::Pose, Alloc>& v) const
+  {
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+      Ubitrack::Serialization::MsgpackArchive::Detail::objectBulk(o, v);
+#else
+      o.type = type::ARRAY;
+      o.via.array.size = (uint32_t)v.size();
+      o.via.array.ptr = static_cast<msgpack::object*>(
+              o.zone.allocate_align(sizeof(msgpack::object)*o.via.array.size));
+      for (std::size_t i = 0; i<v.size(); ++i) {
+          o.via.array.ptr[i] = msgpack::object(v[i], o.zone);
+      }
+#endif
+  }
+};
+
+
+
 /*
  * Ubitrack::Math::ErrorVector<T,N>
  */
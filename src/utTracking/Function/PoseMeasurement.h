@@ -0,0 +1,85 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @file
+ * Measurement function of a pose, given a state with position and orientation.
+ *
+ * @author Daniel Pustka <daniel.pustka@in.tum.de>
+ */ 
+
+
+#ifndef __UBITRACK_TRACKING_FUNCTION_POSEMEASUREMENT_H_INCLUDED__
+#define __UBITRACK_TRACKING_FUNCTION_POSEMEASUREMENT_H_INCLUDED__
+
+#include <boost/numeric/ublas/vector_proxy.hpp>
+#include <boost/numeric/ublas/matrix_proxy.hpp>
+
+namespace Ubitrack { namespace Tracking { namespace Function {
+
+/**
+ * Measurement function of a pose. 
+ * The input is the sub-vector of the state from the position to the orientation quaternion, 
+ * the result is the 7-vector ( position, quaternion ).
+ */
+class PoseMeasurement
+{
+public:
+	/**
+	 * constructor.
+	 * @param rotStart index of the orientation quaternion in the input vector
+	 */
+	PoseMeasurement( int rotStart )
+		: m_rotStart( rotStart )
+	{}
+
+	unsigned size() const
+	{ return 7; }
+
+	/**
+	 * Computes the measurement and the jacobian.
+	 * @param result vector to put the result in
+	 * @param input input vector of size rotStart + 4
+	 * @param jacobian 7-by-(rotStart+4) matrix to put the jacobian into
+	 */
+	template< class VT1, class VT2, class MT > 
+	void evaluateWithJacobian( VT1& result, const VT2& input, MT& jacobian ) const
+	{
+		namespace ublas = boost::numeric::ublas;
+		ublas::subrange( result, 0, 3 ) = ublas::subrange( input, 0, 3 );
+		ublas::subrange( result, 3, 7 ) = ublas::subrange( input, m_rotStart, m_rotStart + 4 );
+		ublas::subrange( jacobian, 0, 3, 0, 3 ) = ublas::identity_matrix< double >( 3 );
+		ublas::subrange( jacobian, 0, 3, 3, m_rotStart + 4 ) = ublas::zero_matrix< double >( 3, m_rotStart + 4 - 3 );
+		ublas::subrange( jacobian, 3, 7, 0, m_rotStart ) = ublas::zero_matrix< double >( 4, m_rotStart );
+		ublas::subrange( jacobian, 3, 7, m_rotStart, m_rotStart + 4 ) = ublas::identity_matrix< double >( 4 );
+	}
+
+protected:
+	int m_rotStart;
+};
+
+} } } // namespace Ubitrack::Tracking::Function
+
+#endif
@@ -0,0 +1,340 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @ingroup tracking
+ * @file
+ * Implementation of kalman filtering of the poses of many targets
+ */
+
+#include "PoseFilterBank.h"
+#ifdef HAVE_LAPACK
+
+#include <utMath/ErrorVector.h>
+#include <utMath/Stochastic/KalmanFilter.h>
+#include <utMath/Optimization/Function/VectorNormalize.h>
+#include <utMath/Util/parallel_ranges.h>
+#include <utUtil/Exception.h>
+#include "Function/QuaternionTimeUpdate.h"
+#include "Function/InsideOutPoseTimeUpdate.h"
+#include "Function/PoseMeasurement.h"
+
+// get a logger
+#include <log4cpp/Category.hh>
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Tracking.PoseFilterBank" ) );
+
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+/** the filter of one target */
+typedef Ubitrack::Math::Stochastic::KalmanFilter< double, 13 > FixedSizeFilter;
+
+/** first index of the orientation in the state */
+const std::size_t iR = 6;
+
+}
+
+namespace Ubitrack { namespace Tracking {
+
+struct PoseFilterBank::TimeUpdate
+{
+	typedef void result_type;
+
+	TimeUpdate( PoseFilterBank& bank, Measurement::Timestamp t )
+		: m_bank( bank )
+		, m_t( t )
+	{}
+
+	void operator()( std::size_t, std::size_t iBegin, std::size_t iEnd ) const
+	{
+		for ( std::size_t i = iBegin; i < iEnd; i++ )
+		{
+			// only update time for the first measurement
+			Measurement::Timestamp& time( m_bank.m_times[ i ] );
+			if ( time != 0 && time != m_t )
+				m_bank.timeUpdate( m_bank.m_states[ i ], m_bank.m_covariances[ i ], ( (long long int)( m_t - time ) ) * 1e-9 );
+			if ( time != 0 )
+				time = m_t;
+		}
+	}
+
+	PoseFilterBank& m_bank;
+	Measurement::Timestamp m_t;
+};
+
+
+struct PoseFilterBank::PoseUpdate
+{
+	typedef void result_type;
+
+	PoseUpdate( PoseFilterBank& bank, const std::vector< std::size_t >& targets, const std::vector< Measurement::ErrorPose >& poses )
+		: m_bank( bank )
+		, m_targets( targets )
+		, m_poses( poses )
+	{}
+
+	void operator()( std::size_t, std::size_t iBegin, std::size_t iEnd ) const
+	{
+		for ( std::size_t i = iBegin; i < iEnd; i++ )
+			update( m_targets[ i ], m_poses[ i ] );
+	}
+
+	/** the same as \c PoseKalmanFilter::addPoseMeasurement for the standard motion model */
+	void update( std::size_t target, const Measurement::ErrorPose& m ) const
+	{
+		StateType& state( m_bank.m_states[ target ] );
+		CovarianceType& covariance( m_bank.m_covariances[ target ] );
+		Measurement::Timestamp& time( m_bank.m_times[ target ] );
+		ublas::vector_range< StateType > rotSubState( state, ublas::range( iR, iR + 4 ) );
+
+		// on first update, set pose
+		if ( time == 0 )
+		{
+			ublas::subrange( state, 0, 3 ) = m->translation();
+			m->rotation().toVector( rotSubState );
+		}
+		else if ( time != m.time() )
+			m_bank.timeUpdate( state, covariance, ( (long long int)( m.time() - time ) ) * 1e-9 );
+		time = m.time();
+
+		// create measurement as ErrorVector
+		Math::ErrorVector< double, 7 > v;
+		m->toAdditiveErrorVector( v );
+
+		// negate quaternion
+		if ( ublas::inner_prod( rotSubState, ublas::subrange( v.value, 3, 7 ) ) < 0 )
+			ublas::subrange( v.value, 3, 7 ) *= -1;
+
+		FixedSizeFilter::measurementUpdate< 10 >( state, covariance, Function::PoseMeasurement( iR ), v.value, v.covariance );
+
+		// normalize quaternion
+		FixedSizeFilter::transformRange< 4, 4 >( state, covariance, Math::Optimization::Function::VectorNormalize( 4 ), iR, iR );
+
+		// check if rotation velocity is too big and reset it in this case
+		if ( ublas::norm_2( ublas::subrange( state, iR + 4, iR + 7 ) ) > 10.0 )
+		{
+			LOG4CPP_NOTICE( logger, "Kalman Filter orientation instability detected for target " << target << ". Resetting orientation derivatives." );
+			ublas::subrange( state, iR + 4, iR + 7 ) = Math::Vector< double, 3 >::zeros();
+		}
+	}
+
+	PoseFilterBank& m_bank;
+	const std::vector< std::size_t >& m_targets;
+	const std::vector< Measurement::ErrorPose >& m_poses;
+};
+
+
+PoseFilterBank::PoseFilterBank( const LinearPoseMotionModel& motionModel, std::size_t nTargets, bool bInsideOut, std::size_t nThreads )
+	: m_motionModel( motionModel )
+	, m_bInsideOut( bInsideOut )
+	, m_nThreads( std::max< std::size_t >( nThreads, 1 ) )
+{
+	if ( m_motionModel.posOrder() != 1 || m_motionModel.oriOrder() != 1 )
+		UBITRACK_THROW( "PoseFilterBank needs posOrder==1 and oriOrder==1" );
+
+	m_states.reserve( nTargets );
+	m_covariances.reserve( nTargets );
+	m_times.reserve( nTargets );
+	for ( std::size_t i = 0; i < nTargets; i++ )
+		addTarget();
+
+	if ( m_nThreads > 1 )
+		m_pool.reset( new Math::Util::ParallelRangesPool( m_nThreads ) );
+}
+
+
+PoseFilterBank::~PoseFilterBank()
+{}
+
+
+std::size_t PoseFilterBank::addTarget()
+{
+	m_states.push_back( StateType() );
+	m_covariances.push_back( CovarianceType() );
+	m_times.push_back( 0 );
+	resetTarget( size() - 1 );
+	return size() - 1;
+}
+
+
+void PoseFilterBank::resetTarget( std::size_t target )
+{
+	m_states[ target ] = StateType::zeros();
+	m_states[ target ]( iR + 3 ) = 1;
+	m_covariances[ target ] = CovarianceType::identity();
+	m_times[ target ] = 0;
+}
+
+
+void PoseFilterBank::removeTarget( std::size_t target )
+{
+	m_states[ target ] = m_states.back();
+	m_covariances[ target ] = m_covariances.back();
+	m_times[ target ] = m_times.back();
+	m_states.pop_back();
+	m_covariances.pop_back();
+	m_times.pop_back();
+}
+
+
+void PoseFilterBank::timeUpdate( Measurement::Timestamp t )
+{
+	LOG4CPP_DEBUG( logger, "Time update of " << size() << " targets to t = " << t );
+	run( size(), TimeUpdate( *this, t ) );
+}
+
+
+void PoseFilterBank::addPoseMeasurement( std::size_t target, const Measurement::ErrorPose& m )
+{
+	std::vector< std::size_t > targets;
+	std::vector< Measurement::ErrorPose > poses;
+	PoseUpdate( *this, targets, poses ).update( target, m );
+}
+
+
+void PoseFilterBank::addPoseMeasurements( const std::vector< std::size_t >& targets, const std::vector< Measurement::ErrorPose >& m )
+{
+	if ( targets.size() != m.size() )
+		UBITRACK_THROW( "PoseFilterBank needs one target index per measurement" );
+	if ( m.empty() )
+		return;
+
+	// the threads must not update the same filter
+	m_batchFlags.resize( size() );
+	std::size_t i = 0;
+	for ( ; i < targets.size(); i++ )
+	{
+		if ( targets[ i ] >= size() || m_batchFlags[ targets[ i ] ] )
+			break;
+		m_batchFlags[ targets[ i ] ] = 1;
+	}
+	const bool bValid = i == targets.size();
+	for ( std::size_t j = 0; j < i; j++ )
+		m_batchFlags[ targets[ j ] ] = 0;
+	if ( !bValid )
+	{
+		if ( targets[ i ] >= size() )
+			UBITRACK_THROW( "PoseFilterBank target index out of range" );
+		UBITRACK_THROW( "PoseFilterBank needs at most one measurement per target in a batch" );
+	}
+
+	run( m.size(), PoseUpdate( *this, targets, m ) );
+}
+
+
+template< typename Function >
+void PoseFilterBank::run( std::size_t n, Function func )
+{
+	if ( n == 0 )
+		return;
+	if ( m_pool )
+		m_pool->run( n, func );
+	else
+		func( 0, 0, n );
+}
+
+
+Measurement::ErrorPose PoseFilterBank::predictPose( std::size_t target, Measurement::Timestamp t ) const
+{
+	if ( !m_times[ target ] )
+		UBITRACK_THROW( "kalman filter not (yet) initialized" );
+
+	StateType state( m_states[ target ] );
+	CovarianceType covariance( m_covariances[ target ] );
+	timeUpdate( state, covariance, ( (long long int)( t - m_times[ target ] ) ) * 1e-9 );
+	
+	// convert to 7x7 error
+	Math::ErrorVector< double, 7 > pose;
+	ublas::subrange( pose.value, 0, 3 ) = ublas::subrange( state, 0, 3 );
+	ublas::subrange( pose.value, 3, 7 ) = ublas::subrange( state, iR, iR + 4 );
+	ublas::subrange( pose.covariance, 0, 3, 0, 3 ) = ublas::subrange( covariance, 0, 3, 0, 3 );
+	ublas::subrange( pose.covariance, 0, 3, 3, 7 ) = ublas::subrange( covariance, 0, 3, iR, iR + 4 );
+	ublas::subrange( pose.covariance, 3, 7, 0, 3 ) = ublas::subrange( covariance, iR, iR + 4, 0, 3 );
+	ublas::subrange( pose.covariance, 3, 7, 3, 7 ) = ublas::subrange( covariance, iR, iR + 4, iR, iR + 4 );
+	return Measurement::ErrorPose( t, Math::ErrorPose::fromAdditiveErrorVector( pose ) );
+}
+
+
+void PoseFilterBank::timeUpdate( StateType& state, CovarianceType& covariance, double dt ) const
+{
+	if ( m_bInsideOut )
+		FixedSizeFilter::transformRange< stateSize, stateSize >( state, covariance, Function::InsideOutPoseTimeUpdate( dt, 1 ) );
+	else
+	{
+		// the jacobian G is the identity, apart from
+		// rows 0-2: position += dt * velocity
+		// rows 6-9: quaternion time update, depending on rows 6-12
+		Math::Vector< double, 4 > q;
+		Math::Matrix< double, 4, 7 > jq;
+		Function::QuaternionTimeUpdate( dt, 1 ).evaluateWithJacobian( q, ublas::subrange( state, iR, iR + 7 ), jq );
+		for ( std::size_t i = 0; i < 3; i++ )
+			state( i ) += dt * state( i + 3 );
+		for ( std::size_t i = 0; i < 4; i++ )
+			state( iR + i ) = q( i );
+
+		// G P, column by column
+		const std::size_t n = stateSize;
+		double* p = &covariance( 0, 0 );
+		const double* j = &jq( 0, 0 );
+		for ( std::size_t c = 0; c < n; c++ )
+		{
+			double* col = p + c * n;
+			double qRows[ 4 ] = { 0, 0, 0, 0 };
+			for ( std::size_t k = 0; k < 7; k++ )
+				for ( std::size_t r = 0; r < 4; r++ )
+					qRows[ r ] += j[ k * 4 + r ] * col[ iR + k ];
+			for ( std::size_t r = 0; r < 3; r++ )
+				col[ r ] += dt * col[ r + 3 ];
+			for ( std::size_t r = 0; r < 4; r++ )
+				col[ iR + r ] = qRows[ r ];
+		}
+
+		// ( G P ) G^T, row by row
+		for ( std::size_t r = 0; r < n; r++ )
+		{
+			double qCols[ 4 ] = { 0, 0, 0, 0 };
+			for ( std::size_t k = 0; k < 7; k++ )
+				for ( std::size_t c = 0; c < 4; c++ )
+					qCols[ c ] += j[ k * 4 + c ] * p[ ( iR + k ) * n + r ];
+			for ( std::size_t c = 0; c < 3; c++ )
+				p[ c * n + r ] += dt * p[ ( c + 3 ) * n + r ];
+			for ( std::size_t c = 0; c < 4; c++ )
+				p[ ( iR + c ) * n + r ] = qCols[ c ];
+		}
+
+		// remove rounding asymmetries
+		for ( std::size_t c = 0; c < n; c++ )
+			for ( std::size_t r = 0; r < c; r++ )
+				p[ c * n + r ] = p[ r * n + c ] = ( p[ c * n + r ] + p[ r * n + c ] ) / 2;
+	}
+	
+	// add process noise
+	m_motionModel.addNoise( covariance, dt );
+}
+
+} } // namespace Ubitrack::Tracking
+
+#endif // HAVE_LAPACK
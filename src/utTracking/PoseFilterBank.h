@@ -0,0 +1,197 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @ingroup tracking
+ * @file
+ * Kalman filtering of the poses of many targets
+ */
+ 
+#ifndef __UBITRACK_TRACKING_POSEFILTERBANK_H_INCLUDED__
+#define __UBITRACK_TRACKING_POSEFILTERBANK_H_INCLUDED__
+
+
+#ifdef HAVE_LAPACK
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <utCore.h>
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMeasurement/Measurement.h>
+#include "LinearPoseMotionModel.h"
+
+namespace Ubitrack { namespace Math { namespace Util {
+	class ParallelRangesPool;
+} } }
+
+namespace Ubitrack { namespace Tracking {
+
+/**
+ * A bank of pose kalman filters for many targets that share the same motion model.
+ *
+ * Each filter behaves like a \c PoseKalmanFilter with the standard motion model (posOrder = 1, 
+ * oriOrder = 1), but the states and covariances of all filters are stored by value in contiguous 
+ * arrays, so that neither updates nor the filters themselves allocate memory on the heap.
+ *
+ * \c timeUpdate advances all filters to a common timestamp in one pass. It exploits the structure 
+ * of the time update, whose jacobian is the identity apart from the position and the orientation rows,
+ * which is considerably faster than a full covariance transformation. Time updates and batches 
+ * of measurement updates are distributed over several threads, if configured. The threads are 
+ * started by the constructor and kept until the bank is destroyed.
+ */
+class UBITRACK_EXPORT PoseFilterBank
+	: private boost::noncopyable
+{
+public:
+	/** size of the state of each filter */
+	static const std::size_t stateSize = 13;
+
+	/** type of internal state representation */
+	typedef Math::Vector< double, stateSize > StateType;
+
+	/** type of internal covariance representation */
+	typedef Math::Matrix< double, stateSize, stateSize > CovarianceType;
+
+	/** 
+	 * Constructor.
+	 * @param motionModel Motion model that defines the process noise. Must have posOrder = 1 and oriOrder = 1.
+	 * @param nTargets initial number of filters
+	 * @param bInsideOut use the inside-out motion model, see \c PoseKalmanFilter
+	 * @param nThreads number of threads used for time updates and batches of measurements
+	 */
+	PoseFilterBank( const LinearPoseMotionModel& motionModel, std::size_t nTargets = 0, bool bInsideOut = false,
+		std::size_t nThreads = 1 );
+
+	/** Destructor, stops the threads */
+	~PoseFilterBank();
+
+	/** returns the number of filters */
+	std::size_t size() const
+	{ return m_times.size(); }
+
+	/** 
+	 * adds a new, uninitialized filter.
+	 * @return index of the new filter
+	 */
+	std::size_t addTarget();
+
+	/** resets a filter, it is initialized again by the next measurement */
+	void resetTarget( std::size_t target );
+
+	/** 
+	 * removes a filter. The last filter takes the index of the removed one.
+	 */
+	void removeTarget( std::size_t target );
+
+	/**
+	 * Forwards all initialized filters to a common timestamp.
+	 * Note: usually, there is no need to call this method, as it is implicitly called by the
+	 * addPoseMeasurement methods.
+	 */
+	void timeUpdate( Measurement::Timestamp t );
+
+	/** 
+	 * integrate an absolute pose measurement into one filter.
+	 * @param target index of the filter
+	 * @param m the measured pose with timestamp and error
+	 */
+	void addPoseMeasurement( std::size_t target, const Measurement::ErrorPose& m );
+
+	/** 
+	 * integrate a batch of absolute pose measurements, at most one per filter.
+	 * @param targets indices of the filters
+	 * @param m the measured poses, one per index in \c targets
+	 * @throws Util::Exception if an index is out of range or occurs more than once. In this case,
+	 *   no filter is changed.
+	 */
+	void addPoseMeasurements( const std::vector< std::size_t >& targets, const std::vector< Measurement::ErrorPose >& m );
+
+	/**
+	 * compute a pose of one filter for a given time, which may lie in the future
+	 */
+	Measurement::ErrorPose predictPose( std::size_t target, Measurement::Timestamp t ) const;
+
+	/** returns the state of a filter */
+	const StateType& getState( std::size_t target ) const
+	{ return m_states[ target ]; }
+
+	/** returns the covariance of a filter */
+	const CovarianceType& getCovariance( std::size_t target ) const
+	{ return m_covariances[ target ]; }
+
+	/** returns the timestamp of a filter, 0 if it has not been initialized */
+	Measurement::Timestamp getTime( std::size_t target ) const
+	{ return m_times[ target ]; }
+
+	/** returns the motion model */
+	const LinearPoseMotionModel& getMotionModel() const
+	{ return m_motionModel; }
+
+protected:
+	/** @internal functor for parallel time updates */
+	struct TimeUpdate;
+
+	/** @internal functor for parallel measurement updates */
+	struct PoseUpdate;
+
+	/** calls func( t, first, last ) for parts of [0, n), in the threads of the pool if there is one */
+	template< typename Function >
+	void run( std::size_t n, Function func );
+
+	/** time update of a state and covariance, in place */
+	void timeUpdate( StateType& state, CovarianceType& covariance, double dt ) const;
+
+	/** the motion model */
+	LinearPoseMotionModel m_motionModel;
+
+	/** inside-out motion model? */
+	bool m_bInsideOut;
+
+	/** number of threads */
+	std::size_t m_nThreads;
+
+	/** worker threads, only if m_nThreads > 1 */
+	boost::scoped_ptr< Math::Util::ParallelRangesPool > m_pool;
+
+	/** @internal per-filter flags to find duplicates in a batch, kept to avoid allocations */
+	std::vector< unsigned char > m_batchFlags;
+
+	/** the states */
+	std::vector< StateType > m_states;
+
+	/** the covariances */
+	std::vector< CovarianceType > m_covariances;
+
+	/** timestamps of the states */
+	std::vector< Measurement::Timestamp > m_times;
+};
+
+} } // namespace Ubitrack::Tracking
+
+#endif // HAVE_LAPACK
+
+#endif
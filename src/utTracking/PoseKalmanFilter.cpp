@@ -33,12 +33,15 @@
 #include "PoseKalmanFilter.h"
 #ifdef HAVE_LAPACK
  
+#include <algorithm>
+#include <utMath/MatrixOperations.h>
 #include <utMath/Stochastic/CovarianceTransform.h>
 #include <utMath/Optimization/Function/VectorNormalize.h>
 #include <utUtil/Exception.h>
 #include "Function/PoseTimeUpdate.h"
 #include "Function/InsideOutPoseTimeUpdate.h"
 #include "Function/InvertRotationVelocity.h"
+#include "Function/PoseMeasurement.h"
 
 // get a logger
 #include <log4cpp/Category.hh>
@@ -46,43 +49,47 @@ static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Trac
 
 #define KALMAN_LOGGING
 #include <utMath/Stochastic/Kalman.h>
+#include <utMath/Stochastic/KalmanFilter.h>
 
 namespace ublas = boost::numeric::ublas;
 
 namespace {
 
-// define the pose measurement class
-struct PoseMeasurement
-{
-	int m_rotStart;
+/** the fixed-size filter of the standard motion model */
+typedef Ubitrack::Math::Stochastic::KalmanFilter< double, 13 > FixedSizeFilter;
 
-	PoseMeasurement( int rotStart )
-		: m_rotStart( rotStart )
-	{}
+/** normalizes the quaternion of a state starting at index iR */
+template< class VT, class MT >
+void normalizeQuaternion( VT& state, MT& covariance, int iR )
+{
+	Ubitrack::Math::Stochastic::transformRangeInternalWithCovariance( Ubitrack::Math::Optimization::Function::VectorNormalize( 4 ), 
+		state, covariance, iR, iR + 4, iR, iR + 4 );
+}
 
-	template< class VT1, class VT2, class MT > 
-	void evaluateWithJacobian( VT1& result, const VT2& input, MT& jacobian ) const
-	{
-		ublas::subrange( result, 0, 3 ) = ublas::subrange( input, 0, 3 );
-		ublas::subrange( result, 3, 7 ) = ublas::subrange( input, m_rotStart, m_rotStart + 4 );
-		ublas::subrange( jacobian, 0, 3, 0, 3 ) = Ubitrack::Math::Matrix< double, 3, 3 >::identity();
-		ublas::subrange( jacobian, 0, 3, 3, m_rotStart + 4 ) = Ubitrack::Math::Matrix< double, 0, 0 >::zeros( 3, m_rotStart + 4 - 3 );
-		ublas::subrange( jacobian, 3, 7, 0, m_rotStart ) = Ubitrack::Math::Matrix< double, 0, 0 >::zeros( 4, m_rotStart );
-		ublas::subrange( jacobian, 3, 7, m_rotStart, m_rotStart + 4 ) = Ubitrack::Math::Matrix< double, 4, 4 >::identity();
-	}
+/** orders history entries by time */
+struct HistoryTimeLess
+{
+	template< class E >
+	bool operator()( Ubitrack::Measurement::Timestamp t, const E& e ) const
+	{ return t < e.time; }
 };
 
 }
 
 namespace Ubitrack { namespace Tracking {
 
-PoseKalmanFilter::PoseKalmanFilter( const LinearPoseMotionModel& motionModel, bool bInsideOut )
+PoseKalmanFilter::PoseKalmanFilter( const LinearPoseMotionModel& motionModel, bool bInsideOut,
+	Measurement::Timestamp maxLag, std::size_t historySize )
 	: m_motionModel( motionModel )
 	, m_bInsideOut( bInsideOut )
+	, m_bFixedSize( motionModel.posOrder() == 1 && motionModel.oriOrder() == 1 )
 	, m_state( Math::Vector< double >::zeros( motionModel.stateSize() ) )
 	, m_covariance( Math::Matrix< double, 0, 0 >::identity( motionModel.stateSize() ) )
 	, m_time( 0 )
+	, m_maxLag( maxLag )
+	, m_history( maxLag ? historySize : 0 )
 {
+	m_spareEntries.reserve( m_history.capacity() );
 	if ( bInsideOut && ( m_motionModel.posOrder() > 1 || m_motionModel.oriOrder() != 1 ) )
 		UBITRACK_THROW( "PoseKalmanFilter needs posOrder==1 or 0 and oriOrder==1 when inside-out mode is used!" );
 
@@ -92,7 +99,138 @@ PoseKalmanFilter::PoseKalmanFilter( const LinearPoseMotionModel& motionModel, bo
 }
 
 
+void PoseKalmanFilter::setLagWindow( Measurement::Timestamp maxLag, std::size_t historySize )
+{
+	m_maxLag = maxLag;
+	m_history.clear();
+	m_history.set_capacity( maxLag ? historySize : 0 );
+	m_spareEntries.clear();
+	m_spareEntries.reserve( m_history.capacity() );
+}
+
+
 void PoseKalmanFilter::addPoseMeasurement( const Measurement::ErrorPose& m )
+{
+	HistoryEntry entry( poseMeasurement, m.time() );
+	entry.pose = m;
+	addMeasurement( entry );
+}
+
+
+void PoseKalmanFilter::addRotationMeasurement( const Measurement::Rotation& m )
+{
+	HistoryEntry entry( rotationMeasurement, m.time() );
+	entry.rotation = m;
+	addMeasurement( entry );
+}
+
+
+void PoseKalmanFilter::addRotationVelocityMeasurement( const Measurement::RotationVelocity& m )
+{
+	HistoryEntry entry( rotationVelocityMeasurement, m.time() );
+	entry.rotationVelocity = m;
+	addMeasurement( entry );
+}
+
+
+void PoseKalmanFilter::addInverseRotationVelocityMeasurement( const Measurement::RotationVelocity& m )
+{
+	HistoryEntry entry( inverseRotationVelocityMeasurement, m.time() );
+	entry.rotationVelocity = m;
+	addMeasurement( entry );
+}
+
+
+void PoseKalmanFilter::addMeasurement( const HistoryEntry& entry )
+{
+	if ( m_history.capacity() == 0 )
+	{
+		applyMeasurement( entry );
+		return;
+	}
+
+	if ( m_time == 0 || entry.time >= m_time )
+	{
+		// measurement in sequence
+		applyMeasurement( entry );
+		if ( m_time == 0 )
+			return;
+
+		// reuse the oldest entry or the storage of a removed one
+		if ( m_history.full() )
+			m_history.rotate( m_history.begin() + 1 );
+		else
+		{
+			m_history.push_back( HistoryEntry() );
+			if ( !m_spareEntries.empty() )
+			{
+				m_history.back().state.swap( m_spareEntries.back().state );
+				m_history.back().covariance.swap( m_spareEntries.back().covariance );
+				m_spareEntries.pop_back();
+			}
+		}
+		m_history.back().assignMeasurement( entry );
+		m_history.back().state = m_state;
+		m_history.back().covariance = m_covariance;
+
+		// keep one entry at or before the start of the lag window
+		while ( m_history.size() > 1 && m_history[ 1 ].time + m_maxLag <= m_time )
+		{
+			m_spareEntries.push_back( HistoryEntry() );
+			m_spareEntries.back().state.swap( m_history.front().state );
+			m_spareEntries.back().covariance.swap( m_history.front().covariance );
+			m_history.pop_front();
+		}
+		return;
+	}
+
+	// out-of-sequence measurement: need a state at or before its time
+	if ( m_history.empty() || entry.time < m_history.front().time || m_time - entry.time > m_maxLag )
+	{
+		LOG4CPP_NOTICE( logger, "Discarding measurement " << ( m_time - entry.time ) * 1e-6 << "ms older than the current state" );
+		return;
+	}
+
+	LOG4CPP_DEBUG( logger, "Out-of-sequence measurement at t = " << entry.time << ", current time " << m_time );
+
+	// roll back to the state after the preceding measurement
+	boost::circular_buffer< HistoryEntry >::iterator it = 
+		std::upper_bound( m_history.begin(), m_history.end(), entry.time, HistoryTimeLess() );
+	m_state = ( it - 1 )->state;
+	m_covariance = ( it - 1 )->covariance;
+	m_time = ( it - 1 )->time;
+
+	// insert and replay the newer measurements (a full buffer drops its oldest entry)
+	for ( it = m_history.insert( it, entry ); it != m_history.end(); ++it )
+	{
+		applyMeasurement( *it );
+		it->state = m_state;
+		it->covariance = m_covariance;
+	}
+}
+
+
+void PoseKalmanFilter::applyMeasurement( const HistoryEntry& entry )
+{
+	switch ( entry.type )
+	{
+		case poseMeasurement:
+			updatePose( entry.pose );
+			break;
+		case rotationMeasurement:
+			updateRotation( entry.rotation );
+			break;
+		case rotationVelocityMeasurement:
+			updateRotationVelocity( entry.rotationVelocity );
+			break;
+		case inverseRotationVelocityMeasurement:
+			updateInverseRotationVelocity( entry.rotationVelocity );
+			break;
+	}
+}
+
+
+void PoseKalmanFilter::updatePose( const Measurement::ErrorPose& m )
 {
 	assert( m_motionModel.posOrder() >= 0 && m_motionModel.oriOrder() >= 0 );
 	int iR = 3 * ( m_motionModel.posOrder() + 1 ); // shortcut for first index of orientation
@@ -120,14 +258,17 @@ void PoseKalmanFilter::addPoseMeasurement( const Measurement::ErrorPose& m )
 		ublas::subrange( v.value, 3, 7 ) *= -1;
 	
 	// measurement update:
-	Math::Stochastic::kalmanMeasurementUpdate( m_state, m_covariance, PoseMeasurement( iR ), v.value, v.covariance, 0, iR + 4 );
+	if ( m_bFixedSize )
+		FixedSizeFilter::measurementUpdate< 10 >( m_state, m_covariance, Function::PoseMeasurement( iR ), v.value, v.covariance );
+	else
+		Math::Stochastic::kalmanMeasurementUpdate( m_state, m_covariance, Function::PoseMeasurement( iR ), v.value, v.covariance, 0, iR + 4 );
 
 	// normalize quaternion
 	normalize();
 }
 
 
-void PoseKalmanFilter::addRotationMeasurement( const Measurement::Rotation& m )
+void PoseKalmanFilter::updateRotation( const Measurement::Rotation& m )
 {
 	assert( m_motionModel.oriOrder() >= 0 );
 	int iR = 3 + 3 * m_motionModel.posOrder(); // shortcut for first index of orientation
@@ -150,14 +291,17 @@ void PoseKalmanFilter::addRotationMeasurement( const Measurement::Rotation& m )
 		v.value *= -1;
 	
 	// measurement update:
-	Math::Stochastic::kalmanMeasurementUpdateIdentity( m_state, m_covariance, v.value, v.covariance, iR, iR + 4 );
+	if ( m_bFixedSize )
+		FixedSizeFilter::measurementUpdateIdentity( m_state, m_covariance, v.value, v.covariance, iR );
+	else
+		Math::Stochastic::kalmanMeasurementUpdateIdentity( m_state, m_covariance, v.value, v.covariance, iR, iR + 4 );
 
 	// normalize quaternion
 	normalize();
 }
 
 
-void PoseKalmanFilter::addRotationVelocityMeasurement( const Measurement::RotationVelocity& m )
+void PoseKalmanFilter::updateRotationVelocity( const Measurement::RotationVelocity& m )
 {
 	assert( m_motionModel.oriOrder() >= 1 );
 	
@@ -174,14 +318,17 @@ void PoseKalmanFilter::addRotationVelocityMeasurement( const Measurement::Rotati
 	
 	// measurement update:
 	int iV = 4 + 3 * ( m_motionModel.posOrder() + 1 ); // shortcut for first index of rotation velocity
-	Math::Stochastic::kalmanMeasurementUpdateIdentity( m_state, m_covariance, v.value, v.covariance, iV, iV + 3 );
+	if ( m_bFixedSize )
+		FixedSizeFilter::measurementUpdateIdentity( m_state, m_covariance, v.value, v.covariance, iV );
+	else
+		Math::Stochastic::kalmanMeasurementUpdateIdentity( m_state, m_covariance, v.value, v.covariance, iV, iV + 3 );
 
 	// normalize quaternion
 	normalize();
 }
 
 
-void PoseKalmanFilter::addInverseRotationVelocityMeasurement( const Measurement::RotationVelocity& m )
+void PoseKalmanFilter::updateInverseRotationVelocity( const Measurement::RotationVelocity& m )
 {
 	assert( m_motionModel.oriOrder() >= 1 );
 	
@@ -198,7 +345,10 @@ void PoseKalmanFilter::addInverseRotationVelocityMeasurement( const Measurement:
 	
 	// measurement update:
 	int iR = 3 * ( m_motionModel.posOrder() + 1 ); // shortcut for first index of orientation
-	Math::Stochastic::kalmanMeasurementUpdate( m_state, m_covariance, Function::InvertRotationVelocity(), v.value, v.covariance, iR, iR + 7 );
+	if ( m_bFixedSize )
+		FixedSizeFilter::measurementUpdate< 7 >( m_state, m_covariance, Function::InvertRotationVelocity(), v.value, v.covariance, iR );
+	else
+		Math::Stochastic::kalmanMeasurementUpdate( m_state, m_covariance, Function::InvertRotationVelocity(), v.value, v.covariance, iR, iR + 7 );
 
 	// normalize quaternion
 	normalize();
@@ -217,17 +367,7 @@ void PoseKalmanFilter::timeUpdate( Measurement::Timestamp t )
 	// update state
 	double dt = ( (long long int)( t - m_time ) ) * 1e-9;
 	LOG4CPP_DEBUG( logger, "Time update to t = " << t << ", dt = " << dt );
-	if ( m_bInsideOut )
-		Math::Stochastic::transformWithCovariance( 
-			Function::InsideOutPoseTimeUpdate( dt, m_motionModel.posOrder() ), 
-				m_state, m_covariance, m_state, m_covariance );
-	else
-		Math::Stochastic::transformWithCovariance( 
-			Function::PoseTimeUpdate( dt, m_motionModel.posOrder(), m_motionModel.oriOrder() ),
-				m_state, m_covariance, m_state, m_covariance );
-	
-	// add process noise
-	m_motionModel.addNoise( m_covariance, dt );
+	predict( m_state, m_covariance, m_state, m_covariance, dt );
 	
 	m_time = t;
 }
@@ -239,8 +379,11 @@ void PoseKalmanFilter::normalize()
 	if ( m_motionModel.oriOrder() >= 0 )
 	{
 		// normalize quaternion
-		Math::Stochastic::transformRangeInternalWithCovariance( Math::Optimization::Function::VectorNormalize( 4 ), 
-			m_state, m_covariance, iR, iR + 4, iR, iR + 4 );
+		if ( m_bFixedSize )
+			FixedSizeFilter::transformRange< 4, 4 >( m_state, m_covariance, Math::Optimization::Function::VectorNormalize( 4 ), iR, iR );
+		else
+			Math::Stochastic::transformRangeInternalWithCovariance( Math::Optimization::Function::VectorNormalize( 4 ), 
+				m_state, m_covariance, iR, iR + 4, iR, iR + 4 );
 	}
 
 	if ( m_motionModel.oriOrder() >= 1 )
@@ -272,38 +415,150 @@ Measurement::ErrorPose PoseKalmanFilter::predictPose( Measurement::Timestamp t )
 	if ( !m_time )
 		UBITRACK_THROW( "kalman filter not (yet) initialized" );
 
-	assert( m_motionModel.posOrder() >= 0 && m_motionModel.oriOrder() >= 0 );
-	const int iR = 3 * ( m_motionModel.posOrder() + 1 );
-
 	double dt = ( (long long int)( t - m_time ) ) * 1e-9;
 	LOG4CPP_DEBUG( logger, "predicting for t=" << t << ", dt=" << dt );
 
 	// update state
 	Math::Vector< double > newState( m_state.size() );
 	Math::Matrix< double, 0, 0 > newCovariance( m_state.size(), m_state.size() );
-	if ( m_bInsideOut )
+	predict( newState, newCovariance, m_state, m_covariance, dt );
+	LOG4CPP_TRACE( logger, "predicted state:" << newState );
+	
+	return toErrorPose( t, newState, newCovariance );
+}
+
+
+Measurement::ErrorPose PoseKalmanFilter::smoothPose( Measurement::Timestamp t ) const
+{
+	if ( !m_time )
+		UBITRACK_THROW( "kalman filter not (yet) initialized" );
+
+	// nothing to smooth after the last measurement: forward prediction of the filtered state
+	if ( m_history.empty() || t >= m_history.back().time )
+	{
+		const StateType& state( m_history.empty() ? m_state : m_history.back().state );
+		const CovarianceType& covariance( m_history.empty() ? m_covariance : m_history.back().covariance );
+		const Measurement::Timestamp time( m_history.empty() ? m_time : m_history.back().time );
+		StateType newState( state.size() );
+		CovarianceType newCovariance( state.size(), state.size() );
+		predict( newState, newCovariance, state, covariance, ( (long long int)( t - time ) ) * 1e-9 );
+		return toErrorPose( t, newState, newCovariance );
+	}
+
+	if ( t < m_history.front().time )
+		UBITRACK_THROW( "requested timestamp is outside of the lag window" );
+
+	const int iR = 3 * ( m_motionModel.posOrder() + 1 );
+
+	// filtered estimate at t, predicted from the preceding measurement
+	boost::circular_buffer< HistoryEntry >::const_iterator it = 
+		std::upper_bound( m_history.begin(), m_history.end(), t, HistoryTimeLess() );
+	StateType state( ( it - 1 )->state );
+	CovarianceType covariance( ( it - 1 )->covariance );
+	if ( t > ( it - 1 )->time )
+	{
+		predict( state, covariance, ( it - 1 )->state, ( it - 1 )->covariance, ( t - ( it - 1 )->time ) * 1e-9 );
+		normalizeQuaternion( state, covariance, iR );
+	}
+
+	// backward pass from the newest entry
+	StateType smoothedState( m_history.back().state );
+	CovarianceType smoothedCovariance( m_history.back().covariance );
+	for ( boost::circular_buffer< HistoryEntry >::const_iterator itNext = m_history.end() - 1; itNext != it - 1; --itNext )
+		if ( itNext == it )
+			smoothingStep( smoothedState, smoothedCovariance, state, covariance, ( itNext->time - t ) * 1e-9 );
+		else
+			smoothingStep( smoothedState, smoothedCovariance, ( itNext - 1 )->state, ( itNext - 1 )->covariance, 
+				( itNext->time - ( itNext - 1 )->time ) * 1e-9 );
+
+	return toErrorPose( t, smoothedState, smoothedCovariance );
+}
+
+
+void PoseKalmanFilter::smoothingStep( StateType& smoothedState, CovarianceType& smoothedCovariance, 
+	const StateType& filteredState, const CovarianceType& filteredCovariance, double dt ) const
+{
+	// nothing happens between measurements with the same timestamp
+	if ( dt == 0 )
+		return;
+
+	const int iR = 3 * ( m_motionModel.posOrder() + 1 );
+	StateType predictedState( filteredState.size() );
+	CovarianceType predictedCovariance( filteredState.size(), filteredState.size() );
+	CovarianceType jacobian( filteredState.size(), filteredState.size() );
+	predict( predictedState, predictedCovariance, filteredState, filteredCovariance, dt, &jacobian );
+
+	// smoother gain C = P F^T Pp^-1
+	const CovarianceType pft( ublas::prod( filteredCovariance, ublas::trans( jacobian ) ) );
+	const CovarianceType gain( ublas::prod( pft, Math::invert_matrix( predictedCovariance ) ) );
+
+	// make sure that quaternion signs agree
+	if ( m_motionModel.oriOrder() >= 0 && 
+		ublas::inner_prod( ublas::subrange( smoothedState, iR, iR + 4 ), ublas::subrange( predictedState, iR, iR + 4 ) ) < 0 )
+		ublas::subrange( smoothedState, iR, iR + 4 ) *= -1;
+
+	smoothedState = filteredState + ublas::prod( gain, smoothedState - predictedState );
+	const CovarianceType tmp( ublas::prod( gain, smoothedCovariance - predictedCovariance ) );
+	smoothedCovariance = filteredCovariance + ublas::prod( tmp, ublas::trans( gain ) );
+
+	if ( m_motionModel.oriOrder() >= 0 )
+		normalizeQuaternion( smoothedState, smoothedCovariance, iR );
+}
+
+
+void PoseKalmanFilter::predict( StateType& newState, CovarianceType& newCovariance, const StateType& state, 
+	const CovarianceType& covariance, double dt, CovarianceType* pJacobian ) const
+{
+	if ( pJacobian )
+	{
+		// explicit jacobian for the smoother
+		*pJacobian = CovarianceType::zeros( state.size(), state.size() );
+		if ( m_bInsideOut )
+			Function::InsideOutPoseTimeUpdate( dt, m_motionModel.posOrder() ).evaluateWithJacobian( newState, state, *pJacobian );
+		else
+			Function::PoseTimeUpdate( dt, m_motionModel.posOrder(), m_motionModel.oriOrder() ).evaluateWithJacobian( newState, state, *pJacobian );
+		const CovarianceType tmp( ublas::prod( *pJacobian, covariance ) );
+		newCovariance = ublas::prod( tmp, ublas::trans( *pJacobian ) );
+	}
+	else if ( m_bFixedSize )
+	{
+		// works in place if newState and state are the same
+		newState = state;
+		newCovariance = covariance;
+		if ( m_bInsideOut )
+			FixedSizeFilter::transformRange< 13, 13 >( newState, newCovariance, Function::InsideOutPoseTimeUpdate( dt, 1 ) );
+		else
+			FixedSizeFilter::transformRange< 13, 13 >( newState, newCovariance, Function::PoseTimeUpdate( dt, 1, 1 ) );
+	}
+	else if ( m_bInsideOut )
 		Math::Stochastic::transformWithCovariance( 
 			Function::InsideOutPoseTimeUpdate( dt, m_motionModel.posOrder() ), 
-				newState, newCovariance, m_state, m_covariance );
+				newState, newCovariance, state, covariance );
 	else
 		Math::Stochastic::transformWithCovariance( 
 			Function::PoseTimeUpdate( dt, m_motionModel.posOrder(), m_motionModel.oriOrder() ),
-				newState, newCovariance, m_state, m_covariance );
+				newState, newCovariance, state, covariance );
 	
 	// add process noise
 	m_motionModel.addNoise( newCovariance, dt );
-	LOG4CPP_TRACE( logger, "predicted state:" << newState );
-	
+}
+
+
+Measurement::ErrorPose PoseKalmanFilter::toErrorPose( Measurement::Timestamp t, const StateType& state, const CovarianceType& covariance ) const
+{
+	assert( m_motionModel.posOrder() >= 0 && m_motionModel.oriOrder() >= 0 );
+	const int iR = 3 * ( m_motionModel.posOrder() + 1 );
+
 	// convert to 7x7 error
 	Math::ErrorVector< double, 7 > newPose;
-	ublas::subrange( newPose.value, 0, 3 ) = ublas::subrange( newState, 0, 3 );
-	ublas::subrange( newPose.value, 3, 7 ) = ublas::subrange( newState, iR, iR + 4 );
-	ublas::subrange( newPose.covariance, 0, 3, 0, 3 ) = ublas::subrange( newCovariance, 0, 3, 0, 3 );
-	ublas::subrange( newPose.covariance, 0, 3, 3, 7 ) = ublas::subrange( newCovariance, 0, 3, iR, iR + 4 );
-	ublas::subrange( newPose.covariance, 3, 7, 0, 3 ) = ublas::subrange( newCovariance, iR, iR + 4, 0, 3 );
-	ublas::subrange( newPose.covariance, 3, 7, 3, 7 ) = ublas::subrange( newCovariance, iR, iR + 4, iR, iR + 4 );
+	ublas::subrange( newPose.value, 0, 3 ) = ublas::subrange( state, 0, 3 );
+	ublas::subrange( newPose.value, 3, 7 ) = ublas::subrange( state, iR, iR + 4 );
+	ublas::subrange( newPose.covariance, 0, 3, 0, 3 ) = ublas::subrange( covariance, 0, 3, 0, 3 );
+	ublas::subrange( newPose.covariance, 0, 3, 3, 7 ) = ublas::subrange( covariance, 0, 3, iR, iR + 4 );
+	ublas::subrange( newPose.covariance, 3, 7, 0, 3 ) = ublas::subrange( covariance, iR, iR + 4, 0, 3 );
+	ublas::subrange( newPose.covariance, 3, 7, 3, 7 ) = ublas::subrange( covariance, iR, iR + 4, iR, iR + 4 );
 	
-	LOG4CPP_DEBUG( logger, "predicted pose and covariance: " << newPose.value << std::endl << newPose.covariance );
+	LOG4CPP_DEBUG( logger, "pose and covariance: " << newPose.value << std::endl << newPose.covariance );
 	return Measurement::ErrorPose( t, Math::ErrorPose::fromAdditiveErrorVector( newPose ) );
 }
 
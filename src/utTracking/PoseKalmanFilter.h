@@ -36,6 +36,9 @@
 
 #ifdef HAVE_LAPACK
 
+#include <vector>
+#include <boost/circular_buffer.hpp>
+
 #include <utCore.h>
 #include <utMath/ErrorVector.h>
 #include <utMeasurement/Measurement.h>
@@ -49,7 +52,6 @@ namespace Ubitrack { namespace Tracking {
  * - include position (well, it's no longer RotationOnly then...)
  * - allow configuration of process noise (insted of hard-coded)
  * - input and output of covariances (insted of hard-coded)
- * - correct integration of measurements from the past
  */
  
 /**
@@ -58,6 +60,14 @@ namespace Ubitrack { namespace Tracking {
  *
  * Unfortunately, covariances of measurements and process noise can't be 
  * configured at the moment.
+ *
+ * The standard motion model with one position and one orientation derivative uses the
+ * fixed-size \c Math::Stochastic::KalmanFilter, which does not allocate memory per update.
+ *
+ * If a lag window is configured, the filter keeps a bounded history of the measurements and the
+ * corresponding posterior states. A measurement that arrives late, but within the lag window, is
+ * integrated at its correct time by rolling back to the preceding state and replaying the
+ * newer measurements. The history also allows to query smoothed poses inside the lag window.
  */
 class UBITRACK_EXPORT PoseKalmanFilter
 {
@@ -68,8 +78,23 @@ public:
 	 * and orientation to use.
 	 * @param bInsideOut if true, a motion model is used that assumes a correlation between orientation and 
 	 * translation, e.g. when a non-moveable object is tracked by a mobile camera.
+	 * @param maxLag maximum age in nanoseconds of out-of-sequence measurements that are integrated
+	 * correctly. 0 disables the history and integrates late measurements by backward prediction.
+	 * @param historySize maximum number of measurements kept in the history
+	 */
+	PoseKalmanFilter( const LinearPoseMotionModel& motionModel, bool bInsideOut = false,
+		Measurement::Timestamp maxLag = 0, std::size_t historySize = 64 );
+
+	/**
+	 * Configures the handling of out-of-sequence measurements. Clears the history.
+	 * @param maxLag maximum age in nanoseconds of late measurements, 0 to disable the history
+	 * @param historySize maximum number of measurements kept in the history
 	 */
-	PoseKalmanFilter( const LinearPoseMotionModel& motionModel, bool bInsideOut = false );
+	void setLagWindow( Measurement::Timestamp maxLag, std::size_t historySize = 64 );
+
+	/** returns the maximum age of out-of-sequence measurements */
+	Measurement::Timestamp getLagWindow() const
+	{ return m_maxLag; }
 
 	/** 
 	 * integrate an absolute pose measurement.
@@ -107,12 +132,33 @@ public:
 	 */
 	Measurement::ErrorPose predictPose( Measurement::Timestamp t );
 
+	/**
+	 * Computes the smoothed pose for a timestamp inside the lag window, using all measurements
+	 * in the history (Rauch-Tung-Striebel smoother). For timestamps after the last measurement, 
+	 * this is the forward prediction of the filtered state after that measurement.
+	 */
+	Measurement::ErrorPose smoothPose( Measurement::Timestamp t ) const;
+
 	/** type of internal state representation */
 	typedef Math::Vector< double > StateType;
 
 	/** type of internal state representation */
 	typedef Math::Matrix< double, 0, 0 > CovarianceType;
 
+	/**
+	 * One backward step of the Rauch-Tung-Striebel smoother.
+	 * @param smoothedState in: smoothed state at time t + dt, out: smoothed state at time t
+	 * @param smoothedCovariance in: smoothed covariance at time t + dt, out: smoothed covariance at time t
+	 * @param filteredState filtered state at time t
+	 * @param filteredCovariance filtered covariance at time t
+	 * @param dt time difference in seconds
+	 */
+	void smoothingStep( StateType& smoothedState, CovarianceType& smoothedCovariance, 
+		const StateType& filteredState, const CovarianceType& filteredCovariance, double dt ) const;
+
+	/** converts a state and its covariance to a pose */
+	Measurement::ErrorPose toErrorPose( Measurement::Timestamp t, const StateType& state, const CovarianceType& covariance ) const;
+
 	/** returns the internal state */
 	const StateType& getState() const
 	{ return m_state; }
@@ -121,6 +167,10 @@ public:
 	const CovarianceType& getCovariance() const
 	{ return m_covariance; }
 
+	/** returns the timestamp of the internal state */
+	Measurement::Timestamp getTime() const
+	{ return m_time; }
+
 	/** returns the motion model */
 	const LinearPoseMotionModel& getMotionModel() const
 	{ return m_motionModel; }
@@ -134,7 +184,53 @@ public:
 	void timeUpdate( Measurement::Timestamp t );
 
 protected:
-	
+
+	/** types of measurements kept in the history */
+	enum MeasurementType { poseMeasurement, rotationMeasurement, rotationVelocityMeasurement, inverseRotationVelocityMeasurement };
+
+	/** a measurement in the history together with the posterior state after its integration */
+	struct HistoryEntry
+	{
+		HistoryEntry( MeasurementType type = poseMeasurement, Measurement::Timestamp time = 0 )
+			: type( type )
+			, time( time )
+		{}
+
+		/** copies the measurement of another entry, but keeps the storage of state and covariance */
+		void assignMeasurement( const HistoryEntry& e )
+		{
+			type = e.type;
+			time = e.time;
+			pose = e.pose;
+			rotation = e.rotation;
+			rotationVelocity = e.rotationVelocity;
+		}
+
+		MeasurementType type;
+		Measurement::Timestamp time;
+		Measurement::ErrorPose pose;
+		Measurement::Rotation rotation;
+		Measurement::RotationVelocity rotationVelocity;
+		StateType state;
+		CovarianceType covariance;
+	};
+
+	/** integrates a measurement, taking care of out-of-sequence measurements */
+	void addMeasurement( const HistoryEntry& entry );
+
+	/** integrates a measurement at the current end of the filter */
+	void applyMeasurement( const HistoryEntry& entry );
+
+	/** the actual measurement updates */
+	void updatePose( const Measurement::ErrorPose& m );
+	void updateRotation( const Measurement::Rotation& m );
+	void updateRotationVelocity( const Measurement::RotationVelocity& m );
+	void updateInverseRotationVelocity( const Measurement::RotationVelocity& m );
+
+	/** predicts state and covariance by dt seconds. Also returns the jacobian if requested */
+	void predict( StateType& newState, CovarianceType& newCovariance, const StateType& state, 
+		const CovarianceType& covariance, double dt, CovarianceType* pJacobian = 0 ) const;
+
 	/** normalizes the state */
 	void normalize();
 	
@@ -144,6 +240,9 @@ protected:
 	/** inside-out motion model? */
 	bool m_bInsideOut;
 
+	/** use the fixed-size kalman filter? Only for the standard motion model with posOrder = 1 and oriOrder = 1 */
+	bool m_bFixedSize;
+
 	/** the state */
 	StateType m_state;
 
@@ -152,6 +251,18 @@ protected:
 	
 	/** timestamp of the current state */
 	Measurement::Timestamp m_time;
+
+	/** maximum age of out-of-sequence measurements */
+	Measurement::Timestamp m_maxLag;
+
+	/** measurements and posterior states inside the lag window, ordered by time */
+	boost::circular_buffer< HistoryEntry > m_history;
+
+	/** 
+	 * entries removed from the history, whose state and covariance storage is reused for new entries,
+	 * so that measurements in sequence do not allocate memory once the history has been filled
+	 */
+	std::vector< HistoryEntry > m_spareEntries;
 };
 
 } } // namespace Ubitrack::Tracking
@@ -0,0 +1,116 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @ingroup tracking
+ * @file
+ * Implementation of offline smoothing of recorded pose streams
+ */
+
+#include "PoseSmoother.h"
+#ifdef HAVE_LAPACK
+
+#include <algorithm>
+#include <utUtil/Exception.h>
+#include "PoseKalmanFilter.h"
+
+// get a logger
+#include <log4cpp/Category.hh>
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Tracking.PoseSmoother" ) );
+
+namespace Ubitrack { namespace Tracking {
+
+PoseSmoother::PoseSmoother( const LinearPoseMotionModel& motionModel, bool bInsideOut, std::size_t chunkSize )
+	: m_motionModel( motionModel )
+	, m_bInsideOut( bInsideOut )
+	, m_chunkSize( std::max< std::size_t >( chunkSize, 1 ) )
+{
+}
+
+
+std::vector< Measurement::ErrorPose > PoseSmoother::smooth( const std::vector< Measurement::ErrorPose >& poses ) const
+{
+	std::vector< Measurement::ErrorPose > smoothed;
+	smooth( poses, smoothed );
+	return smoothed;
+}
+
+
+void PoseSmoother::smooth( const std::vector< Measurement::ErrorPose >& poses, std::vector< Measurement::ErrorPose >& smoothed ) const
+{
+	const std::size_t n( poses.size() );
+	smoothed.resize( n );
+	if ( n == 0 )
+		return;
+
+	for ( std::size_t i = 1; i < n; i++ )
+		if ( poses[ i ].time() < poses[ i - 1 ].time() )
+			UBITRACK_THROW( "PoseSmoother needs poses ordered by timestamp" );
+
+	// forward pass: only keep the filter at the beginning of each chunk
+	const std::size_t nChunks( ( n + m_chunkSize - 1 ) / m_chunkSize );
+	std::vector< PoseKalmanFilter > checkpoints;
+	checkpoints.reserve( nChunks );
+	PoseKalmanFilter filter( m_motionModel, m_bInsideOut );
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		if ( i % m_chunkSize == 0 )
+			checkpoints.push_back( filter );
+		filter.addPoseMeasurement( poses[ i ] );
+	}
+	LOG4CPP_DEBUG( logger, "Smoothing " << n << " poses in " << nChunks << " chunks" );
+
+	// backward pass, chunk by chunk
+	std::vector< PoseKalmanFilter::StateType > states( std::min( n, m_chunkSize ) );
+	std::vector< PoseKalmanFilter::CovarianceType > covariances( states.size() );
+	PoseKalmanFilter::StateType smoothedState( filter.getState() );
+	PoseKalmanFilter::CovarianceType smoothedCovariance( filter.getCovariance() );
+	for ( std::size_t iChunk = nChunks; iChunk-- > 0; )
+	{
+		const std::size_t iBegin( iChunk * m_chunkSize );
+		const std::size_t iEnd( std::min( n, iBegin + m_chunkSize ) );
+
+		// re-filter the chunk
+		PoseKalmanFilter chunkFilter( checkpoints[ iChunk ] );
+		for ( std::size_t i = iBegin; i < iEnd; i++ )
+		{
+			chunkFilter.addPoseMeasurement( poses[ i ] );
+			states[ i - iBegin ] = chunkFilter.getState();
+			covariances[ i - iBegin ] = chunkFilter.getCovariance();
+		}
+
+		for ( std::size_t i = iEnd; i-- > iBegin; )
+		{
+			if ( i + 1 < n )
+				filter.smoothingStep( smoothedState, smoothedCovariance, states[ i - iBegin ], covariances[ i - iBegin ], 
+					( poses[ i + 1 ].time() - poses[ i ].time() ) * 1e-9 );
+			smoothed[ i ] = filter.toErrorPose( poses[ i ].time(), smoothedState, smoothedCovariance );
+		}
+	}
+}
+
+} } // namespace Ubitrack::Tracking
+
+#endif // HAVE_LAPACK
@@ -0,0 +1,95 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @ingroup tracking
+ * @file
+ * Offline smoothing of recorded pose streams
+ */
+ 
+#ifndef __UBITRACK_TRACKING_POSESMOOTHER_H_INCLUDED__
+#define __UBITRACK_TRACKING_POSESMOOTHER_H_INCLUDED__
+
+
+#ifdef HAVE_LAPACK
+
+#include <vector>
+#include <utCore.h>
+#include <utMeasurement/Measurement.h>
+#include "LinearPoseMotionModel.h"
+
+namespace Ubitrack { namespace Tracking {
+
+/**
+ * Forward-backward (Rauch-Tung-Striebel) smoother for recorded sequences of poses.
+ *
+ * The forward pass runs a \c PoseKalmanFilter over the whole sequence, but only keeps a copy of 
+ * the filter at the beginning of each chunk. The backward pass then processes the chunks from
+ * the last to the first: it re-filters the chunk from its checkpoint into a buffer of 
+ * \c chunkSize states and covariances, which stays in the cache, and runs the smoother over it.
+ * Apart from the result, memory is therefore proportional to the number of chunks plus the chunk size,
+ * at the cost of running the forward filter twice.
+ */
+class UBITRACK_EXPORT PoseSmoother
+{
+public:
+	/**
+	 * Constructor.
+	 * @param motionModel Motion model that defines the process noise and the number of derivatives
+	 * @param bInsideOut use the inside-out motion model, see \c PoseKalmanFilter
+	 * @param chunkSize number of poses re-filtered and smoothed at once
+	 */
+	PoseSmoother( const LinearPoseMotionModel& motionModel, bool bInsideOut = false, std::size_t chunkSize = 64 );
+
+	/**
+	 * Smoothes a sequence of poses.
+	 * @param poses measured poses, ordered by timestamp
+	 * @param smoothed receives the smoothed poses, one for each measurement
+	 */
+	void smooth( const std::vector< Measurement::ErrorPose >& poses, std::vector< Measurement::ErrorPose >& smoothed ) const;
+
+	/** returns the smoothed sequence of poses */
+	std::vector< Measurement::ErrorPose > smooth( const std::vector< Measurement::ErrorPose >& poses ) const;
+
+	/** returns the motion model */
+	const LinearPoseMotionModel& getMotionModel() const
+	{ return m_motionModel; }
+
+protected:
+	/** the motion model */
+	LinearPoseMotionModel m_motionModel;
+
+	/** inside-out motion model? */
+	bool m_bInsideOut;
+
+	/** number of poses processed at once in the backward pass */
+	std::size_t m_chunkSize;
+};
+
+} } // namespace Ubitrack::Tracking
+
+#endif // HAVE_LAPACK
+
+#endif
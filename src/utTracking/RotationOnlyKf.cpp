@@ -40,12 +40,18 @@
 // get a logger
 #include <log4cpp/Category.hh>
 static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Tracking.RotationOnlyKF" ) );
-#define KALMAN_LOGGING
 
-#include <utMath/Stochastic/Kalman.h>
+#include <utMath/Stochastic/KalmanFilter.h>
 
 namespace ublas = boost::numeric::ublas;
 
+namespace {
+
+/** the state has a fixed size: rotation and rotation velocity */
+typedef Ubitrack::Math::Stochastic::KalmanFilter< double, 7 > FixedSizeFilter;
+
+}
+
 namespace Ubitrack { namespace Tracking {
 
 RotationOnlyKF::RotationOnlyKF()
@@ -74,10 +80,10 @@ void RotationOnlyKF::addRotationMeasurement( const Measurement::Rotation& m )
 	v.covariance = Math::Matrix< double, 4, 4 >::identity() * 0.004; // magic number, tune here
 	
 	// measurement update:
-	Math::Stochastic::kalmanMeasurementUpdateIdentity< 7, 4 >( m_state, v, 0, 4 );
+	FixedSizeFilter::measurementUpdateIdentity( m_state.value, m_state.covariance, v.value, v.covariance, 0 );
 
 	// normalize quaternion
-	Math::Stochastic::transformRangeInternalWithCovariance< 7 >( Math::Optimization::Function::VectorNormalize( 4 ), m_state, 0, 4, 0, 4 );
+	FixedSizeFilter::transformRange< 4, 4 >( m_state.value, m_state.covariance, Math::Optimization::Function::VectorNormalize( 4 ) );
 }
 
 
@@ -92,10 +98,10 @@ void RotationOnlyKF::addVelocityMeasurement( const Measurement::RotationVelocity
 	v.covariance = Math::Matrix< double, 3, 3 >::identity() * 0.00001; // magic number, tune here
 	
 	// measurement update:
-	Math::Stochastic::kalmanMeasurementUpdateIdentity< 7, 3 >( m_state, v, 4, 7 );
+	FixedSizeFilter::measurementUpdateIdentity( m_state.value, m_state.covariance, v.value, v.covariance, 4 );
 
 	// normalize quaternion
-	Math::Stochastic::transformRangeInternalWithCovariance< 7 >( Math::Optimization::Function::VectorNormalize( 4 ), m_state, 0, 4, 0, 4 );
+	FixedSizeFilter::transformRange< 4, 4 >( m_state.value, m_state.covariance, Math::Optimization::Function::VectorNormalize( 4 ) );
 }
 
 
@@ -110,7 +116,7 @@ void RotationOnlyKF::timeUpdate( Measurement::Timestamp t )
 	
 	// update state
 	double dt = ( (long long int)( t - m_time ) ) * 1e-9;
-	Math::Stochastic::transformRangeInternalWithCovariance< 7 >( Function::QuaternionTimeUpdate( dt ), m_state, 0, 4, 0, 7 );
+	FixedSizeFilter::transformRange< 4, 7 >( m_state.value, m_state.covariance, Function::QuaternionTimeUpdate( dt ) );
 	
 	// add process noise
 	// TODO: better motion model
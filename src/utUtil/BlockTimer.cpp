@@ -31,37 +31,379 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <limits>
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
 
 #include "BlockTimer.h"
+#include "Metrics.h"
+
+#if defined( _MSC_VER )
+	#define BLOCKTIMER_THREAD_LOCAL __declspec( thread )
+#else
+	#define BLOCKTIMER_THREAD_LOCAL __thread
+#endif
 
 namespace Ubitrack { namespace Util { 
 
+namespace {
+
+	/** maximal number of shards of each timer */
+	const std::size_t g_nMaxShards = 64;
+
+	/** number of shards of each timer, one per hardware thread */
+	std::size_t shardCount()
+	{
+		static const std::size_t nShards = std::max< std::size_t >( 1, 
+			std::min< std::size_t >( boost::thread::hardware_concurrency(), g_nMaxShards ) );
+		return nShards;
+	}
+
+	/** shard of the current thread plus one, 0 if not yet assigned */
+	BLOCKTIMER_THREAD_LOCAL unsigned g_threadShard = 0;
+
+	/** counter for assigning shards to threads round-robin */
+	boost::atomic< unsigned > g_nextShard( 0 );
+
+	std::size_t threadShard()
+	{
+		if ( !g_threadShard )
+			g_threadShard = g_nextShard.fetch_add( 1, boost::memory_order_relaxed ) % shardCount() + 1;
+		return g_threadShard - 1;
+	}
+
+	/** index of the most significant bit, v > 0 */
+	unsigned msb( unsigned long long v )
+	{
+	#if defined( __GNUC__ )
+		return 63 - __builtin_clzll( v );
+	#else
+		unsigned r = 0;
+		while ( v >>= 1 )
+			r++;
+		return r;
+	#endif
+	}
+
+	/** atomically replaces the value by v if v is smaller */
+	void atomicMin( boost::atomic< unsigned long long >& a, unsigned long long v )
+	{
+		unsigned long long old = a.load( boost::memory_order_relaxed );
+		while ( v < old && !a.compare_exchange_weak( old, v, boost::memory_order_relaxed ) )
+			;
+	}
+
+	/** atomically replaces the value by v if v is larger */
+	void atomicMax( boost::atomic< unsigned long long >& a, unsigned long long v )
+	{
+		unsigned long long old = a.load( boost::memory_order_relaxed );
+		while ( v > old && !a.compare_exchange_weak( old, v, boost::memory_order_relaxed ) )
+			;
+	}
+
+}
+
+
+struct BlockTimer::Shard
+{
+	Shard()
+		: ticks( 0 )
+		, minTicks( std::numeric_limits< unsigned long long >::max() )
+		, maxTicks( 0 )
+	{
+		for ( std::size_t i = 0; i < nBuckets; i++ )
+			histogram[ i ].store( 0, boost::memory_order_relaxed );
+	}
+
+	boost::atomic< unsigned long long > ticks;
+	boost::atomic< unsigned long long > minTicks;
+	boost::atomic< unsigned long long > maxTicks;
+
+	/** the number of runs is the sum of the histogram */
+	boost::atomic< unsigned long long > histogram[ nBuckets ];
+
+	/** keeps the counters of different shards in different cache lines */
+	char padding[ 64 ];
+};
+
+
+BlockTimer::Snapshot::Snapshot()
+	: runs( 0 )
+	, totalTime( 0 )
+	, minTime( 0 )
+	, maxTime( 0 )
+	, histogram( nBuckets, 0 )
+	, ticksPerMs( getHighPerformanceFrequency() / 1000 )
+{
+}
+
+
+double BlockTimer::Snapshot::getPercentile( double p ) const
+{
+	if ( !runs )
+		return 0.0;
+
+	// smallest bucket that contains the p * runs-th run
+	const double rank = std::max( 1.0, std::min( p, 1.0 ) * runs );
+	unsigned long long sum = 0;
+	std::size_t b = 0;
+	for ( ; b < nBuckets - 1; b++ )
+	{
+		sum += histogram[ b ];
+		if ( sum >= rank )
+			break;
+	}
+
+	// middle of the bucket, limited by the extreme values
+	const double middle = ( bucketBegin( b ) + ( b + 1 < nBuckets ? bucketBegin( b + 1 ) - 1 : bucketBegin( b ) ) ) / 2.0 / ticksPerMs;
+	return std::max( minTime, std::min( maxTime, middle ) );
+}
+
+
+BlockTimer::BlockTimer( const std::string& sName, const std::string& sLoggingCategory )
+	: m_sName( sName )
+	, m_pLogger( sLoggingCategory.empty() ? 0 : &log4cpp::Category::getInstance( sLoggingCategory ) )
+	, m_nCodeLine( 0 )
+	, m_initState( 0 )
+	, m_shards( new boost::atomic< Shard* >[ shardCount() ] )
+	, m_startTime( getHighPerformanceCounter() )
+	, m_reportInterval( 0 )
+	, m_nextReport( 0 )
+{
+	for ( std::size_t i = 0; i < shardCount(); i++ )
+		m_shards[ i ].store( 0, boost::memory_order_relaxed );
+	MetricsRegistry::instance().add( this );
+}
+
+
+BlockTimer::BlockTimer( const std::string& sName, log4cpp::Category& logger )
+	: m_sName( sName )
+	, m_pLogger( &logger )
+	, m_nCodeLine( 0 )
+	, m_initState( 0 )
+	, m_shards( new boost::atomic< Shard* >[ shardCount() ] )
+	, m_startTime( getHighPerformanceCounter() )
+	, m_reportInterval( 0 )
+	, m_nextReport( 0 )
+{
+	for ( std::size_t i = 0; i < shardCount(); i++ )
+		m_shards[ i ].store( 0, boost::memory_order_relaxed );
+	MetricsRegistry::instance().add( this );
+}
+
 
 BlockTimer::~BlockTimer()
 {
-	if ( m_pLogger && m_nRuns ) 
-	{ 
-		std::ostringstream s;
-		s << *this;
-		m_pLogger->log( log4cpp::Priority::info, s.str(), m_sCodeFile.c_str(), m_nCodeLine );
+	MetricsRegistry::instance().remove( this );
+
+	if ( m_pLogger && getRuns() ) 
+		report( snapshot() ).log();
+
+	for ( std::size_t i = 0; i < shardCount(); i++ )
+		delete m_shards[ i ].load( boost::memory_order_relaxed );
+}
+
+
+BlockTimer::Shard& BlockTimer::shard( std::size_t i )
+{
+	Shard* pShard = m_shards[ i ].load( boost::memory_order_acquire );
+	if ( !pShard )
+	{
+		// allocated on first use, so timers used by few threads stay small
+		Shard* pNew = new Shard;
+		if ( m_shards[ i ].compare_exchange_strong( pShard, pNew, boost::memory_order_acq_rel, boost::memory_order_acquire ) )
+			pShard = pNew;
+		else
+			delete pNew;
 	}
+	return *pShard;
+}
+
+
+void BlockTimer::addMeasurement( unsigned long long ticks )
+{
+	Shard& s( shard( threadShard() ) );
+	s.ticks.fetch_add( ticks, boost::memory_order_relaxed );
+	s.histogram[ bucket( ticks ) ].fetch_add( 1, boost::memory_order_relaxed );
+	atomicMin( s.minTicks, ticks );
+	atomicMax( s.maxTicks, ticks );
+}
+
+
+double BlockTimer::getTotalTime() const
+{
+	unsigned long long ticks = 0;
+	for ( std::size_t i = 0; i < shardCount(); i++ )
+		if ( const Shard* pShard = m_shards[ i ].load( boost::memory_order_acquire ) )
+			ticks += pShard->ticks.load( boost::memory_order_relaxed );
+	return ticks / getHighPerformanceFrequency() * 1000;
+}
+
+
+double BlockTimer::getAvgTime() const
+{
+	return getTotalTime() / getRuns();
+}
+
+
+std::size_t BlockTimer::getRuns() const
+{
+	unsigned long long runs = 0;
+	for ( std::size_t i = 0; i < shardCount(); i++ )
+		if ( const Shard* pShard = m_shards[ i ].load( boost::memory_order_acquire ) )
+			for ( std::size_t b = 0; b < nBuckets; b++ )
+				runs += pShard->histogram[ b ].load( boost::memory_order_relaxed );
+	return static_cast< std::size_t >( runs );
+}
+
+
+BlockTimer::Snapshot BlockTimer::snapshot( bool bReset )
+{
+	Snapshot s;
+	unsigned long long ticks = 0;
+	unsigned long long minTicks = std::numeric_limits< unsigned long long >::max();
+	unsigned long long maxTicks = 0;
+	for ( std::size_t i = 0; i < shardCount(); i++ )
+	{
+		Shard* pShard = m_shards[ i ].load( boost::memory_order_acquire );
+		if ( !pShard )
+			continue;
+		Shard& shard( *pShard );
+		if ( bReset )
+		{
+			ticks += shard.ticks.exchange( 0, boost::memory_order_relaxed );
+			minTicks = std::min( minTicks, shard.minTicks.exchange( std::numeric_limits< unsigned long long >::max(), boost::memory_order_relaxed ) );
+			maxTicks = std::max( maxTicks, shard.maxTicks.exchange( 0, boost::memory_order_relaxed ) );
+			for ( std::size_t b = 0; b < nBuckets; b++ )
+				s.histogram[ b ] += shard.histogram[ b ].exchange( 0, boost::memory_order_relaxed );
+		}
+		else
+		{
+			ticks += shard.ticks.load( boost::memory_order_relaxed );
+			minTicks = std::min( minTicks, shard.minTicks.load( boost::memory_order_relaxed ) );
+			maxTicks = std::max( maxTicks, shard.maxTicks.load( boost::memory_order_relaxed ) );
+			for ( std::size_t b = 0; b < nBuckets; b++ )
+				s.histogram[ b ] += shard.histogram[ b ].load( boost::memory_order_relaxed );
+		}
+	}
+	for ( std::size_t b = 0; b < nBuckets; b++ )
+		s.runs += static_cast< std::size_t >( s.histogram[ b ] );
+	if ( bReset )
+		m_startTime.store( getHighPerformanceCounter(), boost::memory_order_relaxed );
+
+	s.totalTime = ticks / s.ticksPerMs;
+	s.minTime = s.runs ? minTicks / s.ticksPerMs : 0.0;
+	s.maxTime = maxTicks / s.ticksPerMs;
+	return s;
+}
+
+
+void BlockTimer::setReportInterval( double seconds )
+{
+	const unsigned long long interval = static_cast< unsigned long long >( seconds * getHighPerformanceFrequency() );
+	m_nextReport.store( getHighPerformanceCounter() + interval, boost::memory_order_relaxed );
+	m_reportInterval.store( interval, boost::memory_order_relaxed );
+	if ( interval )
+		MetricsRegistry::instance().scheduleReports();
+}
+
+
+unsigned long long BlockTimer::reportIfDue( unsigned long long now, std::vector< Report >& reports )
+{
+	const unsigned long long interval = m_reportInterval.load( boost::memory_order_relaxed );
+	if ( !interval )
+		return 0;
+
+	const unsigned long long next = m_nextReport.load( boost::memory_order_relaxed );
+	if ( now < next )
+		return next;
+
+	m_nextReport.store( now + interval, boost::memory_order_relaxed );
+	const Snapshot s( snapshot( true ) );
+	if ( m_pLogger )
+		reports.push_back( report( s ) );
+	return now + interval;
+}
+
+
+std::size_t BlockTimer::bucket( unsigned long long ticks )
+{
+	// four linear buckets per power of two
+	if ( ticks < 4 )
+		return static_cast< std::size_t >( ticks );
+	const unsigned e = msb( ticks );
+	return 4 * ( e - 1 ) + static_cast< std::size_t >( ( ticks >> ( e - 2 ) ) & 3 );
+}
+
+
+unsigned long long BlockTimer::bucketBegin( std::size_t bucket )
+{
+	if ( bucket < 4 )
+		return bucket;
+	const unsigned e = static_cast< unsigned >( bucket / 4 + 1 );
+	return static_cast< unsigned long long >( 4 + bucket % 4 ) << ( e - 2 );
 }
 
 
 void BlockTimer::initializeStart( const char* sCodeFile, unsigned nCodeLine )
 { 
-	m_sCodeFile = sCodeFile; 
-	m_nCodeLine = nCodeLine;
+	// only the first thread sets the location, and publishes it when it is completely written
+	int state = 0;
+	if ( m_initState.compare_exchange_strong( state, 1, boost::memory_order_relaxed ) )
+	{
+		m_sCodeFile = sCodeFile; 
+		m_nCodeLine = nCodeLine;
+		m_initState.store( 2, boost::memory_order_release );
+	}
 }
 
 
 void BlockTimer::initializeEnd()
 {
-	m_bInitialized = true;
 	/// @todo add automatic hierarchy detection
 }
 
 
+BlockTimer::Report::Report()
+	: pLogger( 0 )
+	, nCodeLine( 0 )
+{}
+
+
+void BlockTimer::Report::log() const
+{
+	if ( !sCodeFile.empty() )
+		pLogger->log( log4cpp::Priority::info, sMessage, sCodeFile.c_str(), nCodeLine );
+	else
+		pLogger->log( log4cpp::Priority::info, sMessage );
+}
+
+
+BlockTimer::Report BlockTimer::report( const Snapshot& s ) const
+{
+	std::ostringstream os;
+	os << std::setw( 30 ) << getName()
+		<< " runs: " << std::setw( 6 ) << s.runs
+		<< ", total: " << std::setw( 7 ) << s.totalTime << "ms"
+		<< ", avg: " << std::setw( 7 ) << s.getAvgTime() << "ms"
+		<< ", min: " << std::setw( 7 ) << s.minTime << "ms"
+		<< ", p50: " << std::setw( 7 ) << s.getPercentile( 0.5 ) << "ms"
+		<< ", p99: " << std::setw( 7 ) << s.getPercentile( 0.99 ) << "ms"
+		<< ", p999: " << std::setw( 7 ) << s.getPercentile( 0.999 ) << "ms"
+		<< ", max: " << std::setw( 7 ) << s.maxTime << "ms";
+
+	Report r;
+	r.pLogger = m_pLogger;
+	r.sMessage = os.str();
+	// the code location may only be read after it was published
+	if ( initialized() )
+	{
+		r.sCodeFile = m_sCodeFile;
+		r.nCodeLine = m_nCodeLine;
+	}
+	return r;
+}
 
 
 std::ostream& operator<<( std::ostream& s, const BlockTimer& t )
@@ -32,9 +32,12 @@
 #define __UBITRACK_UTIL_BLOCK_TIMER_H_INCLUDED__
  
 #include <string>
+#include <vector>
 #include <iostream>
 #include <log4cpp/Category.hh>
 #include <boost/utility.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
 #include <utCore.h>
 #include <utUtil/OS.h>
 
@@ -53,11 +56,78 @@ UBITRACK_EXPORT std::ostream& operator<<( std::ostream& s, const BlockTimer& t )
  *
  * The timer is started by instantiating a \c Time object and stopped when it leaves scope. 
  * The result of multiple runs is summed up. The BlockTimer result can be directly printed to an ostream.
+ *
+ * A timer can be shared by several threads. The counters are sharded: each thread adds its runs
+ * with relaxed atomic operations to one of up to one shard per hardware thread, which are only
+ * combined when results are read. Shards are allocated when a thread first uses them.
+ *
+ * Besides total and average, the timer records minimum and maximum and a log-linear histogram
+ * of the run times (four buckets per power of two, i.e. at most 12.5% relative error), from
+ * which percentiles are computed. \c snapshot() reads all results at once and optionally resets
+ * the timer. If a report interval is set, a background thread of the \c MetricsRegistry
+ * periodically logs such a snapshot and resets the timer.
  */
 class UBITRACK_EXPORT BlockTimer
+	: private boost::noncopyable
 {
 public:
 
+	/** number of histogram buckets */
+	static const std::size_t nBuckets = 256;
+
+	/** results of a timer at one point in time. All times are in ms. */
+	struct UBITRACK_EXPORT Snapshot
+	{
+		Snapshot();
+
+		/** number of runs */
+		std::size_t runs;
+
+		/** total time */
+		double totalTime;
+
+		/** minimal time of a run, 0 if there were no runs */
+		double minTime;
+
+		/** maximal time of a run */
+		double maxTime;
+
+		/** number of runs per histogram bucket, see \c BlockTimer::bucketBegin() */
+		std::vector< unsigned long long > histogram;
+
+		/** counter ticks per ms */
+		double ticksPerMs;
+
+		/** returns the average time */
+		double getAvgTime() const
+		{ return runs ? totalTime / runs : 0.0; }
+
+		/**
+		 * returns a percentile of the run times, estimated from the histogram.
+		 * @param p percentile in [0, 1], e.g. 0.99
+		 */
+		double getPercentile( double p ) const;
+	};
+
+	/** a formatted result, which stays valid when the timer is destroyed */
+	struct UBITRACK_EXPORT Report
+	{
+		Report();
+
+		/** category to log to */
+		log4cpp::Category* pLogger;
+
+		/** the formatted results */
+		std::string sMessage;
+
+		/** code location, empty if not initialized */
+		std::string sCodeFile;
+		unsigned nCodeLine;
+
+		/** writes the report to the logger */
+		void log() const;
+	};
+
 	/** times a block of execution */
 	class Time
 		: public boost::noncopyable
@@ -108,76 +178,112 @@ public:
 	 * @param sName name of the timer (for display)
 	 * @param sLoggingCategory log4cpp category to which to print the result when the timer object leaves scope
 	 */
-	BlockTimer( const std::string& sName, const std::string& sLoggingCategory = std::string() )
-		: m_sName( sName )
-		, m_pLogger( sLoggingCategory.empty() ? 0 : &log4cpp::Category::getInstance( sLoggingCategory ) )
-		, m_bInitialized( false )
-		, m_nRuns( 0 )
-		, m_nTicks( 0 )
-		, m_startTime( getHighPerformanceCounter() )
-	{}
+	BlockTimer( const std::string& sName, const std::string& sLoggingCategory = std::string() );
 
 	/** 
 	 * constructs and empty block timer object
 	 * @param sName name of the timer (for display)
 	 * @param logger log4cpp logger to which to print the result when the timer object leaves scope
 	 */
-	BlockTimer( const std::string& sName, log4cpp::Category& logger )
-		: m_sName( sName )
-		, m_pLogger( &logger )
-		, m_bInitialized( false )
-		, m_nRuns( 0 )
-		, m_nTicks( 0 )
-		, m_startTime( getHighPerformanceCounter() )
-	{}
+	BlockTimer( const std::string& sName, log4cpp::Category& logger );
 
 	/** destructor, prints result if a stream was given to the constructor */
 	~BlockTimer();
 	
-	/** adds a timer run to the internal state */
-	void addMeasurement( unsigned long long ticks )
-	{ m_nRuns++; m_nTicks += ticks; }
+	/** adds a timer run to the internal state. Thread-safe. */
+	void addMeasurement( unsigned long long ticks );
 	
 	const std::string& getName() const
 	{ return m_sName; }
 	
 	/** returns the total time in ms */
-	double getTotalTime() const
-	{ return m_nTicks / getHighPerformanceFrequency() * 1000; }
+	double getTotalTime() const;
 	
 	/** returns the average time in ms */
-	double getAvgTime() const
-	{ return m_nTicks / ( getHighPerformanceFrequency() * m_nRuns ) * 1000; }
+	double getAvgTime() const;
 	
 	/** returns the number of times the timer was run */
-	std::size_t getRuns() const
-	{ return m_nRuns; }
+	std::size_t getRuns() const;
+
+	/** 
+	 * returns all results at once.
+	 * @param bReset if true, the timer is reset. Runs that are added concurrently are not lost,
+	 * they are counted either in this or in the next snapshot.
+	 */
+	Snapshot snapshot( bool bReset = false );
+
+	/** resets all counters */
+	void reset()
+	{ snapshot( true ); }
+
+	/**
+	 * Periodically logs the results and resets the timer. The reports are written by a background
+	 * thread, so adding runs is not delayed.
+	 * @param seconds interval in seconds, 0 to disable
+	 */
+	void setReportInterval( double seconds );
+
+	/**
+	 * Resets the timer if a report is due and appends the report, which the caller logs later.
+	 * Called by the report thread of the \c MetricsRegistry.
+	 * @param now current value of the high performance counter
+	 * @param reports receives the report of the timer if it has a logger
+	 * @return counter value of the next report, 0 if reports are disabled
+	 */
+	unsigned long long reportIfDue( unsigned long long now, std::vector< Report >& reports );
+
+	/** histogram bucket of a run time in counter ticks */
+	static std::size_t bucket( unsigned long long ticks );
+
+	/** returns the smallest run time in counter ticks that belongs to a histogram bucket */
+	static unsigned long long bucketBegin( std::size_t bucket );
 	
 	/** returns the time when the timer was started */
 	unsigned long long getStartTime() const
-	{ return m_startTime; }
+	{ return m_startTime.load( boost::memory_order_relaxed ); }
 	
 	/** Are the additional informations about the timer initialized? */
 	bool initialized() const
-	{ return m_bInitialized; }
+	{ return m_initState.load( boost::memory_order_acquire ) == 2; }
 	
-	/** Initialization at begin of first run. Sets the code location (for more useful output) */
+	/** 
+	 * Initialization at begin of first run. Sets the code location (for more useful output) 
+	 * and publishes it to \c initialized() once it is written.
+	 */
 	void initializeStart( const char* sCodeFile, unsigned nCodeLine );
 		
 	/** Initialization at end of first run */
 	void initializeEnd();
 
 protected:
+	/** counters of one or more threads */
+	struct Shard;
+
+	/** returns shard i, allocates it on first use */
+	Shard& shard( std::size_t i );
+
+	/** formats the results for logging */
+	Report report( const Snapshot& s ) const;
+
 	const std::string m_sName;
 	log4cpp::Category* m_pLogger;
 	std::string m_sCodeFile;
 	unsigned m_nCodeLine;
-	bool m_bInitialized;
-	
+
+	/** 0: code location not set, 1: being set, 2: initialized (stored with release semantics) */
+	boost::atomic< int > m_initState;
 	
-	std::size_t m_nRuns;
-	unsigned long long m_nTicks;
-	const unsigned long long m_startTime;
+	/** the counters, null until a thread uses them */
+	boost::scoped_array< boost::atomic< Shard* > > m_shards;
+
+	/** counter value at construction or the last reset */
+	boost::atomic< unsigned long long > m_startTime;
+
+	/** report interval in ticks, 0 if disabled */
+	boost::atomic< unsigned long long > m_reportInterval;
+
+	/** counter value of the next report */
+	boost::atomic< unsigned long long > m_nextReport;
 };
 
 
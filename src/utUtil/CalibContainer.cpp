@@ -0,0 +1,380 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @file
+ * Versioned binary container for calibration data.
+ */
+
+#include "CalibContainer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace Ubitrack { namespace Util {
+
+namespace {
+
+/*
+ * file layout, all numbers little-endian:
+ *   header: magic[8], major u16, minor u16, section count u32, directory entry size u32,
+ *           directory crc u32, directory offset u64, file size u64
+ *   directory entries: name[48], type u32, version u32, rank u32, crc u32, dims u64[3],
+ *           timestamp u64, offset u64, size u64
+ *   payloads, each aligned to 64 bytes
+ * Later minor versions may append fields to the header and the directory entries.
+ */
+const char containerMagic[ 8 ] = { 'U', 'T', 'C', 'A', 'L', 'I', 'B', 0 };
+const boost::uint16_t majorVersion = 1;
+const boost::uint16_t minorVersion = 0;
+const std::size_t headerSize = 40;
+const std::size_t entrySize = 112;
+const std::size_t nameSize = 48;
+const std::size_t payloadAlignment = 64;
+
+inline std::size_t aligned( std::size_t n )
+{
+	return ( n + payloadAlignment - 1 ) & ~( payloadAlignment - 1 );
+}
+
+template< typename T >
+void storeLE( char* p, T value )
+{
+	for ( std::size_t i = 0; i < sizeof( T ); i++ )
+		p[ i ] = static_cast< char >( ( static_cast< boost::uint64_t >( value ) >> ( 8 * i ) ) & 0xff );
+}
+
+template< typename T >
+T loadLE( const char* p )
+{
+	boost::uint64_t value = 0;
+	for ( std::size_t i = 0; i < sizeof( T ); i++ )
+		value |= static_cast< boost::uint64_t >( static_cast< unsigned char >( p[ i ] ) ) << ( 8 * i );
+	return static_cast< T >( value );
+}
+
+/** tables for the slicing-by-8 CRC-32, which is several times faster than a bytewise one on large arrays */
+struct Crc32Tables
+{
+	boost::uint32_t table[ 8 ][ 256 ];
+
+	Crc32Tables()
+	{
+		for ( boost::uint32_t i = 0; i < 256; i++ )
+		{
+			boost::uint32_t c = i;
+			for ( int k = 0; k < 8; k++ )
+				c = c & 1 ? ( c >> 1 ) ^ 0xedb88320 : c >> 1;
+			table[ 0 ][ i ] = c;
+		}
+		for ( std::size_t t = 1; t < 8; t++ )
+			for ( std::size_t i = 0; i < 256; i++ )
+				table[ t ][ i ] = ( table[ t - 1 ][ i ] >> 8 ) ^ table[ 0 ][ table[ t - 1 ][ i ] & 0xff ];
+	}
+};
+
+const Crc32Tables crcTables;
+
+/** the CRC-32 of zlib and \c boost::crc_32_type */
+boost::uint32_t crc32( const char* data, std::size_t size )
+{
+	const boost::uint32_t ( &t )[ 8 ][ 256 ] = crcTables.table;
+	const unsigned char* p = reinterpret_cast< const unsigned char* >( data );
+	boost::uint32_t c = 0xffffffff;
+	for ( ; size >= 8; size -= 8, p += 8 )
+	{
+		const boost::uint32_t lo = c ^ ( p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 ) | ( boost::uint32_t( p[ 3 ] ) << 24 ) );
+		c = t[ 7 ][ lo & 0xff ] ^ t[ 6 ][ ( lo >> 8 ) & 0xff ] ^ t[ 5 ][ ( lo >> 16 ) & 0xff ] ^ t[ 4 ][ lo >> 24 ]
+			^ t[ 3 ][ p[ 4 ] ] ^ t[ 2 ][ p[ 5 ] ] ^ t[ 1 ][ p[ 6 ] ] ^ t[ 0 ][ p[ 7 ] ];
+	}
+	for ( ; size; size--, p++ )
+		c = t[ 0 ][ ( c ^ *p ) & 0xff ] ^ ( c >> 8 );
+	return c ^ 0xffffffff;
+}
+
+std::size_t elementSize( CalibElementType type )
+{
+	switch ( type )
+	{
+	case CALIB_ARCHIVE:
+	case CALIB_INT8:
+	case CALIB_UINT8:
+		return 1;
+	case CALIB_INT32:
+	case CALIB_UINT32:
+	case CALIB_FLOAT32:
+		return 4;
+	case CALIB_INT64:
+	case CALIB_UINT64:
+	case CALIB_FLOAT64:
+		return 8;
+	}
+	return 0;
+}
+
+} // anonymous namespace
+
+
+std::size_t CalibSection::elements() const
+{
+	std::size_t n = 1;
+	for ( std::size_t i = 0; i < rank; i++ )
+		n *= static_cast< std::size_t >( dims[ i ] );
+	return n;
+}
+
+
+CalibContainerWriter::CalibContainerWriter()
+{
+}
+
+
+void CalibContainerWriter::addSection( const std::string& sName, CalibElementType type, std::size_t elementSize,
+	std::size_t rank, const std::size_t* dims, const void* data, boost::uint32_t version, boost::uint64_t timestamp )
+{
+	if ( sName.empty() || sName.size() >= nameSize )
+		UBITRACK_THROW( "Invalid calibration section name " + sName );
+	if ( rank > CalibSection::maxRank )
+		UBITRACK_THROW( "Calibration section " + sName + " has too many dimensions" );
+	for ( std::size_t i = 0; i < m_sections.size(); i++ )
+		if ( m_sections[ i ].name == sName )
+			UBITRACK_THROW( "Duplicate calibration section " + sName );
+
+	CalibSection s;
+	s.name = sName;
+	s.type = type;
+	s.version = version;
+	s.rank = static_cast< boost::uint32_t >( rank );
+	for ( std::size_t i = 0; i < CalibSection::maxRank; i++ )
+		s.dims[ i ] = i < rank ? dims[ i ] : 0;
+	s.timestamp = timestamp;
+	s.size = ( rank ? s.elements() : 1 ) * elementSize;
+	if ( type == CALIB_ARCHIVE )
+		s.size = dims[ 0 ];
+
+	// payloads are kept relative to the first one until the file is written
+	s.offset = aligned( m_payload.size() );
+	m_payload.resize( static_cast< std::size_t >( s.offset + s.size ) );
+	char* p = m_payload.empty() ? 0 : &m_payload[ static_cast< std::size_t >( s.offset ) ];
+	const char* src = static_cast< const char* >( data );
+#if BOOST_ENDIAN_BIG_BYTE
+	for ( std::size_t i = 0; i < s.size; i += elementSize )
+		for ( std::size_t j = 0; j < elementSize; j++ )
+			p[ i + j ] = src[ i + elementSize - 1 - j ];
+#else
+	if ( s.size )
+		std::memcpy( p, src, static_cast< std::size_t >( s.size ) );
+#endif
+	s.checksum = crc32( p, static_cast< std::size_t >( s.size ) );
+
+	m_sections.push_back( s );
+}
+
+
+void CalibContainerWriter::addArchive( const std::string& sName, const std::string& archive,
+	const boost::uint32_t version, const boost::uint64_t timestamp )
+{
+	const std::size_t dims[] = { archive.size() };
+	addSection( sName, CALIB_ARCHIVE, 1, 0, dims, archive.data(), version, timestamp );
+}
+
+
+void CalibContainerWriter::write( const std::string& sFile ) const
+{
+	const std::size_t payloadStart = aligned( headerSize + m_sections.size() * entrySize );
+
+	std::vector< char > directory( m_sections.size() * entrySize, 0 );
+	for ( std::size_t i = 0; i < m_sections.size(); i++ )
+	{
+		const CalibSection& s( m_sections[ i ] );
+		char* p = &directory[ i * entrySize ];
+		std::copy( s.name.begin(), s.name.end(), p );
+		storeLE< boost::uint32_t >( p + 48, s.type );
+		storeLE< boost::uint32_t >( p + 52, s.version );
+		storeLE< boost::uint32_t >( p + 56, s.rank );
+		storeLE< boost::uint32_t >( p + 60, s.checksum );
+		for ( std::size_t d = 0; d < CalibSection::maxRank; d++ )
+			storeLE< boost::uint64_t >( p + 64 + 8 * d, s.dims[ d ] );
+		storeLE< boost::uint64_t >( p + 88, s.timestamp );
+		storeLE< boost::uint64_t >( p + 96, s.offset + payloadStart );
+		storeLE< boost::uint64_t >( p + 104, s.size );
+	}
+
+	char header[ headerSize ];
+	std::memcpy( header, containerMagic, sizeof( containerMagic ) );
+	storeLE< boost::uint16_t >( header + 8, majorVersion );
+	storeLE< boost::uint16_t >( header + 10, minorVersion );
+	storeLE< boost::uint32_t >( header + 12, static_cast< boost::uint32_t >( m_sections.size() ) );
+	storeLE< boost::uint32_t >( header + 16, static_cast< boost::uint32_t >( entrySize ) );
+	storeLE< boost::uint32_t >( header + 20, crc32( directory.empty() ? 0 : &directory[ 0 ], directory.size() ) );
+	storeLE< boost::uint64_t >( header + 24, headerSize );
+	storeLE< boost::uint64_t >( header + 32, payloadStart + m_payload.size() );
+
+	const std::string sTemp( sFile + ".tmp" );
+	{
+		std::ofstream f( sTemp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+		if ( !f )
+			UBITRACK_THROW( "Could not open file " + sTemp + " for writing" );
+		const std::vector< char > padding( payloadStart - headerSize - directory.size(), 0 );
+		f.write( header, headerSize );
+		f.write( directory.empty() ? 0 : &directory[ 0 ], directory.size() );
+		f.write( padding.empty() ? 0 : &padding[ 0 ], padding.size() );
+		f.write( m_payload.empty() ? 0 : &m_payload[ 0 ], m_payload.size() );
+		if ( !f )
+			UBITRACK_THROW( "Could not write calibration file " + sTemp );
+	}
+
+#ifdef _WIN32
+	std::remove( sFile.c_str() );
+#endif
+	if ( std::rename( sTemp.c_str(), sFile.c_str() ) != 0 )
+		UBITRACK_THROW( "Could not rename calibration file to " + sFile );
+}
+
+
+CalibContainerReader::CalibContainerReader( const std::string& sFile, bool bVerifyChecksums )
+	: m_sFile( sFile )
+	, m_bVerifyChecksums( bVerifyChecksums )
+{
+	try
+	{
+		m_pMapping.reset( new boost::interprocess::file_mapping( sFile.c_str(), boost::interprocess::read_only ) );
+		m_pRegion.reset( new boost::interprocess::mapped_region( *m_pMapping, boost::interprocess::read_only ) );
+	}
+	catch ( const boost::interprocess::interprocess_exception& e )
+	{
+		UBITRACK_THROW( "Could not open file " + sFile + " for reading: " + e.what() );
+	}
+
+	const char* pBase = static_cast< const char* >( m_pRegion->get_address() );
+	const std::size_t fileSize = m_pRegion->get_size();
+	if ( fileSize < headerSize || std::memcmp( pBase, containerMagic, sizeof( containerMagic ) ) != 0 )
+		UBITRACK_THROW( sFile + " is no calibration container" );
+	if ( loadLE< boost::uint16_t >( pBase + 8 ) != majorVersion )
+		UBITRACK_THROW( "Unsupported version of calibration container " + sFile );
+
+	const std::size_t count = loadLE< boost::uint32_t >( pBase + 12 );
+	const std::size_t stride = loadLE< boost::uint32_t >( pBase + 16 );
+	const boost::uint64_t directoryOffset = loadLE< boost::uint64_t >( pBase + 24 );
+	if ( loadLE< boost::uint64_t >( pBase + 32 ) != fileSize || stride < entrySize
+		|| directoryOffset > fileSize || count > ( fileSize - directoryOffset ) / stride )
+		UBITRACK_THROW( "Calibration container " + sFile + " is truncated" );
+
+	const char* pDirectory = pBase + directoryOffset;
+	if ( crc32( pDirectory, count * stride ) != loadLE< boost::uint32_t >( pBase + 20 ) )
+		UBITRACK_THROW( "Calibration container " + sFile + " has a corrupt directory" );
+
+	m_sections.resize( count );
+	for ( std::size_t i = 0; i < count; i++ )
+	{
+		const char* p = pDirectory + i * stride;
+		CalibSection& s( m_sections[ i ] );
+		s.name.assign( p, std::find( p, p + nameSize, 0 ) );
+		s.type = static_cast< CalibElementType >( loadLE< boost::uint32_t >( p + 48 ) );
+		s.version = loadLE< boost::uint32_t >( p + 52 );
+		s.rank = loadLE< boost::uint32_t >( p + 56 );
+		s.checksum = loadLE< boost::uint32_t >( p + 60 );
+		for ( std::size_t d = 0; d < CalibSection::maxRank; d++ )
+			s.dims[ d ] = loadLE< boost::uint64_t >( p + 64 + 8 * d );
+		s.timestamp = loadLE< boost::uint64_t >( p + 88 );
+		s.offset = loadLE< boost::uint64_t >( p + 96 );
+		s.size = loadLE< boost::uint64_t >( p + 104 );
+
+		if ( s.offset > fileSize || s.size > fileSize - s.offset || s.rank > CalibSection::maxRank )
+			UBITRACK_THROW( "Calibration container " + sFile + " has a corrupt section " + s.name );
+		// sections of unknown element types are kept, but can only be read as raw payload
+		if ( s.rank && elementSize( s.type ) && s.elements() * elementSize( s.type ) != s.size )
+			UBITRACK_THROW( "Calibration container " + sFile + " has a corrupt section " + s.name );
+	}
+}
+
+
+CalibContainerReader::~CalibContainerReader()
+{
+}
+
+
+bool CalibContainerReader::has( const std::string& sName ) const
+{
+	for ( std::size_t i = 0; i < m_sections.size(); i++ )
+		if ( m_sections[ i ].name == sName )
+			return true;
+	return false;
+}
+
+
+const CalibSection& CalibContainerReader::section( const std::string& sName ) const
+{
+	for ( std::size_t i = 0; i < m_sections.size(); i++ )
+		if ( m_sections[ i ].name == sName )
+			return m_sections[ i ];
+	UBITRACK_THROW( "Calibration container " + m_sFile + " has no section " + sName );
+}
+
+
+const char* CalibContainerReader::payload( const CalibSection& s ) const
+{
+	const char* p = static_cast< const char* >( m_pRegion->get_address() ) + s.offset;
+	if ( m_bVerifyChecksums && crc32( p, static_cast< std::size_t >( s.size ) ) != s.checksum )
+		UBITRACK_THROW( "Checksum error in section " + s.name + " of calibration container " + m_sFile );
+	return p;
+}
+
+
+const void* CalibContainerReader::arrayPayload( const CalibSection& s, CalibElementType type ) const
+{
+	if ( s.type != type || s.rank == 0 )
+		UBITRACK_THROW( "Calibration section " + s.name + " has another element type" );
+#if BOOST_ENDIAN_BIG_BYTE
+	UBITRACK_THROW( "Calibration arrays can only be mapped on little-endian machines, use copyArray" );
+#else
+	return payload( s );
+#endif
+}
+
+
+bool CalibContainerReader::isContainer( const std::string& sFile )
+{
+	std::ifstream stream( sFile.c_str(), std::ios::in | std::ios::binary );
+	char magic[ sizeof( containerMagic ) ];
+	return stream.read( magic, sizeof( magic ) ) && std::memcmp( magic, containerMagic, sizeof( magic ) ) == 0;
+}
+
+
+bool isBinaryCalibFile( const std::string& sFile )
+{
+	// binary archives start with the length of the signature, text archives with its decimal digits
+	std::ifstream stream( sFile.c_str(), std::ios::in | std::ios::binary );
+	char first;
+	return stream.get( first ) && ( first < '0' || first > '9' ) && first != ' ';
+}
+
+} } // namespace Ubitrack::Util
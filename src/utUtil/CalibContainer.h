@@ -0,0 +1,594 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+
+/**
+ * @file
+ * Versioned binary container for calibration data with typed, checksummed sections
+ * that are loaded by memory-mapping the file.
+ */
+
+#ifndef __UBITRACK_UTIL_CALIBCONTAINER_H_INCLUDED__
+#define __UBITRACK_UTIL_CALIBCONTAINER_H_INCLUDED__
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <boost/utility.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/predef/other/endian.h>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/utility/enable_if.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+
+#include <utCore.h>
+#include <utUtil/Exception.h>
+#include <utUtil/CalibFile.h>
+#include <utMeasurement/Measurement.h>
+#include <utMath/Scalar.h>
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Quaternion.h>
+#include <utMath/Pose.h>
+
+namespace boost { namespace interprocess {
+class file_mapping;
+class mapped_region;
+} }
+
+namespace Ubitrack { namespace Util {
+
+/** element types of calibration container sections */
+enum CalibElementType
+{
+	CALIB_ARCHIVE = 0, ///< boost text archive, for types without an array layout
+	CALIB_INT8,
+	CALIB_UINT8,
+	CALIB_INT32,
+	CALIB_UINT32,
+	CALIB_INT64,
+	CALIB_UINT64,
+	CALIB_FLOAT32,
+	CALIB_FLOAT64
+};
+
+/** maps arithmetic types to their \c CalibElementType */
+template< typename S > struct CalibElementTraits;
+template<> struct CalibElementTraits< char > { static const CalibElementType type = CALIB_INT8; };
+template<> struct CalibElementTraits< signed char > { static const CalibElementType type = CALIB_INT8; };
+template<> struct CalibElementTraits< unsigned char > { static const CalibElementType type = CALIB_UINT8; };
+template<> struct CalibElementTraits< boost::int32_t > { static const CalibElementType type = CALIB_INT32; };
+template<> struct CalibElementTraits< boost::uint32_t > { static const CalibElementType type = CALIB_UINT32; };
+template<> struct CalibElementTraits< boost::int64_t > { static const CalibElementType type = CALIB_INT64; };
+template<> struct CalibElementTraits< boost::uint64_t > { static const CalibElementType type = CALIB_UINT64; };
+template<> struct CalibElementTraits< float > { static const CalibElementType type = CALIB_FLOAT32; };
+template<> struct CalibElementTraits< double > { static const CalibElementType type = CALIB_FLOAT64; };
+
+
+/** directory entry of a section in a calibration container */
+struct CalibSection
+{
+	/** maximum number of dimensions of an array section */
+	static const std::size_t maxRank = 3;
+
+	std::string name;
+	CalibElementType type;
+
+	/** version of the section content, chosen by the writer to let readers evolve with the data */
+	boost::uint32_t version;
+
+	/** number of dimensions, 0 for archive sections */
+	boost::uint32_t rank;
+
+	/** extents of the dimensions, the first one varies fastest */
+	boost::uint64_t dims[ maxRank ];
+
+	/** timestamp of a stored measurement, 0 otherwise */
+	boost::uint64_t timestamp;
+
+	/** position of the payload in the file, aligned to 64 bytes */
+	boost::uint64_t offset;
+
+	/** size of the payload in bytes */
+	boost::uint64_t size;
+
+	/** CRC-32 of the payload */
+	boost::uint32_t checksum;
+
+	/** @return number of elements of an array section */
+	std::size_t elements() const;
+};
+
+
+/**
+ * Read-only view onto an array section in the mapped file.
+ * Only valid as long as the \c CalibContainerReader exists.
+ */
+template< typename S >
+struct CalibArrayView
+{
+	const S* data;
+	const CalibSection* section;
+
+	std::size_t size() const
+	{ return section->elements(); }
+
+	const S& operator[]( std::size_t i ) const
+	{ return data[ i ]; }
+};
+
+
+/**
+ * Collects sections in memory and writes them into a calibration container file.
+ *
+ * The container starts with a header with magic and format version, followed by a
+ * directory of sections and the section payloads. Each section has a name, an element type,
+ * up to three dimensions, a version and a CRC-32. The byte order is fixed to little-endian
+ * and not recorded in the file; payloads are aligned to 64 bytes so that arrays can be used
+ * in place.
+ *
+ * Values are added with \c add(), which uses \c CalibTraits to store Ubitrack math types as
+ * arrays and all other types as boost text archives.
+ */
+class UBITRACK_EXPORT CalibContainerWriter
+	: private boost::noncopyable
+{
+public:
+	CalibContainerWriter();
+
+	/**
+	 * adds an array section
+	 * @param sName unique name of at most 47 characters
+	 * @param dims extents of the \c rank dimensions, the first one varies fastest
+	 */
+	template< typename S >
+	void addArray( const std::string& sName, const S* data, const std::size_t rank, const std::size_t* dims,
+		const boost::uint32_t version = 0, const boost::uint64_t timestamp = 0 )
+	{ addSection( sName, CalibElementTraits< S >::type, sizeof( S ), rank, dims, data, version, timestamp ); }
+
+	/** adds a section with a serialized boost text archive */
+	void addArchive( const std::string& sName, const std::string& archive,
+		const boost::uint32_t version = 0, const boost::uint64_t timestamp = 0 );
+
+	/** adds a value as a section with the layout given by \c CalibTraits */
+	template< typename T >
+	void add( const std::string& sName, const T& value, const boost::uint32_t version = 0 );
+
+	/** writes the container, replacing an existing file only when it was written completely */
+	void write( const std::string& sFile ) const;
+
+protected:
+	void addSection( const std::string& sName, CalibElementType type, std::size_t elementSize, std::size_t rank,
+		const std::size_t* dims, const void* data, boost::uint32_t version, boost::uint64_t timestamp );
+
+	std::vector< CalibSection > m_sections;
+	std::vector< char > m_payload;
+};
+
+
+/**
+ * Reads a calibration container by memory-mapping the file.
+ *
+ * Opening the file only reads the header and the directory. Payloads are accessed in the
+ * mapping, large arrays can be used without copying with \c array(). Sections are found by
+ * name, so readers ignore sections they do not know, and checksums are verified when a
+ * section is accessed.
+ *
+ * Containers with a newer minor format version can be read, a newer major version is rejected.
+ */
+class UBITRACK_EXPORT CalibContainerReader
+	: private boost::noncopyable
+{
+public:
+	/**
+	 * maps a container file
+	 * @param bVerifyChecksums verify the CRC-32 of each section when it is accessed
+	 */
+	explicit CalibContainerReader( const std::string& sFile, bool bVerifyChecksums = true );
+
+	~CalibContainerReader();
+
+	/** @return all sections in the order they were added */
+	const std::vector< CalibSection >& sections() const
+	{ return m_sections; }
+
+	/** @return \c true if the container has a section with the name */
+	bool has( const std::string& sName ) const;
+
+	/** @return the section with the name, throws if there is none */
+	const CalibSection& section( const std::string& sName ) const;
+
+	/** @return the payload of the section in the mapping, after checking its checksum */
+	const char* payload( const CalibSection& section ) const;
+
+	/**
+	 * @return a view onto an array section without copying.
+	 * The element type must match exactly. Only available on little-endian machines.
+	 */
+	template< typename S >
+	CalibArrayView< S > array( const std::string& sName ) const
+	{
+		CalibArrayView< S > view;
+		view.section = &section( sName );
+		view.data = static_cast< const S* >( arrayPayload( *view.section, CalibElementTraits< S >::type ) );
+		return view;
+	}
+
+	/**
+	 * copies the elements of an array section, converting them to \c S
+	 * @param result memory for \c section.elements() values
+	 */
+	template< typename S >
+	void copyArray( const CalibSection& section, S* result ) const;
+
+	/** reads a value that was stored with \c CalibContainerWriter::add */
+	template< typename T >
+	void get( const std::string& sName, T& value ) const;
+
+	/** @return \c true if the file starts like a calibration container */
+	static bool isContainer( const std::string& sFile );
+
+protected:
+	const void* arrayPayload( const CalibSection& section, CalibElementType type ) const;
+
+	const std::string m_sFile;
+	const bool m_bVerifyChecksums;
+	boost::scoped_ptr< boost::interprocess::file_mapping > m_pMapping;
+	boost::scoped_ptr< boost::interprocess::mapped_region > m_pRegion;
+	std::vector< CalibSection > m_sections;
+};
+
+
+/** converts an element from its little-endian representation in the file */
+template< typename S >
+inline S loadCalibElement( const char* p )
+{
+	S value;
+	char* v = reinterpret_cast< char* >( &value );
+#if BOOST_ENDIAN_BIG_BYTE
+	for ( std::size_t i = 0; i < sizeof( S ); i++ )
+		v[ i ] = p[ sizeof( S ) - 1 - i ];
+#else
+	for ( std::size_t i = 0; i < sizeof( S ); i++ )
+		v[ i ] = p[ i ];
+#endif
+	return value;
+}
+
+template< typename S >
+void CalibContainerReader::copyArray( const CalibSection& s, S* result ) const
+{
+	const char* p = payload( s );
+	const std::size_t n = s.elements();
+#if !BOOST_ENDIAN_BIG_BYTE
+	if ( s.type == CalibElementTraits< S >::type && s.rank )
+	{
+		std::memcpy( result, p, n * sizeof( S ) );
+		return;
+	}
+#endif
+	switch ( s.type )
+	{
+	case CALIB_INT8: for ( std::size_t i = 0; i < n; i++ ) result[ i ] = static_cast< S >( loadCalibElement< signed char >( p + i ) ); break;
+	case CALIB_UINT8: for ( std::size_t i = 0; i < n; i++ ) result[ i ] = static_cast< S >( loadCalibElement< unsigned char >( p + i ) ); break;
+	case CALIB_INT32: for ( std::size_t i = 0; i < n; i++ ) result[ i ] = static_cast< S >( loadCalibElement< boost::int32_t >( p + 4 * i ) ); break;
+	case CALIB_UINT32: for ( std::size_t i = 0; i < n; i++ ) result[ i ] = static_cast< S >( loadCalibElement< boost::uint32_t >( p + 4 * i ) ); break;
+	case CALIB_INT64: for ( std::size_t i = 0; i < n; i++ ) result[ i ] = static_cast< S >( loadCalibElement< boost::int64_t >( p + 8 * i ) ); break;
+	case CALIB_UINT64: for ( std::size_t i = 0; i < n; i++ ) result[ i ] = static_cast< S >( loadCalibElement< boost::uint64_t >( p + 8 * i ) ); break;
+	case CALIB_FLOAT32: for ( std::size_t i = 0; i < n; i++ ) result[ i ] = static_cast< S >( loadCalibElement< float >( p + 4 * i ) ); break;
+	case CALIB_FLOAT64: for ( std::size_t i = 0; i < n; i++ ) result[ i ] = static_cast< S >( loadCalibElement< double >( p + 8 * i ) ); break;
+	default:
+		UBITRACK_THROW( "Calibration section " + s.name + " is no array" );
+	}
+}
+
+
+/**
+ * Layout of a value in a calibration container.
+ *
+ * The default stores a boost text archive. Specializations store math types as arrays of
+ * their element type, and are free to convert between element types when loading.
+ */
+template< typename T, typename Enable = void >
+struct CalibTraits
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const T& value,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{
+		std::ostringstream stream;
+		{
+			boost::archive::text_oarchive archive( stream );
+			archive << value;
+		}
+		w.addArchive( sName, stream.str(), version, timestamp );
+	}
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, T& value )
+	{
+		if ( s.type != CALIB_ARCHIVE )
+			UBITRACK_THROW( "Calibration section " + s.name + " is no archive" );
+		std::istringstream stream( std::string( r.payload( s ), static_cast< std::size_t >( s.size ) ) );
+		boost::archive::text_iarchive archive( stream );
+		archive >> value;
+	}
+};
+
+/** checks the shape of an array section */
+inline void checkCalibShape( const CalibSection& s, const std::size_t rank, const std::size_t d0, const std::size_t d1 = 1 )
+{
+	if ( s.type == CALIB_ARCHIVE || s.rank != rank || s.dims[ 0 ] != d0 || ( rank > 1 && s.dims[ 1 ] != d1 ) )
+		UBITRACK_THROW( "Calibration section " + s.name + " has the wrong shape" );
+}
+
+template< typename T >
+struct CalibTraits< T, typename boost::enable_if< boost::is_arithmetic< T > >::type >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const T& value,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{
+		const std::size_t dims[] = { 1 };
+		w.addArray( sName, &value, 1, dims, version, timestamp );
+	}
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, T& value )
+	{
+		checkCalibShape( s, 1, 1 );
+		r.copyArray( s, &value );
+	}
+};
+
+template< typename T >
+struct CalibTraits< Math::Scalar< T > >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const Math::Scalar< T >& value,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{ CalibTraits< T >::save( w, sName, value.m_value, version, timestamp ); }
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, Math::Scalar< T >& value )
+	{ CalibTraits< T >::load( r, s, value.m_value ); }
+};
+
+/** also for dynamic vectors */
+template< typename T, std::size_t N >
+struct CalibTraits< Math::Vector< T, N > >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const Math::Vector< T, N >& value,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{
+		const std::vector< T > data( value.begin(), value.end() );
+		const std::size_t dims[] = { data.size() };
+		w.addArray( sName, data.empty() ? static_cast< const T* >( 0 ) : &data[ 0 ], 1, dims, version, timestamp );
+	}
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, Math::Vector< T, N >& value )
+	{
+		if ( N == 0 && s.rank == 1 )
+			value.resize( static_cast< std::size_t >( s.dims[ 0 ] ) );
+		checkCalibShape( s, 1, value.size() );
+		std::vector< T > data( value.size() );
+		r.copyArray( s, data.empty() ? static_cast< T* >( 0 ) : &data[ 0 ] );
+		std::copy( data.begin(), data.end(), value.begin() );
+	}
+};
+
+/** stored column-major as rows x columns, also for dynamic matrices */
+template< typename T, std::size_t M, std::size_t N >
+struct CalibTraits< Math::Matrix< T, M, N > >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const Math::Matrix< T, M, N >& value,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{
+		std::vector< T > data;
+		data.reserve( value.size1() * value.size2() );
+		for ( std::size_t j = 0; j < value.size2(); j++ )
+			for ( std::size_t i = 0; i < value.size1(); i++ )
+				data.push_back( value( i, j ) );
+		const std::size_t dims[] = { value.size1(), value.size2() };
+		w.addArray( sName, data.empty() ? static_cast< const T* >( 0 ) : &data[ 0 ], 2, dims, version, timestamp );
+	}
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, Math::Matrix< T, M, N >& value )
+	{
+		if ( ( M == 0 || N == 0 ) && s.rank == 2 )
+			value.resize( static_cast< std::size_t >( s.dims[ 0 ] ), static_cast< std::size_t >( s.dims[ 1 ] ) );
+		checkCalibShape( s, 2, value.size1(), value.size2() );
+		std::vector< T > data( value.size1() * value.size2() );
+		r.copyArray( s, data.empty() ? static_cast< T* >( 0 ) : &data[ 0 ] );
+		typename std::vector< T >::const_iterator it = data.begin();
+		for ( std::size_t j = 0; j < value.size2(); j++ )
+			for ( std::size_t i = 0; i < value.size1(); i++ )
+				value( i, j ) = *it++;
+	}
+};
+
+/** stored as x, y, z, w */
+template<>
+struct CalibTraits< Math::Quaternion >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const Math::Quaternion& q,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{
+		const double data[] = { q.x(), q.y(), q.z(), q.w() };
+		const std::size_t dims[] = { 4 };
+		w.addArray( sName, data, 1, dims, version, timestamp );
+	}
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, Math::Quaternion& q )
+	{
+		checkCalibShape( s, 1, 4 );
+		double data[ 4 ];
+		r.copyArray( s, data );
+		q = Math::Quaternion( data[ 0 ], data[ 1 ], data[ 2 ], data[ 3 ] );
+	}
+};
+
+/** stored as tx, ty, tz, qx, qy, qz, qw like \c Pose::toVector */
+template<>
+struct CalibTraits< Math::Pose >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const Math::Pose& p,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{
+		Math::Vector< double, 7 > v;
+		p.toVector( v );
+		CalibTraits< Math::Vector< double, 7 > >::save( w, sName, v, version, timestamp );
+	}
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, Math::Pose& p )
+	{
+		Math::Vector< double, 7 > v;
+		CalibTraits< Math::Vector< double, 7 > >::load( r, s, v );
+		p = Math::Pose::fromVector( v );
+	}
+};
+
+/** point sets and lookup tables, stored as N x count */
+template< typename T, std::size_t N >
+struct CalibTraits< std::vector< Math::Vector< T, N > >, typename boost::enable_if_c< ( N > 0 ) >::type >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const std::vector< Math::Vector< T, N > >& value,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{
+		std::vector< T > data;
+		data.reserve( N * value.size() );
+		for ( std::size_t i = 0; i < value.size(); i++ )
+			data.insert( data.end(), value[ i ].begin(), value[ i ].end() );
+		const std::size_t dims[] = { N, value.size() };
+		w.addArray( sName, data.empty() ? static_cast< const T* >( 0 ) : &data[ 0 ], 2, dims, version, timestamp );
+	}
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, std::vector< Math::Vector< T, N > >& value )
+	{
+		checkCalibShape( s, 2, N, s.rank == 2 ? static_cast< std::size_t >( s.dims[ 1 ] ) : 0 );
+		value.resize( static_cast< std::size_t >( s.dims[ 1 ] ) );
+		std::vector< T > data( N * value.size() );
+		r.copyArray( s, data.empty() ? static_cast< T* >( 0 ) : &data[ 0 ] );
+		for ( std::size_t i = 0; i < value.size(); i++ )
+			std::copy( data.begin() + i * N, data.begin() + ( i + 1 ) * N, value[ i ].begin() );
+	}
+};
+
+template< typename T >
+struct CalibTraits< std::vector< T >, typename boost::enable_if< boost::is_arithmetic< T > >::type >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const std::vector< T >& value,
+		const boost::uint32_t version, const boost::uint64_t timestamp )
+	{
+		const std::size_t dims[] = { value.size() };
+		w.addArray( sName, value.empty() ? static_cast< const T* >( 0 ) : &value[ 0 ], 1, dims, version, timestamp );
+	}
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, std::vector< T >& value )
+	{
+		checkCalibShape( s, 1, s.rank == 1 ? static_cast< std::size_t >( s.dims[ 0 ] ) : 0 );
+		value.resize( static_cast< std::size_t >( s.dims[ 0 ] ) );
+		r.copyArray( s, value.empty() ? static_cast< T* >( 0 ) : &value[ 0 ] );
+	}
+};
+
+/** the payload with the timestamp of the measurement */
+template< typename T >
+struct CalibTraits< Measurement::Measurement< T > >
+{
+	static void save( CalibContainerWriter& w, const std::string& sName, const Measurement::Measurement< T >& m,
+		const boost::uint32_t version, const boost::uint64_t )
+	{ CalibTraits< T >::save( w, sName, *m, version, m.time() ); }
+
+	static void load( const CalibContainerReader& r, const CalibSection& s, Measurement::Measurement< T >& m )
+	{
+		m = Measurement::Measurement< T >( s.timestamp, boost::shared_ptr< T >( new T() ) );
+		CalibTraits< T >::load( r, s, *m );
+	}
+};
+
+
+template< typename T >
+void CalibContainerWriter::add( const std::string& sName, const T& value, const boost::uint32_t version )
+{
+	CalibTraits< T >::save( *this, sName, value, version, 0 );
+}
+
+template< typename T >
+void CalibContainerReader::get( const std::string& sName, T& value ) const
+{
+	const CalibSection& s( section( sName ) );
+	try
+	{
+		CalibTraits< T >::load( *this, s, value );
+	}
+	catch ( const boost::archive::archive_exception& e )
+	{
+		UBITRACK_THROW( "Could not read calibration section " + sName + " of " + m_sFile + ": " + e.what() );
+	}
+}
+
+
+/** @return \c true if the file starts like a boost binary archive */
+UBITRACK_EXPORT bool isBinaryCalibFile( const std::string& sFile );
+
+/** name of the section used by \c convertCalibFile and \c loadCalibFile */
+const char* const defaultCalibSection = "calibration";
+
+/**
+ * converts a calibration file written by \c writeCalibFile or \c writeBinaryCalibFile into a
+ * calibration container with one section
+ */
+template< typename T >
+void convertCalibFile( const std::string& sArchiveFile, const std::string& sContainerFile,
+	const bool bBinary = false, const std::string& sSection = defaultCalibSection )
+{
+	T value;
+	if ( bBinary )
+		readBinaryCalibFile( sArchiveFile, value );
+	else
+		readCalibFile( sArchiveFile, value );
+
+	CalibContainerWriter writer;
+	writer.add( sSection, value );
+	writer.write( sContainerFile );
+}
+
+/**
+ * reads a calibration from a calibration container or from a text or binary archive file,
+ * depending on the content of the file
+ */
+template< typename T >
+void loadCalibFile( const std::string& sFile, T& result, const std::string& sSection = defaultCalibSection )
+{
+	if ( CalibContainerReader::isContainer( sFile ) )
+		CalibContainerReader( sFile ).get( sSection, result );
+	else if ( isBinaryCalibFile( sFile ) )
+		readBinaryCalibFile( sFile, result );
+	else
+		readCalibFile( sFile, result );
+}
+
+} } // namespace Ubitrack::Util
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @file
+ * Implementation of the nanosecond clocks
+ */
+
+#include "Clock.h"
+
+#include <boost/atomic.hpp>
+#include <boost/thread/once.hpp>
+
+#ifdef _WIN32
+#include "CleanWindows.h"
+#else
+#include <time.h>
+#endif
+
+namespace Ubitrack { namespace Util {
+
+namespace {
+
+	/** number of clock readings used for the calibration, the one with the smallest uncertainty is taken */
+	const int g_nCalibrationSamples = 16;
+
+	boost::atomic< int > g_clockPolicy( SystemClock );
+
+	/** offset from the monotonic clock to the wall clock */
+	boost::atomic< long long > g_offset( 0 );
+
+	/** last value returned by strictlyIncreasingNanoseconds() */
+	boost::atomic< unsigned long long > g_last( 0 );
+
+	boost::once_flag g_calibrationFlag = BOOST_ONCE_INIT;
+
+	void calibrate()
+	{
+		unsigned long long bestWidth = 0;
+		long long bestOffset = 0;
+		for ( int i = 0; i < g_nCalibrationSamples; i++ )
+		{
+			// the wall clock is read between two monotonic readings
+			const unsigned long long before = monotonicNanoseconds();
+			const unsigned long long wall = systemNanoseconds();
+			const unsigned long long after = monotonicNanoseconds();
+
+			const unsigned long long width = after - before;
+			if ( i == 0 || width < bestWidth )
+			{
+				bestWidth = width;
+				bestOffset = static_cast< long long >( wall - ( before + width / 2 ) );
+			}
+		}
+		g_offset.store( bestOffset, boost::memory_order_release );
+	}
+
+} // anonymous namespace
+
+
+void setClockPolicy( ClockPolicy policy )
+{
+	g_clockPolicy.store( policy, boost::memory_order_relaxed );
+}
+
+
+ClockPolicy getClockPolicy()
+{
+	return static_cast< ClockPolicy >( g_clockPolicy.load( boost::memory_order_relaxed ) );
+}
+
+
+#ifdef _WIN32
+
+unsigned long long systemNanoseconds()
+{
+	// 100ns intervals since 1601-01-01
+	FILETIME ft;
+	GetSystemTimeAsFileTime( &ft );
+	const unsigned long long t = ( static_cast< unsigned long long >( ft.dwHighDateTime ) << 32 ) | ft.dwLowDateTime;
+	return ( t - 116444736000000000ULL ) * 100;
+}
+
+
+namespace {
+
+	unsigned long long performanceFrequency()
+	{
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency( &f );
+		return f.QuadPart;
+	}
+
+} // anonymous namespace
+
+unsigned long long monotonicNanoseconds()
+{
+	static const unsigned long long frequency = performanceFrequency();
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter( &counter );
+	const unsigned long long c = counter.QuadPart;
+
+	// split to avoid overflow of c * 1e9
+	return ( c / frequency ) * 1000000000ULL + ( c % frequency ) * 1000000000ULL / frequency;
+}
+
+#else
+
+unsigned long long systemNanoseconds()
+{
+	timespec ts;
+	clock_gettime( CLOCK_REALTIME, &ts );
+	return static_cast< unsigned long long >( ts.tv_sec ) * 1000000000ULL + ts.tv_nsec;
+}
+
+
+unsigned long long monotonicNanoseconds()
+{
+	timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return static_cast< unsigned long long >( ts.tv_sec ) * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif
+
+
+unsigned long long calibratedNanoseconds()
+{
+	boost::call_once( g_calibrationFlag, &calibrate );
+	return monotonicNanoseconds() + g_offset.load( boost::memory_order_acquire );
+}
+
+
+unsigned long long strictlyIncreasingNanoseconds()
+{
+	unsigned long long t = calibratedNanoseconds();
+
+	// make readings strictly increasing, also between threads
+	unsigned long long last = g_last.load( boost::memory_order_relaxed );
+	do
+	{
+		if ( t <= last )
+			t = last + 1;
+	}
+	while ( !g_last.compare_exchange_weak( last, t, boost::memory_order_relaxed ) );
+
+	return t;
+}
+
+
+void calibrateClock()
+{
+	boost::call_once( g_calibrationFlag, &calibrate );
+	calibrate();
+}
+
+} } // namespace Ubitrack::Util
@@ -0,0 +1,100 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @file
+ * Nanosecond clocks used for timestamps and timing
+ */
+
+#ifndef __UBITRACK_UTIL_CLOCK_H_INCLUDED__
+#define __UBITRACK_UTIL_CLOCK_H_INCLUDED__
+
+#include <utCore.h>
+
+namespace Ubitrack { namespace Util {
+
+/** clock sources for timestamps */
+enum ClockPolicy
+{
+	/**
+	 * operating system wall clock (\c gettimeofday, on Windows the high performance counter
+	 * continuously synchronized to the real time clock). Can jump backwards when the system time is set.
+	 * This is the default.
+	 */
+	SystemClock,
+
+	/**
+	 * monotonic nanosecond clock (\c CLOCK_MONOTONIC, on Windows the high performance counter),
+	 * calibrated once against the wall clock. Does not follow changes of the system time.
+	 */
+	MonotonicClock,
+
+	/**
+	 * the monotonic clock, but successive readings are strictly increasing, even across threads.
+	 * Meant for debugging and tests that rely on unique timestamps: all threads update one shared
+	 * counter on every reading.
+	 */
+	StrictlyIncreasingClock
+};
+
+/**
+ * Selects the clock for the whole process. It is used by \c Measurement::now(), by
+ * \c getHighPerformanceCounter() (on Unix) and by \c Measurement::TimestampSync objects
+ * created afterwards. Should be set once at startup, before any timestamps are taken.
+ */
+UBITRACK_EXPORT void setClockPolicy( ClockPolicy policy );
+
+/** @return the clock selected by \c setClockPolicy() */
+UBITRACK_EXPORT ClockPolicy getClockPolicy();
+
+/**
+ * @return nanoseconds of the raw monotonic clock. The epoch is unspecified (usually the boot time),
+ * use it for time differences only.
+ */
+UBITRACK_EXPORT unsigned long long monotonicNanoseconds();
+
+/** @return nanoseconds since the epoch (UNIX birth) from the operating system wall clock */
+UBITRACK_EXPORT unsigned long long systemNanoseconds();
+
+/**
+ * @return nanoseconds since the epoch (UNIX birth) from the monotonic clock. The offset to the
+ * wall clock is measured once on first use.
+ */
+UBITRACK_EXPORT unsigned long long calibratedNanoseconds();
+
+/**
+ * @return the same as \c calibratedNanoseconds(), but never returns the same value twice and never
+ * goes backwards, also not across threads or after \c calibrateClock().
+ */
+UBITRACK_EXPORT unsigned long long strictlyIncreasingNanoseconds();
+
+/**
+ * Measures the offset between the monotonic clock and the wall clock again, e.g. after the system
+ * time was corrected. \c calibratedNanoseconds() jumps by the correction, if the new offset is smaller,
+ * \c strictlyIncreasingNanoseconds() stalls until it has caught up.
+ */
+UBITRACK_EXPORT void calibrateClock();
+
+} } // namespace Ubitrack::Util
+
+#endif
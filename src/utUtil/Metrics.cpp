@@ -0,0 +1,519 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @file
+ * Implementation of the metrics registry and its exporters
+ */
+
+#include "Metrics.h"
+
+#include <map>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <utUtil/Clock.h>
+#include <utUtil/Exception.h>
+#include <utUtil/OS.h>
+
+#ifndef _WIN32
+	#include <cerrno>
+	#include <unistd.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+#endif
+
+namespace Ubitrack { namespace Util { 
+
+namespace {
+
+	template< class T >
+	void removeFrom( std::vector< T* >& v, T* p )
+	{
+		typename std::vector< T* >::iterator it = std::find( v.begin(), v.end(), p );
+		if ( it != v.end() )
+			v.erase( it );
+	}
+
+	/** escapes a string for JSON, control characters become \\u00XX */
+	std::string escapeJson( const std::string& s )
+	{
+		static const char hex[] = "0123456789abcdef";
+		std::string r;
+		for ( std::string::const_iterator it = s.begin(); it != s.end(); ++it )
+		{
+			const unsigned char c = static_cast< unsigned char >( *it );
+			if ( c == '"' || c == '\\' )
+			{
+				r += '\\';
+				r += *it;
+			}
+			else if ( c < 0x20 )
+			{
+				r += "\\u00";
+				r += hex[ c >> 4 ];
+				r += hex[ c & 0xf ];
+			}
+			else
+				r += *it;
+		}
+		return r;
+	}
+
+	/** escapes a Prometheus label value, which may contain all characters but a newline */
+	std::string escapeLabel( const std::string& s )
+	{
+		std::string r;
+		for ( std::string::const_iterator it = s.begin(); it != s.end(); ++it )
+			switch ( *it )
+			{
+				case '"': r += "\\\""; break;
+				case '\\': r += "\\\\"; break;
+				case '\n': r += "\\n"; break;
+				default: r += *it;
+			}
+		return r;
+	}
+
+	/** valid Prometheus metric name */
+	std::string prometheusName( const std::string& s )
+	{
+		std::string r( "ubitrack_" );
+		for ( std::string::const_iterator it = s.begin(); it != s.end(); ++it )
+			r += ( isalnum( static_cast< unsigned char >( *it ) ) || *it == '_' ) ? *it : '_';
+		return r;
+	}
+
+	/** Prometheus name of a counter or gauge in exports */
+	std::string exportedName( const std::string& s, bool bCounter )
+	{ return prometheusName( s ) + ( bCounter ? "_total" : "" ); }
+
+	/** true if a counter or gauge would be exported under a name that is already in use */
+	template< class T >
+	bool collides( const std::vector< T* >& metrics, bool bCounters, const std::string& sName, bool bCounter )
+	{
+		for ( std::size_t i = 0; i < metrics.size(); i++ )
+		{
+			const std::string& sOther( metrics[ i ]->getName() );
+			// metrics of the same kind and name are merged
+			if ( bCounters == bCounter && sOther == sName )
+				continue;
+			// counters also occupy the name without the _total suffix
+			if ( prometheusName( sOther ) == prometheusName( sName )
+				|| exportedName( sOther, bCounters ) == exportedName( sName, bCounter ) )
+				return true;
+		}
+		return false;
+	}
+
+	/** throws if the name of a new counter or gauge cannot be exported unambiguously */
+	void checkName( const std::vector< Counter* >& counters, const std::vector< Gauge* >& gauges, 
+		const std::string& sName, bool bCounter )
+	{
+		const std::string sExported( exportedName( sName, bCounter ) );
+		if ( sExported.compare( 0, 27, "ubitrack_block_time_seconds" ) == 0 
+			|| sExported.compare( 0, 31, "ubitrack_block_time_max_seconds" ) == 0 
+			|| collides( counters, true, sName, bCounter ) || collides( gauges, false, sName, bCounter ) )
+			UBITRACK_THROW( "Metric name \"" + sName + "\" collides with another metric" );
+	}
+
+	/** JSON number, there is no representation of nan and infinity */
+	std::string jsonNumber( double v )
+	{
+		if ( v != v || v - v != 0 )
+			return "null";
+		std::ostringstream s;
+		s << std::setprecision( 10 ) << v;
+		return s.str();
+	}
+
+	void writeText( std::ostream& os, const MetricsSnapshot& s )
+	{
+		for ( std::size_t i = 0; i < s.timers.size(); i++ )
+		{
+			const BlockTimer::Snapshot& t( s.timers[ i ].second );
+			os << "timer " << s.timers[ i ].first << ": runs " << t.runs
+				<< ", total " << t.totalTime << "ms, avg " << t.getAvgTime() << "ms, min " << t.minTime 
+				<< "ms, p50 " << t.getPercentile( 0.5 ) << "ms, p99 " << t.getPercentile( 0.99 ) 
+				<< "ms, p999 " << t.getPercentile( 0.999 ) << "ms, max " << t.maxTime << "ms\n";
+		}
+		for ( std::size_t i = 0; i < s.counters.size(); i++ )
+			os << "counter " << s.counters[ i ].first << ": " << s.counters[ i ].second << "\n";
+		for ( std::size_t i = 0; i < s.gauges.size(); i++ )
+			os << "gauge " << s.gauges[ i ].first << ": " << s.gauges[ i ].second << "\n";
+	}
+
+	void writeJson( std::ostream& os, const MetricsSnapshot& s )
+	{
+		os << "{\"time\":" << s.time << ",\"timers\":{";
+		for ( std::size_t i = 0; i < s.timers.size(); i++ )
+		{
+			const BlockTimer::Snapshot& t( s.timers[ i ].second );
+			os << ( i ? "," : "" ) << "\"" << escapeJson( s.timers[ i ].first ) << "\":{\"runs\":" << t.runs
+				<< ",\"total_ms\":" << jsonNumber( t.totalTime ) << ",\"avg_ms\":" << jsonNumber( t.getAvgTime() )
+				<< ",\"min_ms\":" << jsonNumber( t.minTime ) << ",\"p50_ms\":" << jsonNumber( t.getPercentile( 0.5 ) )
+				<< ",\"p99_ms\":" << jsonNumber( t.getPercentile( 0.99 ) ) << ",\"p999_ms\":" << jsonNumber( t.getPercentile( 0.999 ) )
+				<< ",\"max_ms\":" << jsonNumber( t.maxTime ) << "}";
+		}
+		os << "},\"counters\":{";
+		for ( std::size_t i = 0; i < s.counters.size(); i++ )
+			os << ( i ? "," : "" ) << "\"" << escapeJson( s.counters[ i ].first ) << "\":" << s.counters[ i ].second;
+		os << "},\"gauges\":{";
+		for ( std::size_t i = 0; i < s.gauges.size(); i++ )
+			os << ( i ? "," : "" ) << "\"" << escapeJson( s.gauges[ i ].first ) << "\":" << jsonNumber( s.gauges[ i ].second );
+		os << "}}\n";
+	}
+
+	void writePrometheus( std::ostream& os, const MetricsSnapshot& s )
+	{
+		if ( !s.timers.empty() )
+		{
+			const char* quantiles[] = { "0.5", "0.99", "0.999" };
+			const double values[] = { 0.5, 0.99, 0.999 };
+			os << "# HELP ubitrack_block_time_seconds Execution time of code blocks measured by BlockTimers.\n"
+				<< "# TYPE ubitrack_block_time_seconds summary\n";
+			for ( std::size_t i = 0; i < s.timers.size(); i++ )
+			{
+				const BlockTimer::Snapshot& t( s.timers[ i ].second );
+				const std::string label( "timer=\"" + escapeLabel( s.timers[ i ].first ) + "\"" );
+				for ( std::size_t q = 0; q < 3; q++ )
+					os << "ubitrack_block_time_seconds{" << label << ",quantile=\"" << quantiles[ q ] << "\"} " 
+						<< t.getPercentile( values[ q ] ) * 1e-3 << "\n";
+				os << "ubitrack_block_time_seconds_sum{" << label << "} " << t.totalTime * 1e-3 << "\n"
+					<< "ubitrack_block_time_seconds_count{" << label << "} " << t.runs << "\n";
+			}
+			os << "# HELP ubitrack_block_time_max_seconds Maximal execution time of code blocks measured by BlockTimers.\n"
+				<< "# TYPE ubitrack_block_time_max_seconds gauge\n";
+			for ( std::size_t i = 0; i < s.timers.size(); i++ )
+				os << "ubitrack_block_time_max_seconds{timer=\"" << escapeLabel( s.timers[ i ].first ) << "\"} " 
+					<< s.timers[ i ].second.maxTime * 1e-3 << "\n";
+		}
+		for ( std::size_t i = 0; i < s.counters.size(); i++ )
+		{
+			const std::string name( prometheusName( s.counters[ i ].first ) + "_total" );
+			os << "# TYPE " << name << " counter\n" << name << " " << s.counters[ i ].second << "\n";
+		}
+		for ( std::size_t i = 0; i < s.gauges.size(); i++ )
+		{
+			const std::string name( prometheusName( s.gauges[ i ].first ) );
+			os << "# TYPE " << name << " gauge\n" << name << " " << s.gauges[ i ].second << "\n";
+		}
+	}
+
+}
+
+
+Counter::Counter( const std::string& sName )
+	: m_sName( sName )
+	, m_value( 0 )
+{
+	MetricsRegistry::instance().add( this );
+}
+
+
+Counter::~Counter()
+{
+	MetricsRegistry::instance().remove( this );
+}
+
+
+Gauge::Gauge( const std::string& sName, double value )
+	: m_sName( sName )
+	, m_value( value )
+{
+	MetricsRegistry::instance().add( this );
+}
+
+
+Gauge::~Gauge()
+{
+	MetricsRegistry::instance().remove( this );
+}
+
+
+void Gauge::add( double d )
+{
+	double old = m_value.load( boost::memory_order_relaxed );
+	while ( !m_value.compare_exchange_weak( old, old + d, boost::memory_order_relaxed ) )
+		;
+}
+
+
+MetricsRegistry::MetricsRegistry()
+	: m_bReporting( false )
+{
+}
+
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+	// never destroyed, as static timers may still unregister at exit
+	static MetricsRegistry* pRegistry = new MetricsRegistry;
+	return *pRegistry;
+}
+
+
+void MetricsRegistry::add( BlockTimer* pTimer )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_timers.push_back( pTimer );
+}
+
+
+void MetricsRegistry::remove( BlockTimer* pTimer )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	removeFrom( m_timers, pTimer );
+}
+
+
+void MetricsRegistry::add( Counter* pCounter )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	checkName( m_counters, m_gauges, pCounter->getName(), true );
+	m_counters.push_back( pCounter );
+}
+
+
+void MetricsRegistry::remove( Counter* pCounter )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	removeFrom( m_counters, pCounter );
+}
+
+
+void MetricsRegistry::add( Gauge* pGauge )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	checkName( m_counters, m_gauges, pGauge->getName(), false );
+	m_gauges.push_back( pGauge );
+}
+
+
+void MetricsRegistry::remove( Gauge* pGauge )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	removeFrom( m_gauges, pGauge );
+}
+
+
+void MetricsRegistry::scheduleReports()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( m_bReporting )
+		m_reportCondition.notify_one();
+	else
+	{
+		m_bReporting = true;
+		boost::thread( boost::bind( &MetricsRegistry::reportLoop, this ) ).detach();
+	}
+}
+
+
+void MetricsRegistry::reportLoop()
+{
+	// timers unregister under the lock, so they cannot be destroyed while they take their snapshots
+	boost::mutex::scoped_lock l( m_mutex );
+	std::vector< BlockTimer::Report > reports;
+	while ( true )
+	{
+		const unsigned long long now = static_cast< unsigned long long >( getHighPerformanceCounter() );
+		unsigned long long next = 0;
+		for ( std::size_t i = 0; i < m_timers.size(); i++ )
+		{
+			const unsigned long long due = m_timers[ i ]->reportIfDue( now, reports );
+			if ( due && ( !next || due < next ) )
+				next = due;
+		}
+
+		if ( !next )
+		{
+			m_bReporting = false;
+			return;
+		}
+
+		// logging may block, so the reports are written without holding the lock. Changes
+		// signalled meanwhile are picked up by checking the timers again before waiting.
+		if ( !reports.empty() )
+		{
+			l.unlock();
+			for ( std::size_t i = 0; i < reports.size(); i++ )
+				reports[ i ].log();
+			reports.clear();
+			l.lock();
+			continue;
+		}
+
+		const unsigned long long later = static_cast< unsigned long long >( getHighPerformanceCounter() );
+		const double ms = ( next - std::min( next, later ) ) / getHighPerformanceFrequency() * 1000;
+		m_reportCondition.timed_wait( l, boost::posix_time::milliseconds( static_cast< long >( ms ) + 1 ) );
+	}
+}
+
+
+MetricsSnapshot MetricsRegistry::snapshot() const
+{
+	std::map< std::string, BlockTimer::Snapshot > timers;
+	std::map< std::string, unsigned long long > counters;
+	std::map< std::string, double > gauges;
+	MetricsSnapshot s;
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		s.time = getClockPolicy() == SystemClock ? systemNanoseconds() : calibratedNanoseconds();
+
+		for ( std::size_t i = 0; i < m_timers.size(); i++ )
+		{
+			const BlockTimer::Snapshot t( m_timers[ i ]->snapshot() );
+			std::map< std::string, BlockTimer::Snapshot >::iterator it = timers.find( m_timers[ i ]->getName() );
+			if ( it == timers.end() )
+				timers[ m_timers[ i ]->getName() ] = t;
+			else if ( t.runs )
+			{
+				// merge timers of the same name
+				BlockTimer::Snapshot& m( it->second );
+				m.minTime = m.runs ? std::min( m.minTime, t.minTime ) : t.minTime;
+				m.maxTime = std::max( m.maxTime, t.maxTime );
+				m.runs += t.runs;
+				m.totalTime += t.totalTime;
+				for ( std::size_t b = 0; b < m.histogram.size(); b++ )
+					m.histogram[ b ] += t.histogram[ b ];
+			}
+		}
+
+		for ( std::size_t i = 0; i < m_counters.size(); i++ )
+			counters[ m_counters[ i ]->getName() ] += m_counters[ i ]->get();
+		for ( std::size_t i = 0; i < m_gauges.size(); i++ )
+			gauges[ m_gauges[ i ]->getName() ] += m_gauges[ i ]->get();
+	}
+
+	s.timers.assign( timers.begin(), timers.end() );
+	s.counters.assign( counters.begin(), counters.end() );
+	s.gauges.assign( gauges.begin(), gauges.end() );
+	return s;
+}
+
+
+void MetricsRegistry::write( std::ostream& os, const MetricsSnapshot& s, Format format )
+{
+	switch ( format )
+	{
+		case TextFormat:
+			writeText( os, s );
+			break;
+		case JsonFormat:
+			writeJson( os, s );
+			break;
+		case PrometheusFormat:
+			writePrometheus( os, s );
+			break;
+	}
+}
+
+
+std::string MetricsRegistry::dump( Format format ) const
+{
+	std::ostringstream os;
+	write( os, snapshot(), format );
+	return os.str();
+}
+
+
+void MetricsRegistry::dumpToFile( const std::string& sFilename, Format format ) const
+{
+	const std::string sTemp( sFilename + ".tmp" );
+	{
+		std::ofstream f( sTemp.c_str() );
+		if ( !f )
+			UBITRACK_THROW( "Cannot write metrics to " + sTemp );
+		write( f, snapshot(), format );
+		if ( !f )
+			UBITRACK_THROW( "Cannot write metrics to " + sTemp );
+	}
+
+#ifdef _WIN32
+	std::remove( sFilename.c_str() );
+#endif
+	if ( std::rename( sTemp.c_str(), sFilename.c_str() ) != 0 )
+		UBITRACK_THROW( "Cannot rename metrics file to " + sFilename );
+}
+
+
+void MetricsRegistry::dumpToSocket( const std::string& sSocketPath, Format format ) const
+{
+#ifndef _WIN32
+	sockaddr_un address;
+	std::memset( &address, 0, sizeof( address ) );
+	address.sun_family = AF_UNIX;
+	if ( sSocketPath.size() >= sizeof( address.sun_path ) )
+		UBITRACK_THROW( "Socket path too long: " + sSocketPath );
+	std::strcpy( address.sun_path, sSocketPath.c_str() );
+
+	const int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if ( fd < 0 )
+		UBITRACK_THROW( "Cannot create socket" );
+	if ( connect( fd, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) != 0 )
+	{
+		close( fd );
+		UBITRACK_THROW( "Cannot connect to " + sSocketPath );
+	}
+
+	// a reader that closes the connection must not raise SIGPIPE in the process
+#ifdef SO_NOSIGPIPE
+	const int one = 1;
+	setsockopt( fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof( one ) );
+#endif
+#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL;
+#else
+	const int flags = 0;
+#endif
+
+	const std::string s( dump( format ) );
+	for ( std::size_t written = 0; written < s.size(); )
+	{
+		const ssize_t n = send( fd, s.data() + written, s.size() - written, flags );
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n <= 0 )
+		{
+			const bool bClosed = n < 0 && errno == EPIPE;
+			close( fd );
+			UBITRACK_THROW( ( bClosed ? "Connection closed by " : "Cannot write metrics to " ) + sSocketPath );
+		}
+		written += static_cast< std::size_t >( n );
+	}
+	close( fd );
+#else
+	UBITRACK_THROW( "Metrics can only be written to unix domain sockets" );
+#endif
+}
+
+} } // namespace Ubitrack::Util
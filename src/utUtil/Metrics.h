@@ -0,0 +1,203 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the 
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @file
+ * Process-wide registry of timers, counters and gauges, with exporters for 
+ * text, JSON and the Prometheus exposition format.
+ */ 
+
+#ifndef __UBITRACK_UTIL_METRICS_H_INCLUDED__
+#define __UBITRACK_UTIL_METRICS_H_INCLUDED__
+ 
+#include <string>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <boost/utility.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <utCore.h>
+#include <utUtil/BlockTimer.h>
+
+namespace Ubitrack { namespace Util {
+
+/**
+ * A monotonically increasing count, e.g. of processed or dropped measurements.
+ * Registers itself in the \c MetricsRegistry for its lifetime. Thread-safe.
+ */
+class UBITRACK_EXPORT Counter
+	: private boost::noncopyable
+{
+public:
+	/** 
+	 * @param sName name of the counter, counters with the same name are added in exports. 
+	 *   Throws \c Util::Exception if a gauge or another counter is exported under the same name.
+	 */
+	explicit Counter( const std::string& sName );
+
+	~Counter();
+
+	/** increments the counter */
+	void increment( unsigned long long n = 1 )
+	{ m_value.fetch_add( n, boost::memory_order_relaxed ); }
+
+	/** returns the current value */
+	unsigned long long get() const
+	{ return m_value.load( boost::memory_order_relaxed ); }
+
+	const std::string& getName() const
+	{ return m_sName; }
+
+protected:
+	const std::string m_sName;
+	boost::atomic< unsigned long long > m_value;
+};
+
+
+/**
+ * A value that can go up and down, e.g. a queue length or a frame rate.
+ * Registers itself in the \c MetricsRegistry for its lifetime. Thread-safe.
+ */
+class UBITRACK_EXPORT Gauge
+	: private boost::noncopyable
+{
+public:
+	/** 
+	 * @param sName name of the gauge, gauges with the same name are added in exports.
+	 *   Throws \c Util::Exception if a counter or another gauge is exported under the same name.
+	 */
+	explicit Gauge( const std::string& sName, double value = 0 );
+
+	~Gauge();
+
+	/** sets the value */
+	void set( double value )
+	{ m_value.store( value, boost::memory_order_relaxed ); }
+
+	/** adds to the value */
+	void add( double d );
+
+	/** returns the current value */
+	double get() const
+	{ return m_value.load( boost::memory_order_relaxed ); }
+
+	const std::string& getName() const
+	{ return m_sName; }
+
+protected:
+	const std::string m_sName;
+	boost::atomic< double > m_value;
+};
+
+
+/** values of all registered metrics at one point in time, metrics with the same name are merged */
+struct UBITRACK_EXPORT MetricsSnapshot
+{
+	/** time of the snapshot in nanoseconds since the epoch */
+	unsigned long long time;
+
+	/** timers, sorted by name */
+	std::vector< std::pair< std::string, BlockTimer::Snapshot > > timers;
+
+	/** counters, sorted by name */
+	std::vector< std::pair< std::string, unsigned long long > > counters;
+
+	/** gauges, sorted by name */
+	std::vector< std::pair< std::string, double > > gauges;
+};
+
+
+/**
+ * Process-wide registry of all \c BlockTimer, \c Counter and \c Gauge objects.
+ *
+ * Metrics register in their constructor and unregister in their destructor, which are the only
+ * places that lock the registry. Taking a snapshot locks the registry against such changes, but 
+ * reads the values with atomic loads, so the threads that update the metrics are never stopped.
+ */
+class UBITRACK_EXPORT MetricsRegistry
+	: private boost::noncopyable
+{
+public:
+	/** export formats */
+	enum Format { TextFormat, JsonFormat, PrometheusFormat };
+
+	/** returns the registry */
+	static MetricsRegistry& instance();
+
+	void add( BlockTimer* pTimer );
+	void remove( BlockTimer* pTimer );
+	void add( Counter* pCounter );
+	void remove( Counter* pCounter );
+	void add( Gauge* pGauge );
+	void remove( Gauge* pGauge );
+
+	/** reads all metrics */
+	MetricsSnapshot snapshot() const;
+
+	/** writes a snapshot in the given format */
+	static void write( std::ostream& os, const MetricsSnapshot& s, Format format );
+
+	/** returns a snapshot of all metrics in the given format */
+	std::string dump( Format format ) const;
+
+	/** 
+	 * Writes a snapshot of all metrics to a file. The file is written under a temporary name and 
+	 * then renamed, so readers never see a partial snapshot. Throws \c Util::Exception on errors.
+	 */
+	void dumpToFile( const std::string& sFilename, Format format ) const;
+
+	/**
+	 * Writes a snapshot of all metrics to a local (unix domain) socket, which must be listening.
+	 * Throws \c Util::Exception on errors, including a reader that closes the connection early, 
+	 * and on systems without unix domain sockets. Never raises \c SIGPIPE.
+	 */
+	void dumpToSocket( const std::string& sSocketPath, Format format ) const;
+
+	/** 
+	 * Starts the report thread if necessary and wakes it up to pick up changed report intervals.
+	 * Called by \c BlockTimer::setReportInterval(). The thread ends when no timer has a report interval.
+	 */
+	void scheduleReports();
+
+protected:
+	MetricsRegistry();
+
+	/** writes the periodic reports of the timers */
+	void reportLoop();
+
+	mutable boost::mutex m_mutex;
+	std::vector< BlockTimer* > m_timers;
+	std::vector< Counter* > m_counters;
+	std::vector< Gauge* > m_gauges;
+
+	/** true while the report thread runs */
+	bool m_bReporting;
+	boost::condition_variable m_reportCondition;
+};
+
+} } // namespace Ubitrack::Util
+
+#endif //__UBITRACK_UTIL_METRICS_H_INCLUDED__
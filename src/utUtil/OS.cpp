@@ -29,6 +29,7 @@
  */ 
 
 #include "OS.h"
+#include "Clock.h"
 
 #ifdef WIN32
 #include "CleanWindows.h"
@@ -75,16 +76,16 @@ void sleep( unsigned ms, unsigned ns )
 
 long long getHighPerformanceCounter()
 {
-	// TODO: read CPU counter
-	struct timeval tv;
-	gettimeofday( &tv, 0 );
-	return tv.tv_sec * static_cast< long long >( 1000000 ) + tv.tv_usec;
+	// nanoseconds of the clock selected by the clock policy, without the calibration to the wall clock
+	if ( getClockPolicy() == SystemClock )
+		return static_cast< long long >( systemNanoseconds() );
+	return static_cast< long long >( monotonicNanoseconds() );
 }
 
 
 double getHighPerformanceFrequency()
 {
-	return 1000000.0;
+	return 1e9;
 }
 	
 #endif
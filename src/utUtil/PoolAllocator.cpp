@@ -0,0 +1,252 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @file
+ * Implementation of the small object pool
+ */
+
+#include <vector>
+#include <utility>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/config.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "PoolAllocator.h"
+
+namespace Ubitrack { namespace Util {
+
+namespace {
+
+/** size classes are multiples of this, also the alignment of all blocks */
+const std::size_t g_granularity = 16;
+
+/** number of size classes */
+const std::size_t g_nClasses = poolMaxBlockSize / g_granularity;
+
+/** number of blocks passed between a thread cache and the depot at once */
+const std::size_t g_batchSize = 64;
+
+/** free blocks are linked through their first bytes */
+struct FreeBlock
+{
+	FreeBlock* pNext;
+};
+
+/** list of free blocks of one size class */
+struct FreeList
+{
+	FreeList()
+		: pHead( 0 )
+		, count( 0 )
+	{}
+
+	void push( FreeBlock* pBlock )
+	{
+		pBlock->pNext = pHead;
+		pHead = pBlock;
+		count++;
+	}
+
+	FreeBlock* pop()
+	{
+		FreeBlock* pBlock = pHead;
+		pHead = pBlock->pNext;
+		count--;
+		return pBlock;
+	}
+
+	/** removes \c n blocks from the list and returns them as a new list */
+	FreeList split( const std::size_t n )
+	{
+		FreeList result;
+		while ( result.count < n && pHead )
+			result.push( pop() );
+		return result;
+	}
+
+	FreeBlock* pHead;
+	std::size_t count;
+};
+
+/** global store of free blocks shared by all threads */
+struct Depot
+{
+	boost::mutex mutex;
+	std::vector< FreeList > batches[ g_nClasses ];
+};
+
+Depot& depot()
+{
+	// never destroyed, blocks may still be freed during static destruction
+	static Depot* pDepot = new Depot;
+	return *pDepot;
+}
+
+/** returns a batch of blocks to the depot */
+void returnBatch( const std::size_t sizeClass, const FreeList& batch )
+{
+	if ( !batch.count )
+		return;
+	Depot& d( depot() );
+	boost::mutex::scoped_lock lock( d.mutex );
+	d.batches[ sizeClass ].push_back( batch );
+}
+
+/** gets a batch of blocks from the depot or allocates a new chunk */
+FreeList fetchBatch( const std::size_t sizeClass )
+{
+	{
+		Depot& d( depot() );
+		boost::mutex::scoped_lock lock( d.mutex );
+		std::vector< FreeList >& batches( d.batches[ sizeClass ] );
+		if ( !batches.empty() )
+		{
+			FreeList batch = batches.back();
+			batches.pop_back();
+			return batch;
+		}
+	}
+
+	const std::size_t blockSize = ( sizeClass + 1 ) * g_granularity;
+	char* pChunk = static_cast< char* >( ::operator new( blockSize * g_batchSize ) );
+	FreeList batch;
+	for ( std::size_t i = g_batchSize; i > 0; i-- )
+		batch.push( reinterpret_cast< FreeBlock* >( pChunk + ( i - 1 ) * blockSize ) );
+	return batch;
+}
+
+#ifndef BOOST_NO_CXX11_THREAD_LOCAL
+
+/**
+ * set when the cache of the thread has been destroyed. Destructors of other thread_local objects 
+ * and, in the main thread, of static objects can still free blocks afterwards.
+ */
+thread_local bool t_bCacheDestroyed = false;
+
+#endif
+
+/** per-thread cache of free blocks */
+struct ThreadCache
+{
+	~ThreadCache()
+	{
+		// hand everything over to the other threads
+		for ( std::size_t c = 0; c < g_nClasses; c++ )
+			while ( lists[ c ].count )
+				returnBatch( c, lists[ c ].split( g_batchSize ) );
+
+#ifndef BOOST_NO_CXX11_THREAD_LOCAL
+		t_bCacheDestroyed = true;
+#endif
+	}
+
+	FreeList lists[ g_nClasses ];
+};
+
+#ifndef BOOST_NO_CXX11_THREAD_LOCAL
+
+/** @return the cache of the current thread, 0 if it has already been destroyed */
+ThreadCache* threadCache()
+{
+	if ( t_bCacheDestroyed )
+		return 0;
+	static thread_local ThreadCache cache;
+	return &cache;
+}
+
+#else
+
+/** @return the cache of the current thread */
+ThreadCache* threadCache()
+{
+	static boost::thread_specific_ptr< ThreadCache >* pCache = new boost::thread_specific_ptr< ThreadCache >;
+	ThreadCache* p = pCache->get();
+	if ( !p )
+	{
+		p = new ThreadCache;
+		pCache->reset( p );
+	}
+	return p;
+}
+
+#endif
+
+} // anonymous namespace
+
+
+void* poolAllocate( std::size_t size )
+{
+	if ( size == 0 || size > poolMaxBlockSize )
+		return ::operator new( size );
+
+	const std::size_t sizeClass = ( size - 1 ) / g_granularity;
+	ThreadCache* pCache = threadCache();
+	if ( !pCache )
+	{
+		// the thread is exiting, work on the depot directly
+		FreeList batch( fetchBatch( sizeClass ) );
+		void* p = batch.pop();
+		returnBatch( sizeClass, batch );
+		return p;
+	}
+
+	FreeList& list( pCache->lists[ sizeClass ] );
+	if ( !list.count )
+		list = fetchBatch( sizeClass );
+	return list.pop();
+}
+
+
+void poolDeallocate( void* p, std::size_t size )
+{
+	if ( !p )
+		return;
+
+	if ( size == 0 || size > poolMaxBlockSize )
+	{
+		::operator delete( p );
+		return;
+	}
+
+	const std::size_t sizeClass = ( size - 1 ) / g_granularity;
+	ThreadCache* pCache = threadCache();
+	if ( !pCache )
+	{
+		// the thread is exiting, give the block directly to the depot
+		FreeList single;
+		single.push( static_cast< FreeBlock* >( p ) );
+		returnBatch( sizeClass, single );
+		return;
+	}
+
+	FreeList& list( pCache->lists[ sizeClass ] );
+	list.push( static_cast< FreeBlock* >( p ) );
+
+	// threads that mostly free (e.g. consumers of measurements) pass their surplus on
+	if ( list.count >= 2 * g_batchSize )
+		returnBatch( sizeClass, list.split( g_batchSize ) );
+}
+
+} } // namespace Ubitrack::Util
@@ -0,0 +1,139 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @file
+ * Pooled allocation of small objects with thread-local caches
+ */
+
+#ifndef __UBITRACK_UTIL_POOL_ALLOCATOR_H_INCLUDED__
+#define __UBITRACK_UTIL_POOL_ALLOCATOR_H_INCLUDED__
+
+#include <cstddef>
+#include <new>
+#include <limits>
+#include <utCore.h>
+
+namespace Ubitrack { namespace Util {
+
+/**
+ * Allocates a block of memory from the small object pool.
+ *
+ * Blocks up to \c poolMaxBlockSize bytes are taken from size classes of 16 bytes. Every thread
+ * keeps a cache of free blocks per size class, so allocation and deallocation usually do not
+ * synchronize at all. Blocks may be freed by a different thread than the one that allocated them,
+ * excess blocks are passed between threads in batches through a global depot. Memory of the
+ * pool is never returned to the system but kept for reuse.
+ *
+ * Larger blocks are allocated with \c ::operator \c new.
+ *
+ * @param size size of the block in bytes
+ * @return pointer to the block, throws \c std::bad_alloc on failure
+ */
+UBITRACK_EXPORT void* poolAllocate( std::size_t size );
+
+/**
+ * Returns a block allocated with \c poolAllocate to the pool.
+ * @param p pointer to the block
+ * @param size size of the block in bytes, same as passed to \c poolAllocate
+ */
+UBITRACK_EXPORT void poolDeallocate( void* p, std::size_t size );
+
+/** blocks larger than this are not pooled */
+static const std::size_t poolMaxBlockSize = 512;
+
+
+/**
+ * Standard allocator using the small object pool.
+ *
+ * Single objects are taken from the pool, arrays from \c ::operator \c new.
+ * Mainly used with \c boost::allocate_shared to get the payload and reference count
+ * of a \c shared_ptr in one pooled allocation.
+ */
+template< typename T >
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+
+	template< typename U >
+	struct rebind
+	{
+		typedef PoolAllocator< U > other;
+	};
+
+	PoolAllocator()
+	{}
+
+	template< typename U >
+	PoolAllocator( const PoolAllocator< U >& )
+	{}
+
+	pointer address( reference x ) const
+	{ return &x; }
+
+	const_pointer address( const_reference x ) const
+	{ return &x; }
+
+	pointer allocate( size_type n, const void* = 0 )
+	{
+		if ( n == 1 )
+			return static_cast< pointer >( poolAllocate( sizeof( T ) ) );
+		return static_cast< pointer >( ::operator new( n * sizeof( T ) ) );
+	}
+
+	void deallocate( pointer p, size_type n )
+	{
+		if ( n == 1 )
+			poolDeallocate( p, sizeof( T ) );
+		else
+			::operator delete( p );
+	}
+
+	size_type max_size() const
+	{ return std::numeric_limits< size_type >::max() / sizeof( T ); }
+
+	void construct( pointer p, const T& value )
+	{ new( p ) T( value ); }
+
+	void destroy( pointer p )
+	{ p->~T(); }
+};
+
+template< typename T, typename U >
+inline bool operator==( const PoolAllocator< T >&, const PoolAllocator< U >& )
+{ return true; }
+
+template< typename T, typename U >
+inline bool operator!=( const PoolAllocator< T >&, const PoolAllocator< U >& )
+{ return false; }
+
+} } // namespace Ubitrack::Util
+
+#endif
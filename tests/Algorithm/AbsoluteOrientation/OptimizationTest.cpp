@@ -5,6 +5,7 @@
 #include <utMath/Geometry/PointTransformation.h>
 #include <utAlgorithm/PoseEstimation3D3D/AbsoluteOrientation.h>
 #include <utAlgorithm/PoseEstimation3D3D/Optimization.h>
+#include <utMath/Optimization/LevenbergMarquardt.h>
 
 #include <utMath/Random/Scalar.h>
 #include <utMath/Random/Vector.h>
@@ -92,11 +93,137 @@ void testOptimizedAbsoluteOrientationRandom( const std::size_t n_runs, const T e
 
 #ifdef HAVE_LAPACK
 
+template< typename T >
+void testLevenbergMarquardtSolverReuse( const std::size_t n_runs, const T epsilon )
+{
+	typename Random::Quaternion< T >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randVector( -1, 1 );
+	typename Random::Vector< T, 3 >::Uniform randPositionNoise( -0.01, 0.01 );
+
+	const Ubitrack::Math::Optimization::OptTerminate termCrit( 50, 1e-8 );
+
+	// one solver with static parameter size is reused for all problems
+	Ubitrack::Math::Optimization::LevenbergMarquardtSolver< T, 0, 7 > lm;
+	
+	for ( std::size_t iRun = 0; iRun < n_runs; iRun++ )
+	{
+		const std::size_t n_p3d = 10+(iRun%5);
+
+		std::vector< Vector< T, 3 > > rightFrame;
+		rightFrame.reserve( n_p3d );
+		std::generate_n ( std::back_inserter( rightFrame ), n_p3d,  randVector );
+		
+		const Quaternion q = randQuat();
+		const Vector< T, 3 > t = randVector();
+		
+		std::vector< Vector< T, 3 > > leftFrame;
+		leftFrame.reserve( n_p3d );
+		Geometry::transform_points( Matrix< T, 3, 4 >( q, t ), rightFrame.begin(), rightFrame.end(), std::back_inserter( leftFrame ) );
+		
+		Vector< T > measurement( 3 * n_p3d );
+		for ( std::size_t i = 0; i < n_p3d; i++ )
+			for ( std::size_t j = 0; j < 3; j++ )
+				measurement( i*3+j ) = leftFrame[ i ]( j );
+		
+		const Pose perurbedPose( Quaternion( q.x() + 0.01, q.y() - 0.01, q.z(), q.w() ).normalize(), t + randPositionNoise() );
+		Vector< T > paramsReference( 7 );
+		perurbedPose.toVector( paramsReference );
+		Vector< T, 7 > params( paramsReference );
+
+		Ubitrack::Algorithm::PoseEstimation3D3D::PointCorrespodencesSinglePose< typename std::vector< Vector< T, 3 > >::const_iterator > 
+			func( rightFrame.begin(), rightFrame.end() );
+
+		const T resReference = Ubitrack::Math::Optimization::levenbergMarquardt( func, paramsReference, measurement, termCrit, Ubitrack::Math::Optimization::OptNoNormalize() );
+		const T res = lm.solve( func, params, measurement, termCrit, Ubitrack::Math::Optimization::OptNoNormalize() );
+		
+		BOOST_CHECK_EQUAL( lm.measurementSize(), 3 * n_p3d );
+		BOOST_CHECK( std::abs( res - resReference ) < epsilon );
+		for ( std::size_t i = 0; i < 7; i++ )
+			BOOST_CHECK_MESSAGE( std::abs( params( i ) - paramsReference( i ) ) < epsilon, 
+				"\nCompare parameters of reused solver and levenbergMarquardt():\n" << params << "\n" << paramsReference );
+	}
+}
+
+template< typename T >
+void testCallerProvidedSolver( const std::size_t n_runs, const T epsilon )
+{
+	typename Random::Quaternion< T >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randVector( -1, 1 );
+	typename Random::Vector< T, 3 >::Uniform randPositionNoise( -0.01, 0.01 );
+
+	const Ubitrack::Math::Optimization::OptTerminate termCrit( 50, 1e-8 );
+	typedef Ubitrack::Math::Optimization::LevenbergMarquardtSolver< T, 0, 7 > Solver;
+	Solver lm;
+
+	// the thread's solver is a single object
+	Solver* pFirst = &Ubitrack::Math::Optimization::threadLevenbergMarquardtSolver< T, 0, 7 >();
+	Solver* pSecond = &Ubitrack::Math::Optimization::threadLevenbergMarquardtSolver< T, 0, 7 >();
+	BOOST_CHECK( pFirst == pSecond );
+
+	for ( std::size_t iRun = 0; iRun < n_runs; iRun++ )
+	{
+		const std::size_t n_p3d = 10+(iRun%3);
+
+		std::vector< Vector< T, 3 > > rightFrame;
+		rightFrame.reserve( n_p3d );
+		std::generate_n ( std::back_inserter( rightFrame ), n_p3d,  randVector );
+
+		const Quaternion q = randQuat();
+		const Vector< T, 3 > t = randVector();
+
+		std::vector< Vector< T, 3 > > leftFrame;
+		leftFrame.reserve( n_p3d );
+		Geometry::transform_points( Matrix< T, 3, 4 >( q, t ), rightFrame.begin(), rightFrame.end(), std::back_inserter( leftFrame ) );
+
+		const Pose perurbedPose( Quaternion( q.x() + 0.01, q.y() - 0.01, q.z(), q.w() ).normalize(), t + randPositionNoise() );
+
+		Pose poseReference = perurbedPose;
+		const bool bReference = Ubitrack::Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( leftFrame.begin(), leftFrame.end(), poseReference, rightFrame.begin(), rightFrame.end(), termCrit );
+
+		Pose pose = perurbedPose;
+		const bool bDone = Ubitrack::Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( leftFrame.begin(), leftFrame.end(), pose, rightFrame.begin(), rightFrame.end(), termCrit, lm );
+
+		BOOST_CHECK_EQUAL( bDone, bReference );
+		BOOST_CHECK_EQUAL( lm.measurementSize(), 3 * n_p3d );
+		BOOST_CHECK_MESSAGE( quaternionDiff( pose.rotation(), poseReference.rotation() ) < epsilon
+			&& vectorDiff( pose.translation(), poseReference.translation() ) < epsilon,
+			"\nCompare caller-provided and thread solver:\n" << pose << "\n" << poseReference );
+	}
+
+	// a warm solver keeps the measurement vector for problems of the same size
+	{
+		const std::size_t n_p3d = 10;
+		std::vector< Vector< T, 3 > > rightFrame;
+		rightFrame.reserve( n_p3d );
+		std::generate_n ( std::back_inserter( rightFrame ), n_p3d,  randVector );
+		std::vector< Vector< T, 3 > > leftFrame;
+		leftFrame.reserve( n_p3d );
+		Geometry::transform_points( Matrix< T, 3, 4 >( randQuat(), randVector() ), rightFrame.begin(), rightFrame.end(), std::back_inserter( leftFrame ) );
+
+		Pose pose;
+		Ubitrack::Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( leftFrame.begin(), leftFrame.end(), pose, rightFrame.begin(), rightFrame.end(), termCrit, lm );
+		const T* pBuffer = &lm.measurementBuffer( 3 * n_p3d )( 0 );
+		Ubitrack::Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( leftFrame.begin(), leftFrame.end(), pose, rightFrame.begin(), rightFrame.end(), termCrit, lm );
+		BOOST_CHECK( &lm.measurementBuffer( 3 * n_p3d )( 0 ) == pBuffer );
+		for ( std::size_t i = 0; i < n_p3d; i++ )
+			for ( std::size_t j = 0; j < 3; j++ )
+				BOOST_CHECK_EQUAL( lm.measurementBuffer( 3 * n_p3d )( i*3+j ), leftFrame[ i ]( j ) );
+	}
+}
+
 void TestOptimizedAbsoluteOrientation()
 {
 	// do some iterations of random tests
 	testOptimizedAbsoluteOrientationRandom< float >( 1000, 1e-2f );
 	testOptimizedAbsoluteOrientationRandom< double >( 1000, 1e-6 );
+	
+	// workspace reusing solver has to give the same results as the free function
+	testLevenbergMarquardtSolverReuse< float >( 100, 1e-4f );
+	testLevenbergMarquardtSolverReuse< double >( 100, 1e-10 );
+	
+	// caller-provided solver has to give the same results as the thread's solver
+	testCallerProvidedSolver< float >( 100, 1e-4f );
+	testCallerProvidedSolver< double >( 100, 1e-10 );
 }
 
 #else // HAVE_LAPACK
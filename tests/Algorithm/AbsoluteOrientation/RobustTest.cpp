@@ -4,6 +4,8 @@
 #include <utMath/Matrix.h>
 #include <utMath/Geometry/PointTransformation.h>
 #include <utAlgorithm/PoseEstimation3D3D/Ransac.h>
+#include <utMath/Optimization/ParallelRansac.h>
+#include <utMath/Optimization/RansacStrategies.h>
 
 #include <utMath/Random/Scalar.h>
 #include <utMath/Random/Vector.h>
@@ -97,12 +99,233 @@ void testRansacAbsoluteOrientationRandom( const std::size_t n_runs, const T epsi
 	}	
 }
 
+template< typename T >
+void testParallelRansacAbsoluteOrientationRandom( const std::size_t n_runs, const T epsilon )
+{
+	typename Random::Quaternion< T >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randVector( -100, 100 );
+	
+	for ( std::size_t iRun = 0; iRun < n_runs; iRun++ )
+	{
+		const std::size_t n_p3d = 10+(iRun%491);
+
+		std::vector< Vector< T, 3 > > rightFrame;
+		rightFrame.reserve( n_p3d );
+		std::generate_n ( std::back_inserter( rightFrame ), n_p3d,  randVector );
+		
+		Quaternion q = randQuat();
+		Vector< T, 3 > t = randVector();
+		Matrix< T, 3, 4 > trafo( q, t );
+		
+		std::vector< Vector< T, 3 > > leftFrame;
+		leftFrame.reserve( n_p3d );
+		Geometry::transform_points( trafo, rightFrame.begin(), rightFrame.end(), std::back_inserter( leftFrame ) );
+		
+		// now produce some (10%) outlier on both sides
+		const std::size_t outlier( n_p3d/10 );
+		for( std::size_t i = 0; i<outlier; ++i )
+		{
+			const std::size_t index1 = Random::distribute_uniform< std::size_t >( 0, n_p3d-1 ) ;
+			leftFrame[ index1 ] = randVector();
+			
+			const std::size_t index2 = Random::distribute_uniform< std::size_t >( 0, n_p3d-1 ) ;
+			rightFrame[ index2 ] = randVector();
+		}
+		
+		const Ubitrack::Math::Optimization::RansacParameter< T > serialParams( T( 0.05 ), 3, n_p3d, T( 0.4 ), T( 0.99 ) );
+		const Ubitrack::Math::Optimization::ParallelRansacParameter< T > params( serialParams, 1 + ( iRun % 4 ), 0, static_cast< boost::uint32_t >( iRun ) );
+		
+		Pose estimatedPose;
+		const bool b_done = Ubitrack::Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( leftFrame.begin(), leftFrame.end(), estimatedPose, rightFrame.begin(), rightFrame.end(), params );
+		
+		const T rotDiff = quaternionDiff( estimatedPose.rotation(), q );
+		const T posDiff = vectorDiff( estimatedPose.translation(), t );
+		
+		if( !b_done )
+		{
+			BOOST_WARN_MESSAGE( b_done, "Algorithm did not successfully estimate a result with " << n_p3d 
+				<< " points.\nRemaining difference in rotation " << rotDiff << ", difference in translation " << posDiff << "." );
+			continue;
+		}
+		
+		BOOST_CHECK_MESSAGE( rotDiff < epsilon, "\nCompare rotation    result (expected vs. estimated) using " << n_p3d << " points:\n" << q << " " << estimatedPose.rotation() );
+		BOOST_CHECK_MESSAGE( posDiff < epsilon, "\nCompare translation result (expected vs. estimated) using " << n_p3d << " points:\n" << t << " " << estimatedPose.translation() );
+		
+		// the same seed and number of threads must reproduce the result exactly
+		Pose repeatedPose;
+		Ubitrack::Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( leftFrame.begin(), leftFrame.end(), repeatedPose, rightFrame.begin(), rightFrame.end(), params );
+		BOOST_CHECK_EQUAL( estimatedPose.rotation().x(), repeatedPose.rotation().x() );
+		BOOST_CHECK_EQUAL( estimatedPose.rotation().y(), repeatedPose.rotation().y() );
+		BOOST_CHECK_EQUAL( estimatedPose.rotation().z(), repeatedPose.rotation().z() );
+		BOOST_CHECK_EQUAL( estimatedPose.rotation().w(), repeatedPose.rotation().w() );
+		for( std::size_t i = 0; i < 3; ++i )
+			BOOST_CHECK_EQUAL( estimatedPose.translation()( i ), repeatedPose.translation()( i ) );
+	}	
+}
+
+/// mean of scalar values, which fails for negative values (std::logic_error) and for values larger than 100 (std::runtime_error)
+template< typename T >
+struct FailingMean
+{
+	struct Estimator
+	{
+		template< typename InputIterator, typename ResultType >
+		bool operator()( ResultType& result, const InputIterator iBegin, const InputIterator iEnd ) const
+		{
+			result = 0;
+			for( InputIterator it = iBegin; it != iEnd; ++it )
+			{
+				if( *it < 0 )
+					throw std::logic_error( "negative value" );
+				if( *it > 100 )
+					throw std::runtime_error( "value out of range" );
+				result += *it;
+			}
+			result /= static_cast< T >( std::distance( iBegin, iEnd ) );
+			return true;
+		}
+	};
+
+	struct Evaluator
+	{
+		T operator()( const T& mean, const T& value ) const
+		{
+			return std::fabs( mean - value );
+		}
+	};
+};
+
+template< typename T >
+void testParallelRansacExceptions()
+{
+	using namespace Ubitrack::Math::Optimization;
+
+	std::vector< T > values( 20, T( 1 ) );
+	values[ 7 ] = T( 1000 );
+	const RansacParameter< T > serialParams( T( 0.1 ), std::size_t( 2 ), values.size() - 1, std::size_t( 200 ) );
+
+	for( std::size_t nThreads = 1; nThreads <= 4; ++nThreads )
+	{
+		const ParallelRansacParameter< T > params( serialParams, nThreads, 0, static_cast< boost::uint32_t >( nThreads ) );
+
+		// a std::runtime_error only discards the hypothesis
+		T mean( 0 );
+		std::size_t nInlier = 0;
+		BOOST_CHECK_NO_THROW( nInlier = ransac( values.begin(), values.end(), mean, FailingMean< T >(), params ) );
+		BOOST_CHECK_EQUAL( nInlier, values.size() - 1 );
+		BOOST_CHECK_SMALL( mean - T( 1 ), T( 1e-12 ) );
+
+		// any other exception reaches the caller, the required inlier cannot be found before the failing value is drawn
+		std::vector< T > invalid( values );
+		invalid[ 3 ] = T( -1 );
+		BOOST_CHECK_THROW( ransac( invalid.begin(), invalid.end(), mean, FailingMean< T >(), params ), std::logic_error );
+	}
+}
+
+template< typename T, typename ParameterType >
+void checkRansacStrategy( const std::vector< Vector< T, 3 > >& leftFrame, const std::vector< Vector< T, 3 > >& rightFrame
+	, const Quaternion& q, const Vector< T, 3 >& t, const ParameterType& params, const char* name, const T epsilon )
+{
+	Pose estimatedPose;
+	const bool b_done = Ubitrack::Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( leftFrame.begin(), leftFrame.end(), estimatedPose, rightFrame.begin(), rightFrame.end(), params );
+	
+	const T rotDiff = quaternionDiff( estimatedPose.rotation(), q );
+	const T posDiff = vectorDiff( estimatedPose.translation(), t );
+	
+	if( !b_done )
+	{
+		BOOST_WARN_MESSAGE( b_done, name << " did not successfully estimate a result with " << leftFrame.size() 
+			<< " points.\nRemaining difference in rotation " << rotDiff << ", difference in translation " << posDiff << "." );
+		return;
+	}
+	
+	BOOST_CHECK_MESSAGE( rotDiff < epsilon, "\n" << name << ": compare rotation    result (expected vs. estimated) using " << leftFrame.size() << " points:\n" << q << " " << estimatedPose.rotation() );
+	BOOST_CHECK_MESSAGE( posDiff < epsilon, "\n" << name << ": compare translation result (expected vs. estimated) using " << leftFrame.size() << " points:\n" << t << " " << estimatedPose.translation() );
+}
+
+template< typename T >
+void testRansacStrategiesAbsoluteOrientationRandom( const std::size_t n_runs, const T epsilon )
+{
+	typename Random::Quaternion< T >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randVector( -100, 100 );
+	
+	for ( std::size_t iRun = 0; iRun < n_runs; iRun++ )
+	{
+		const std::size_t n_p3d = 20+(iRun%181);
+
+		std::vector< Vector< T, 3 > > rightFrame;
+		rightFrame.reserve( n_p3d );
+		std::generate_n ( std::back_inserter( rightFrame ), n_p3d,  randVector );
+		
+		Quaternion q = randQuat();
+		Vector< T, 3 > t = randVector();
+		Matrix< T, 3, 4 > trafo( q, t );
+		
+		std::vector< Vector< T, 3 > > leftFrame;
+		leftFrame.reserve( n_p3d );
+		Geometry::transform_points( trafo, rightFrame.begin(), rightFrame.end(), std::back_inserter( leftFrame ) );
+		
+		// 30% outlier at the end, values are sorted by quality as required for PROSAC
+		const std::size_t outlier( (3*n_p3d)/10 );
+		for( std::size_t i = n_p3d - outlier; i<n_p3d; ++i )
+			leftFrame[ i ] = randVector();
+		
+		using namespace Ubitrack::Math::Optimization;
+		const RansacParameter< T > params( T( 0.05 ), std::size_t( 3 ), n_p3d / 2, std::size_t( 10000 ) );
+		
+		checkRansacStrategy( leftFrame, rightFrame, q, t, AdaptiveRansacParameter< T >( params ), "adaptive RANSAC", epsilon );
+		checkRansacStrategy( leftFrame, rightFrame, q, t, AdaptiveRansacParameter< T >( params, T( 0.99 ), ransacProsacSampling ), "PROSAC", epsilon );
+		checkRansacStrategy( leftFrame, rightFrame, q, t, AdaptiveRansacParameter< T >( params, T( 0.99 ), ransacUniformSampling, 5 ), "LO-RANSAC", epsilon );
+		checkRansacStrategy( leftFrame, rightFrame, q, t, PreemptiveRansacParameter< T >( RansacParameter< T >( T( 0.05 ), std::size_t( 3 ), n_p3d / 2, std::size_t( 64 ) ), 10 ), "preemptive RANSAC", epsilon );
+	}
+}
+
+template< typename T, typename ParameterType >
+void checkRansacStrategyExceptions( const ParameterType& params, const char* name )
+{
+	using namespace Ubitrack::Math::Optimization;
+
+	// a std::runtime_error only discards the hypothesis
+	std::vector< T > values( 20, T( 1 ) );
+	values[ 7 ] = T( 1000 );
+	T mean( 0 );
+	std::size_t nInlier = 0;
+	BOOST_CHECK_NO_THROW( nInlier = ransac( values.begin(), values.end(), mean, FailingMean< T >(), params ) );
+	BOOST_CHECK_MESSAGE( nInlier == values.size() - 1 && std::fabs( mean - T( 1 ) ) < T( 1e-12 ), name << ": " << nInlier << " inlier, mean " << mean );
+
+	// any other exception reaches the caller
+	const std::vector< T > invalid( values.size(), T( -1 ) );
+	BOOST_CHECK_THROW( ransac( invalid.begin(), invalid.end(), mean, FailingMean< T >(), params ), std::logic_error );
+}
+
+template< typename T >
+void testRansacStrategiesExceptions()
+{
+	using namespace Ubitrack::Math::Optimization;
+	const RansacParameter< T > params( T( 0.1 ), std::size_t( 2 ), std::size_t( 19 ), std::size_t( 200 ) );
+
+	checkRansacStrategyExceptions< T >( AdaptiveRansacParameter< T >( params ), "adaptive RANSAC" );
+	checkRansacStrategyExceptions< T >( AdaptiveRansacParameter< T >( params, T( 0.99 ), ransacProsacSampling ), "PROSAC" );
+	checkRansacStrategyExceptions< T >( AdaptiveRansacParameter< T >( params, T( 0.99 ), ransacUniformSampling, 5 ), "LO-RANSAC" );
+	checkRansacStrategyExceptions< T >( PreemptiveRansacParameter< T >( RansacParameter< T >( T( 0.1 ), std::size_t( 2 ), std::size_t( 19 ), std::size_t( 64 ) ), 5 ), "preemptive RANSAC" );
+}
+
 #ifndef HAVE_LAPACK
 void TestRobustAbsoluteOrientation()
 {
 	// Absolute Orientation does not work without lapack
 }
 
+void TestParallelRobustAbsoluteOrientation()
+{
+	// Absolute Orientation does not work without lapack
+}
+
+void TestRansacStrategiesAbsoluteOrientation()
+{
+	// Absolute Orientation does not work without lapack
+}
+
 #else // HAVE_LAPACK
 
 void TestRobustAbsoluteOrientation()
@@ -112,4 +335,19 @@ void TestRobustAbsoluteOrientation()
 	testRansacAbsoluteOrientationRandom< double >( 10000, 1e-6 );
 }
 
+void TestParallelRobustAbsoluteOrientation()
+{
+	testParallelRansacAbsoluteOrientationRandom< float >( 1000, 1e-2f );
+	testParallelRansacAbsoluteOrientationRandom< double >( 1000, 1e-6 );
+
+	testParallelRansacExceptions< double >();
+}
+
+void TestRansacStrategiesAbsoluteOrientation()
+{
+	testRansacStrategiesAbsoluteOrientationRandom< float >( 1000, 1e-2f );
+	testRansacStrategiesAbsoluteOrientationRandom< double >( 1000, 1e-6 );
+	testRansacStrategiesExceptions< double >();
+}
+
 #endif // HAVE_LAPACK
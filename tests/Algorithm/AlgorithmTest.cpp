@@ -9,8 +9,11 @@ void TestAbsOrientScale();
 void TestAbsOrientRotation3D();
 void TestAbsoluteOrientation();
 void TestRobustAbsoluteOrientation();
+void TestParallelRobustAbsoluteOrientation();
+void TestRansacStrategiesAbsoluteOrientation();
 void TestOptimizedAbsoluteOrientation();
 void TestCovarianceAbsoluteOrientation();
+void TestUnscentedPoseCovariance();
 
 // old tests..
 void Test2D3DPoseEstimation();
@@ -21,6 +24,7 @@ void TestFundamentalMatrix();
 void TestHomography();
 void TestProjectionDLT();
 void TestCorrelation();
+void TestUndistortionMap();
 void TestTsaiLenzHandEye();
 void TestDualHandEye();
 void TestHandEyeDataSelection();
@@ -35,8 +39,11 @@ AlgorithmTest::AlgorithmTest()
 	add( BOOST_TEST_CASE( &TestAbsOrientRotation3D ) );
 	add( BOOST_TEST_CASE( &TestAbsoluteOrientation ) );
 	add( BOOST_TEST_CASE( &TestRobustAbsoluteOrientation ) );
+	add( BOOST_TEST_CASE( &TestParallelRobustAbsoluteOrientation ) );
+	add( BOOST_TEST_CASE( &TestRansacStrategiesAbsoluteOrientation ) );
 	add( BOOST_TEST_CASE( &TestOptimizedAbsoluteOrientation ) );
 	add( BOOST_TEST_CASE( &TestCovarianceAbsoluteOrientation ) );
+	add( BOOST_TEST_CASE( &TestUnscentedPoseCovariance ) );
 	
 	// old tests...
 	add( BOOST_TEST_CASE( &Test2D3DPoseEstimation ) );
@@ -50,6 +57,7 @@ AlgorithmTest::AlgorithmTest()
 	add( BOOST_TEST_CASE( &TestDualHandEye ) );
 	add( BOOST_TEST_CASE( &TestHandEyeDataSelection ) );
 	add( BOOST_TEST_CASE( &TestCorrelation ) );
+	add( BOOST_TEST_CASE( &TestUndistortionMap ) );
 	
 
 }
@@ -52,115 +52,129 @@ public:
 
 } // anonymous namesapce
 
+/**
+ * generates a random network of cameras observing 3D points and a noisy version of
+ * the cameras and points as starting point for the bundle adjustment
+ */
 template< typename T >
-void TestMarkerBundleAdjustment( const std::size_t n_runs, const T epsilon )
+void generateNetwork( std::vector< Vector< T, 3 > >& points_3D, std::vector< Vector< T, 3 > >& points_3D_noisy
+	, std::vector< Pose >& extrinsics_orig, std::vector< Pose >& extrinsics_noisy
+	, std::vector< std::vector< Vector< T, 2 > > >& observed_points_2D )
 {
+	//change here for a really big bundle adjustment:
+	const std::size_t n_p3d = 30;//Random::distribute_uniform( 10, 15 ); 
+	const std::size_t n_cams = Random::distribute_uniform( 3, 5 );
+	
 	Vector< T, 2 > screenResolution( 640, 480 );
 	
+	// random intrinsics matrix, never changes, assume always the same camera
+	Matrix< T, 3, 3 > cam( Matrix< T, 3, 3 >::identity() );
+	cam( 0, 0 ) = Random::distribute_uniform< T >( 500, 800 );
+	cam( 1, 1 ) = Random::distribute_uniform< T >( 500, 800 );
+	cam( 0, 2 ) = screenResolution[ 0 ] / 2;
+	cam( 1, 2 ) = screenResolution[ 1 ] / 2;
+	cam( 2, 2 ) = 1;
+		
+	// typename Random::Vector< T, 2 >::Normal randPixelNoise( 0, 0.25 ); // gaussian noise for 2d Pixels -> usually very below 1 pixel
+	typename Random::Vector< T, 3 >::Uniform randVector( -5.0, 5.0 ); // 3d points, assume meters as unit
+	typename Random::Vector< T, 3 >::Normal randPositionNoise( 0, 0.05 ); // gaussian noise for 3d points -> can be quite high
+	// typename Random::Vector< T, 3 >::Uniform randPositionNoise( -0.25, 0.25 ); // uniform noise	for 3d points
 	
-	// run bundleAdjustment test for several times
-	for( std::size_t i( 0 ); i< n_runs; ++i )
+	// random poses for the estimation
+	typename Random::Quaternion< T >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randTranslation( -10, 10 ); //translation
+	//alternatively one could use a random pose:
+	// Random::Pose< T >::Uniform( -100, 100 );
+	
+
+	// generate 3d points (ground truth) + add some noise to points
+	points_3D.clear();
+	points_3D.reserve( n_p3d );
+	std::generate_n ( std::back_inserter( points_3D ), n_p3d,  randVector );
+	
+	//generate some noise for the 3d points and add it
+	points_3D_noisy.clear();
+	points_3D_noisy.reserve( n_p3d );
+	std::generate_n ( std::back_inserter( points_3D_noisy ), n_p3d,  randPositionNoise );
+	std::transform( points_3D.begin(), points_3D.end(), points_3D_noisy.begin(), points_3D_noisy.begin(), std::plus< Vector< T, 3 > >() );
+	
+	// generate random poses and project on image plane
+	extrinsics_orig.clear();
+	extrinsics_noisy.clear();
+	observed_points_2D.clear();
+	
+	do
 	{
-		//change here for a really big bundle adjustment:
-		const std::size_t n_p3d = 30;//Random::distribute_uniform( 10, 15 ); 
-		const std::size_t n_cams = Random::distribute_uniform( 3, 5 );
-		
-		// random intrinsics matrix, never changes, assume always the same camera
-		Matrix< T, 3, 3 > cam( Matrix< T, 3, 3 >::identity() );
-		cam( 0, 0 ) = Random::distribute_uniform< T >( 500, 800 );
-		cam( 1, 1 ) = Random::distribute_uniform< T >( 500, 800 );
-		cam( 0, 2 ) = screenResolution[ 0 ] / 2;
-		cam( 1, 2 ) = screenResolution[ 1 ] / 2;
-		cam( 2, 2 ) = 1;
-			
-		// typename Random::Vector< T, 2 >::Normal randPixelNoise( 0, 0.25 ); // gaussian noise for 2d Pixels -> usually very below 1 pixel
-		typename Random::Vector< T, 3 >::Uniform randVector( -5.0, 5.0 ); // 3d points, assume meters as unit
-		typename Random::Vector< T, 3 >::Normal randPositionNoise( 0, 0.05 ); // gaussian noise for 3d points -> can be quite high
-		// typename Random::Vector< T, 3 >::Uniform randPositionNoise( -0.25, 0.25 ); // uniform noise	for 3d points
+		Quaternion rot( randQuat( ) );
+		rot.normalize() ;
 		
-		// random poses for the estimation
-		typename Random::Quaternion< T >::Uniform randQuat;
-		typename Random::Vector< T, 3 >::Uniform randTranslation( -10, 10 ); //translation
-		//alternatively one could use a random pose:
-		// Random::Pose< T >::Uniform( -100, 100 );
+		Vector< T, 3 > trans ( randTranslation() );
 		
-	
-		// generate 3d points (ground truth) + add some noise to points
-		std::vector< Vector< T, 3 > > points_3D;
-		points_3D.reserve( n_p3d );
-		std::generate_n ( std::back_inserter( points_3D ), n_p3d,  randVector );
+		Pose pose6D( rot, trans );
+		Matrix< T, 3, 4 > proj( rot, trans );
 		
-		//generate some noise for the 3d points and add it
-		std::vector< Vector< T, 3 > > points_3D_noisy;
-		points_3D_noisy.reserve( n_p3d );
-		std::generate_n ( std::back_inserter( points_3D_noisy ), n_p3d,  randPositionNoise );
-		std::transform( points_3D.begin(), points_3D.end(), points_3D_noisy.begin(), points_3D_noisy.begin(), std::plus< Vector< T, 3 > >() );
+		std::vector< Vector< T, 2 > > points_2D;
+		points_2D.reserve( n_p3d );
+		Geometry::project_points( proj, points_3D.begin(), points_3D.end(), std::back_inserter( points_2D ) );
 		
-		// generate random poses and project on image plane
-		std::vector< Pose > extrinsics_orig;
-		std::vector< Pose > extrinsics_noisy;
-		std::vector< std::vector< Vector< T, 2 > > > observed_points_2D;
+		//generate the 2D points without noise -> clear observation of ground truth data
+		std::vector< Vector< T, 2 > > noisy_points_2D;
+		noisy_points_2D.reserve( n_p3d );
+		std::copy( points_2D.begin(), points_2D.end(), std::back_inserter( noisy_points_2D ) );
+		
+		
+		// remove pixels outside the screen
+		//noisy_points_2D.erase( std::remove_if( noisy_points_2D.begin(), noisy_points_2D.end(), isPixelNotWithinScreen< T >( screenResolution ) ), noisy_points_2D.end() ); 
+		// const std::size_t n_2d( noisy_points_2D.size() );
 		
-		do
+		
+		// at the moment count visible image points
+		proj = boost::numeric::ublas::prod( cam, proj );
+		const std::size_t n_2d = std::count_if( points_3D.begin(), points_3D.end(), std::bind1st( isPointWithinScreen< T >( screenResolution ), proj ) );
+		
+		if( n_2d > ( n_p3d /2 ) ) //enough points are visible?
 		{
-			Quaternion rot( randQuat( ) );
-			rot.normalize() ;
-			
-			Vector< T, 3 > trans ( randTranslation() );
-			
-			Pose pose6D( rot, trans );
-			Matrix< T, 3, 4 > proj( rot, trans );
-			
-			std::vector< Vector< T, 2 > > points_2D;
-			points_2D.reserve( n_p3d );
-			Geometry::project_points( proj, points_3D.begin(), points_3D.end(), std::back_inserter( points_2D ) );
-			
-			//generate the 2D points without noise -> clear observation of ground truth data
-			std::vector< Vector< T, 2 > > noisy_points_2D;
-			noisy_points_2D.reserve( n_p3d );
-			std::copy( points_2D.begin(), points_2D.end(), std::back_inserter( noisy_points_2D ) );
-			
-			
-			// remove pixels outside the screen
-			//noisy_points_2D.erase( std::remove_if( noisy_points_2D.begin(), noisy_points_2D.end(), isPixelNotWithinScreen< T >( screenResolution ) ), noisy_points_2D.end() ); 
-			// const std::size_t n_2d( noisy_points_2D.size() );
-			
+			// Pose noisyPose( rot, trans  );
+			// Pose noisyPose( rot, trans + randPositionNoise() );
+			const T rotEps( 0.01 );
+			Pose noisyPose( Quaternion( rot.x() + Random::distribute_uniform< T >( -rotEps, rotEps )
+					, rot.y() + Random::distribute_uniform< T >( -rotEps, rotEps )
+					, rot.z() + Random::distribute_uniform< T >( -rotEps, rotEps )
+					, rot.w() + Random::distribute_uniform< T >( -rotEps, rotEps ) )
+					, trans + randPositionNoise() );
 			
-			// at the moment count visible image points
-			proj = boost::numeric::ublas::prod( cam, proj );
-			const std::size_t n_2d = std::count_if( points_3D.begin(), points_3D.end(), std::bind1st( isPointWithinScreen< T >( screenResolution ), proj ) );
-			
-			if( n_2d > ( n_p3d /2 ) ) //enough points are visible?
-			{
-				// Pose noisyPose( rot, trans  );
-				// Pose noisyPose( rot, trans + randPositionNoise() );
-				const T rotEps( 0.01 );
-				Pose noisyPose( Quaternion( rot.x() + Random::distribute_uniform< T >( -rotEps, rotEps )
-						, rot.y() + Random::distribute_uniform< T >( -rotEps, rotEps )
-						, rot.z() + Random::distribute_uniform< T >( -rotEps, rotEps )
-						, rot.w() + Random::distribute_uniform< T >( -rotEps, rotEps ) )
-						, trans + randPositionNoise() );
-				
-						
-				extrinsics_orig.push_back( pose6D );
-				extrinsics_noisy.push_back( noisyPose );
-				observed_points_2D.push_back( noisy_points_2D );
-			}
+					
+			extrinsics_orig.push_back( pose6D );
+			extrinsics_noisy.push_back( noisyPose );
+			observed_points_2D.push_back( noisy_points_2D );
 		}
-		while( extrinsics_noisy.size() < n_cams );
+	}
+	while( extrinsics_noisy.size() < n_cams );
+}
+
+template< typename T >
+void TestMarkerBundleAdjustment( const std::size_t n_runs, const T epsilon )
+{
+	// run bundleAdjustment test for several times
+	for( std::size_t i( 0 ); i< n_runs; ++i )
+	{
+		std::vector< Vector< T, 3 > > points_3D;
+		std::vector< Vector< T, 3 > > points_3D_noisy;
+		std::vector< Pose > extrinsics_orig;
+		std::vector< Pose > extrinsics_noisy;
+		std::vector< std::vector< Vector< T, 2 > > > observed_points_2D;
+		generateNetwork( points_3D, points_3D_noisy, extrinsics_orig, extrinsics_noisy, observed_points_2D );
 		
 		const T error3D = meanSummedDiff( points_3D_noisy, points_3D );
 		const T errorPoseT = meanSummedTranslationDiff< T >( extrinsics_noisy, extrinsics_orig );
 		const T errorPoseA = meanSummedAngularDiff< T >( extrinsics_noisy, extrinsics_orig );
 		
-		
-		// std::cout << std::endl << std::endl << std::endl << std::endl;
-		// std::copy( extrinsics_noisy.begin(), extrinsics_noisy.end(), std::ostream_iterator< Ubitrack::Math::Pose > ( std::cout, ", ") );	
-		// std::cout << std::endl << std::endl;
-		// std::copy( points_3D_noisy.begin(), points_3D_noisy.end(), std::ostream_iterator< Ubitrack::Math::Vector< T, 3 > > ( std::cout, ", ") );	
-		// std::cout << std::endl << std::endl;
+		// the block-sparse solver starts from the same parameters
+		std::vector< Vector< T, 3 > > points_3D_sparse( points_3D_noisy );
+		std::vector< Pose > extrinsics_sparse( extrinsics_noisy );
 		
 		Ubitrack::Algorithm::simpleBundleAdjustment( observed_points_2D, extrinsics_noisy, points_3D_noisy );
+		Ubitrack::Algorithm::sparseBundleAdjustment( observed_points_2D, extrinsics_sparse, points_3D_sparse );
 		// call to templated function (does not link on windows):
 		// Ubitrack::Algorithm::simpleBundleAdjustment( observed_points_2D.begin(), observed_points_2D.end(), intrinsics.begin(), extrinsics.begin(), points_3D_noisy.begin(), points_3D_noisy.end() );
 		
@@ -175,6 +189,22 @@ void TestMarkerBundleAdjustment( const std::size_t n_runs, const T epsilon )
 		BOOST_WARN_MESSAGE( errorPoseT >= optErrorPoseT, "Error (pose) position " << errorPoseT << " vs. " << optErrorPoseT << " (before vs. later)" );
 		BOOST_WARN_MESSAGE( errorPoseA >= optErrorPoseA, "Error (pose) angle    " << errorPoseA << " vs. " << optErrorPoseA << " (before vs. later)" );
 		
+		// both solvers perform the same steps
+		for ( std::size_t iCam = 0; iCam < extrinsics_noisy.size(); ++iCam )
+		{
+			const Quaternion& q1 = extrinsics_noisy[ iCam ].rotation();
+			const Quaternion& q2 = extrinsics_sparse[ iCam ].rotation();
+			BOOST_CHECK_SMALL( T( q1.x() - q2.x() ), epsilon );
+			BOOST_CHECK_SMALL( T( q1.y() - q2.y() ), epsilon );
+			BOOST_CHECK_SMALL( T( q1.z() - q2.z() ), epsilon );
+			BOOST_CHECK_SMALL( T( q1.w() - q2.w() ), epsilon );
+			for ( std::size_t j = 0; j < 3; ++j )
+				BOOST_CHECK_SMALL( T( extrinsics_noisy[ iCam ].translation()( j ) - extrinsics_sparse[ iCam ].translation()( j ) ), epsilon );
+		}
+		for ( std::size_t iPoint = 0; iPoint < points_3D_noisy.size(); ++iPoint )
+			for ( std::size_t j = 0; j < 3; ++j )
+				BOOST_CHECK_SMALL( T( points_3D_noisy[ iPoint ]( j ) - points_3D_sparse[ iPoint ]( j ) ), epsilon );
+		
 		
 		// print out 3d values
 		// std::copy( points_3D_noisy.begin(), points_3D_noisy.end(), std::ostream_iterator< Ubitrack::Math::Vector< T, 3 > > ( std::cout, ", ") );	
@@ -190,10 +220,58 @@ void TestMarkerBundleAdjustment( const std::size_t n_runs, const T epsilon )
 	}	
 };
 
+template< typename T >
+void TestSparseBundleAdjustmentDegenerate( const std::size_t n_runs )
+{
+	for( std::size_t i( 0 ); i< n_runs; ++i )
+	{
+		std::vector< Vector< T, 3 > > points_3D;
+		std::vector< Vector< T, 3 > > points_3D_noisy;
+		std::vector< Pose > extrinsics_orig;
+		std::vector< Pose > extrinsics_noisy;
+		std::vector< std::vector< Vector< T, 2 > > > observed_points_2D;
+		generateNetwork( points_3D, points_3D_noisy, extrinsics_orig, extrinsics_noisy, observed_points_2D );
+		
+		{
+			// an observation of a point that does not exist is skipped and does not shift the others
+			std::vector< std::vector< Vector< T, 2 > > > observed_points_extra( observed_points_2D );
+			observed_points_extra.front().push_back( Vector< T, 2 >( 100, 100 ) );
+			
+			std::vector< Vector< T, 3 > > points_3D_reference( points_3D_noisy );
+			std::vector< Pose > extrinsics_reference( extrinsics_noisy );
+			Ubitrack::Algorithm::sparseBundleAdjustment( observed_points_2D, extrinsics_reference, points_3D_reference );
+			
+			std::vector< Vector< T, 3 > > points_3D_extra( points_3D_noisy );
+			std::vector< Pose > extrinsics_extra( extrinsics_noisy );
+			Ubitrack::Algorithm::sparseBundleAdjustment( observed_points_extra, extrinsics_extra, points_3D_extra );
+			
+			BOOST_CHECK_SMALL( meanSummedDiff( points_3D_extra, points_3D_reference ), T( 1e-12 ) );
+			BOOST_CHECK_SMALL( meanSummedTranslationDiff< T >( extrinsics_extra, extrinsics_reference ), T( 1e-12 ) );
+		}
+		
+		// a camera without observations and no damping make the reduced camera system singular
+		const Pose unobserved( Quaternion( 0, 0, 0, 1 ), Vector< double, 3 >( 1, 2, 3 ) );
+		extrinsics_noisy.push_back( unobserved );
+		observed_points_2D.push_back( std::vector< Vector< T, 2 > >() );
+		
+		const std::vector< Vector< T, 3 > > points_3D_before( points_3D_noisy );
+		Ubitrack::Algorithm::sparseBundleAdjustment( observed_points_2D, extrinsics_noisy, points_3D_noisy, 0.0 );
+		
+		// the optimization continues after the failed cholesky decomposition
+		const T moved = meanSummedDiff( points_3D_noisy, points_3D_before );
+		BOOST_CHECK_MESSAGE( moved > 0 && moved < 1, "Mean change of the 3D points " << moved );
+		BOOST_CHECK_SMALL( meanSummedTranslationDiff< T >( std::vector< Pose >( 1, extrinsics_noisy.back() ), std::vector< Pose >( 1, unobserved ) ), T( 1e-6 ) );
+	}
+}
+
 void TestBundleAdjustment()
 {
 	// attention: works also with float now :)
-	TestMarkerBundleAdjustment< double >( 10, 1e-3 );
-	TestMarkerBundleAdjustment< float >( 10, 1e-3 );
+	// also compares the block-sparse solver to the dense one
+	TestMarkerBundleAdjustment< double >( 10, 1e-8 );
+	TestMarkerBundleAdjustment< float >( 10, 5e-2f );
+	
+	// singular reduced camera system and skipped observations
+	TestSparseBundleAdjustmentDegenerate< double >( 10 );
 }
 
@@ -0,0 +1,136 @@
+#include <utMath/Random/Scalar.h>
+#include <utAlgorithm/CameraLens/Correction.h>
+#include <utAlgorithm/CameraLens/UndistortionMap.h>
+#include <utUtil/BlockTimer.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Algorithm.CameraLensTest" ) );
+
+using namespace Ubitrack;
+
+#ifdef HAVE_LAPACK
+
+namespace {
+
+template< typename T >
+Math::CameraIntrinsics< T > testIntrinsics()
+{
+	Math::Matrix< T, 3, 3 > K( Math::Matrix< T, 3, 3 >::identity() );
+	K( 0, 0 ) = 520;
+	K( 1, 1 ) = 525;
+	K( 0, 2 ) = -322;
+	K( 1, 2 ) = -238;
+	K( 2, 2 ) = -1;
+
+	Math::Vector< T, 6 > radial( Math::Vector< T, 6 >::zeros() );
+	radial( 0 ) = static_cast< T >( -0.28 );
+	radial( 1 ) = static_cast< T >( 0.09 );
+	radial( 2 ) = static_cast< T >( -0.01 );
+	Math::Vector< T, 2 > tangential( static_cast< T >( 0.0008 ), static_cast< T >( -0.0005 ) );
+	return Math::CameraIntrinsics< T >( K, radial, tangential, 640, 480 );
+}
+
+template< typename T >
+void testUndistortionMap( const std::size_t n, const T tolerance )
+{
+	const Math::CameraIntrinsics< T > intrinsics( testIntrinsics< T >() );
+	Util::BlockTimer tMap( "UndistortionMap (build)", "Ubitrack.Algorithm.CameraLensTest" );
+	Util::BlockTimer tLookup( "UndistortionMap (lookup)", "Ubitrack.Algorithm.CameraLensTest" );
+	Util::BlockTimer tOptimization( "undistort_impl", "Ubitrack.Algorithm.CameraLensTest" );
+
+	boost::scoped_ptr< Algorithm::CameraLens::UndistortionMap< T > > pMap;
+	{
+		UBITRACK_TIME( tMap );
+		pMap.reset( new Algorithm::CameraLens::UndistortionMap< T >( intrinsics, tolerance ) );
+	}
+	BOOST_CHECK( pMap->maxError() <= tolerance );
+	BOOST_CHECK( pMap->matches( intrinsics ) );
+	BOOST_CHECK( pMap->contains( 0, 0 ) );
+	BOOST_CHECK( pMap->contains( 639, 479 ) );
+
+	std::vector< Math::Vector< T, 2 > > distorted;
+	distorted.reserve( n );
+	for( std::size_t i = 0; i < n; ++i )
+		distorted.push_back( Math::Vector< T, 2 >( Math::Random::distribute_uniform< T >( 0, 639 ), Math::Random::distribute_uniform< T >( 0, 479 ) ) );
+
+	std::vector< Math::Vector< T, 2 > > reference( n );
+	{
+		UBITRACK_TIME( tOptimization );
+		Algorithm::CameraLens::undistort_impl( intrinsics, distorted, reference );
+	}
+
+	std::vector< Math::Vector< T, 2 > > undistorted;
+	{
+		UBITRACK_TIME( tLookup );
+		pMap->undistort( distorted, undistorted );
+	}
+
+	BOOST_REQUIRE_EQUAL( undistorted.size(), n );
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		BOOST_CHECK_SMALL( undistorted[ i ]( 0 ) - reference[ i ]( 0 ), tolerance );
+		BOOST_CHECK_SMALL( undistorted[ i ]( 1 ) - reference[ i ]( 1 ), tolerance );
+	}
+
+	// points outside of the map fall back to the optimization
+	const Math::Vector< T, 2 > outside( -200, 900 );
+	Math::Vector< T, 2 > fromMap, fromOptimization;
+	BOOST_CHECK( !pMap->contains( outside( 0 ), outside( 1 ) ) );
+	pMap->undistort( outside, fromMap );
+	Algorithm::CameraLens::undistort_impl( intrinsics, outside, fromOptimization );
+	BOOST_CHECK_SMALL( fromMap( 0 ) - fromOptimization( 0 ), static_cast< T >( 1e-4 ) );
+	BOOST_CHECK_SMALL( fromMap( 1 ) - fromOptimization( 1 ), static_cast< T >( 1e-4 ) );
+
+	// the exported functions switch to the map once it is enabled
+	BOOST_CHECK( !Algorithm::CameraLens::getUndistortionMap( intrinsics ) );
+	BOOST_CHECK( Algorithm::CameraLens::enableUndistortionMap( intrinsics, tolerance ) );
+	std::vector< Math::Vector< T, 2 > > undistortedExported( n );
+	Algorithm::CameraLens::undistort( intrinsics, distorted, undistortedExported );
+	Math::Vector< T, 2 > single;
+	Algorithm::CameraLens::undistort( intrinsics, distorted[ 0 ], single );
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		BOOST_CHECK_EQUAL( undistortedExported[ i ]( 0 ), undistorted[ i ]( 0 ) );
+		BOOST_CHECK_EQUAL( undistortedExported[ i ]( 1 ), undistorted[ i ]( 1 ) );
+	}
+	BOOST_CHECK_EQUAL( single( 0 ), undistorted[ 0 ]( 0 ) );
+	BOOST_CHECK_EQUAL( single( 1 ), undistorted[ 0 ]( 1 ) );
+
+	// callers may keep the map, also beyond disabling it
+	const boost::shared_ptr< const Algorithm::CameraLens::UndistortionMap< T > > pHandle( 
+		Algorithm::CameraLens::getUndistortionMap( intrinsics ) );
+	Algorithm::CameraLens::disableUndistortionMaps();
+	BOOST_REQUIRE( pHandle );
+	BOOST_CHECK( !Algorithm::CameraLens::getUndistortionMap( intrinsics ) );
+	Math::Vector< T, 2 > fromHandle;
+	pHandle->undistort( distorted[ 0 ], fromHandle );
+	BOOST_CHECK_EQUAL( fromHandle( 0 ), undistorted[ 0 ]( 0 ) );
+	BOOST_CHECK_EQUAL( fromHandle( 1 ), undistorted[ 0 ]( 1 ) );
+
+	// a map that does not reach the tolerance is not used ( small image to keep the build short )
+	const Math::CameraIntrinsics< T > small( intrinsics.matrix, intrinsics.radial_params, intrinsics.tangential_params, 64, 48 );
+	BOOST_CHECK( !Algorithm::CameraLens::enableUndistortionMap( small, static_cast< T >( 1e-9 ) ) );
+	BOOST_CHECK( !Algorithm::CameraLens::getUndistortionMap( small ) );
+	Algorithm::CameraLens::undistort( small, distorted[ 0 ], single );
+	Algorithm::CameraLens::undistort_impl( small, distorted[ 0 ], fromOptimization );
+	BOOST_CHECK_EQUAL( single( 0 ), fromOptimization( 0 ) );
+	BOOST_CHECK_EQUAL( single( 1 ), fromOptimization( 1 ) );
+
+}
+
+} // anonymous namespace
+
+#endif // HAVE_LAPACK
+
+void TestUndistortionMap()
+{
+#ifdef HAVE_LAPACK
+	testUndistortionMap< float >( 2000, 0.05f );
+	testUndistortionMap< double >( 2000, 0.01 );
+#endif
+}
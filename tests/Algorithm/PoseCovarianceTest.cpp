@@ -0,0 +1,133 @@
+#include <utMath/Pose.h>
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Geometry/PointProjection.h>
+#include <utMath/Stochastic/UnscentedTransform.h>
+#include <utMath/Stochastic/BackwardPropagation.h>
+#include <utAlgorithm/Function/MultiplePointProjection.h>
+#include <utAlgorithm/Function/MultiplePointProjectionError.h>
+#include <utAlgorithm/Function/ProjectivePoseNormalize.h>
+
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include "../tools.h"
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& covarianceLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.PoseCovariance" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+/** relative frobenius norm of the difference */
+double relativeDifference( const Matrix< double, 6, 6 >& a, const Matrix< double, 6, 6 >& b )
+{
+	return ublas::norm_frobenius( a - b ) / ublas::norm_frobenius( b );
+}
+
+void testPoseCovariance( const std::size_t n, const std::size_t n_runs )
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Uniform randVector( -0.5, 0.5 );
+	const double variance = 0.25;
+
+	Ubitrack::Util::BlockTimer coldTimer( "cold-started sigma points", covarianceLogger );
+	Ubitrack::Util::BlockTimer warmTimer( "UnscentedPoseCovariance", covarianceLogger );
+	Ubitrack::Util::BlockTimer parallelTimer( "UnscentedPoseCovariance parallel", covarianceLogger );
+	Ubitrack::Util::BlockTimer firstOrderTimer( "first order", covarianceLogger );
+
+	Stochastic::UnscentedPoseCovariance< double > engine;
+	Stochastic::UnscentedPoseCovariance< double > parallelEngine( Stochastic::UnscentedTransformParameter( 4 ) );
+
+	for ( std::size_t iRun = 0; iRun < n_runs; iRun++ )
+	{
+		Matrix< double, 3, 3 > cam( Matrix< double, 3, 3 >::identity() );
+		cam( 0, 0 ) = cam( 1, 1 ) = Random::distribute_uniform< double >( 400, 800 );
+		cam( 0, 2 ) = 320;
+		cam( 1, 2 ) = 240;
+
+		const Quaternion rot( randQuat() );
+		Vector< double, 3 > trans( Random::distribute_uniform< double >( -0.3, 0.3 ), Random::distribute_uniform< double >( -0.3, 0.3 ), Random::distribute_uniform< double >( 2, 4 ) );
+		Matrix< double, 3, 4 > proj( rot, trans );
+		proj = ublas::prod( cam, proj );
+
+		std::vector< Vector< double, 3 > > p3D;
+		std::generate_n( std::back_inserter( p3D ), n, randVector );
+		std::vector< Vector< double, 2 > > p2D;
+		Geometry::project_points( proj, p3D.begin(), p3D.end(), std::back_inserter( p2D ) );
+
+		Algorithm::Function::MultiplePointProjection< double > problem( p3D, cam );
+		Vector< double, 7 > truePose;
+		Pose( rot, trans ).toVector( truePose );
+
+		// first order, compared to the jacobian of the pose error
+		Matrix< double, 6, 6 > firstOrder;
+		{
+			UBITRACK_TIME( firstOrderTimer );
+			firstOrder = Stochastic::UnscentedPoseCovariance< double >::firstOrder( problem, variance, truePose );
+		}
+		Matrix< double, 6, 6 > reference;
+		Stochastic::backwardPropagationIdentity( reference, variance, Algorithm::Function::MultiplePointProjectionError< double >( p3D, cam ), truePose );
+		BOOST_CHECK_SMALL( relativeDifference( firstOrder, reference ), 1e-6 );
+
+		// unscented, starting from a disturbed pose
+		Vector< double, 7 > pose( truePose );
+		ublas::subrange( pose, 0, 3 ) += randomVector< double, 3 >( 0.05 );
+		ublas::subrange( pose, 3, 7 ) += randomVector< double, 4 >( 0.05 );
+		const Vector< double, 7 > initialPose( pose );
+		Vector< double, 7 > parallelPose( pose );
+
+		Matrix< double, 6, 6 > unscented;
+		{
+			UBITRACK_TIME( warmTimer );
+			unscented = engine.unscented( problem, p2D, variance, pose, Algorithm::Function::ProjectivePoseNormalize() );
+		}
+		BOOST_CHECK_SMALL( ublas::norm_2( ublas::subrange( pose, 0, 3 ) - trans ), 1e-6 );
+		BOOST_CHECK_SMALL( relativeDifference( unscented, firstOrder ), 0.05 );
+
+		Matrix< double, 6, 6 > parallel;
+		{
+			UBITRACK_TIME( parallelTimer );
+			parallel = parallelEngine.unscented( problem, p2D, variance, parallelPose, Algorithm::Function::ProjectivePoseNormalize() );
+		}
+		BOOST_CHECK_SMALL( relativeDifference( parallel, unscented ), 1e-6 );
+
+		// the same sigma points, but every optimization starts from the initial guess
+		{
+			UBITRACK_TIME( coldTimer );
+			Vector< double > measurements( 2 * n );
+			for ( std::size_t i = 0; i < n; i++ )
+				ublas::subrange( measurements, 2 * i, 2 * i + 2 ) = p2D[ i ];
+			const double spread = std::sqrt( 2 * n * variance );
+			for ( std::size_t i = 0; i < 4 * n + 1; i++ )
+			{
+				Vector< double > sigmaSet( measurements );
+				if ( i > 0 )
+					sigmaSet( ( i - 1 ) / 2 ) += i % 2 ? spread : -spread;
+				Vector< double, 7 > coldPose( initialPose );
+				Optimization::levenbergMarquardt( problem, coldPose, sigmaSet, Optimization::OptTerminate( 200, 1e-6 ), Algorithm::Function::ProjectivePoseNormalize() );
+			}
+		}
+	}
+
+	BOOST_TEST_MESSAGE( n << " points: cold-started " << coldTimer.getTotalTime() / n_runs << "ms, warm-started "
+		<< warmTimer.getTotalTime() / n_runs << "ms, 4 threads " << parallelTimer.getTotalTime() / n_runs
+		<< "ms, first order " << firstOrderTimer.getTotalTime() / n_runs << "ms per pose" );
+}
+
+} // anonymous namespace
+
+void TestUnscentedPoseCovariance()
+{
+	testPoseCovariance( 8, 20 );
+	testPoseCovariance( 40, 5 );
+}
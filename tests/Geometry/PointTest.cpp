@@ -6,6 +6,9 @@
 
 #include <utMath/Geometry/PointProjection.h>
 #include <utMath/Geometry/PointTransformation.h>
+#include <utMath/CameraIntrinsics.h>
+#include <utAlgorithm/CameraLens/Distortion.h>
+#include <utUtil/BlockTimer.h>
 
 #include "../tools.h"
 #include <boost/test/unit_test.hpp>
@@ -191,12 +194,194 @@ void testBasicPointProjection( const std::size_t n )
 	BOOST_CHECK_SMALL( 0.01, 0.02 );
 }
 
+
+/// scalar reference of the equidistant fish-eye model for a single image point
+template< typename T >
+Vector< T, 2 > distortFisheye( const CameraIntrinsics< T >& intrinsics, const Vector< T, 2 >& imagePoint )
+{
+	Vector< T, 2 > normalized;
+	Ubitrack::Algorithm::CameraLens::internal::unproject_impl( intrinsics, imagePoint, normalized );
+
+	const T r = norm_2( normalized );
+	const T theta = std::atan( r );
+	T thetaD = theta;
+	T thetaPow = theta;
+	for( std::size_t i = 0; i < 4; ++i )
+	{
+		thetaPow *= theta * theta;
+		thetaD += intrinsics.radial_params( i ) * thetaPow;
+	}
+
+	Vector< T, 2 > distorted( normalized * ( r > 0 ? thetaD / r : T( 1 ) ) );
+	Ubitrack::Algorithm::CameraLens::internal::project_impl( intrinsics, distorted, distorted );
+	return distorted;
+}
+
+template< typename T >
+void testBatchPointProjection( const std::size_t n, const T epsilon )
+{
+	typename Random::Quaternion< T >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randPoints3D( -1, 1 );
+
+	// camera looking along negative z-axis (ubitrack convention), points in front of it
+	const Quaternion rot( randQuat() );
+	const Vector< T, 3 > trans( 0, 0, -10 );
+	const Matrix< T, 3, 4 > extrinsic( rot, trans );
+	const Matrix< T, 4, 4 > extrinsic4( rot, trans );
+
+	CameraIntrinsics< T > intrinsics;
+	intrinsics.calib_type = CameraIntrinsics< T >::OPENCV_6_2;
+	intrinsics.dimension = Vector< std::size_t, 2 >( 640, 480 );
+	intrinsics.matrix = Matrix< T, 3, 3 >::identity();
+	intrinsics.matrix( 0, 0 ) = 600;
+	intrinsics.matrix( 1, 1 ) = 610;
+	intrinsics.matrix( 0, 2 ) = -320;
+	intrinsics.matrix( 1, 2 ) = -240;
+	intrinsics.matrix( 2, 2 ) = -1;
+	intrinsics.radial_size = 6;
+	intrinsics.radial_params = Vector< T, 6 >::zeros();
+	intrinsics.radial_params( 0 ) = static_cast< T >( -0.2 );
+	intrinsics.radial_params( 1 ) = static_cast< T >( 0.05 );
+	intrinsics.radial_params( 3 ) = static_cast< T >( 0.01 );
+	intrinsics.tangential_params( 0 ) = static_cast< T >( 0.001 );
+	intrinsics.tangential_params( 1 ) = static_cast< T >( -0.002 );
+
+	Matrix< T, 3, 4 > projection;
+	boost::numeric::ublas::noalias( projection ) = boost::numeric::ublas::prod( intrinsics.matrix, extrinsic );
+
+	std::vector< Vector< T, 3 > > points;
+	points.reserve( n );
+	std::generate_n( std::back_inserter( points ), n, randPoints3D );
+
+	// structure-of-arrays and packed planar copies of the points
+	std::vector< T > planar( 3 * n );
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		planar[ i ] = points[ i ]( 0 );
+		planar[ n + i ] = points[ i ]( 1 );
+		planar[ 2 * n + i ] = points[ i ]( 2 );
+	}
+	const T* x = &planar[ 0 ];
+	const T* y = x + n;
+	const T* z = y + n;
+
+	Ubitrack::Util::BlockTimer tPoint( "ProjectPoint", "Ubitrack.Math.Geometry.PointTest" );
+	Ubitrack::Util::BlockTimer tIterator( "project_points (iterator)", "Ubitrack.Math.Geometry.PointTest" );
+	Ubitrack::Util::BlockTimer tBatch( "project_points (soa)", "Ubitrack.Math.Geometry.PointTest" );
+
+	// reference: point by point
+	std::vector< Vector< T, 2 > > reference( n );
+	{
+		UBITRACK_TIME( tPoint );
+		for( std::size_t i = 0; i < n; ++i )
+			reference[ i ] = Geometry::ProjectPoint()( projection, points[ i ] );
+	}
+
+	std::vector< Vector< T, 2 > > pointsOut;
+	pointsOut.reserve( n );
+	{
+		UBITRACK_TIME( tIterator );
+		Geometry::project_points( projection, points.begin(), points.end(), std::back_inserter( pointsOut ) );
+	}
+
+	std::vector< T > u( n ), v( n ), packedOut( 2 * n );
+	{
+		UBITRACK_TIME( tBatch );
+		Geometry::project_points( projection, n, x, y, z, &u[ 0 ], &v[ 0 ] );
+	}
+	Geometry::project_points( projection, n, &planar[ 0 ], &packedOut[ 0 ] );
+
+	BOOST_CHECK_EQUAL( pointsOut.size(), n );
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		const T scale = std::max< T >( 1, std::fabs( reference[ i ]( 0 ) ) + std::fabs( reference[ i ]( 1 ) ) );
+		BOOST_CHECK_SMALL( ( pointsOut[ i ]( 0 ) - reference[ i ]( 0 ) ) / scale, epsilon );
+		BOOST_CHECK_SMALL( ( pointsOut[ i ]( 1 ) - reference[ i ]( 1 ) ) / scale, epsilon );
+		BOOST_CHECK_SMALL( ( u[ i ] - reference[ i ]( 0 ) ) / scale, epsilon );
+		BOOST_CHECK_SMALL( ( v[ i ] - reference[ i ]( 1 ) ) / scale, epsilon );
+		BOOST_CHECK_SMALL( ( packedOut[ i ] - reference[ i ]( 0 ) ) / scale, epsilon );
+		BOOST_CHECK_SMALL( ( packedOut[ n + i ] - reference[ i ]( 1 ) ) / scale, epsilon );
+	}
+
+	// transformation of structure-of-arrays points
+	{
+		std::vector< T > xOut( n ), yOut( n ), zOut( n ), wOut( n ), transformed( 3 * n );
+		Geometry::transform_points( extrinsic, n, x, y, z, &xOut[ 0 ], &yOut[ 0 ], &zOut[ 0 ] );
+		Geometry::transform_points( extrinsic, n, &planar[ 0 ], &transformed[ 0 ] );
+		std::vector< Vector< T, 3 > > pointsTransformed;
+		pointsTransformed.reserve( n );
+		Geometry::transform_points( extrinsic, points.begin(), points.end(), std::back_inserter( pointsTransformed ) );
+		for( std::size_t i = 0; i < n; ++i )
+		{
+			const Vector< T, 3 > p = Geometry::TransformPoint()( extrinsic, points[ i ] );
+			BOOST_CHECK_SMALL( xOut[ i ] - p( 0 ), epsilon * 10 );
+			BOOST_CHECK_SMALL( yOut[ i ] - p( 1 ), epsilon * 10 );
+			BOOST_CHECK_SMALL( zOut[ i ] - p( 2 ), epsilon * 10 );
+			BOOST_CHECK_SMALL( transformed[ 2 * n + i ] - p( 2 ), epsilon * 10 );
+			BOOST_CHECK_SMALL( pointsTransformed[ i ]( 0 ) - p( 0 ), epsilon * 10 );
+		}
+		Geometry::transform_points( extrinsic4, n, x, y, z, &xOut[ 0 ], &yOut[ 0 ], &zOut[ 0 ], &wOut[ 0 ] );
+		for( std::size_t i = 0; i < n; ++i )
+			BOOST_CHECK_SMALL( wOut[ i ] - 1, epsilon );
+	}
+
+	// projection including lens distortion
+	{
+		std::vector< Vector< T, 2 > > distortedOut;
+		distortedOut.reserve( n );
+		Geometry::project_points( intrinsics, extrinsic, points.begin(), points.end(), std::back_inserter( distortedOut ) );
+		Geometry::project_points( intrinsics, extrinsic, n, x, y, z, &u[ 0 ], &v[ 0 ] );
+		for( std::size_t i = 0; i < n; ++i )
+		{
+			Vector< T, 2 > distorted;
+			Ubitrack::Algorithm::CameraLens::distort_impl( intrinsics, reference[ i ], distorted );
+			const T scale = std::max< T >( 1, std::fabs( distorted( 0 ) ) + std::fabs( distorted( 1 ) ) );
+			BOOST_CHECK_SMALL( ( distortedOut[ i ]( 0 ) - distorted( 0 ) ) / scale, epsilon * 10 );
+			BOOST_CHECK_SMALL( ( distortedOut[ i ]( 1 ) - distorted( 1 ) ) / scale, epsilon * 10 );
+			BOOST_CHECK_SMALL( ( u[ i ] - distorted( 0 ) ) / scale, epsilon * 10 );
+			BOOST_CHECK_SMALL( ( v[ i ] - distorted( 1 ) ) / scale, epsilon * 10 );
+		}
+	}
+
+	// projection including fish-eye lens distortion
+	{
+		CameraIntrinsics< T > fisheye;
+		fisheye.calib_type = CameraIntrinsics< T >::OPENCV_4_0_FISHEYE;
+		fisheye.dimension = intrinsics.dimension;
+		fisheye.matrix = intrinsics.matrix;
+		fisheye.radial_size = 4;
+		fisheye.radial_params = Vector< T, 6 >::zeros();
+		fisheye.radial_params( 0 ) = static_cast< T >( -0.01 );
+		fisheye.radial_params( 1 ) = static_cast< T >( 0.005 );
+		fisheye.radial_params( 2 ) = static_cast< T >( -0.002 );
+		fisheye.radial_params( 3 ) = static_cast< T >( 0.001 );
+		fisheye.tangential_params = Vector< T, 2 >::zeros();
+
+		std::vector< Vector< T, 2 > > distortedOut;
+		distortedOut.reserve( n );
+		Geometry::project_points( fisheye, extrinsic, points.begin(), points.end(), std::back_inserter( distortedOut ) );
+		Geometry::project_points( fisheye, extrinsic, n, x, y, z, &u[ 0 ], &v[ 0 ] );
+		BOOST_CHECK_EQUAL( distortedOut.size(), n );
+		for( std::size_t i = 0; i < n; ++i )
+		{
+			const Vector< T, 2 > distorted = distortFisheye( fisheye, reference[ i ] );
+			const T scale = std::max< T >( 1, std::fabs( distorted( 0 ) ) + std::fabs( distorted( 1 ) ) );
+			BOOST_CHECK_SMALL( ( distortedOut[ i ]( 0 ) - distorted( 0 ) ) / scale, epsilon * 10 );
+			BOOST_CHECK_SMALL( ( distortedOut[ i ]( 1 ) - distorted( 1 ) ) / scale, epsilon * 10 );
+			BOOST_CHECK_SMALL( ( u[ i ] - distorted( 0 ) ) / scale, epsilon * 10 );
+			BOOST_CHECK_SMALL( ( v[ i ] - distorted( 1 ) ) / scale, epsilon * 10 );
+		}
+	}
+}
+
 void TestPoints()
 {
 	testBasicPointTransformations< float >( 10000 );
 	testBasicPointTransformations< double >( 10000 );
 	testBasicPointProjection< float >( 10000 );
 	testBasicPointProjection< double >( 10000 );
+	testBatchPointProjection< float >( 10000, 1e-5f );
+	testBatchPointProjection< double >( 10000, 1e-10 );
 }
 
 
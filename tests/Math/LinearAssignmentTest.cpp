@@ -0,0 +1,204 @@
+#include <utMath/Matrix.h>
+#include <utMath/Graph/Munkres.h>
+#include <utMath/Graph/LinearAssignment.h>
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "../tools.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& assignmentLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Math.LinearAssignment" ) );
+
+using namespace Ubitrack::Math;
+
+namespace {
+
+/** exhaustive search for the best matching with maximal cardinality ( or minimal cost including the gate ) */
+void bruteForce( const Matrix< double, 0, 0 >& m, std::size_t row, std::vector< bool >& used,
+	double cost, std::size_t count, const double gate, double& bestCost, std::size_t& bestCount )
+{
+	if ( row == m.size1() )
+	{
+		const bool better = gate > 0 ? cost < bestCost : ( count > bestCount || ( count == bestCount && cost < bestCost ) );
+		if ( better )
+		{
+			bestCost = cost;
+			bestCount = count;
+		}
+		return;
+	}
+
+	// leave the row unmatched
+	bruteForce( m, row + 1, used, cost + ( gate > 0 ? gate : 0 ), count, gate, bestCost, bestCount );
+
+	for ( std::size_t j = 0; j < m.size2(); j++ )
+		if ( !used[ j ] && ( gate <= 0 || m( row, j ) <= gate ) && m( row, j ) != std::numeric_limits< double >::infinity() )
+		{
+			used[ j ] = true;
+			bruteForce( m, row + 1, used, cost + m( row, j ), count + 1, gate, bestCost, bestCount );
+			used[ j ] = false;
+		}
+}
+
+/** checks that the match lists are consistent and the cost is optimal */
+void checkSolution( const Graph::LinearAssignment< double >& solver, const Matrix< double, 0, 0 >& m, const double gate )
+{
+	const std::vector< std::size_t > rowMatches( solver.getRowMatchList() );
+	const std::vector< std::size_t > colMatches( solver.getColMatchList() );
+	BOOST_CHECK_EQUAL( rowMatches.size(), m.size1() );
+	BOOST_CHECK_EQUAL( colMatches.size(), m.size2() );
+
+	double cost = 0;
+	double unmatched = 0;
+	for ( std::size_t i = 0; i < m.size1(); i++ )
+		if ( rowMatches[ i ] < m.size2() )
+		{
+			BOOST_CHECK_EQUAL( colMatches[ rowMatches[ i ] ], i );
+			cost += m( i, rowMatches[ i ] );
+		}
+		else
+			unmatched += gate > 0 ? gate : 0;
+
+	std::vector< bool > used( m.size2(), false );
+	double bestCost = std::numeric_limits< double >::max();
+	std::size_t bestCount = 0;
+	bruteForce( m, 0, used, 0, 0, gate, bestCost, bestCount );
+
+	BOOST_CHECK_CLOSE( cost + 1.0, solver.getCost() + 1.0, 1e-8 );
+	BOOST_CHECK_CLOSE( cost + unmatched + 1.0, bestCost + 1.0, 1e-8 );
+}
+
+Matrix< double, 0, 0 > randomCosts( const std::size_t rows, const std::size_t cols )
+{
+	Matrix< double, 0, 0 > m( rows, cols );
+	for ( std::size_t i = 0; i < rows; i++ )
+		for ( std::size_t j = 0; j < cols; j++ )
+			m( i, j ) = random( 0.0, 10.0 );
+	return m;
+}
+
+void testOptimality()
+{
+	for ( std::size_t iter = 0; iter < 200; iter++ )
+	{
+		const std::size_t rows = 1 + rand() % 6;
+		const std::size_t cols = 1 + rand() % 6;
+		Matrix< double, 0, 0 > m( randomCosts( rows, cols ) );
+
+		// some integer costs to provoke ties
+		if ( iter % 3 == 0 )
+			for ( std::size_t i = 0; i < rows; i++ )
+				for ( std::size_t j = 0; j < cols; j++ )
+					m( i, j ) = double( rand() % 3 );
+
+		Graph::LinearAssignment< double > solver( m );
+		solver.solve();
+		checkSolution( solver, m, 0 );
+
+		// gated
+		Graph::LinearAssignment< double > gated;
+		gated.setGate( 3.0 );
+		gated.setMatrix( m );
+		gated.solve();
+		checkSolution( gated, m, 3.0 );
+
+		// forbidden pairs
+		m( rand() % rows, rand() % cols ) = std::numeric_limits< double >::infinity();
+		Graph::LinearAssignment< double > sparse( m );
+		sparse.solve();
+		checkSolution( sparse, m, 0 );
+
+		// warm start from the duals of a slightly different problem
+		Matrix< double, 0, 0 > m2( randomCosts( rows, cols ) );
+		m2 = m2 * 0.1 + m;
+		Graph::LinearAssignment< double > warm( m2 );
+		warm.solve( std::vector< double >(), sparse.getColDuals() );
+		checkSolution( warm, m2, 0 );
+		warm.solve( sparse.getRowDuals(), std::vector< double >() );
+		checkSolution( warm, m2, 0 );
+	}
+}
+
+/** simulates the association of moving blobs between consecutive frames */
+void testFrameToFrame( const std::size_t n, const std::size_t frames )
+{
+	std::vector< Vector< double, 2 > > points( n );
+	for ( std::size_t i = 0; i < n; i++ )
+		points[ i ] = randomVector< double, 2 >( 100.0 );
+
+	Ubitrack::Util::BlockTimer munkresTimer( "Munkres", assignmentLogger );
+	Ubitrack::Util::BlockTimer coldTimer( "LinearAssignment", assignmentLogger );
+	Ubitrack::Util::BlockTimer warmTimer( "LinearAssignment warm", assignmentLogger );
+
+	std::vector< double > rowDuals;
+	for ( std::size_t f = 0; f < frames; f++ )
+	{
+		// move the points and shuffle the detections
+		std::vector< Vector< double, 2 > > detections( points );
+		for ( std::size_t i = 0; i < n; i++ )
+			detections[ i ] += randomVector< double, 2 >( 3.0 );
+		std::vector< std::size_t > permutation( n );
+		for ( std::size_t i = 0; i < n; i++ )
+			permutation[ i ] = i;
+		std::random_shuffle( permutation.begin(), permutation.end() );
+
+		Matrix< double, 0, 0 > m( n, n );
+		for ( std::size_t i = 0; i < n; i++ )
+			for ( std::size_t j = 0; j < n; j++ )
+			{
+				const Vector< double, 2 > d( points[ i ] - detections[ permutation[ j ] ] );
+				m( i, j ) = d( 0 ) * d( 0 ) + d( 1 ) * d( 1 );
+			}
+
+		std::vector< std::size_t > munkresMatches;
+		{
+			UBITRACK_TIME( munkresTimer );
+			Graph::Munkres< double > munkres( m );
+			munkres.solve();
+			munkresMatches = munkres.getRowMatchList();
+		}
+
+		Graph::LinearAssignment< double > cold( m );
+		{
+			UBITRACK_TIME( coldTimer );
+			cold.solve();
+		}
+
+		Graph::LinearAssignment< double > warm( m );
+		{
+			UBITRACK_TIME( warmTimer );
+			warm.solve( rowDuals, std::vector< double >() );
+		}
+		rowDuals = warm.getRowDuals();
+
+		// at least as good as the true association
+		double trueCost = 0;
+		for ( std::size_t j = 0; j < n; j++ )
+			trueCost += m( permutation[ j ], j );
+		BOOST_CHECK( warm.getCost() <= trueCost + 1e-9 );
+
+		const std::vector< std::size_t > matches( warm.getRowMatchList() );
+		BOOST_CHECK( cold.getRowMatchList() == matches );
+		BOOST_CHECK( munkresMatches == matches );
+
+		for ( std::size_t i = 0; i < n; i++ )
+			points[ i ] = detections[ i ];
+	}
+
+	BOOST_TEST_MESSAGE( n << " points: Munkres " << munkresTimer.getTotalTime() / frames << "ms, LinearAssignment "
+		<< coldTimer.getTotalTime() / frames << "ms, warm-started " << warmTimer.getTotalTime() / frames << "ms per frame" );
+}
+
+} // anonymous namespace
+
+void TestLinearAssignment()
+{
+	testOptimality();
+	testFrameToFrame( 100, 10 );
+	testFrameToFrame( 300, 5 );
+}
@@ -6,6 +6,8 @@ void TestBlas2();
 void TestBlas3();
 void TestVectorFunctions();
 void TestLapack();
+void TestSmallMatrixKernels();
+void TestLinearAssignment();
 
 
 MathTest::MathTest()
@@ -16,4 +18,6 @@ MathTest::MathTest()
 	add( BOOST_TEST_CASE( &TestBlas3 ) );
 	add( BOOST_TEST_CASE( &TestVectorFunctions ) );
 	add( BOOST_TEST_CASE( &TestLapack ) );
+	add( BOOST_TEST_CASE( &TestSmallMatrixKernels ) );
+	add( BOOST_TEST_CASE( &TestLinearAssignment ) );
 }
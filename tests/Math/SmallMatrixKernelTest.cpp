@@ -0,0 +1,184 @@
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Blas2.h>
+#include <utMath/Blas3.h>
+#include <utMath/Geometry/PointTransformation.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Matrix.h>
+
+#include <typeinfo>
+#include <algorithm> //std::generate_n
+
+#include "../tools.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& kernelLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Math.SmallMatrixKernel" ) );
+
+using namespace Ubitrack::Math;
+namespace ublas = boost::numeric::ublas;
+
+/**
+ * compares the small matrix kernel product of M-by-N and N-by-K matrices with the generic ublas product
+ * and reports the time of both.
+ */
+template< typename T, std::size_t M, std::size_t N, std::size_t K >
+void testMatrixMatrixKernel( const std::size_t n, const T epsilon )
+{
+	typedef typename Matrix< T, M, N >::base_type base_type1;
+	typedef typename Matrix< T, N, K >::base_type base_type2;
+
+	typename Random::Matrix< T, M, N >::Uniform randMatrix1( -1, 1 );
+	typename Random::Matrix< T, N, K >::Uniform randMatrix2( -1, 1 );
+
+	std::vector< Matrix< T, M, N > > matrices1;
+	matrices1.reserve( n );
+	std::generate_n ( std::back_inserter( matrices1 ), n,  randMatrix1 );
+
+	std::vector< Matrix< T, N, K > > matrices2;
+	matrices2.reserve( n );
+	std::generate_n ( std::back_inserter( matrices2 ), n,  randMatrix2 );
+
+	std::vector< Matrix< T, M, K > > resultsKernel( n );
+	std::vector< Matrix< T, M, K > > resultsGeneric( n );
+
+	std::stringstream sstream;
+	sstream << "[" << M << "x" << N << "]x[" << N << "x" << K << "] " << typeid( T ).name();
+	Ubitrack::Util::BlockTimer kernelTimer( "kernel  " + sstream.str(), kernelLogger );
+	Ubitrack::Util::BlockTimer genericTimer( "generic " + sstream.str(), kernelLogger );
+
+	{
+		UBITRACK_TIME( kernelTimer );
+		for( std::size_t i = 0; i < n; ++i )
+			resultsKernel[ i ] = ublas::prod( matrices1[ i ], matrices2[ i ] );
+	}
+
+	{
+		UBITRACK_TIME( genericTimer );
+		for( std::size_t i = 0; i < n; ++i )
+			ublas::noalias( resultsGeneric[ i ] ) = ublas::prod( static_cast< const base_type1& >( matrices1[ i ] ), static_cast< const base_type2& >( matrices2[ i ] ) );
+	}
+
+	for( std::size_t i = 0; i < n; ++i )
+		BOOST_CHECK_SMALL( matrixDiff( resultsKernel[ i ], resultsGeneric[ i ] ), epsilon );
+
+	// the Blas3 functor has to give the same results
+	Matrix< T, M, K > result;
+	product( matrices1[ 0 ], matrices2[ 0 ], result );
+	BOOST_CHECK_SMALL( matrixDiff( result, resultsGeneric[ 0 ] ), epsilon );
+
+	BOOST_TEST_MESSAGE( sstream.str() << ": kernel " << kernelTimer.getTotalTime() << "ms, generic ublas " << genericTimer.getTotalTime() << "ms" );
+}
+
+/**
+ * compares the small matrix kernel products of a M-by-N matrix with vectors with the generic ublas products
+ * and reports the time of both.
+ */
+template< typename T, std::size_t M, std::size_t N >
+void testMatrixVectorKernel( const std::size_t n, const T epsilon )
+{
+	typedef typename Matrix< T, M, N >::base_type matrix_base_type;
+	typedef typename Vector< T, N >::base_type vector_base_type;
+
+	typename Random::Matrix< T, M, N >::Uniform randMatrix( -1, 1 );
+	typename Random::Vector< T, N >::Uniform randVector( -1, 1 );
+
+	std::vector< Matrix< T, M, N > > matrices;
+	matrices.reserve( n );
+	std::generate_n ( std::back_inserter( matrices ), n,  randMatrix );
+
+	std::vector< Vector< T, N > > vectors;
+	vectors.reserve( n );
+	std::generate_n ( std::back_inserter( vectors ), n,  randVector );
+
+	std::vector< Vector< T, M > > resultsKernel( n );
+	std::vector< Vector< T, M > > resultsGeneric( n );
+
+	std::stringstream sstream;
+	sstream << "[" << M << "x" << N << "]x[" << N << "] " << typeid( T ).name();
+	Ubitrack::Util::BlockTimer kernelTimer( "kernel  " + sstream.str(), kernelLogger );
+	Ubitrack::Util::BlockTimer genericTimer( "generic " + sstream.str(), kernelLogger );
+
+	{
+		UBITRACK_TIME( kernelTimer );
+		for( std::size_t i = 0; i < n; ++i )
+			resultsKernel[ i ] = ublas::prod( matrices[ i ], vectors[ i ] );
+	}
+
+	{
+		UBITRACK_TIME( genericTimer );
+		for( std::size_t i = 0; i < n; ++i )
+			ublas::noalias( resultsGeneric[ i ] ) = ublas::prod( static_cast< const matrix_base_type& >( matrices[ i ] ), static_cast< const vector_base_type& >( vectors[ i ] ) );
+	}
+
+	for( std::size_t i = 0; i < n; ++i )
+		BOOST_CHECK_SMALL( vectorDiff( resultsKernel[ i ], resultsGeneric[ i ] ), epsilon );
+
+	// the Blas2 functor has to give the same results
+	Vector< T, M > result;
+	product( matrices[ 0 ], vectors[ 0 ], result );
+	BOOST_CHECK_SMALL( vectorDiff( result, resultsGeneric[ 0 ] ), epsilon );
+
+	// transposed product with a row vector
+	const Vector< T, M > rowVector( resultsGeneric[ 0 ] );
+	const Vector< T, N > transKernel = ublas::prod( rowVector, matrices[ 0 ] );
+	const Vector< T, N > transGeneric = ublas::prod( static_cast< const typename Vector< T, M >::base_type& >( rowVector ), static_cast< const matrix_base_type& >( matrices[ 0 ] ) );
+	BOOST_CHECK_SMALL( vectorDiff( transKernel, transGeneric ), epsilon );
+
+	BOOST_TEST_MESSAGE( sstream.str() << ": kernel " << kernelTimer.getTotalTime() << "ms, generic ublas " << genericTimer.getTotalTime() << "ms" );
+}
+
+/**
+ * compares \c TransformPoint with a homogeneous 4-by-4 matrix, including a non-trivial last row,
+ * with the generic ublas product of the homogeneous point.
+ */
+template< typename T >
+void testTransformPoint4x4( const std::size_t n, const T epsilon )
+{
+	typedef typename Matrix< T, 4, 4 >::base_type matrix_base_type;
+	typedef typename Vector< T, 4 >::base_type vector_base_type;
+
+	typename Random::Matrix< T, 4, 4 >::Uniform randMatrix( -1, 1 );
+	typename Random::Vector< T, 4 >::Uniform randVector( -1, 1 );
+
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		const Matrix< T, 4, 4 > mat( randMatrix() );
+		const Vector< T, 4 > vec4( randVector() );
+		const Vector< T, 3 > vec3( vec4( 0 ), vec4( 1 ), vec4( 2 ) );
+		const Vector< T, 2 > vec2( vec4( 0 ), vec4( 1 ) );
+
+		const Vector< T, 4 > generic4 = ublas::prod( static_cast< const matrix_base_type& >( mat ), static_cast< const vector_base_type& >( vec4 ) );
+		const Vector< T, 4 > generic3 = ublas::prod( static_cast< const matrix_base_type& >( mat ), static_cast< const vector_base_type& >( Vector< T, 4 >( vec4( 0 ), vec4( 1 ), vec4( 2 ), 1 ) ) );
+		const Vector< T, 4 > generic2 = ublas::prod( static_cast< const matrix_base_type& >( mat ), static_cast< const vector_base_type& >( Vector< T, 4 >( vec4( 0 ), vec4( 1 ), 0, 1 ) ) );
+
+		BOOST_CHECK_SMALL( vectorDiff( Geometry::TransformPoint()( mat, vec4 ), generic4 ), epsilon );
+		BOOST_CHECK_SMALL( vectorDiff( Geometry::TransformPoint()( mat, vec3 ), generic3 ), epsilon );
+		BOOST_CHECK_SMALL( vectorDiff( Geometry::TransformPoint()( mat, vec2 ), generic2 ), epsilon );
+	}
+}
+
+void TestSmallMatrixKernels()
+{
+	testMatrixMatrixKernel< double, 3, 3, 3 >( 100000, 1e-12 );
+	testMatrixMatrixKernel< double, 4, 4, 4 >( 100000, 1e-12 );
+	testMatrixMatrixKernel< double, 3, 4, 4 >( 100000, 1e-12 );
+	testMatrixMatrixKernel< double, 6, 6, 6 >( 100000, 1e-12 );
+	testMatrixMatrixKernel< double, 8, 8, 8 >( 100000, 1e-12 );
+	testMatrixMatrixKernel< float, 3, 3, 3 >( 100000, 1e-5f );
+	testMatrixMatrixKernel< float, 4, 4, 4 >( 100000, 1e-5f );
+	testMatrixMatrixKernel< float, 2, 5, 7 >( 100000, 1e-5f );
+
+	testMatrixVectorKernel< double, 3, 3 >( 100000, 1e-12 );
+	testMatrixVectorKernel< double, 3, 4 >( 100000, 1e-12 );
+	testMatrixVectorKernel< double, 4, 4 >( 100000, 1e-12 );
+	testMatrixVectorKernel< double, 6, 6 >( 100000, 1e-12 );
+	testMatrixVectorKernel< float, 3, 3 >( 100000, 1e-5f );
+	testMatrixVectorKernel< float, 4, 4 >( 100000, 1e-5f );
+	testMatrixVectorKernel< float, 7, 5 >( 100000, 1e-5f );
+
+	testTransformPoint4x4< double >( 1000, 1e-12 );
+	testTransformPoint4x4< float >( 1000, 1e-5f );
+}
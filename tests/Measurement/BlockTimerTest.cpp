@@ -0,0 +1,119 @@
+#include <utUtil/BlockTimer.h>
+#include <utUtil/OS.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace Ubitrack;
+
+namespace {
+
+void testBuckets()
+{
+	for ( std::size_t b = 0; b < 250; b++ )
+	{
+		BOOST_CHECK( Util::BlockTimer::bucketBegin( b ) < Util::BlockTimer::bucketBegin( b + 1 ) );
+		BOOST_CHECK_EQUAL( Util::BlockTimer::bucket( Util::BlockTimer::bucketBegin( b ) ), b );
+		BOOST_CHECK_EQUAL( Util::BlockTimer::bucket( Util::BlockTimer::bucketBegin( b + 1 ) - 1 ), b );
+	}
+	BOOST_CHECK( Util::BlockTimer::bucket( ~0ULL ) < Util::BlockTimer::nBuckets );
+}
+
+void testPercentiles()
+{
+	// run times of 1..1000us, one of them an outlier of 50ms
+	const double ticksPerUs = Util::getHighPerformanceFrequency() * 1e-6;
+	Util::BlockTimer timer( "percentiles" );
+	for ( std::size_t i = 1; i <= 1000; i++ )
+		timer.addMeasurement( static_cast< unsigned long long >( ( i == 500 ? 50000 : i ) * ticksPerUs ) );
+
+	const Util::BlockTimer::Snapshot s( timer.snapshot() );
+	BOOST_CHECK_EQUAL( s.runs, 1000u );
+	BOOST_CHECK_CLOSE( s.minTime, 0.001, 1.0 );
+	BOOST_CHECK_CLOSE( s.maxTime, 50.0, 1.0 );
+	BOOST_CHECK_CLOSE( s.getPercentile( 0.5 ), 0.5, 12.5 );
+	BOOST_CHECK_CLOSE( s.getPercentile( 0.99 ), 0.99, 12.5 );
+	BOOST_CHECK_CLOSE( s.getPercentile( 0.999 ), 1.0, 12.5 );
+	BOOST_CHECK_CLOSE( s.getPercentile( 1.0 ), 50.0, 12.5 );
+	BOOST_CHECK_CLOSE( s.getAvgTime(), timer.getAvgTime(), 1e-9 );
+
+	// reset
+	const Util::BlockTimer::Snapshot s2( timer.snapshot( true ) );
+	BOOST_CHECK_EQUAL( s2.runs, s.runs );
+	BOOST_CHECK_EQUAL( timer.getRuns(), 0u );
+	BOOST_CHECK_EQUAL( timer.snapshot().maxTime, 0.0 );
+}
+
+void timeRuns( Util::BlockTimer& timer, const std::size_t n )
+{
+	for ( std::size_t i = 0; i < n; i++ )
+		timer.addMeasurement( 1 + i % 1000 );
+}
+
+void testConcurrency()
+{
+	const std::size_t nThreads = 4;
+	const std::size_t n = 100000;
+	Util::BlockTimer timer( "shared" );
+	boost::thread_group threads;
+	for ( std::size_t t = 0; t < nThreads; t++ )
+		threads.create_thread( boost::bind( &timeRuns, boost::ref( timer ), n ) );
+
+	// concurrent snapshots and resets lose nothing
+	std::size_t runs = 0;
+	for ( std::size_t i = 0; i < 10; i++ )
+		runs += timer.snapshot( true ).runs;
+	threads.join_all();
+	const Util::BlockTimer::Snapshot s( timer.snapshot() );
+	BOOST_CHECK_EQUAL( runs + s.runs, nThreads * n );
+	unsigned long long histogramRuns = 0;
+	for ( std::size_t b = 0; b < s.histogram.size(); b++ )
+		histogramRuns += s.histogram[ b ];
+	BOOST_CHECK_EQUAL( histogramRuns, s.runs );
+}
+
+void testOverhead()
+{
+	const std::size_t n = 1000000;
+	Util::BlockTimer outer( "outer" );
+	Util::BlockTimer inner( "inner" );
+	{
+		UBITRACK_TIME( outer );
+		for ( std::size_t i = 0; i < n; i++ )
+		{
+			UBITRACK_TIME( inner );
+		}
+	}
+	BOOST_CHECK_EQUAL( inner.getRuns(), n );
+	BOOST_CHECK( inner.initialized() );
+	BOOST_TEST_MESSAGE( "UBITRACK_TIME overhead: " << outer.getTotalTime() * 1e6 / n << "ns per block" );
+}
+
+void testPeriodicReport()
+{
+	Util::BlockTimer timer( "report", "Ubitrack.Util.BlockTimerTest" );
+	timer.addMeasurement( 1000 );
+	timer.addMeasurement( 2000 );
+	timer.setReportInterval( 0.01 );
+
+	// the report thread resets the timer without further runs being added
+	for ( std::size_t i = 0; i < 200 && timer.getRuns(); i++ )
+		boost::this_thread::sleep( boost::posix_time::milliseconds( 5 ) );
+	BOOST_CHECK_EQUAL( timer.getRuns(), 0u );
+	timer.setReportInterval( 0 );
+}
+
+} // anonymous namespace
+
+void TestBlockTimer()
+{
+	testBuckets();
+	testPercentiles();
+	testConcurrency();
+	testOverhead();
+	testPeriodicReport();
+}
@@ -0,0 +1,208 @@
+#include <utMeasurement/ClockSync.h>
+#include <utMeasurement/TimestampSync.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "../tools.h"
+
+using namespace Ubitrack;
+using namespace Ubitrack::Measurement;
+
+namespace {
+
+const Timestamp startLocal = 1000000000000000000ULL;
+
+/** a simulated sensor clock with microsecond ticks */
+struct SimulatedClock
+{
+	SimulatedClock( double drift, double driftChange = 0.0 )
+		: drift( drift )
+		, driftChange( driftChange )
+		, offset( 12345.0 )
+	{}
+
+	/** native time at a true local time in seconds since the start */
+	double native( double t ) const
+	{ return offset + 1e6 * ( t + drift * t + 0.5 * driftChange * t * t ); }
+
+	double drift;
+	double driftChange;
+	double offset;
+};
+
+/** local time at which a measurement taken at \c t is received: up to 100us latency, sometimes 20ms */
+Timestamp received( double t )
+{
+	double latency = random( 0.0, 100e-6 );
+	if ( rand() % 50 == 0 )
+		latency += 0.02;
+	return startLocal + static_cast< Timestamp >( t * 1e9 + latency * 1e9 );
+}
+
+double errorAt( const ClockTracker& tracker, const SimulatedClock& clock, double t )
+{
+	const Timestamp expected = startLocal + static_cast< Timestamp >( t * 1e9 );
+	return static_cast< long long >( tracker.convertNativeToLocal( clock.native( t ) ) - expected ) * 1e-9;
+}
+
+void testDrift()
+{
+	ClockSyncConfig config;
+	config.nativeFrequency = 1e6;
+	ClockTracker tracker( config );
+	TimestampSync kalman( 1e6 );
+	const SimulatedClock clock( 50e-6 );
+
+	double kalmanError = 0;
+	for ( std::size_t i = 0; i < 3000; i++ )
+	{
+		const double t = i * 0.01;
+		const Timestamp local = received( t );
+		tracker.addSample( clock.native( t ), local );
+		const Timestamp k = kalman.convertNativeToLocal( clock.native( t ), local );
+		if ( i >= 2000 )
+			kalmanError = std::max( kalmanError, std::fabs( static_cast< long long >( k - startLocal - static_cast< Timestamp >( t * 1e9 ) ) * 1e-9 ) );
+	}
+
+	BOOST_CHECK( tracker.isSynchronized() );
+	const ClockSyncStatus status( tracker.status() );
+	BOOST_CHECK_EQUAL( status.samples, 3000u );
+	BOOST_CHECK( status.outliers > 20 );
+	BOOST_CHECK_EQUAL( status.jumps, 0u );
+	BOOST_CHECK( status.deviation < 100e-6 );
+	// the native clock runs fast, so local time advances slower per nominal native second
+	BOOST_CHECK( std::fabs( status.drift + 50.0 ) < 2.0 );
+
+	double error = 0;
+	for ( double t = 20.0; t < 30.5; t += 0.1 )
+		error = std::max( error, std::fabs( errorAt( tracker, clock, t ) ) );
+	BOOST_CHECK( error < 100e-6 );
+	BOOST_TEST_MESSAGE( "ClockTracker: max error " << error * 1e6 << "us, TimestampSync: " << kalmanError * 1e6 << "us" );
+}
+
+void testDriftChange()
+{
+	// the drift changes by 1ppm per second
+	const SimulatedClock clock( 0.0, 1e-6 );
+	double error[ 2 ];
+	for ( unsigned degree = 1; degree <= 2; degree++ )
+	{
+		ClockSyncConfig config;
+		config.nativeFrequency = 1e6;
+		config.degree = degree;
+		config.windowSize = 3000;
+		ClockTracker tracker( config );
+		for ( std::size_t i = 0; i < 6000; i++ )
+			tracker.addSample( clock.native( i * 0.1 ), received( i * 0.1 ) );
+		error[ degree - 1 ] = std::fabs( errorAt( tracker, clock, 600.0 ) );
+	}
+	BOOST_TEST_MESSAGE( "drift change: linear " << error[ 0 ] * 1e6 << "us, quadratic " << error[ 1 ] * 1e6 << "us" );
+	BOOST_CHECK( error[ 1 ] < 100e-6 );
+	BOOST_CHECK( error[ 1 ] < error[ 0 ] );
+}
+
+void testJumps()
+{
+	ClockSyncConfig config;
+	config.nativeFrequency = 1e6;
+	ClockTracker tracker( config );
+	SimulatedClock clock( 20e-6 );
+	for ( std::size_t i = 0; i < 1000; i++ )
+		tracker.addSample( clock.native( i * 0.01 ), received( i * 0.01 ) );
+
+	// the native clock jumps ahead by one second
+	clock.offset += 1e6;
+	for ( std::size_t i = 1000; i < 1200; i++ )
+		tracker.addSample( clock.native( i * 0.01 ), received( i * 0.01 ) );
+	BOOST_CHECK_EQUAL( tracker.status().jumps, 1u );
+	BOOST_CHECK( std::fabs( errorAt( tracker, clock, 12.0 ) ) < 200e-6 );
+
+	// and is reset
+	clock.offset = -1e6 * 12.5;
+	for ( std::size_t i = 1200; i < 1400; i++ )
+		tracker.addSample( clock.native( i * 0.01 ), received( i * 0.01 ) );
+	BOOST_CHECK_EQUAL( tracker.status().jumps, 2u );
+	BOOST_CHECK( std::fabs( errorAt( tracker, clock, 14.0 ) ) < 200e-6 );
+}
+
+void testReset()
+{
+	ClockSyncConfig config;
+	config.nativeFrequency = 1e6;
+	config.degree = 0;
+	ClockTracker tracker( config );
+	BOOST_CHECK_EQUAL( tracker.config().degree, 1u );
+
+	// before the first sample native ticks are converted to local seconds
+	BOOST_CHECK_EQUAL( tracker.convertNativeToLocal( 2.5e6 ), Timestamp( 2500000000ULL ) );
+
+	const SimulatedClock clock( 50e-6 );
+	for ( int i = 0; i < 100; i++ )
+		tracker.addSample( clock.native( i * 0.01 ), received( i * 0.01 ) );
+	BOOST_CHECK( tracker.isSynchronized() );
+	BOOST_CHECK( tracker.convertNativeToLocal( 2.5e6 ) != Timestamp( 2500000000ULL ) );
+
+	// the reset model is published at once
+	tracker.reset();
+	BOOST_CHECK( !tracker.isSynchronized() );
+	BOOST_CHECK_EQUAL( tracker.convertNativeToLocal( 2.5e6 ), Timestamp( 2500000000ULL ) );
+
+	config.degree = 5;
+	BOOST_CHECK_EQUAL( ClockTracker( config ).config().degree, 2u );
+}
+
+void convertConcurrently( const ClockTracker* pTracker, const SimulatedClock* pClock, bool* pOk )
+{
+	for ( std::size_t i = 0; i < 20000; i++ )
+	{
+		const double t = 5.0 + ( i % 100 ) * 0.01;
+		const Timestamp expected = startLocal + static_cast< Timestamp >( t * 1e9 );
+		const long long diff = static_cast< long long >( pTracker->convertNativeToLocal( pClock->native( t ) ) - expected );
+		*pOk = *pOk && diff > -1000000 && diff < 1000000;
+	}
+}
+
+void testConcurrency()
+{
+	ClockSyncConfig config;
+	config.nativeFrequency = 1e6;
+	ClockTracker& tracker( *ClockSyncService::instance().clock( "ClockSyncTest.bus", config ) );
+	BOOST_CHECK_EQUAL( ClockSyncService::instance().clock( "ClockSyncTest.bus" ).get(), &tracker );
+	BOOST_CHECK( ClockSyncService::instance().hasClock( "ClockSyncTest.bus" ) );
+
+	const SimulatedClock clock( 10e-6 );
+	for ( std::size_t i = 0; i < 500; i++ )
+		tracker.addSample( clock.native( i * 0.01 ), received( i * 0.01 ) );
+
+	// readers convert while samples are added
+	const std::size_t nThreads = 4;
+	bool ok[ nThreads ] = { true, true, true, true };
+	boost::thread_group threads;
+	for ( std::size_t i = 0; i < nThreads; i++ )
+		threads.create_thread( boost::bind( &convertConcurrently, &tracker, &clock, &ok[ i ] ) );
+	for ( std::size_t i = 500; i < 2500; i++ )
+		tracker.addSample( clock.native( i * 0.01 ), received( i * 0.01 ) );
+	threads.join_all();
+	for ( std::size_t i = 0; i < nThreads; i++ )
+		BOOST_CHECK( ok[ i ] );
+
+	ClockSyncService::instance().removeClock( "ClockSyncTest.bus" );
+	BOOST_CHECK( !ClockSyncService::instance().hasClock( "ClockSyncTest.bus" ) );
+}
+
+} // anonymous namespace
+
+void TestClockSync()
+{
+	testDrift();
+	testDriftChange();
+	testJumps();
+	testReset();
+	testConcurrency();
+}
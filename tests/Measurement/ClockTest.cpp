@@ -0,0 +1,131 @@
+#include <utMeasurement/Timestamp.h>
+#include <utMeasurement/TimestampSync.h>
+#include <utUtil/Clock.h>
+#include <utUtil/OS.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using namespace Ubitrack;
+
+namespace {
+
+void collectTimestamps( std::vector< Measurement::Timestamp >& timestamps, const std::size_t n )
+{
+	timestamps.reserve( n );
+	for ( std::size_t i = 0; i < n; i++ )
+		timestamps.push_back( Measurement::now() );
+}
+
+bool nonDecreasing( const std::vector< Measurement::Timestamp >& timestamps )
+{
+	for ( std::size_t i = 1; i < timestamps.size(); i++ )
+		if ( timestamps[ i ] < timestamps[ i - 1 ] )
+			return false;
+	return true;
+}
+
+void testDefaultPolicy()
+{
+	// the wall clock, unless selected otherwise
+	BOOST_CHECK_EQUAL( Util::getClockPolicy(), Util::SystemClock );
+	const Measurement::Timestamp t0 = Measurement::systemNow();
+	const Measurement::Timestamp t1 = Measurement::now();
+	BOOST_CHECK( t1 >= t0 && t1 - t0 < 1000000000ULL );
+
+	// the high performance counter has nanosecond units on all policies
+	const long long c0 = Util::getHighPerformanceCounter();
+	Util::sleep( 2 );
+	const double elapsed = ( Util::getHighPerformanceCounter() - c0 ) / Util::getHighPerformanceFrequency();
+	BOOST_CHECK( elapsed >= 0.0015 && elapsed < 1.0 );
+}
+
+void testMonotonicClock()
+{
+	Util::setClockPolicy( Util::MonotonicClock );
+	BOOST_CHECK_EQUAL( Util::getClockPolicy(), Util::MonotonicClock );
+
+	// calibrated to the wall clock
+	const long long diff = static_cast< long long >( Measurement::now() - Measurement::systemNow() );
+	BOOST_CHECK( diff > -10000000 && diff < 10000000 );
+
+	// does not go backwards within one thread
+	std::vector< Measurement::Timestamp > timestamps;
+	collectTimestamps( timestamps, 100000 );
+	BOOST_CHECK( nonDecreasing( timestamps ) );
+
+	// the high performance counter advances with the monotonic clock
+	const long long c0 = Util::getHighPerformanceCounter();
+	Util::sleep( 2 );
+	const double elapsed = ( Util::getHighPerformanceCounter() - c0 ) / Util::getHighPerformanceFrequency();
+	BOOST_CHECK( elapsed >= 0.0015 && elapsed < 1.0 );
+
+	Util::setClockPolicy( Util::SystemClock );
+}
+
+void testStrictlyIncreasingClock()
+{
+	Util::setClockPolicy( Util::StrictlyIncreasingClock );
+
+	// strictly increasing within one thread
+	std::vector< Measurement::Timestamp > timestamps;
+	collectTimestamps( timestamps, 100000 );
+	bool increasing = true;
+	for ( std::size_t i = 1; i < timestamps.size(); i++ )
+		increasing = increasing && timestamps[ i ] > timestamps[ i - 1 ];
+	BOOST_CHECK( increasing );
+
+	// and unique between threads
+	const std::size_t nThreads = 4;
+	std::vector< std::vector< Measurement::Timestamp > > perThread( nThreads );
+	boost::thread_group threads;
+	for ( std::size_t t = 0; t < nThreads; t++ )
+		threads.create_thread( boost::bind( &collectTimestamps, boost::ref( perThread[ t ] ), 50000 ) );
+	threads.join_all();
+
+	std::vector< Measurement::Timestamp > all;
+	for ( std::size_t t = 0; t < nThreads; t++ )
+		all.insert( all.end(), perThread[ t ].begin(), perThread[ t ].end() );
+	std::sort( all.begin(), all.end() );
+	BOOST_CHECK( std::adjacent_find( all.begin(), all.end() ) == all.end() );
+
+	// recalibration does not make the clock go backwards
+	const Measurement::Timestamp before = Measurement::now();
+	Util::calibrateClock();
+	BOOST_CHECK( Measurement::now() > before );
+
+	Util::setClockPolicy( Util::SystemClock );
+}
+
+void testTimestampSyncClock()
+{
+	// TimestampSync keeps the clock selected at construction
+	Util::setClockPolicy( Util::MonotonicClock );
+	Measurement::TimestampSync sync( 1e9 );
+	Util::setClockPolicy( Util::SystemClock );
+	BOOST_CHECK_EQUAL( sync.getClockPolicy(), Util::MonotonicClock );
+
+	const Measurement::Timestamp before = Measurement::now( Util::MonotonicClock );
+	const Measurement::Timestamp local = sync.convertNativeToLocal( 1e9 );
+	const Measurement::Timestamp after = Measurement::now( Util::MonotonicClock );
+	BOOST_CHECK( local >= before && local <= after );
+
+	Measurement::TimestampSync systemSync( 1e9 );
+	BOOST_CHECK_EQUAL( systemSync.getClockPolicy(), Util::SystemClock );
+	systemSync.setClockPolicy( Util::StrictlyIncreasingClock );
+	BOOST_CHECK_EQUAL( systemSync.getClockPolicy(), Util::StrictlyIncreasingClock );
+}
+
+} // anonymous namespace
+
+void TestClock()
+{
+	testDefaultPolicy();
+	testMonotonicClock();
+	testStrictlyIncreasingClock();
+	testTimestampSyncClock();
+}
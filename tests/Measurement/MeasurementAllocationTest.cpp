@@ -0,0 +1,150 @@
+#include <utMeasurement/Measurement.h>
+#include <utUtil/PoolAllocator.h>
+#include <utUtil/BlockTimer.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <cstring>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Measurement.MeasurementAllocationTest" ) );
+
+using namespace Ubitrack;
+
+namespace {
+
+template< typename Type >
+void benchmarkAllocation( const std::string& name, const Type& value, const std::size_t n )
+{
+	Util::BlockTimer tHeap( name + " (new)", "Ubitrack.Measurement.MeasurementAllocationTest" );
+	Util::BlockTimer tPool( name + " (pool)", "Ubitrack.Measurement.MeasurementAllocationTest" );
+
+	// keep a window of live measurements, similar to a queue between threads
+	const std::size_t window = 64;
+	std::vector< Measurement::Measurement< Type > > heap( window );
+	std::vector< Measurement::Measurement< Type > > pooled( window );
+	{
+		UBITRACK_TIME( tHeap );
+		for ( std::size_t i = 0; i < n; i++ )
+			heap[ i % window ] = Measurement::Measurement< Type >( i + 1, boost::shared_ptr< Type >( new Type( value ) ) );
+	}
+	{
+		UBITRACK_TIME( tPool );
+		for ( std::size_t i = 0; i < n; i++ )
+			pooled[ i % window ] = Measurement::Measurement< Type >( i + 1, value );
+	}
+
+	BOOST_TEST_MESSAGE( name << ": new " << tHeap.getTotalTime() << "ms, pool " << tPool.getTotalTime() << "ms for " << n << " measurements" );
+	for ( std::size_t i = 0; i < window; i++ )
+		BOOST_CHECK_EQUAL( pooled[ i ].time(), heap[ i ].time() );
+}
+
+void produce( std::vector< Measurement::Pose >& measurements, const std::size_t n )
+{
+	for ( std::size_t i = 0; i < n; i++ )
+		measurements.push_back( Measurement::Pose( i + 1, Math::Pose( Math::Quaternion(), Math::Vector< double, 3 >( double( i ), 0, 0 ) ) ) );
+}
+
+void consume( std::vector< Measurement::Pose >& measurements )
+{
+	measurements.clear();
+}
+
+void testCrossThreadRelease( const std::size_t rounds, const std::size_t n )
+{
+	// payloads are allocated in one thread and released in another
+	for ( std::size_t r = 0; r < rounds; r++ )
+	{
+		std::vector< Measurement::Pose > measurements;
+		boost::thread producer( boost::bind( &produce, boost::ref( measurements ), n ) );
+		producer.join();
+
+		bool ok = true;
+		for ( std::size_t i = 0; i < n; i++ )
+			ok = ok && measurements[ i ]->translation()( 0 ) == double( i );
+		BOOST_CHECK( ok );
+
+		// clone copies the payload
+		Measurement::Pose copy( measurements.back().clone() );
+		BOOST_CHECK( copy.get() != measurements.back().get() );
+		BOOST_CHECK_EQUAL( copy.time(), measurements.back().time() );
+
+		boost::thread consumer( boost::bind( &consume, boost::ref( measurements ) ) );
+		consumer.join();
+	}
+}
+
+void testPoolAllocator()
+{
+	// all size classes and the unpooled fall-back
+	std::vector< void* > blocks;
+	for ( std::size_t size = 1; size <= Util::poolMaxBlockSize + 64; size += 7 )
+	{
+		void* p = Util::poolAllocate( size );
+		BOOST_CHECK( p != 0 );
+		BOOST_CHECK_EQUAL( reinterpret_cast< std::size_t >( p ) % 16, 0u );
+		std::memset( p, 0xab, size );
+		blocks.push_back( p );
+	}
+	std::size_t size = 1;
+	for ( std::size_t i = 0; i < blocks.size(); i++, size += 7 )
+		Util::poolDeallocate( blocks[ i ], size );
+}
+
+#ifndef BOOST_NO_CXX11_THREAD_LOCAL
+
+/** frees its blocks in the destructor, which may run after the thread cache of the pool is gone */
+struct LateRelease
+{
+	~LateRelease()
+	{
+		for ( std::size_t i = 0; i < blocks.size(); i++ )
+			Util::poolDeallocate( blocks[ i ], 48 );
+		Util::poolDeallocate( Util::poolAllocate( 48 ), 48 );
+	}
+
+	std::vector< void* > blocks;
+};
+
+void allocateForLateRelease( const std::size_t n )
+{
+	// constructed before the thread cache, hence destroyed after it
+	static thread_local LateRelease release;
+	release.blocks.reserve( n );
+	for ( std::size_t i = 0; i < n; i++ )
+		release.blocks.push_back( Util::poolAllocate( 48 ) );
+}
+
+void testReleaseAfterThreadCache()
+{
+	for ( std::size_t r = 0; r < 4; r++ )
+	{
+		boost::thread t( boost::bind( &allocateForLateRelease, 200 ) );
+		t.join();
+	}
+
+	// the blocks went back to the pool and can be used again
+	std::vector< void* > blocks;
+	for ( std::size_t i = 0; i < 1000; i++ )
+		blocks.push_back( Util::poolAllocate( 48 ) );
+	for ( std::size_t i = 0; i < blocks.size(); i++ )
+		Util::poolDeallocate( blocks[ i ], 48 );
+}
+
+#endif
+
+} // anonymous namespace
+
+void TestMeasurementAllocation()
+{
+	testPoolAllocator();
+#ifndef BOOST_NO_CXX11_THREAD_LOCAL
+	testReleaseAfterThreadCache();
+#endif
+	testCrossThreadRelease( 4, 10000 );
+	benchmarkAllocation( "Pose", Math::Pose( Math::Quaternion(), Math::Vector< double, 3 >( 1, 2, 3 ) ), 1000000 );
+	benchmarkAllocation( "Position", Math::Vector< double, 3 >( 1, 2, 3 ), 1000000 );
+	benchmarkAllocation( "ErrorPose", Math::ErrorPose(), 1000000 );
+}
@@ -0,0 +1,145 @@
+#include <utMeasurement/MeasurementRingBuffer.h>
+#include <utUtil/BlockTimer.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Measurement.MeasurementRingBufferTest" ) );
+
+using namespace Ubitrack;
+
+namespace {
+
+void testTimestampQueries()
+{
+	Measurement::MeasurementRingBuffer< Math::Vector< double, 3 >, Measurement::SingleProducer > buffer( 6 );
+	BOOST_CHECK_EQUAL( buffer.capacity(), 8u );
+	BOOST_CHECK( buffer.view().empty() );
+
+	for ( std::size_t i = 1; i <= 8; i++ )
+		BOOST_CHECK( buffer.push( Measurement::Position( i * 100, Math::Vector< double, 3 >( double( i ), 0, 0 ) ) ) );
+
+	// full
+	BOOST_CHECK( !buffer.push( 900, Math::Vector< double, 3 >( 9, 0, 0 ) ) );
+	BOOST_CHECK_EQUAL( buffer.dropped(), 1u );
+	BOOST_CHECK_EQUAL( buffer.size(), 8u );
+
+	Measurement::MeasurementRingBuffer< Math::Vector< double, 3 >, Measurement::SingleProducer >::View view( buffer.view() );
+	BOOST_CHECK_EQUAL( view.size(), 8u );
+	BOOST_CHECK_EQUAL( view.latest(), 7u );
+	BOOST_CHECK_EQUAL( view.time( view.latest() ), 800u );
+	BOOST_CHECK_EQUAL( view[ view.nearest( 349 ) ]( 0 ), 3.0 );
+	BOOST_CHECK_EQUAL( view[ view.nearest( 351 ) ]( 0 ), 4.0 );
+	BOOST_CHECK_EQUAL( view.nearest( 10000 ), 7u );
+
+	std::vector< std::size_t > indices;
+	BOOST_CHECK_EQUAL( view.range( 250, 600, indices ), 4u );
+	BOOST_CHECK_EQUAL( view.time( indices.front() ), 300u );
+	BOOST_CHECK_EQUAL( view.time( indices.back() ), 600u );
+
+	// release everything older than 500 and wrap around
+	BOOST_CHECK_EQUAL( buffer.consumeUntil( 500 ), 4u );
+	for ( std::size_t i = 9; i <= 12; i++ )
+		BOOST_CHECK( buffer.push( i * 100, Math::Vector< double, 3 >( double( i ), 0, 0 ) ) );
+
+	Measurement::Position m;
+	BOOST_CHECK( buffer.pop( m ) );
+	BOOST_CHECK_EQUAL( m.time(), 500u );
+	BOOST_CHECK_EQUAL( ( *m )( 0 ), 5.0 );
+
+	view = buffer.view();
+	BOOST_CHECK_EQUAL( view.size(), 7u );
+	BOOST_CHECK_EQUAL( view.time( view.latest() ), 1200u );
+	BOOST_CHECK_EQUAL( view[ 0 ]( 0 ), 6.0 );
+
+	// releasing more than is available stops at the end of the written slots
+	BOOST_CHECK_EQUAL( buffer.consume( 100 ), 7u );
+	BOOST_CHECK( buffer.view().empty() );
+	BOOST_CHECK( buffer.push( 1300, Math::Vector< double, 3 >( 13, 0, 0 ) ) );
+	BOOST_CHECK( buffer.pop( m ) );
+	BOOST_CHECK_EQUAL( m.time(), 1300u );
+}
+
+typedef Measurement::MeasurementRingBuffer< Math::Pose, Measurement::MultiProducer > PoseBuffer;
+
+void producer( PoseBuffer& buffer, const std::size_t id, const std::size_t n )
+{
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		// timestamps encode producer and sequence number
+		const Measurement::Timestamp t = ( Measurement::Timestamp( id ) << 32 ) + i + 1;
+		const Math::Pose pose( Math::Quaternion(), Math::Vector< double, 3 >( double( id ), double( i ), 0 ) );
+		while ( !buffer.push( t, pose ) )
+			boost::this_thread::yield();
+	}
+}
+
+void testMultiProducer( const std::size_t nProducers, const std::size_t n )
+{
+	PoseBuffer buffer( 1024 );
+	Util::BlockTimer timer( "MultiProducer", "Ubitrack.Measurement.MeasurementRingBufferTest" );
+
+	boost::thread_group producers;
+	{
+		UBITRACK_TIME( timer );
+		for ( std::size_t p = 0; p < nProducers; p++ )
+			producers.create_thread( boost::bind( &producer, boost::ref( buffer ), p, n ) );
+
+		// consumer: every producer's measurements arrive complete and in order
+		std::vector< std::size_t > received( nProducers, 0 );
+		std::size_t total = 0;
+		bool ok = true;
+		while ( total < nProducers * n )
+		{
+			const PoseBuffer::View view( buffer.view() );
+			for ( std::size_t i = 0; i < view.size(); i++ )
+			{
+				const std::size_t id = static_cast< std::size_t >( view.time( i ) >> 32 );
+				const std::size_t seq = static_cast< std::size_t >( view.time( i ) & 0xffffffff );
+				ok = ok && id < nProducers && seq == received[ id ] + 1
+					&& view[ i ].translation()( 0 ) == double( id ) && view[ i ].translation()( 1 ) == double( seq - 1 );
+				if ( id < nProducers )
+					received[ id ] = seq;
+			}
+			buffer.consume( view.size() );
+			total += view.size();
+			if ( view.empty() )
+				boost::this_thread::yield();
+		}
+		producers.join_all();
+
+		BOOST_CHECK( ok );
+		BOOST_CHECK_EQUAL( total, nProducers * n );
+		BOOST_CHECK_EQUAL( buffer.size(), 0u );
+	}
+}
+
+void testReservedPayloads()
+{
+	// every slot keeps the capacity of the prototype, pushing smaller lists reuses it
+	std::vector< Math::Vector< double, 3 > > prototype;
+	prototype.reserve( 16 );
+	Measurement::MeasurementRingBuffer< std::vector< Math::Vector< double, 3 > > > buffer( 2, prototype );
+
+	const std::vector< Math::Vector< double, 3 > > list( 10, Math::Vector< double, 3 >( 1, 2, 3 ) );
+	BOOST_CHECK( buffer.push( 100, list ) );
+	const Math::Vector< double, 3 >* pStorage = &buffer.view()[ 0 ][ 0 ];
+	BOOST_CHECK_GE( buffer.view()[ 0 ].capacity(), 16u );
+	buffer.consume( 1 );
+
+	BOOST_CHECK( buffer.push( 200, list ) );
+	BOOST_CHECK( buffer.push( 300, list ) );
+	BOOST_CHECK_EQUAL( buffer.view().size(), 2u );
+	BOOST_CHECK( &buffer.view()[ 1 ][ 0 ] == pStorage );
+}
+
+} // anonymous namespace
+
+void TestMeasurementRingBuffer()
+{
+	testTimestampQueries();
+	testReservedPayloads();
+	testMultiProducer( 4, 100000 );
+}
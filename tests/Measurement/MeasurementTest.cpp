@@ -0,0 +1,20 @@
+#include "MeasurementTest.h"
+
+// declare external tests here, to save us some trivial header files
+void TestMeasurementRingBuffer();
+void TestMeasurementAllocation();
+void TestClock();
+void TestBlockTimer();
+void TestMetrics();
+void TestClockSync();
+
+MeasurementTest::MeasurementTest()
+	: boost::unit_test::test_suite( "MeasurementTests" )
+{
+	add( BOOST_TEST_CASE( &TestMeasurementRingBuffer ) );
+	add( BOOST_TEST_CASE( &TestMeasurementAllocation ) );
+	add( BOOST_TEST_CASE( &TestClock ) );
+	add( BOOST_TEST_CASE( &TestBlockTimer ) );
+	add( BOOST_TEST_CASE( &TestMetrics ) );
+	add( BOOST_TEST_CASE( &TestClockSync ) );
+}
@@ -0,0 +1,7 @@
+#include <boost/test/unit_test.hpp>
+
+struct MeasurementTest
+	: public boost::unit_test::test_suite
+{
+	MeasurementTest();
+};
@@ -0,0 +1,248 @@
+#include <utUtil/Metrics.h>
+#include <utUtil/Exception.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+	#include <unistd.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+#endif
+
+using namespace Ubitrack;
+
+namespace {
+
+bool contains( const std::string& s, const std::string& what )
+{
+	return s.find( what ) != std::string::npos;
+}
+
+void testFormats()
+{
+	Util::BlockTimer timer1( "metrics.timer" );
+	Util::BlockTimer timer2( "metrics.timer" );
+	Util::Counter counter( "metrics.frames" );
+	Util::Gauge gauge( "metrics.queue \"length\"", 2.5 );
+
+	const unsigned long long ticksPerMs = static_cast< unsigned long long >( Util::getHighPerformanceFrequency() * 1e-3 );
+	timer1.addMeasurement( ticksPerMs );
+	timer2.addMeasurement( 3 * ticksPerMs );
+	counter.increment();
+	counter.increment( 41 );
+	gauge.add( 0.5 );
+
+	// timers with the same name are merged
+	const Util::MetricsSnapshot s( Util::MetricsRegistry::instance().snapshot() );
+	const Util::BlockTimer::Snapshot* pTimer = 0;
+	for ( std::size_t i = 0; i < s.timers.size(); i++ )
+		if ( s.timers[ i ].first == "metrics.timer" )
+			pTimer = &s.timers[ i ].second;
+	BOOST_REQUIRE( pTimer );
+	BOOST_CHECK_EQUAL( pTimer->runs, 2u );
+	BOOST_CHECK_CLOSE( pTimer->minTime, 1.0, 1.0 );
+	BOOST_CHECK_CLOSE( pTimer->maxTime, 3.0, 1.0 );
+	BOOST_CHECK_CLOSE( pTimer->totalTime, 4.0, 1.0 );
+
+	const std::string text( Util::MetricsRegistry::instance().dump( Util::MetricsRegistry::TextFormat ) );
+	BOOST_CHECK( contains( text, "timer metrics.timer: runs 2" ) );
+	BOOST_CHECK( contains( text, "counter metrics.frames: 42" ) );
+	BOOST_CHECK( contains( text, "gauge metrics.queue \"length\": 3" ) );
+
+	const std::string json( Util::MetricsRegistry::instance().dump( Util::MetricsRegistry::JsonFormat ) );
+	BOOST_CHECK( contains( json, "\"metrics.timer\":{\"runs\":2," ) );
+	BOOST_CHECK( contains( json, "\"metrics.frames\":42" ) );
+	BOOST_CHECK( contains( json, "\"metrics.queue \\\"length\\\"\":3" ) );
+
+	const std::string prometheus( Util::MetricsRegistry::instance().dump( Util::MetricsRegistry::PrometheusFormat ) );
+	BOOST_CHECK( contains( prometheus, "# TYPE ubitrack_block_time_seconds summary" ) );
+	BOOST_CHECK( contains( prometheus, "ubitrack_block_time_seconds_count{timer=\"metrics.timer\"} 2" ) );
+	BOOST_CHECK( contains( prometheus, "ubitrack_block_time_seconds{timer=\"metrics.timer\",quantile=\"0.99\"}" ) );
+	BOOST_CHECK( contains( prometheus, "ubitrack_metrics_frames_total 42" ) );
+	BOOST_CHECK( contains( prometheus, "ubitrack_metrics_queue__length_ 3" ) );
+}
+
+void testNameCollisions()
+{
+	Util::Counter counter( "metrics.collision" );
+	Util::Gauge gauge( "metrics.collision_gauge" );
+
+	// metrics of the same kind and name are merged
+	Util::Counter sameCounter( "metrics.collision" );
+	Util::Gauge sameGauge( "metrics.collision_gauge" );
+
+	// but different names or kinds must not map to the same Prometheus name
+	BOOST_CHECK_THROW( Util::Gauge g( "metrics.collision" ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Util::Gauge g( "metrics.collision_total" ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Util::Counter c( "metrics-collision" ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Util::Counter c( "metrics.collision_gauge" ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Util::Gauge g( "block_time_seconds" ), Ubitrack::Util::Exception );
+
+	// only one TYPE line per name
+	const std::string prometheus( Util::MetricsRegistry::instance().dump( Util::MetricsRegistry::PrometheusFormat ) );
+	const std::string typeLine( "# TYPE ubitrack_metrics_collision_total counter" );
+	BOOST_CHECK( contains( prometheus, typeLine ) );
+	BOOST_CHECK_EQUAL( prometheus.find( typeLine ), prometheus.rfind( typeLine ) );
+}
+
+void testControlCharacters()
+{
+	Util::Counter counter( "metrics.tab\there" );
+	const std::string json( Util::MetricsRegistry::instance().dump( Util::MetricsRegistry::JsonFormat ) );
+	BOOST_CHECK( contains( json, "\"metrics.tab\\u0009here\":0" ) );
+}
+
+void testUnregister()
+{
+	{
+		Util::Counter counter( "metrics.temporary" );
+		counter.increment();
+		BOOST_CHECK( contains( Util::MetricsRegistry::instance().dump( Util::MetricsRegistry::TextFormat ), "metrics.temporary" ) );
+	}
+	BOOST_CHECK( !contains( Util::MetricsRegistry::instance().dump( Util::MetricsRegistry::TextFormat ), "metrics.temporary" ) );
+}
+
+void testFileDump()
+{
+	Util::Counter counter( "metrics.file" );
+	counter.increment( 7 );
+	const std::string sFilename( "metrics_test.prom" );
+	Util::MetricsRegistry::instance().dumpToFile( sFilename, Util::MetricsRegistry::PrometheusFormat );
+
+	std::ifstream f( sFilename.c_str() );
+	std::ostringstream content;
+	content << f.rdbuf();
+	BOOST_CHECK( contains( content.str(), "ubitrack_metrics_file_total 7" ) );
+	f.close();
+	std::remove( sFilename.c_str() );
+
+	BOOST_CHECK_THROW( Util::MetricsRegistry::instance().dumpToFile( "no/such/directory/metrics", 
+		Util::MetricsRegistry::TextFormat ), Ubitrack::Util::Exception );
+}
+
+#ifndef _WIN32
+void testSocketDump()
+{
+	Util::Counter counter( "metrics.socket" );
+	counter.increment( 3 );
+
+	const std::string sPath( "metrics_test.sock" );
+	unlink( sPath.c_str() );
+	sockaddr_un address = sockaddr_un();
+	address.sun_family = AF_UNIX;
+	sPath.copy( address.sun_path, sPath.size() );
+	const int server = socket( AF_UNIX, SOCK_STREAM, 0 );
+	BOOST_REQUIRE( server >= 0 );
+	BOOST_REQUIRE( bind( server, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) == 0 );
+	BOOST_REQUIRE( listen( server, 1 ) == 0 );
+
+	// the connection is queued by the kernel, so we can write before accepting
+	Util::MetricsRegistry::instance().dumpToSocket( sPath, Util::MetricsRegistry::JsonFormat );
+
+	const int client = accept( server, 0, 0 );
+	BOOST_REQUIRE( client >= 0 );
+	std::string received;
+	char buffer[ 4096 ];
+	ssize_t n;
+	while ( ( n = read( client, buffer, sizeof( buffer ) ) ) > 0 )
+		received.append( buffer, n );
+	close( client );
+	close( server );
+	unlink( sPath.c_str() );
+
+	BOOST_CHECK( contains( received, "\"metrics.socket\":3" ) );
+	BOOST_CHECK_THROW( Util::MetricsRegistry::instance().dumpToSocket( sPath, Util::MetricsRegistry::JsonFormat ), 
+		Ubitrack::Util::Exception );
+}
+
+void acceptAndClose( const int server )
+{
+	const int client = accept( server, 0, 0 );
+	if ( client >= 0 )
+		close( client );
+}
+
+void testSocketClosedByReader()
+{
+	// more than fits into the socket buffer, so the writer is still sending when the reader closes
+	Util::Gauge gauge( std::string( 4 << 20, 'x' ) );
+
+	const std::string sPath( "metrics_test_closed.sock" );
+	unlink( sPath.c_str() );
+	sockaddr_un address = sockaddr_un();
+	address.sun_family = AF_UNIX;
+	sPath.copy( address.sun_path, sPath.size() );
+	const int server = socket( AF_UNIX, SOCK_STREAM, 0 );
+	BOOST_REQUIRE( server >= 0 );
+	BOOST_REQUIRE( bind( server, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) == 0 );
+	BOOST_REQUIRE( listen( server, 1 ) == 0 );
+
+	// fails with an exception instead of killing the process with SIGPIPE
+	boost::thread reader( boost::bind( &acceptAndClose, server ) );
+	BOOST_CHECK_THROW( Util::MetricsRegistry::instance().dumpToSocket( sPath, Util::MetricsRegistry::JsonFormat ), 
+		Ubitrack::Util::Exception );
+	reader.join();
+	close( server );
+	unlink( sPath.c_str() );
+}
+#endif
+
+void countAndTime( Util::Counter& counter, Util::BlockTimer& timer, const std::size_t n )
+{
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		counter.increment();
+		timer.addMeasurement( 1 + i % 100 );
+	}
+}
+
+void testConcurrentSnapshots()
+{
+	const std::size_t nThreads = 4;
+	const std::size_t n = 100000;
+	Util::Counter counter( "metrics.concurrent" );
+	Util::BlockTimer timer( "metrics.concurrent" );
+	boost::thread_group threads;
+	for ( std::size_t t = 0; t < nThreads; t++ )
+		threads.create_thread( boost::bind( &countAndTime, boost::ref( counter ), boost::ref( timer ), n ) );
+
+	// snapshots see monotonically increasing values while the threads are running
+	unsigned long long last = 0;
+	for ( std::size_t i = 0; i < 20; i++ )
+	{
+		const Util::MetricsSnapshot s( Util::MetricsRegistry::instance().snapshot() );
+		for ( std::size_t j = 0; j < s.counters.size(); j++ )
+			if ( s.counters[ j ].first == "metrics.concurrent" )
+			{
+				BOOST_CHECK( s.counters[ j ].second >= last );
+				last = s.counters[ j ].second;
+			}
+	}
+	threads.join_all();
+
+	BOOST_CHECK_EQUAL( counter.get(), nThreads * n );
+	BOOST_CHECK_EQUAL( timer.getRuns(), nThreads * n );
+}
+
+} // anonymous namespace
+
+void TestMetrics()
+{
+	testFormats();
+	testNameCollisions();
+	testControlCharacters();
+	testUnregister();
+	testFileDump();
+#ifndef _WIN32
+	testSocketDump();
+	testSocketClosedByReader();
+#endif
+	testConcurrentSnapshots();
+}
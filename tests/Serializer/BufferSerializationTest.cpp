@@ -0,0 +1,128 @@
+#include <utSerialization/BufferSerialization.h>
+#include <utMeasurement/Measurement.h>
+#include <utUtil/BlockTimer.h>
+
+#include <sstream>
+#include <vector>
+
+#include "../tools.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+using namespace Ubitrack;
+using namespace Ubitrack::Serialization;
+
+namespace {
+
+template< typename T >
+void testRoundTrip( const SerializationProtocol p, const Measurement::Measurement< T >& data )
+{
+	const std::size_t maxLength = maxSerializationLength( p, data );
+	std::vector< char > buffer( maxLength );
+	const std::size_t length = serialize( p, &buffer[ 0 ], buffer.size(), data );
+	BOOST_CHECK( length <= maxLength );
+	if ( p != PROTOCOL_MSGPACK )
+		BOOST_CHECK_EQUAL( length, maxLength );
+
+	Measurement::Measurement< T > result( 0, T() );
+	BOOST_CHECK_EQUAL( deserialize( p, &buffer[ 0 ], length, result ), length );
+	BOOST_CHECK_EQUAL( data.time(), result.time() );
+	BOOST_CHECK( *data == *result );
+
+	// too small buffers are detected
+	BOOST_CHECK_THROW( serialize( p, &buffer[ 0 ], length - 1, data ), StreamOverrunException );
+}
+
+void testSession( const SerializationProtocol p )
+{
+	MessageWriter writer( p );
+	MessageReader reader( p );
+
+	// the same object with changing contents, written into one stream of messages
+	Measurement::Pose pose( 1, Math::Pose( randomQuaternion(), randomVector< double, 3 >( 5.0 ) ) );
+	std::vector< char > stream;
+	std::vector< Measurement::Pose > sent;
+	for ( std::size_t i = 0; i < 5; i++ )
+	{
+		pose = Measurement::Pose( i + 1, Math::Pose( randomQuaternion(), randomVector< double, 3 >( 5.0 ) ) );
+		const std::size_t length = writer.write( pose );
+		stream.insert( stream.end(), writer.data(), writer.data() + length );
+		sent.push_back( pose );
+	}
+
+	// and into a caller-provided buffer
+	char buffer[ 1024 ];
+	const std::size_t length = writer.write( buffer, sizeof( buffer ), pose );
+	stream.insert( stream.end(), buffer, buffer + length );
+	sent.push_back( pose );
+
+	std::size_t offset = 0;
+	for ( std::size_t i = 0; i < sent.size(); i++ )
+	{
+		Measurement::Pose result( 0, Math::Pose() );
+		offset += reader.read( &stream[ offset ], stream.size() - offset, result );
+		BOOST_CHECK_EQUAL( result.time(), sent[ i ].time() );
+		BOOST_CHECK_EQUAL( *result, *sent[ i ] );
+	}
+	BOOST_CHECK_EQUAL( offset, stream.size() );
+}
+
+void testProtocol( const SerializationProtocol p )
+{
+	const Measurement::Timestamp ts = Measurement::now();
+	testRoundTrip( p, Measurement::Pose( ts, Math::Pose( randomQuaternion(), randomVector< double, 3 >( 5.0 ) ) ) );
+
+	Math::Matrix< double, 3, 4 > m;
+	randomMatrix( m );
+	testRoundTrip( p, Measurement::Matrix3x4( ts, m ) );
+
+	std::vector< Math::Vector< double, 3 > > positions;
+	for ( std::size_t i = 0; i < 50; i++ )
+		positions.push_back( randomVector< double, 3 >( 5.0 ) );
+	testRoundTrip( p, Measurement::PositionList( ts, positions ) );
+
+	testSession( p );
+}
+
+/** compares the stream interface with a reused writer */
+void testPerformance( const SerializationProtocol p, const char* name )
+{
+	const std::size_t n = 10000;
+	const Measurement::Pose pose( Measurement::now(), Math::Pose( randomQuaternion(), randomVector< double, 3 >( 5.0 ) ) );
+	Ubitrack::Util::BlockTimer streamTimer( "stream" );
+	Ubitrack::Util::BlockTimer writerTimer( "writer" );
+
+	std::size_t streamBytes = 0;
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		UBITRACK_TIME( streamTimer );
+		std::ostringstream stream;
+		serialize( p, stream, pose );
+		streamBytes += stream.str().size();
+	}
+
+	MessageWriter writer( p );
+	std::size_t writerBytes = 0;
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		UBITRACK_TIME( writerTimer );
+		writerBytes += writer.write( pose );
+	}
+
+	BOOST_TEST_MESSAGE( name << " pose: stream " << streamTimer.getTotalTime() * 1e3 / n << "us, " << streamBytes / n 
+		<< " bytes, MessageWriter " << writerTimer.getTotalTime() * 1e3 / n << "us, " << writerBytes / n << " bytes per message" );
+}
+
+} // anonymous namespace
+
+void TestBufferSerialization()
+{
+	testProtocol( PROTOCOL_BOOST_TEXT );
+	testProtocol( PROTOCOL_BOOST_BINARY );
+	testPerformance( PROTOCOL_BOOST_TEXT, "Boost text" );
+	testPerformance( PROTOCOL_BOOST_BINARY, "Boost binary" );
+#ifdef HAVE_MSGPACK
+	testProtocol( PROTOCOL_MSGPACK );
+	testPerformance( PROTOCOL_MSGPACK, "Msgpack" );
+#endif // HAVE_MSGPACK
+}
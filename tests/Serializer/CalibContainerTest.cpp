@@ -0,0 +1,230 @@
+#include <utUtil/CalibContainer.h>
+#include <utUtil/CalibFile.h>
+#include <utUtil/BlockTimer.h>
+#include <utMeasurement/Measurement.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "../tools.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& calibContainerLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Serializer.CalibContainer" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Util;
+
+namespace {
+
+const char* containerFile = "CalibContainerTest.calib";
+const char* archiveFile = "CalibContainerTest.cal";
+
+std::vector< char > readBytes( const char* sFile )
+{
+	std::ifstream in( sFile, std::ios::binary );
+	return std::vector< char >( std::istreambuf_iterator< char >( in ), std::istreambuf_iterator< char >() );
+}
+
+void writeBytes( const char* sFile, const std::vector< char >& content )
+{
+	std::ofstream out( sFile, std::ios::binary | std::ios::trunc );
+	out.write( &content[ 0 ], content.size() );
+}
+
+void testSections()
+{
+	const Math::Pose pose( randomQuaternion(), randomVector< double, 3 >( 10.0 ) );
+	const Measurement::Pose measurement( 123456789, pose );
+	Math::Matrix< double, 3, 3 > intrinsics;
+	randomMatrix( intrinsics );
+	Math::Matrix< double, 0, 0 > dynamic( 4, 7 );
+	for ( std::size_t i = 0; i < 4; i++ )
+		for ( std::size_t j = 0; j < 7; j++ )
+			dynamic( i, j ) = random( -1.0, 1.0 );
+	const Math::Vector< float, 5 > distortion( randomVector< float, 5 >( 1.0f ) );
+	std::vector< Math::Vector< double, 2 > > lut( 1000 );
+	for ( std::size_t i = 0; i < lut.size(); i++ )
+		lut[ i ] = randomVector< double, 2 >( 640.0 );
+	std::vector< Math::Scalar< int > > ids( 3 );
+	ids[ 1 ] = 7;
+
+	{
+		CalibContainerWriter writer;
+		writer.add( "pose", pose );
+		writer.add( "measurement", measurement );
+		writer.add( "intrinsics", intrinsics, 2 );
+		writer.add( "dynamic", dynamic );
+		writer.add( "distortion", distortion );
+		writer.add( "lut", lut );
+		writer.add( "ids", ids );
+		writer.add( "threshold", 0.25 );
+		BOOST_CHECK_THROW( writer.add( "pose", pose ), Util::Exception );
+		writer.write( containerFile );
+	}
+	BOOST_CHECK( CalibContainerReader::isContainer( containerFile ) );
+
+	CalibContainerReader reader( containerFile );
+	BOOST_CHECK_EQUAL( reader.sections().size(), 8u );
+	BOOST_CHECK( reader.has( "lut" ) );
+	BOOST_CHECK( !reader.has( "missing" ) );
+	BOOST_CHECK_EQUAL( reader.section( "intrinsics" ).version, 2u );
+
+	Math::Pose pose2;
+	reader.get( "pose", pose2 );
+	BOOST_CHECK( pose2 == pose );
+
+	Measurement::Pose measurement2;
+	reader.get( "measurement", measurement2 );
+	BOOST_CHECK_EQUAL( measurement2.time(), measurement.time() );
+	BOOST_CHECK( *measurement2 == pose );
+
+	Math::Matrix< double, 3, 3 > intrinsics2;
+	reader.get( "intrinsics", intrinsics2 );
+	BOOST_CHECK( intrinsics2 == intrinsics );
+
+	Math::Matrix< double, 0, 0 > dynamic2;
+	reader.get( "dynamic", dynamic2 );
+	BOOST_REQUIRE_EQUAL( dynamic2.size1(), 4u );
+	BOOST_REQUIRE_EQUAL( dynamic2.size2(), 7u );
+	for ( std::size_t i = 0; i < 4; i++ )
+		for ( std::size_t j = 0; j < 7; j++ )
+			BOOST_CHECK_EQUAL( dynamic2( i, j ), dynamic( i, j ) );
+
+	// element types are converted when loading
+	Math::Vector< double, 0 > distortion2;
+	reader.get( "distortion", distortion2 );
+	BOOST_REQUIRE_EQUAL( distortion2.size(), 5u );
+	for ( std::size_t i = 0; i < 5; i++ )
+		BOOST_CHECK_EQUAL( distortion2( i ), double( distortion( i ) ) );
+	Math::Vector< double, 4 > wrongShape;
+	BOOST_CHECK_THROW( reader.get( "distortion", wrongShape ), Util::Exception );
+
+	std::vector< Math::Vector< double, 2 > > lut2;
+	reader.get( "lut", lut2 );
+	BOOST_REQUIRE_EQUAL( lut2.size(), lut.size() );
+	for ( std::size_t i = 0; i < lut.size(); i++ )
+		BOOST_CHECK( lut2[ i ] == lut[ i ] );
+
+	// large arrays can be used in place
+	const CalibArrayView< double > view( reader.array< double >( "lut" ) );
+	BOOST_CHECK_EQUAL( view.size(), 2 * lut.size() );
+	BOOST_CHECK_EQUAL( view[ 2 * 999 + 1 ], lut[ 999 ]( 1 ) );
+	BOOST_CHECK_THROW( reader.array< float >( "lut" ), Util::Exception );
+
+	std::vector< Math::Scalar< int > > ids2;
+	reader.get( "ids", ids2 );
+	BOOST_REQUIRE_EQUAL( ids2.size(), 3u );
+	BOOST_CHECK_EQUAL( ids2[ 1 ].m_value, 7 );
+
+	double threshold;
+	reader.get( "threshold", threshold );
+	BOOST_CHECK_EQUAL( threshold, 0.25 );
+}
+
+void testCorruption()
+{
+	const std::vector< char > content( readBytes( containerFile ) );
+	std::vector< char > corrupt( content );
+
+	// a damaged payload is detected when the section is read
+	{
+		CalibContainerReader reader( containerFile );
+		corrupt[ static_cast< std::size_t >( reader.section( "lut" ).offset ) + 100 ] ^= 1;
+	}
+	writeBytes( containerFile, corrupt );
+	{
+		CalibContainerReader reader( containerFile );
+		Math::Pose pose;
+		reader.get( "pose", pose );
+		std::vector< Math::Vector< double, 2 > > lut;
+		BOOST_CHECK_THROW( reader.get( "lut", lut ), Util::Exception );
+		CalibContainerReader unchecked( containerFile, false );
+		unchecked.get( "lut", lut );
+	}
+
+	// a damaged directory is detected when the file is opened
+	corrupt = content;
+	corrupt[ 50 ] ^= 1;
+	writeBytes( containerFile, corrupt );
+	BOOST_CHECK_THROW( CalibContainerReader reader( containerFile ), Util::Exception );
+
+	// truncated files are rejected
+	corrupt = content;
+	corrupt.resize( content.size() - 8 );
+	writeBytes( containerFile, corrupt );
+	BOOST_CHECK_THROW( CalibContainerReader reader( containerFile ), Util::Exception );
+
+	// newer minor versions can be read, newer major versions not
+	corrupt = content;
+	corrupt[ 10 ] = 5;
+	writeBytes( containerFile, corrupt );
+	{
+		CalibContainerReader reader( containerFile );
+		BOOST_CHECK( reader.has( "pose" ) );
+	}
+	corrupt[ 8 ] = 2;
+	writeBytes( containerFile, corrupt );
+	BOOST_CHECK_THROW( CalibContainerReader reader( containerFile ), Util::Exception );
+
+	BOOST_CHECK_THROW( CalibContainerReader reader( "CalibContainerTest.missing" ), Util::Exception );
+}
+
+void testConversion()
+{
+	const Measurement::Pose measurement( 42, Math::Pose( randomQuaternion(), randomVector< double, 3 >( 10.0 ) ) );
+	writeCalibFile( archiveFile, measurement );
+	convertCalibFile< Measurement::Pose >( archiveFile, containerFile );
+
+	Measurement::Pose fromContainer;
+	loadCalibFile( containerFile, fromContainer );
+	BOOST_CHECK_EQUAL( fromContainer.time(), 42u );
+	BOOST_CHECK( *fromContainer == *measurement );
+
+	// the format is detected from the content
+	Measurement::Pose fromArchive;
+	loadCalibFile( archiveFile, fromArchive );
+	BOOST_CHECK( *fromArchive == *measurement );
+
+	std::vector< Math::Vector< double, 3 > > points( 20000 );
+	for ( std::size_t i = 0; i < points.size(); i++ )
+		points[ i ] = randomVector< double, 3 >( 1.0 );
+	writeBinaryCalibFile( archiveFile, points );
+	BOOST_CHECK( isBinaryCalibFile( archiveFile ) );
+	convertCalibFile< std::vector< Math::Vector< double, 3 > > >( archiveFile, containerFile, true, "points" );
+
+	BlockTimer archiveTimer( "readBinaryCalibFile", calibContainerLogger );
+	BlockTimer containerTimer( "CalibContainerReader", calibContainerLogger );
+	for ( std::size_t i = 0; i < 5; i++ )
+	{
+		std::vector< Math::Vector< double, 3 > > fromBinary;
+		{
+			UBITRACK_TIME( archiveTimer );
+			loadCalibFile( archiveFile, fromBinary );
+		}
+		std::vector< Math::Vector< double, 3 > > loaded;
+		{
+			UBITRACK_TIME( containerTimer );
+			loadCalibFile( containerFile, loaded, "points" );
+		}
+		BOOST_REQUIRE_EQUAL( loaded.size(), points.size() );
+		BOOST_CHECK( loaded == points );
+		BOOST_CHECK( fromBinary == points );
+	}
+	BOOST_TEST_MESSAGE( points.size() << " points: binary archive " << archiveTimer.getTotalTime() / 5
+		<< "ms, calibration container " << containerTimer.getTotalTime() / 5 << "ms" );
+}
+
+} // anonymous namespace
+
+void TestCalibContainer()
+{
+	testSections();
+	testCorruption();
+	testConversion();
+	std::remove( containerFile );
+	std::remove( archiveFile );
+}
@@ -0,0 +1,202 @@
+#include <utSerialization/MeasurementRecording.h>
+#include <utMeasurement/Measurement.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "../tools.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+using namespace Ubitrack;
+using namespace Ubitrack::Serialization;
+
+namespace {
+
+const char* recordingFile = "MeasurementRecordingTest.rec";
+
+Math::Pose randomPose()
+{
+	return Math::Pose( randomQuaternion(), randomVector< double, 3 >( 10.0 ) );
+}
+
+void pushPoses( RecordingWriter< Math::Pose >* pWriter, const std::vector< Measurement::Pose >* pPoses )
+{
+	for ( std::size_t i = 0; i < pPoses->size(); i++ )
+		pWriter->push( (*pPoses)[ i ] );
+}
+
+void testFixedSize()
+{
+	const std::size_t n = 10000;
+	std::vector< Measurement::Pose > poses;
+	Measurement::Timestamp t = 1000;
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		// some equal timestamps
+		t += rand() % 3;
+		poses.push_back( Measurement::Pose( t, randomPose() ) );
+	}
+
+	{
+		RecordingWriter< Math::Pose > writer( recordingFile, 100, 16384 );
+		boost::thread producer( boost::bind( &pushPoses, &writer, &poses ) );
+		producer.join();
+		writer.close();
+		BOOST_CHECK_EQUAL( writer.written(), n );
+		BOOST_CHECK_EQUAL( writer.dropped(), 0u );
+	}
+
+	RecordingReader< Math::Pose > reader( recordingFile );
+	BOOST_REQUIRE_EQUAL( reader.size(), n );
+
+	std::size_t i = 0;
+	for ( RecordingReader< Math::Pose >::const_iterator it = reader.begin(); it != reader.end(); ++it, i++ )
+	{
+		BOOST_CHECK_EQUAL( it.time(), poses[ i ].time() );
+		BOOST_CHECK_EQUAL( it.dataSize(), 7 * sizeof( double ) );
+		const Measurement::Pose m( it.measurement() );
+		BOOST_CHECK( *m == *poses[ i ] );
+
+		// fixed-size records can be read in place
+		const double* p = reinterpret_cast< const double* >( it.data() );
+		BOOST_CHECK_EQUAL( p[ 0 ], poses[ i ]->translation()( 0 ) );
+		BOOST_CHECK_EQUAL( p[ 6 ], poses[ i ]->rotation().w() );
+	}
+	BOOST_CHECK_EQUAL( i, n );
+
+	// seeking finds the first measurement not before the timestamp
+	for ( std::size_t k = 0; k < 1000; k++ )
+	{
+		const Measurement::Timestamp ts = 990 + rand() % ( t - 970 );
+		std::size_t expected = 0;
+		while ( expected < n && poses[ expected ].time() < ts )
+			expected++;
+
+		const RecordingReader< Math::Pose >::const_iterator it = reader.seek( ts );
+		if ( expected == n )
+			BOOST_CHECK( it == reader.end() );
+		else
+		{
+			BOOST_REQUIRE( it != reader.end() );
+			BOOST_CHECK_EQUAL( it.time(), poses[ expected ].time() );
+			BOOST_CHECK( ( expected == 0 || poses[ expected - 1 ].time() < ts ) );
+			Math::Pose pose;
+			it.value( pose );
+			BOOST_CHECK( pose == *poses[ expected ] );
+		}
+	}
+	BOOST_CHECK( reader.seek( 0 ) == reader.begin() );
+
+	// the recording contains another type
+	BOOST_CHECK_THROW( RecordingReader< Math::Quaternion > wrongType( recordingFile ), Util::Exception );
+}
+
+void testTruncated()
+{
+	// a file cut off in the last chunk loses only that chunk
+	std::vector< char > content;
+	{
+		std::ifstream in( recordingFile, std::ios::binary );
+		content.assign( std::istreambuf_iterator< char >( in ), std::istreambuf_iterator< char >() );
+	}
+	{
+		std::ofstream out( recordingFile, std::ios::binary | std::ios::trunc );
+		out.write( &content[ 0 ], content.size() - 10 );
+	}
+	RecordingReader< Math::Pose > reader( recordingFile );
+	BOOST_CHECK_EQUAL( reader.size(), 9900u );
+}
+
+void testVariableSize()
+{
+	const std::size_t n = 500;
+	std::vector< Measurement::PositionList > lists;
+	{
+		// slots with room for the largest list, so pushing does not allocate
+		std::vector< Math::Vector< double, 3 > > prototype;
+		prototype.reserve( 20 );
+		RecordingWriter< std::vector< Math::Vector< double, 3 > > > writer( recordingFile, 64, 1024, 0.001, prototype );
+		for ( std::size_t i = 0; i < n; i++ )
+		{
+			std::vector< Math::Vector< double, 3 > > list( rand() % 20 );
+			for ( std::size_t j = 0; j < list.size(); j++ )
+				list[ j ] = randomVector< double, 3 >( 5.0 );
+			lists.push_back( Measurement::PositionList( 100 * ( i + 1 ), list ) );
+			BOOST_CHECK( writer.push( lists.back() ) );
+		}
+
+		// out-of-order measurements are dropped
+		writer.push( 50, std::vector< Math::Vector< double, 3 > >() );
+		writer.close();
+		BOOST_CHECK_EQUAL( writer.written(), n );
+		BOOST_CHECK_EQUAL( writer.dropped(), 1u );
+	}
+
+	RecordingReader< std::vector< Math::Vector< double, 3 > > > reader( recordingFile );
+	BOOST_REQUIRE_EQUAL( reader.size(), n );
+	for ( std::size_t i = 0; i < n; i += 7 )
+	{
+		RecordingReader< std::vector< Math::Vector< double, 3 > > >::const_iterator it = reader.seek( 100 * ( i + 1 ) - 50 );
+		BOOST_REQUIRE( it != reader.end() );
+		BOOST_CHECK_EQUAL( it.time(), lists[ i ].time() );
+		const Measurement::PositionList m( it.measurement() );
+		BOOST_REQUIRE_EQUAL( m->size(), lists[ i ]->size() );
+		for ( std::size_t j = 0; j < m->size(); j++ )
+			BOOST_CHECK( ( *m )[ j ] == ( *lists[ i ] )[ j ] );
+	}
+	BOOST_CHECK( reader.seek( 100 * n + 1 ) == reader.end() );
+}
+
+void testCorruptOffsets()
+{
+	// walk the chunks of the file written by testVariableSize
+	std::vector< char > content;
+	{
+		std::ifstream in( recordingFile, std::ios::binary );
+		content.assign( std::istreambuf_iterator< char >( in ), std::istreambuf_iterator< char >() );
+	}
+	const char chunkMagic[ 4 ] = { 'U', 'T', 'C', 'K' };
+	std::size_t pos = std::search( content.begin(), content.end(), chunkMagic, chunkMagic + 4 ) - content.begin();
+	BOOST_REQUIRE( pos < content.size() );
+	std::size_t lastChunk = pos;
+	while ( pos < content.size() )
+	{
+		lastChunk = pos;
+		boost::uint64_t size;
+		std::memcpy( &size, &content[ pos + 8 ], sizeof( size ) );
+		pos += static_cast< std::size_t >( size );
+	}
+
+	// record offsets that decrease but stay within the chunk invalidate the last chunk
+	boost::uint32_t count;
+	std::memcpy( &count, &content[ lastChunk + 4 ], sizeof( count ) );
+	BOOST_REQUIRE( count > 1 );
+	const std::size_t offsetsPos = lastChunk + 32 + count * sizeof( boost::uint64_t );
+	boost::uint64_t offsets[ 3 ];
+	std::memcpy( offsets, &content[ offsetsPos ], sizeof( offsets ) );
+	offsets[ 1 ] = offsets[ 2 ] + 8;
+	std::memcpy( &content[ offsetsPos ], offsets, sizeof( offsets ) );
+	{
+		std::ofstream out( recordingFile, std::ios::binary | std::ios::trunc );
+		out.write( &content[ 0 ], content.size() );
+	}
+
+	RecordingReader< std::vector< Math::Vector< double, 3 > > > reader( recordingFile );
+	BOOST_CHECK_EQUAL( reader.size(), 500u - count );
+}
+
+} // anonymous namespace
+
+void TestMeasurementRecording()
+{
+	testFixedSize();
+	testTruncated();
+	testVariableSize();
+	testCorruptOffsets();
+	std::remove( recordingFile );
+}
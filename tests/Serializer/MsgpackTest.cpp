@@ -208,6 +208,152 @@ void testSerializeMultiple()
 }
 
 
+template< typename T >
+void unpack(const msgpack::sbuffer& buffer, T& result)
+{
+    msgpack::unpacker pac;
+    pac.reserve_buffer(buffer.size());
+    memcpy(pac.buffer(), buffer.data(), buffer.size() );
+    pac.buffer_consumed(buffer.size());
+    MsgpackArchive::deserialize(pac, result);
+}
+
+void testBulkEncoding()
+{
+    // lists are written as one blob and are much smaller than the per-element array encoding
+    std::vector< Math::Vector< double, 3 > > positions;
+    std::vector< Math::Pose > poses;
+    for (std::size_t i = 0; i < 100; ++i) {
+        positions.push_back(randomVector<double, 3>(5.0));
+        poses.push_back(Math::Pose(randomQuaternion(), randomVector<double, 3>(5.0)));
+    }
+
+    msgpack::sbuffer bulk;
+    msgpack::packer<msgpack::sbuffer> pk(&bulk);
+    MsgpackArchive::serialize(pk, positions);
+
+    msgpack::sbuffer legacy;
+    msgpack::packer<msgpack::sbuffer> lpk(&legacy);
+    lpk.pack_array((uint32_t)positions.size());
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        lpk.pack_array(3);
+        for (std::size_t j = 0; j < 3; ++j)
+            lpk.pack(positions[i](j));
+    }
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+    BOOST_CHECK(bulk.size() < legacy.size());
+#endif
+
+    // both encodings are readable
+    std::vector< Math::Vector< double, 3 > > r_positions;
+    unpack(bulk, r_positions);
+    BOOST_CHECK(r_positions == positions);
+    r_positions.clear();
+    unpack(legacy, r_positions);
+    BOOST_CHECK(r_positions == positions);
+
+    // but checked for the right shape
+    std::vector< Math::Vector< double, 4 > > wrongShape;
+    BOOST_CHECK_THROW(unpack(bulk, wrongShape), msgpack::type_error);
+
+    msgpack::sbuffer poseBuffer;
+    msgpack::packer<msgpack::sbuffer> ppk(&poseBuffer);
+    MsgpackArchive::serialize(ppk, poses);
+    std::vector< Math::Pose > r_poses;
+    unpack(poseBuffer, r_poses);
+    BOOST_CHECK_EQUAL(poses.size(), r_poses.size());
+    for (std::size_t i = 0; i < poses.size(); ++i)
+        BOOST_CHECK_EQUAL(poses[i], r_poses[i]);
+
+    // also through msgpack's as<>, which is used for lists of types with an as<> adaptor
+    std::size_t offset = 0;
+    msgpack::object_handle poseHandle = msgpack::unpack(poseBuffer.data(), poseBuffer.size(), offset);
+    const std::vector< Math::Pose > as_poses = poseHandle.get().as< std::vector< Math::Pose > >();
+    BOOST_CHECK_EQUAL(poses.size(), as_poses.size());
+    for (std::size_t i = 0; i < poses.size(); ++i)
+        BOOST_CHECK_EQUAL(poses[i], as_poses[i]);
+
+    // dynamically sized and non-square matrices
+    Math::Matrix< double, 3, 4 > v_mat34;
+    randomMatrix(v_mat34);
+    testSerializeSimple(v_mat34);
+
+#ifndef UBITRACK_MSGPACK_ARRAY_ENCODING
+    Math::Matrix< double, 0, 0 > v_matd(5, 7);
+    randomMatrix(v_matd);
+    msgpack::sbuffer matrixBuffer;
+    msgpack::packer<msgpack::sbuffer> mpk(&matrixBuffer);
+    MsgpackArchive::serialize(mpk, v_matd);
+    Math::Matrix< double, 0, 0 > r_matd;
+    unpack(matrixBuffer, r_matd);
+    BOOST_CHECK_EQUAL(r_matd.size1(), 5u);
+    BOOST_CHECK_EQUAL(r_matd.size2(), 7u);
+    BOOST_CHECK(std::equal(v_matd.data().begin(), v_matd.data().end(), r_matd.data().begin()));
+#endif
+
+    // element types are converted when they differ
+    Math::Vector< float, 3 > v_vec3f(1.5f, -2.25f, 3.0f);
+    msgpack::sbuffer floatBuffer;
+    msgpack::packer<msgpack::sbuffer> fpk(&floatBuffer);
+    MsgpackArchive::serialize(fpk, v_vec3f);
+    Math::Vector< double, 3 > r_vec3d;
+    unpack(floatBuffer, r_vec3d);
+    const Math::Vector< double, 3 > v_vec3d(1.5, -2.25, 3.0);
+    BOOST_CHECK_EQUAL(r_vec3d, v_vec3d);
+}
+
+/** packs a bulk ext object with a rank 2 header and the given payload size */
+msgpack::sbuffer malformedBulk(const unsigned char code, const uint32_t rows, const uint32_t cols, const std::size_t payload)
+{
+    std::vector< char > ext(12 + payload, 0);
+    ext[0] = char(code);
+    ext[1] = 2;
+    for (std::size_t i = 0; i < 4; ++i) {
+        ext[4 + i] = char(rows >> (8 * i));
+        ext[8 + i] = char(cols >> (8 * i));
+    }
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> pk(&buffer);
+    pk.pack_ext(ext.size(), MsgpackArchive::bulkExtType);
+    pk.pack_ext_body(&ext[0], (uint32_t)ext.size());
+    return buffer;
+}
+
+void testMalformedBulk()
+{
+    std::vector< Math::Vector< double, 3 > > positions;
+    std::vector< Math::Vector< double, 0 > > dynamicPositions;
+    std::vector< Math::Pose > poses;
+
+    // well-formed reference: two rows of three doubles
+    unpack(malformedBulk(0x18, 2, 3, 48), positions);
+    BOOST_CHECK_EQUAL(positions.size(), 2u);
+
+    // unknown type codes, also for empty lists
+    BOOST_CHECK_THROW(unpack(malformedBulk(0x1f, 2, 3, 90), positions), msgpack::type_error);
+    BOOST_CHECK_THROW(unpack(malformedBulk(0x13, 2, 3, 18), positions), msgpack::type_error);
+    BOOST_CHECK_THROW(unpack(malformedBulk(0x00, 0, 3, 0), positions), msgpack::type_error);
+
+    // dimensions that do not match the payload, including overflowing products
+    BOOST_CHECK_THROW(unpack(malformedBulk(0x18, 0xffffffffu, 3, 48), positions), msgpack::type_error);
+    BOOST_CHECK_THROW(unpack(malformedBulk(0x18, 0x80000000u, 0x80000000u, 0), dynamicPositions), msgpack::type_error);
+    BOOST_CHECK_THROW(unpack(malformedBulk(0x18, 0xffffffffu, 7, 56), poses), msgpack::type_error);
+
+    // empty rows are not bounded by the payload
+    BOOST_CHECK_THROW(unpack(malformedBulk(0x18, 0xffffffffu, 0, 0), dynamicPositions), msgpack::type_error);
+
+    // lists of empty vectors still round-trip
+    dynamicPositions.assign(3, Math::Vector< double, 0 >());
+    msgpack::sbuffer emptyRows;
+    msgpack::packer<msgpack::sbuffer> pk(&emptyRows);
+    MsgpackArchive::serialize(pk, dynamicPositions);
+    dynamicPositions.clear();
+    unpack(emptyRows, dynamicPositions);
+    BOOST_CHECK_EQUAL(dynamicPositions.size(), 3u);
+}
+
+
+
 
 #endif // HAVE_MSGPACK
 
@@ -318,6 +464,10 @@ void TestMsgpack()
 
     // test serializing multiple objects in astream
     testSerializeMultiple();
+
+    // test the bulk encoding of numeric arrays
+    testBulkEncoding();
+    testMalformedBulk();
     
 #endif // HAVE_MSGPACK
 }
@@ -3,10 +3,16 @@
 // declare external tests here, to save us some trivial header files
 void TestBoostArchive();
 void TestMsgpack();
+void TestBufferSerialization();
+void TestMeasurementRecording();
+void TestCalibContainer();
 
 SerializerTest::SerializerTest()
 	: boost::unit_test::test_suite( "SerializerTests" )
 {
 	add( BOOST_TEST_CASE( &TestBoostArchive ) );
     add( BOOST_TEST_CASE( &TestMsgpack ) );
+    add( BOOST_TEST_CASE( &TestBufferSerialization ) );
+    add( BOOST_TEST_CASE( &TestMeasurementRecording ) );
+    add( BOOST_TEST_CASE( &TestCalibContainer ) );
 }
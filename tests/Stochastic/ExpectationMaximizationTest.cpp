@@ -3,10 +3,15 @@
 #include <utMath/Random/Scalar.h>
 #include <utMath/Random/Vector.h>
 #include <utMath/Stochastic/expectation_maximization.h>
+#include <utMath/Stochastic/expectation_maximization_blocked.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& emLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.ExpectationMaximization" ) );
+
 using namespace Ubitrack::Math;
 
 template< typename T >
@@ -85,3 +90,132 @@ void TestExpectationMaximization()
 	testBasicExpectationMaximization< double >( 10, 10000, 5 );
 	testBasicExpectationMaximization< float >( 10, 10000, 5 );
 }
+
+/** draws values from well separated clusters and starts the estimation from disturbed components */
+template< typename T, std::size_t N >
+void generateClusters( const std::size_t cluster, const std::size_t n, const T sigma,
+	std::vector< Vector< T, N > >& values, std::vector< Stochastic::Weighted< Stochastic::Gaussian< T, N >, T > >& mixture,
+	std::vector< Vector< T, N > >& centers )
+{
+	typename Random::Vector< T, N >::Uniform randCenters( -20, 20 );
+	centers.clear();
+	for( std::size_t c = 0; c < cluster; ++c )
+		centers.push_back( randCenters() );
+
+	values.clear();
+	values.reserve( n );
+	for( std::size_t i = 0; i < n; ++i )
+		values.push_back( centers[ i % cluster ] + Random::distribute_normal< T, N >( 0, sigma ) );
+
+	mixture.assign( cluster, Stochastic::Weighted< Stochastic::Gaussian< T, N >, T >() );
+	for( std::size_t c = 0; c < cluster; ++c )
+	{
+		mixture[ c ].weight = 1 / static_cast< T >( cluster );
+		std::fill( mixture[ c ].covariance, mixture[ c ].covariance + N * N, static_cast< T >( 0 ) );
+		for( std::size_t i = 0; i < N; ++i )
+		{
+			mixture[ c ].mean[ i ] = centers[ c ][ i ] + Random::distribute_uniform< T >( -1, 1 );
+			mixture[ c ].covariance[ i * N + i ] = 4;
+		}
+	}
+}
+
+template< typename T, std::size_t N >
+void testBlockedExpectationMaximization( const std::size_t n, const bool diagonal, const std::size_t threads )
+{
+	const std::size_t cluster = 3;
+	const T sigma = static_cast< T >( 0.5 );
+	std::vector< Vector< T, N > > values;
+	std::vector< Vector< T, N > > centers;
+	std::vector< Stochastic::Weighted< Stochastic::Gaussian< T, N >, T > > mixture;
+	generateClusters< T, N >( cluster, n, sigma, values, mixture, centers );
+
+	const Stochastic::ExpectationMaximizationParameter< T > params( 100, static_cast< T >( 1e-6 ), threads, diagonal );
+	const T likelihood = Stochastic::expectation_maximization_blocked( values.begin(), values.end(), mixture.begin(), mixture.end(), params );
+	BOOST_CHECK_CLOSE( likelihood, Stochastic::log_likelihood_blocked( mixture.begin(), mixture.end(), values.begin(), values.end(), params ), 1e-2 );
+
+	// the mixture of the true clusters has the likelihood -N/2 * ( 1 + log( 2 pi sigma^2 ) ) - log( cluster )
+	const T expected = -static_cast< T >( N ) / 2 * ( 1 + std::log( 2 * static_cast< T >( 3.14159265358979 ) * sigma * sigma ) ) - std::log( static_cast< T >( cluster ) );
+	BOOST_CHECK_SMALL( likelihood - expected, static_cast< T >( 0.05 * N ) );
+
+	for( std::size_t c = 0; c < cluster; ++c )
+	{
+		BOOST_CHECK_CLOSE( mixture[ c ].weight, 1 / static_cast< T >( cluster ), 5 );
+		for( std::size_t i = 0; i < N; ++i )
+		{
+			BOOST_CHECK_SMALL( mixture[ c ].mean[ i ] - centers[ c ][ i ], static_cast< T >( 0.1 ) );
+			BOOST_CHECK_CLOSE( mixture[ c ].covariance[ i * N + i ], sigma * sigma, 20 );
+			for( std::size_t j = 0; j < N; ++j )
+				if( i != j )
+				{
+					BOOST_CHECK_SMALL( mixture[ c ].covariance[ i * N + j ], static_cast< T >( 0.05 ) );
+					if( diagonal )
+						BOOST_CHECK_EQUAL( mixture[ c ].covariance[ i * N + j ], 0 );
+				}
+		}
+	}
+}
+
+template< typename T >
+void testBlockedExpectationMaximizationNonFinite()
+{
+	// identical values and no regularization: the first M-step yields a singular covariance
+	const std::vector< Vector< T, 2 > > values( 10, Vector< T, 2 >( 1, 2 ) );
+	std::vector< Stochastic::Weighted< Stochastic::Gaussian< T, 2 >, T > > mixture( 1 );
+	mixture[ 0 ].weight = 1;
+	std::fill( mixture[ 0 ].mean, mixture[ 0 ].mean + 2, static_cast< T >( 0 ) );
+	std::fill( mixture[ 0 ].covariance, mixture[ 0 ].covariance + 4, static_cast< T >( 0 ) );
+	mixture[ 0 ].covariance[ 0 ] = mixture[ 0 ].covariance[ 3 ] = 1;
+
+	// the values have zero probability afterwards, the M-step changes nothing anymore and
+	// EM has to stop instead of running all (here practically endless) iterations
+	const Stochastic::ExpectationMaximizationParameter< T > params( 1000000000, static_cast< T >( 1e-6 ), 1, false, 0 );
+	const T likelihood = Stochastic::expectation_maximization_blocked( values.begin(), values.end(), mixture.begin(), mixture.end(), params );
+	BOOST_CHECK_EQUAL( likelihood, -std::numeric_limits< T >::infinity() );
+	BOOST_CHECK_EQUAL( mixture[ 0 ].weight, 0 );
+	BOOST_CHECK_SMALL( mixture[ 0 ].mean[ 0 ] - 1, static_cast< T >( 1e-6 ) );
+	BOOST_CHECK_SMALL( mixture[ 0 ].mean[ 1 ] - 2, static_cast< T >( 1e-6 ) );
+}
+
+void testBlockedExpectationMaximizationTiming( const std::size_t n )
+{
+	std::vector< Vector< double, 3 > > values;
+	std::vector< Vector< double, 3 > > centers;
+	std::vector< Stochastic::Weighted< Stochastic::Gaussian< double, 3 >, double > > mixture;
+	generateClusters< double, 3 >( 4, n, 1.0, values, mixture, centers );
+	std::vector< Stochastic::Weighted< Stochastic::Gaussian< double, 3 >, double > > mixture2( mixture );
+
+	Ubitrack::Util::BlockTimer oldTimer( "expectation_maximization", emLogger );
+	Ubitrack::Util::BlockTimer blockedTimer( "expectation_maximization_blocked", emLogger );
+	{
+		UBITRACK_TIME( oldTimer );
+		Stochastic::expectation_maximization( values.begin(), values.end(), mixture.begin(), mixture.end() );
+	}
+	{
+		UBITRACK_TIME( blockedTimer );
+		Stochastic::expectation_maximization_blocked( values.begin(), values.end(), mixture2.begin(), mixture2.end(),
+			Stochastic::ExpectationMaximizationParameter< double >( 100, 1e-5, 0 ) );
+	}
+	// both converge to the same components
+	for( std::size_t c = 0; c < mixture.size(); ++c )
+		for( std::size_t i = 0; i < 3; ++i )
+			BOOST_CHECK_SMALL( mixture[ c ].mean[ i ] - mixture2[ c ].mean[ i ], 0.01 );
+	BOOST_TEST_MESSAGE( n << " values: expectation_maximization " << oldTimer.getTotalTime() << "ms, expectation_maximization_blocked "
+		<< blockedTimer.getTotalTime() << "ms" );
+}
+
+void TestExpectationMaximizationBlocked()
+{
+	testBlockedExpectationMaximization< double, 2 >( 3000, false, 1 );
+	testBlockedExpectationMaximization< double, 2 >( 3000, true, 1 );
+	testBlockedExpectationMaximization< double, 3 >( 20000, false, 4 );
+	testBlockedExpectationMaximization< float, 3 >( 6000, false, 1 );
+
+	// the densities of distant components underflow to zero here
+	testBlockedExpectationMaximization< double, 40 >( 6000, false, 2 );
+	testBlockedExpectationMaximization< double, 40 >( 6000, true, 1 );
+
+	testBlockedExpectationMaximizationNonFinite< double >();
+
+	testBlockedExpectationMaximizationTiming( 50000 );
+}
@@ -3,10 +3,15 @@
 #include <utMath/Random/Scalar.h>
 #include <utMath/Random/Vector.h>
 #include <utMath/Stochastic/k_means.h>
+#include <utMath/Stochastic/k_means_accelerated.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& kmeansLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.KMeans" ) );
+
 using namespace Ubitrack::Math;
 
 template< typename T >
@@ -61,3 +66,141 @@ void TestKMeans()
 	testBasicKMeans< double >( 10, 10000, 5 );
 	testBasicKMeans< float >( 10, 10000, 5 );
 }
+
+/** draws points around some well separated cluster centers */
+template< typename T, std::size_t N >
+void generateClusters( const std::size_t n, const std::size_t n_cluster, std::vector< Vector< T, N > >& centers, std::vector< Vector< T, N > >& points )
+{
+	typename Random::Vector< T, N >::Uniform randCenter( -100, 100 );
+	centers.clear();
+	while( centers.size() < n_cluster )
+	{
+		const Vector< T, N > c( randCenter() );
+		bool separated = true;
+		for( std::size_t k = 0; k < centers.size(); ++k )
+			separated = separated && Norm_2()( Vector< T, N >( c - centers[ k ] ) ) > 20;
+		if( separated )
+			centers.push_back( c );
+	}
+
+	points.clear();
+	points.reserve( n );
+	for( std::size_t i = 0; i < n; ++i )
+		points.push_back( centers[ i % n_cluster ] + Random::distribute_normal< T, N >( 0, 2 ) );
+}
+
+/** checks that every point belongs to the closest centroid and every centroid is the mean of its points */
+template< typename T, std::size_t N >
+void checkLloydFixedPoint( const std::vector< Vector< T, N > >& points, const std::vector< Vector< T, N > >& centroids, const std::vector< std::size_t >& indices, const T epsilon )
+{
+	std::vector< Vector< T, N > > sums( centroids.size(), Vector< T, N >::zeros() );
+	std::vector< std::size_t > counts( centroids.size(), 0 );
+	std::size_t wrong( 0 );
+	for( std::size_t i = 0; i < points.size(); ++i )
+	{
+		const T d = Norm_2()( Vector< T, N >( points[ i ] - centroids[ indices[ i ] ] ) );
+		for( std::size_t k = 0; k < centroids.size(); ++k )
+			if( Norm_2()( Vector< T, N >( points[ i ] - centroids[ k ] ) ) < d - epsilon )
+				wrong++;
+		sums[ indices[ i ] ] += points[ i ];
+		counts[ indices[ i ] ]++;
+	}
+	BOOST_CHECK_EQUAL( wrong, 0u );
+
+	for( std::size_t k = 0; k < centroids.size(); ++k )
+		if( counts[ k ] )
+		{
+			const Vector< T, N > mean( sums[ k ] / static_cast< T >( counts[ k ] ) );
+			BOOST_CHECK_SMALL( Norm_2()( Vector< T, N >( mean - centroids[ k ] ) ), epsilon );
+		}
+}
+
+template< typename T, std::size_t N >
+void testAcceleratedKMeans( const std::size_t n, const std::size_t n_cluster, const T epsilon )
+{
+	std::vector< Vector< T, N > > centers;
+	std::vector< Vector< T, N > > points;
+	generateClusters( n, n_cluster, centers, points );
+
+	std::vector< Vector< T, N > > seeds;
+	Stochastic::copy_probability( points.begin(), points.end(), n_cluster, std::back_inserter( seeds ), SquaredDistance< Vector< T, N > >() );
+
+	Ubitrack::Util::BlockTimer lloydTimer( "Lloyd", kmeansLogger );
+	Ubitrack::Util::BlockTimer hamerlyTimer( "Hamerly", kmeansLogger );
+	Ubitrack::Util::BlockTimer parallelTimer( "Hamerly parallel", kmeansLogger );
+	Ubitrack::Util::BlockTimer batchTimer( "mini-batch", kmeansLogger );
+
+	// the original implementation
+	std::vector< Vector< T, N > > lloyd( seeds );
+	std::vector< std::size_t > lloydIndices;
+	{
+		UBITRACK_TIME( lloydTimer );
+		Stochastic::k_means( points.begin(), points.end(), lloyd.begin(), lloyd.end(), std::back_inserter( lloydIndices ), SquaredDistance< Vector< T, N > >() );
+	}
+
+	// Hamerly, single and multi-threaded from the same seeds
+	std::vector< Vector< T, N > > hamerly( seeds );
+	std::vector< std::size_t > hamerlyIndices;
+	{
+		UBITRACK_TIME( hamerlyTimer );
+		Stochastic::k_means_hamerly( points.begin(), points.end(), hamerly.begin(), hamerly.end(), std::back_inserter( hamerlyIndices ), Stochastic::KMeansParameter< T >() );
+	}
+	checkLloydFixedPoint( points, hamerly, hamerlyIndices, epsilon );
+
+	// the bounds only skip distance computations, with the stopping threshold of k_means()
+	// the result is the one of Lloyd's algorithm
+	std::vector< Vector< T, N > > hamerlyLloyd( seeds );
+	std::vector< std::size_t > hamerlyLloydIndices;
+	Stochastic::k_means_hamerly( points.begin(), points.end(), hamerlyLloyd.begin(), hamerlyLloyd.end(), std::back_inserter( hamerlyLloydIndices ), Stochastic::KMeansParameter< T >( 100, T( 1e-4 ) ) );
+	BOOST_CHECK( hamerlyLloydIndices == lloydIndices );
+	for( std::size_t k = 0; k < n_cluster; ++k )
+		BOOST_CHECK_SMALL( Norm_2()( Vector< T, N >( hamerlyLloyd[ k ] - lloyd[ k ] ) ), epsilon );
+
+	std::vector< Vector< T, N > > parallel( seeds );
+	std::vector< std::size_t > parallelIndices;
+	{
+		UBITRACK_TIME( parallelTimer );
+		Stochastic::k_means_hamerly( points.begin(), points.end(), parallel.begin(), parallel.end(), std::back_inserter( parallelIndices ), Stochastic::KMeansParameter< T >( 100, 0, 4 ) );
+	}
+	checkLloydFixedPoint( points, parallel, parallelIndices, epsilon );
+	for( std::size_t k = 0; k < n_cluster; ++k )
+		BOOST_CHECK_SMALL( Norm_2()( Vector< T, N >( parallel[ k ] - hamerly[ k ] ) ), epsilon );
+
+	// mini-batch from disturbed cluster centers, only approximately at the cluster centers
+	std::vector< Vector< T, N > > batch;
+	for( std::size_t k = 0; k < n_cluster; ++k )
+		batch.push_back( centers[ k ] + Random::distribute_normal< T, N >( 0, 1 ) );
+	std::vector< std::size_t > batchIndices;
+	{
+		UBITRACK_TIME( batchTimer );
+		Stochastic::k_means_mini_batch( points.begin(), points.end(), batch.begin(), batch.end(), std::back_inserter( batchIndices ), Stochastic::KMeansParameter< T >( 100, 0, 4, 1000 ) );
+	}
+	BOOST_CHECK_EQUAL( batchIndices.size(), n );
+	for( std::size_t k = 0; k < n_cluster; ++k )
+		BOOST_CHECK_SMALL( Norm_2()( Vector< T, N >( batch[ k ] - centers[ k ] ) ), T( 0.5 ) );
+
+	// complete algorithm including seeding
+	std::vector< Vector< T, N > > centroids;
+	std::vector< std::size_t > indices;
+	Stochastic::k_means_accelerated( points.begin(), points.end(), n_cluster, std::back_inserter( centroids ), std::back_inserter( indices ), Stochastic::KMeansParameter< T >( 100, 0, 0 ) );
+	BOOST_CHECK_EQUAL( centroids.size(), n_cluster );
+	checkLloydFixedPoint( points, centroids, indices, epsilon );
+
+	// no clusters or no elements
+	std::vector< Vector< T, N > > none;
+	BOOST_CHECK_THROW( Stochastic::k_means_accelerated( points.begin(), points.end(), 0, std::back_inserter( centroids ), std::back_inserter( indices ), Stochastic::KMeansParameter< T >() ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Stochastic::k_means_accelerated( none.begin(), none.end(), n_cluster, std::back_inserter( centroids ), std::back_inserter( indices ), Stochastic::KMeansParameter< T >() ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Stochastic::k_means_hamerly( none.begin(), none.end(), hamerly.begin(), hamerly.end(), std::back_inserter( indices ), Stochastic::KMeansParameter< T >() ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Stochastic::k_means_hamerly( points.begin(), points.end(), hamerly.begin(), hamerly.begin(), std::back_inserter( indices ), Stochastic::KMeansParameter< T >() ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Stochastic::k_means_mini_batch( none.begin(), none.end(), batch.begin(), batch.end(), std::back_inserter( indices ), Stochastic::KMeansParameter< T >( 100, 0, 1, 10 ) ), Ubitrack::Util::Exception );
+	BOOST_CHECK_THROW( Stochastic::k_means_mini_batch( points.begin(), points.end(), batch.begin(), batch.begin(), std::back_inserter( indices ), Stochastic::KMeansParameter< T >( 100, 0, 1, 10 ) ), Ubitrack::Util::Exception );
+
+	BOOST_TEST_MESSAGE( n << " points, " << n_cluster << " clusters: Lloyd " << lloydTimer.getTotalTime() << "ms, Hamerly "
+		<< hamerlyTimer.getTotalTime() << "ms, with 4 threads " << parallelTimer.getTotalTime() << "ms, mini-batch " << batchTimer.getTotalTime() << "ms" );
+}
+
+void TestKMeansAccelerated()
+{
+	testAcceleratedKMeans< double, 3 >( 100000, 20, 1e-6 );
+	testAcceleratedKMeans< float, 2 >( 20000, 10, 1e-2f );
+}
@@ -0,0 +1,175 @@
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Stochastic/Kalman.h>
+#include <utMath/Stochastic/KalmanFilter.h>
+#include <utMath/Stochastic/CovarianceTransform.h>
+#include <utMath/Optimization/Function/VectorNormalize.h>
+
+#include "../tools.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& kalmanLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.KalmanFilter" ) );
+
+using namespace Ubitrack::Math;
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+/** a linear measurement function y = A x */
+template< std::size_t M, std::size_t K >
+struct LinearMeasurement
+{
+	Matrix< double, M, K > a;
+
+	template< class VT1, class VT2, class MT >
+	void evaluateWithJacobian( VT1& result, const VT2& input, MT& jacobian ) const
+	{
+		result = ublas::prod( a, input );
+		jacobian = a;
+	}
+};
+
+/** frobenius norm of the difference of two matrices */
+template< class M1, class M2 >
+double difference( const M1& a, const M2& b )
+{
+	return ublas::norm_frobenius( a - b );
+}
+
+/** random symmetric positive definite matrix */
+template< std::size_t N >
+Matrix< double, N, N > randomCovariance( const double scale )
+{
+	Matrix< double, N, N > a;
+	for ( std::size_t i = 0; i < N; i++ )
+		for ( std::size_t j = 0; j < N; j++ )
+			a( i, j ) = random( -1.0, 1.0 );
+	Matrix< double, N, N > p( ublas::prod( a, ublas::trans( a ) ) );
+	for ( std::size_t i = 0; i < N; i++ )
+		p( i, i ) += 0.1;
+	return p * scale;
+}
+
+template< std::size_t N, std::size_t M, std::size_t K >
+void testMeasurementUpdate( const std::size_t n_runs )
+{
+	for ( std::size_t iRun = 0; iRun < n_runs; iRun++ )
+	{
+		Stochastic::KalmanFilter< double, N > filter( randomVector< double, N >( 1.0 ), randomCovariance< N >( 1.0 ) );
+		Vector< double > state( filter.state() );
+		Matrix< double, 0, 0 > covariance( filter.covariance() );
+
+		LinearMeasurement< M, K > f;
+		for ( std::size_t i = 0; i < M; i++ )
+			for ( std::size_t j = 0; j < K; j++ )
+				f.a( i, j ) = random( -1.0, 1.0 );
+		const Vector< double, M > z( randomVector< double, M >( 1.0 ) );
+		const Matrix< double, M, M > r( randomCovariance< M >( 0.1 ) );
+		const std::size_t iBegin = rand() % ( N - K + 1 );
+
+		const bool bUpdated = filter.template measurementUpdate< K >( f, z, r, iBegin );
+		BOOST_CHECK( bUpdated );
+		Stochastic::kalmanMeasurementUpdate( state, covariance, f, z, r, iBegin, iBegin + K );
+
+		BOOST_CHECK_SMALL( ublas::norm_2( filter.state() - state ), 1e-9 );
+		BOOST_CHECK_SMALL( difference( filter.covariance(), covariance ), 1e-9 );
+		BOOST_CHECK_EQUAL( difference( filter.covariance(), ublas::trans( filter.covariance() ) ), 0.0 );
+
+		// identity measurement on the external storage
+		const std::size_t iIdentity = rand() % ( N - M + 1 );
+		const bool bIdentityUpdated = Stochastic::KalmanFilter< double, N >::measurementUpdateIdentity( state, covariance, z, r, iIdentity );
+		BOOST_CHECK( bIdentityUpdated );
+		Vector< double, N > state2( filter.state() );
+		Matrix< double, N, N > covariance2( filter.covariance() );
+		Stochastic::kalmanMeasurementUpdateIdentity( state2, covariance2, z, r, iIdentity, iIdentity + M );
+		BOOST_CHECK_SMALL( ublas::norm_2( state - state2 ), 1e-9 );
+		BOOST_CHECK_SMALL( difference( covariance, covariance2 ), 1e-9 );
+	}
+}
+
+void testTransformRange()
+{
+	const std::size_t N = 7;
+	Stochastic::KalmanFilter< double, N > filter( randomVector< double, N >( 1.0 ), randomCovariance< N >( 1.0 ) );
+	Vector< double, N > state( filter.state() );
+	Matrix< double, N, N > covariance( filter.covariance() );
+
+	filter.template transformRange< 4, 4 >( Optimization::Function::VectorNormalize( 4 ), 2, 2 );
+	Stochastic::transformRangeInternalWithCovariance( Optimization::Function::VectorNormalize( 4 ), state, covariance, 2, 6, 2, 6 );
+	BOOST_CHECK_SMALL( ublas::norm_2( filter.state() - state ), 1e-12 );
+	BOOST_CHECK_SMALL( difference( filter.covariance(), covariance ), 1e-12 );
+
+	// overlapping ranges
+	LinearMeasurement< 3, 5 > f;
+	randomMatrix( f.a );
+	filter.template transformRange< 3, 5 >( f, 1, 0 );
+	Stochastic::transformRangeInternalWithCovariance( f, state, covariance, 1, 4, 0, 5 );
+	BOOST_CHECK_SMALL( ublas::norm_2( filter.state() - state ), 1e-9 );
+	BOOST_CHECK_SMALL( difference( filter.covariance(), covariance ) / double( ublas::norm_frobenius( covariance ) ), 1e-12 );
+}
+
+/** a badly conditioned measurement which makes the standard covariance update indefinite */
+void testJosephForm()
+{
+	Stochastic::KalmanFilter< double, 2 > filter( Vector< double, 2 >( 0, 0 ), Matrix< double, 2, 2 >::identity() * 1e8 );
+	Matrix< double, 1, 1 > r;
+	r( 0, 0 ) = 1e-8;
+	LinearMeasurement< 1, 2 > f;
+	f.a( 0, 0 ) = 1;
+	f.a( 0, 1 ) = 1;
+	Vector< double, 1 > z;
+	z( 0 ) = 1;
+	for ( std::size_t i = 0; i < 10; i++ )
+		filter.template measurementUpdate< 2 >( f, z, r );
+
+	const Matrix< double, 2, 2 >& p( filter.covariance() );
+	BOOST_CHECK( p( 0, 0 ) > 0 && p( 1, 1 ) > 0 );
+	BOOST_CHECK( p( 0, 0 ) * p( 1, 1 ) - p( 0, 1 ) * p( 1, 0 ) >= -1e-6 * p( 0, 0 ) * p( 1, 1 ) );
+	BOOST_CHECK_CLOSE( filter.state()( 0 ) + filter.state()( 1 ), 1.0, 1e-4 );
+}
+
+void testTiming( const std::size_t n )
+{
+	const std::size_t N = 13;
+	Stochastic::KalmanFilter< double, N > filter( randomVector< double, N >( 1.0 ), randomCovariance< N >( 1.0 ) );
+	Vector< double > state( filter.state() );
+	Matrix< double, 0, 0 > covariance( filter.covariance() );
+	const Vector< double, 7 > z( randomVector< double, 7 >( 1.0 ) );
+	const Matrix< double, 7, 7 > r( randomCovariance< 7 >( 0.01 ) );
+	const Matrix< double, N, N > q( Matrix< double, N, N >::identity() * 0.01 );
+
+	Ubitrack::Util::BlockTimer fixedTimer( "KalmanFilter", kalmanLogger );
+	Ubitrack::Util::BlockTimer dynamicTimer( "kalmanMeasurementUpdate", kalmanLogger );
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		{
+			UBITRACK_TIME( fixedTimer );
+			filter.measurementUpdateIdentity( z, r, 3 );
+		}
+		{
+			UBITRACK_TIME( dynamicTimer );
+			Stochastic::kalmanMeasurementUpdateIdentity( state, covariance, z, r, 3, 10 );
+		}
+		filter.covariance() += q;
+		covariance += q;
+	}
+	BOOST_CHECK_SMALL( ublas::norm_2( filter.state() - state ), 1e-6 );
+	BOOST_TEST_MESSAGE( "13x13 state, 7x7 measurement: KalmanFilter " << fixedTimer.getTotalTime() * 1000.0 / n
+		<< "us, kalmanMeasurementUpdateIdentity " << dynamicTimer.getTotalTime() * 1000.0 / n << "us per update" );
+}
+
+} // anonymous namespace
+
+void TestKalmanFilter()
+{
+	testMeasurementUpdate< 7, 4, 7 >( 100 );
+	testMeasurementUpdate< 13, 7, 10 >( 100 );
+	testMeasurementUpdate< 13, 3, 7 >( 100 );
+	testMeasurementUpdate< 6, 1, 3 >( 100 );
+	testTransformRange();
+	testJosephForm();
+	testTiming( 10000 );
+}
@@ -0,0 +1,305 @@
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Quaternion.h>
+#include <utTracking/PoseKalmanFilter.h>
+#include <utTracking/PoseSmoother.h>
+#include <utTracking/PoseFilterBank.h>
+#include <utUtil/Exception.h>
+
+#include <vector>
+#include <algorithm>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+
+#include "../tools.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+static log4cpp::Category& filterLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.PoseKalmanFilter" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+Tracking::LinearPoseMotionModel motionModel()
+{
+	Tracking::LinearPoseMotionModel model( 1, 1 );
+	model.setPosPN( 0, 0.01 );
+	model.setPosPN( 1, 0.1 );
+	model.setOriPN( 0, 0.01 );
+	model.setOriPN( 1, 0.1 );
+	return model;
+}
+
+/** noisy measurements of a pose moving with constant velocity */
+std::vector< Measurement::ErrorPose > trajectory( const std::size_t n, const Measurement::Timestamp t0, const Measurement::Timestamp dt )
+{
+	const Vector< double, 3 > velocity( 0.1, -0.2, 0.05 );
+	const Quaternion angularVelocity( Vector< double, 3 >( 0, 0, 1 ), 0.3 );
+	const Matrix< double, 6, 6 > covariance( Matrix< double, 6, 6 >::identity() * 1e-4 );
+
+	std::vector< Measurement::ErrorPose > poses;
+	Vector< double, 3 > position( 0, 0, 1 );
+	Quaternion rotation;
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		const Quaternion noise( randomVector< double, 3 >( 0.01 ), 0.01 );
+		poses.push_back( Measurement::ErrorPose( t0 + i * dt, 
+			ErrorPose( rotation * noise, position + randomVector< double, 3 >( 0.01 ), covariance ) ) );
+
+		position += velocity * ( dt * 1e-9 );
+		rotation = rotation * Quaternion( Vector< double, 3 >( 0, 0, 1 ), 0.3 * dt * 1e-9 );
+	}
+	return poses;
+}
+
+void checkEqualState( const Tracking::PoseKalmanFilter& a, const Tracking::PoseKalmanFilter& b, const double eps )
+{
+	BOOST_CHECK_EQUAL( a.getTime(), b.getTime() );
+	BOOST_CHECK_SMALL( double( ublas::norm_2( a.getState() - b.getState() ) ), eps );
+	BOOST_CHECK_SMALL( double( ublas::norm_frobenius( a.getCovariance() - b.getCovariance() ) ), eps );
+}
+
+void testOutOfSequence()
+{
+	const Measurement::Timestamp dt( 10000000 ); // 10ms
+	const std::vector< Measurement::ErrorPose > poses( trajectory( 200, 1000000000ULL, dt ) );
+
+	// rotation measurements from a second, slower sensor with 35ms latency
+	std::vector< Measurement::Rotation > rotations;
+	for ( std::size_t i = 1; i < poses.size(); i += 3 )
+		rotations.push_back( Measurement::Rotation( poses[ i ].time() + dt / 2, poses[ i ]->rotation() ) );
+
+	// the rotations arrive 35ms late
+	Tracking::PoseKalmanFilter delayed( motionModel(), false, 100000000ULL );
+	std::size_t iDelayed = 0;
+	for ( std::size_t i = 0; i < poses.size(); i++ )
+	{
+		while ( iDelayed < rotations.size() && rotations[ iDelayed ].time() + 35000000ULL <= poses[ i ].time() )
+			delayed.addRotationMeasurement( rotations[ iDelayed++ ] );
+		delayed.addPoseMeasurement( poses[ i ] );
+	}
+
+	// must be the same as integrating the same measurements in the order of their timestamps
+	Tracking::PoseKalmanFilter reference( motionModel() );
+	for ( std::size_t i = 0, r = 0; i < poses.size(); i++ )
+	{
+		while ( r < iDelayed && rotations[ r ].time() < poses[ i ].time() )
+			reference.addRotationMeasurement( rotations[ r++ ] );
+		reference.addPoseMeasurement( poses[ i ] );
+	}
+	checkEqualState( reference, delayed, 1e-9 );
+
+	// measurements older than the lag window are discarded
+	Tracking::PoseKalmanFilter tooLate( delayed );
+	tooLate.addRotationMeasurement( Measurement::Rotation( delayed.getTime() - 200000000ULL, Quaternion() ) );
+	checkEqualState( tooLate, delayed, 0.0 );
+}
+
+void testSmoothing()
+{
+	const Measurement::Timestamp dt( 10000000 );
+	const Measurement::Timestamp t0( 1000000000ULL );
+	const std::vector< Measurement::ErrorPose > poses( trajectory( 100, t0, dt ) );
+
+	Tracking::PoseKalmanFilter filter( motionModel(), false, 500000000ULL );
+	Tracking::PoseKalmanFilter causal( motionModel() );
+	std::vector< Measurement::ErrorPose > filtered;
+	for ( std::size_t i = 0; i < poses.size(); i++ )
+	{
+		filter.addPoseMeasurement( poses[ i ] );
+		causal.addPoseMeasurement( poses[ i ] );
+		filtered.push_back( causal.predictPose( poses[ i ].time() ) );
+	}
+
+	// at the end of the window the smoother equals the filter
+	const Measurement::ErrorPose last( filter.smoothPose( filter.getTime() ) );
+	BOOST_CHECK_SMALL( double( ublas::norm_2( last->translation() - filtered.back()->translation() ) ), 1e-12 );
+
+	// inside the window the smoothed poses are more certain and closer to the truth
+	double filteredError = 0;
+	double smoothedError = 0;
+	for ( std::size_t i = 60; i < 90; i++ )
+	{
+		const Measurement::ErrorPose smoothed( filter.smoothPose( poses[ i ].time() ) );
+		const Vector< double, 3 > truth( Vector< double, 3 >( 0, 0, 1 ) + Vector< double, 3 >( 0.1, -0.2, 0.05 ) * ( i * dt * 1e-9 ) );
+		filteredError += ublas::norm_2( filtered[ i ]->translation() - truth );
+		smoothedError += ublas::norm_2( smoothed->translation() - truth );
+
+		double filteredTrace = 0;
+		double smoothedTrace = 0;
+		for ( std::size_t j = 0; j < 6; j++ )
+		{
+			filteredTrace += filtered[ i ]->covariance()( j, j );
+			smoothedTrace += smoothed->covariance()( j, j );
+		}
+		BOOST_CHECK( smoothedTrace < filteredTrace );
+	}
+	BOOST_CHECK( smoothedError < filteredError );
+
+	// between measurements
+	const Measurement::ErrorPose between( filter.smoothPose( poses[ 80 ].time() + dt / 2 ) );
+	const Measurement::ErrorPose before( filter.smoothPose( poses[ 80 ].time() ) );
+	const Measurement::ErrorPose after( filter.smoothPose( poses[ 81 ].time() ) );
+	BOOST_CHECK_SMALL( double( ublas::norm_2( between->translation() - ( before->translation() + after->translation() ) * 0.5 ) ), 1e-3 );
+
+	// outside of the window
+	BOOST_CHECK_THROW( filter.smoothPose( t0 ), Ubitrack::Util::Exception );
+
+	// after the last measurement, also when the filter has been updated to a later time
+	const Measurement::Timestamp tLast( filter.getTime() );
+	filter.timeUpdate( tLast + 2 * dt );
+	for ( Measurement::Timestamp t = tLast; t <= tLast + 3 * dt; t += dt / 2 )
+	{
+		const Measurement::ErrorPose smoothed( filter.smoothPose( t ) );
+		const Measurement::ErrorPose predicted( causal.predictPose( t ) );
+		BOOST_CHECK_EQUAL( smoothed.time(), t );
+		BOOST_CHECK_SMALL( double( ublas::norm_2( smoothed->translation() - predicted->translation() ) ), 1e-9 );
+		BOOST_CHECK_SMALL( double( ublas::norm_frobenius( smoothed->covariance() - predicted->covariance() ) ), 1e-9 );
+	}
+}
+
+void testBatchSmoother()
+{
+	const Measurement::Timestamp dt( 10000000 );
+	const std::vector< Measurement::ErrorPose > poses( trajectory( 300, 1000000000ULL, dt ) );
+
+	// chunked result must not depend on the chunk size
+	const std::vector< Measurement::ErrorPose > smoothed( Tracking::PoseSmoother( motionModel(), false, 7 ).smooth( poses ) );
+	const std::vector< Measurement::ErrorPose > smoothedOnce( Tracking::PoseSmoother( motionModel(), false, 1000 ).smooth( poses ) );
+	BOOST_REQUIRE_EQUAL( smoothed.size(), poses.size() );
+
+	// same as the smoother of the filter with a lag window covering the whole sequence
+	Tracking::PoseKalmanFilter filter( motionModel(), false, 10000000000ULL, 1000 );
+	for ( std::size_t i = 0; i < poses.size(); i++ )
+		filter.addPoseMeasurement( poses[ i ] );
+
+	double measuredError = 0;
+	double smoothedError = 0;
+	for ( std::size_t i = 0; i < poses.size(); i++ )
+	{
+		BOOST_CHECK_EQUAL( smoothed[ i ].time(), poses[ i ].time() );
+		BOOST_CHECK_SMALL( double( ublas::norm_2( smoothed[ i ]->translation() - smoothedOnce[ i ]->translation() ) ), 1e-12 );
+		BOOST_CHECK_SMALL( double( ublas::norm_frobenius( smoothed[ i ]->covariance() - smoothedOnce[ i ]->covariance() ) ), 1e-12 );
+
+		const Measurement::ErrorPose windowed( filter.smoothPose( poses[ i ].time() ) );
+		BOOST_CHECK_SMALL( double( ublas::norm_2( smoothed[ i ]->translation() - windowed->translation() ) ), 1e-9 );
+
+		const Vector< double, 3 > truth( Vector< double, 3 >( 0, 0, 1 ) + Vector< double, 3 >( 0.1, -0.2, 0.05 ) * ( i * dt * 1e-9 ) );
+		measuredError += ublas::norm_2( poses[ i ]->translation() - truth );
+		smoothedError += ublas::norm_2( smoothed[ i ]->translation() - truth );
+	}
+	BOOST_CHECK( smoothedError < 0.5 * measuredError );
+	BOOST_TEST_MESSAGE( "mean position error: measured " << measuredError / poses.size() << ", smoothed " << smoothedError / poses.size() );
+}
+
+void testFilterBank( const std::size_t nTargets, const std::size_t frames )
+{
+	const Measurement::Timestamp dt( 10000000 );
+	std::vector< std::vector< Measurement::ErrorPose > > poses;
+	for ( std::size_t i = 0; i < nTargets; i++ )
+		poses.push_back( trajectory( frames, 1000000000ULL, dt ) );
+
+	std::vector< Tracking::PoseKalmanFilter > filters( nTargets, Tracking::PoseKalmanFilter( motionModel() ) );
+	Tracking::PoseFilterBank bank( motionModel(), nTargets );
+	Tracking::PoseFilterBank threadedBank( motionModel(), nTargets, false, 2 );
+
+	Ubitrack::Util::BlockTimer filterTimer( "PoseKalmanFilter", filterLogger );
+	Ubitrack::Util::BlockTimer bankTimer( "PoseFilterBank", filterLogger );
+	std::vector< std::size_t > targets;
+	std::vector< Measurement::ErrorPose > framePoses;
+	for ( std::size_t f = 0; f < frames; f++ )
+	{
+		// every third target is missing in every other frame
+		targets.clear();
+		framePoses.clear();
+		for ( std::size_t i = 0; i < nTargets; i++ )
+			if ( i % 3 != 0 || f % 2 == 0 )
+			{
+				targets.push_back( i );
+				framePoses.push_back( poses[ i ][ f ] );
+			}
+
+		{
+			UBITRACK_TIME( filterTimer );
+			for ( std::size_t i = 0; i < nTargets; i++ )
+				if ( filters[ i ].getTime() )
+					filters[ i ].timeUpdate( poses[ i ][ f ].time() );
+			for ( std::size_t i = 0; i < targets.size(); i++ )
+				filters[ targets[ i ] ].addPoseMeasurement( framePoses[ i ] );
+		}
+		{
+			UBITRACK_TIME( bankTimer );
+			bank.timeUpdate( poses[ 0 ][ f ].time() );
+			bank.addPoseMeasurements( targets, framePoses );
+		}
+		threadedBank.timeUpdate( poses[ 0 ][ f ].time() );
+		threadedBank.addPoseMeasurements( targets, framePoses );
+	}
+
+	for ( std::size_t i = 0; i < nTargets; i++ )
+	{
+		BOOST_CHECK_EQUAL( bank.getTime( i ), filters[ i ].getTime() );
+		BOOST_CHECK_SMALL( double( ublas::norm_2( bank.getState( i ) - filters[ i ].getState() ) ), 1e-9 );
+		BOOST_CHECK_SMALL( double( ublas::norm_frobenius( bank.getCovariance( i ) - filters[ i ].getCovariance() ) ), 1e-9 );
+		BOOST_CHECK_EQUAL( double( ublas::norm_2( bank.getState( i ) - threadedBank.getState( i ) ) ), 0.0 );
+
+		const Measurement::ErrorPose predicted( bank.predictPose( i, bank.getTime( i ) + dt ) );
+		const Measurement::ErrorPose reference( filters[ i ].predictPose( bank.getTime( i ) + dt ) );
+		BOOST_CHECK_SMALL( double( ublas::norm_2( predicted->translation() - reference->translation() ) ), 1e-9 );
+	}
+
+	BOOST_TEST_MESSAGE( nTargets << " targets: PoseKalmanFilter " << filterTimer.getTotalTime() / frames 
+		<< "ms, PoseFilterBank " << bankTimer.getTotalTime() / frames << "ms per frame" );
+}
+
+void testFilterBankBatches()
+{
+	// empty banks and batches
+	Tracking::PoseFilterBank empty( motionModel(), 0, false, 4 );
+	empty.timeUpdate( 1000000000ULL );
+	empty.addPoseMeasurements( std::vector< std::size_t >(), std::vector< Measurement::ErrorPose >() );
+	BOOST_CHECK_EQUAL( empty.size(), 0u );
+
+	// more threads than targets
+	const std::vector< Measurement::ErrorPose > poses( trajectory( 3, 1000000000ULL, 10000000 ) );
+	Tracking::PoseFilterBank bank( motionModel(), 2, false, 4 );
+	std::vector< std::size_t > targets( 1, 1 );
+	std::vector< Measurement::ErrorPose > batch( 1, poses[ 0 ] );
+	bank.addPoseMeasurements( targets, batch );
+	bank.timeUpdate( poses[ 1 ].time() );
+	BOOST_CHECK_EQUAL( bank.getTime( 0 ), Measurement::Timestamp( 0 ) );
+	BOOST_CHECK_EQUAL( bank.getTime( 1 ), poses[ 1 ].time() );
+
+	// duplicate and invalid indices are rejected without changing any filter
+	const Tracking::PoseFilterBank::StateType state( bank.getState( 1 ) );
+	targets.push_back( 0 );
+	targets.push_back( 1 );
+	batch.assign( 3, poses[ 2 ] );
+	BOOST_CHECK_THROW( bank.addPoseMeasurements( targets, batch ), Ubitrack::Util::Exception );
+	targets[ 2 ] = 2;
+	BOOST_CHECK_THROW( bank.addPoseMeasurements( targets, batch ), Ubitrack::Util::Exception );
+	BOOST_CHECK_EQUAL( bank.getTime( 0 ), Measurement::Timestamp( 0 ) );
+	BOOST_CHECK_EQUAL( double( ublas::norm_2( bank.getState( 1 ) - state ) ), 0.0 );
+
+	// the flags of rejected batches are cleared
+	targets.pop_back();
+	batch.pop_back();
+	bank.addPoseMeasurements( targets, batch );
+	BOOST_CHECK_EQUAL( bank.getTime( 0 ), poses[ 2 ].time() );
+	BOOST_CHECK_EQUAL( bank.getTime( 1 ), poses[ 2 ].time() );
+}
+
+} // anonymous namespace
+
+void TestPoseKalmanFilter()
+{
+	testOutOfSequence();
+	testSmoothing();
+	testBatchSmoother();
+	testFilterBank( 50, 100 );
+	testFilterBankBatches();
+}
@@ -2,7 +2,11 @@
 
 // declare external tests here, to save us some trivial header files
 void TestKMeans();
+void TestKMeansAccelerated();
 void TestExpectationMaximization();
+void TestExpectationMaximizationBlocked();
+void TestKalmanFilter();
+void TestPoseKalmanFilter();
 
 
 
@@ -10,5 +14,9 @@ StochasticTest::StochasticTest()
 	: boost::unit_test::test_suite( "StochasticTests" )
 {
 	add( BOOST_TEST_CASE( &TestKMeans ) );
+	add( BOOST_TEST_CASE( &TestKMeansAccelerated ) );
 	add( BOOST_TEST_CASE( &TestExpectationMaximization ) );
+	add( BOOST_TEST_CASE( &TestExpectationMaximizationBlocked ) );
+	add( BOOST_TEST_CASE( &TestKalmanFilter ) );
+	add( BOOST_TEST_CASE( &TestPoseKalmanFilter ) );
 }
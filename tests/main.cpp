@@ -7,6 +7,7 @@
 #include "Stochastic/StochasticTest.h"
 #include "Algorithm/AlgorithmTest.h"
 #include "Serializer/SerializerTest.h"
+#include "Measurement/MeasurementTest.h"
 
 using boost::unit_test::test_suite;
 
@@ -28,6 +29,7 @@ test_suite* init_unit_test_suite( int, char* [] )
 	allTests->add( new StochasticTest );
 	allTests->add( new AlgorithmTest );
 	allTests->add( new SerializerTest );
+	allTests->add( new MeasurementTest );
 
 	return allTests;
 }